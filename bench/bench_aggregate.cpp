@@ -0,0 +1,80 @@
+// Throughput of aggregate() on one thread and on a pool, against materializing every value as a
+// msgpack_object with Msgpack::at_path.
+//
+// usage: msgpacksearch_bench_aggregate [file.msgpack [threads]]
+//        the file is a stream of concatenated records.
+//        without a file, 300k synthetic records are generated.
+//        threads defaults to std::thread::hardware_concurrency().
+
+#include "bench_util.h"
+
+#include <aggregate.h>
+#include <json.h>
+#include <msgpacksearch.h>
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        // one record per document: drop the array 32 header json_to_msgpack puts around them
+        data = json_to_msgpack(bench::generate_json_records(300000));
+        data.erase(data.begin(), data.begin() + 5);
+    }
+
+    aggregate_query query;
+    query.value_path = "latency";
+    query.group_by = "level";
+    query.histogram = histogram_spec{0, 500, 50};
+
+    aggregate_result result;
+
+    double single = bench::best_of(5, [&] { result = aggregate(data.data(), data.size(), query); });
+    size_t records = result.total.records;
+
+    ThreadPool pool(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0);
+    double pooled = bench::best_of(5, [&] { result = aggregate(data.data(), data.size(), query, &pool); });
+
+    std::map<std::string, numeric_aggregate> groups;
+
+    double materialized = bench::best_of(5, [&] {
+        groups.clear();
+        for (size_t offset = 0; offset < data.size(); offset += Msgpack::skip_object(data.data() + offset))
+        {
+            Msgpack record(data.data() + offset, data.size() - offset);
+            msgpack_object value = record.at_path(query.value_path);
+            msgpack_object key = record.at_path(query.group_by);
+            const msgpack_str *key_str = std::get_if<msgpack_str>(&key);
+            numeric_aggregate &group = groups[key_str ? std::string(key_str->data, key_str->size) : "null"];
+
+            group.records++;
+            if (const double *d = std::get_if<double>(&value))
+                group.add(*d);
+            else if (const uint64_t *u = std::get_if<uint64_t>(&value))
+                group.add(static_cast<double>(*u));
+            else if (const int64_t *i = std::get_if<int64_t>(&value))
+                group.add(static_cast<double>(*i));
+        }
+    });
+
+    bench::report("aggregate, 1 thread", single, data.size(), records);
+    bench::report(("aggregate, " + std::to_string(pool.size()) + " threads").c_str(), pooled, data.size(), records);
+    bench::report("at_path + msgpack_object", materialized, data.size(), records);
+    std::printf("1 thread / materialized: %.2fx, %zu threads / 1 thread: %.2fx\n",
+                materialized / single, pool.size(), single / pooled);
+
+    return 0;
+}
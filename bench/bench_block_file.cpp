@@ -0,0 +1,120 @@
+// Cost of querying a compressed record stream: decompressing every block against decompressing only
+// the blocks whose min / max of an indexed path overlap the query, on one thread and on a pool, and
+// filters pushed down to the zone maps of the blocks.
+//
+// usage: msgpacksearch_bench_block_file [threads]
+//        300k synthetic records are written with every codec of the build, indexed on "ts" with zone
+//        maps of "ts", "id", "user_id" and "meta.host".
+//        threads defaults to std::thread::hardware_concurrency().
+
+#include "bench_util.h"
+
+#include <block_file.h>
+#include <json.h>
+#include <msgpacksearch.h>
+#include <thread_pool.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data = json_to_msgpack(bench::generate_json_records(300000));
+    Cursor root(data.data(), data.size());
+    ThreadPool pool(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 0);
+
+    // 1% of the time range, in the middle of the stream
+    const double from = 1600000000000.0 + 150000 * 37.0;
+    const double until = from + 3000 * 37.0;
+
+    for (block_codec codec : {block_codec::none, block_codec::zstd, block_codec::lz4})
+    {
+        if (!codec_available(codec))
+            continue;
+
+        const char *name = codec == block_codec::none ? "none" : codec == block_codec::zstd ? "zstd" : "lz4";
+        std::string path = std::string("/tmp/msgpacksearch_bench_block_file.") + name;
+
+        block_writer_options options;
+        options.codec = codec;
+        options.block_bytes = 256 << 10;
+        options.indexed_path = "ts";
+        options.zone_paths = {"ts", "id", "user_id", "meta.host"};
+
+        double written = bench::best_of(1, [&] {
+            BlockWriter writer(path, options);
+            for (Cursor record = root.at(0); record; record = record.next_sibling())
+                writer.append(record.data(), record.length());
+            writer.finish();
+        });
+
+        BlockFile file(path);
+        std::vector<size_t> all(file.blocks());
+        std::iota(all.begin(), all.end(), 0);
+
+        size_t matches = 0;
+        auto count_matches = [&matches, from, until](const Msgpack &record, uint64_t) {
+            std::optional<double> ts = record.try_get_double("ts");
+            matches += ts && *ts >= from && *ts <= until;
+            return true;
+        };
+
+        double full = bench::best_of(3, [&] { matches = 0; file.scan(all, count_matches); });
+        double pooled = bench::best_of(3, [&] { matches = 0; file.scan(all, count_matches, &pool); });
+        std::vector<size_t> selected = file.blocks_in_range(from, until);
+        double pruned = bench::best_of(3, [&] { matches = 0; file.scan(selected, count_matches, &pool); });
+
+        std::printf("codec %s: %zu blocks, %.1f MB -> %.1f MB\n", name, file.blocks(), data.size() / 1e6, file.file().size() / 1e6);
+        bench::report("write", written, data.size(), file.records());
+        bench::report("scan all blocks, 1 thread", full, data.size(), file.records());
+        bench::report(("scan all blocks, " + std::to_string(pool.size()) + " threads").c_str(), pooled, data.size(), file.records());
+        bench::report("scan blocks in range", pruned, data.size(), file.records());
+        std::printf("%zu matches in %zu blocks, pruned / full: %.1fx faster\n", matches, selected.size(), full / pruned);
+
+        // the same filters evaluated on every record of a file without zone maps, and pushed down to them
+        std::string plain_path = path + ".plain";
+        options.zone_paths.clear();
+        {
+            BlockWriter writer(plain_path, options);
+            for (Cursor record = root.at(0); record; record = record.next_sibling())
+                writer.append(record.data(), record.length());
+            writer.finish();
+        }
+        BlockFile plain(plain_path);
+
+        using op_type = block_predicate::op_type;
+        const std::vector<std::pair<const char *, std::vector<block_predicate>>> filters = {
+            {"id = 123456", {{"id", op_type::eq, 123456.0}}},
+            {"user_id = 5000 (absent)", {{"user_id", op_type::eq, 5000.0}}},
+            {"ts in 1% range, host node-5", {{"ts", op_type::ge, from}, {"ts", op_type::le, until}, {"meta.host", op_type::eq, std::string("node-5")}}},
+            {"host node-5", {{"meta.host", op_type::eq, std::string("node-5")}}},
+        };
+
+        for (const auto &[filter, predicates] : filters)
+        {
+            size_t filtered = 0;
+            auto count = [&filtered](const Msgpack &, uint64_t) { filtered++; return true; };
+
+            double every = bench::best_of(3, [&] { filtered = 0; plain.scan_where(predicates, count, &pool); });
+            double pushed = bench::best_of(3, [&] { filtered = 0; file.scan_where(predicates, count, &pool); });
+
+            bench::report((std::string(filter) + ", every block").c_str(), every, data.size(), file.records());
+            bench::report((std::string(filter) + ", zone maps").c_str(), pushed, data.size(), file.records());
+            std::printf("%zu matches, %zu / %zu blocks read, %.1fx faster\n", filtered,
+                        file.blocks_matching(predicates).size(), file.blocks(), every / pushed);
+        }
+
+        std::printf("\n");
+
+        std::remove(path.c_str());
+        std::remove(plain_path.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+// Cost of routing on a header field of huge messages: Cursor::child against find_key_bounded with a
+// byte budget, for a key near the start and for a missing key.
+//
+// usage: msgpacksearch_bench_bounded_lookup [nmb_members]
+//        messages are maps of nmb_members members (100k by default) with the routing key first.
+
+#include "bench_util.h"
+
+#include <cursor.h>
+#include <packer.h>
+#include <path.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    const size_t nmb_members = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const size_t nmb_lookups = 1000;
+
+    std::vector<uint8_t> message;
+    Packer packer(message);
+    packer.pack_map(nmb_members);
+    packer.pack_str("route");
+    packer.pack_str("billing");
+    for (size_t member = 1; member < nmb_members; member++)
+    {
+        packer.pack_str("field" + std::to_string(member));
+        packer.pack_uint(member);
+    }
+
+    lookup_budget budget;
+    budget.max_bytes = 4096;
+
+    size_t found = 0;
+    auto cursor_lookup = [&](const char *key) {
+        return bench::best_of(5, [&] {
+            found = 0;
+            for (size_t lookup = 0; lookup < nmb_lookups; lookup++)
+                found += Cursor(message.data(), message.size()).child(key).valid();
+        });
+    };
+    auto bounded_lookup = [&](const char *key) {
+        return bench::best_of(5, [&] {
+            found = 0;
+            for (size_t lookup = 0; lookup < nmb_lookups; lookup++)
+                found += find_key_bounded(message.data(), message.size(), key, budget).status == lookup_status::found;
+        });
+    };
+
+    double present = cursor_lookup("route");
+    double present_bounded = bounded_lookup("route");
+    double missing = cursor_lookup("absent");
+    double missing_bounded = bounded_lookup("absent");
+
+    bench::report("Cursor::child, first key", present, 0, nmb_lookups);
+    bench::report("find_key_bounded, first key", present_bounded, 0, nmb_lookups);
+    bench::report("Cursor::child, missing key", missing, message.size() * nmb_lookups, nmb_lookups);
+    bench::report("find_key_bounded 4 KiB, missing key", missing_bounded, 0, nmb_lookups);
+    std::printf("missing key, full scan / bounded: %.1fx\n", missing / missing_bounded);
+
+    return 0;
+}
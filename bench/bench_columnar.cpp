@@ -0,0 +1,93 @@
+// Rows/sec of the columnar extractor against one follow_path lookup per column and record.
+//
+// usage: msgpacksearch_bench_columnar [file.msgpack]
+//        the file is a stream of concatenated records.
+//        without a file, 300k synthetic records are generated.
+
+#include "bench_util.h"
+
+#include <columnar.h>
+#include <decode.h>
+#include <json.h>
+#include <msgpacksearch.h>
+
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        // one record per document: drop the array 32 header json_to_msgpack puts around them
+        data = json_to_msgpack(bench::generate_json_records(300000));
+        data.erase(data.begin(), data.begin() + 5);
+    }
+
+    const std::vector<column_spec> specs = {{"ts", column_type::int64},
+                                            {"latency", column_type::float64},
+                                            {"level", column_type::string},
+                                            {"meta.host", column_type::string}};
+    const size_t batch_rows = 4096;
+
+    ColumnarExtractor extractor(specs);
+    record_batch batch = extractor.make_batch(batch_rows);
+    size_t rows = 0;
+
+    double columnar = bench::best_of(5, [&] {
+        rows = 0;
+        for (size_t offset = 0; offset < data.size();)
+        {
+            batch.clear();
+            offset += extractor.extract(data.data() + offset, data.size() - offset, batch, batch_rows);
+            rows += batch.rows;
+        }
+    });
+
+    std::vector<msgpack_path> paths;
+    for (const column_spec &spec : specs)
+        paths.push_back(parse_path(spec.path));
+
+    std::vector<int64_t> ts;
+    std::vector<double> latency;
+    std::vector<std::string_view> level;
+    std::vector<std::string_view> host;
+
+    double per_path = bench::best_of(5, [&] {
+        ts.clear();
+        latency.clear();
+        level.clear();
+        host.clear();
+        for (size_t offset = 0; offset < data.size();)
+        {
+            Cursor record(data.data() + offset, data.size() - offset);
+            int64_t i = 0;
+            double d = 0;
+            std::string_view s;
+
+            Cursor value = follow_path(record, paths[0]);
+            ts.push_back(value && read_i64(value.data(), i) ? i : 0);
+            value = follow_path(record, paths[1]);
+            latency.push_back(value && read_double(value.data(), d) ? d : 0);
+            value = follow_path(record, paths[2]);
+            level.push_back(value && read_str(value.data(), s) ? s : std::string_view());
+            value = follow_path(record, paths[3]);
+            host.push_back(value && read_str(value.data(), s) ? s : std::string_view());
+
+            offset += record.length();
+        }
+    });
+
+    bench::report("ColumnarExtractor, 4 columns", columnar, data.size(), rows);
+    bench::report("follow_path per column", per_path, data.size(), ts.size());
+    std::printf("columnar / per path: %.2fx\n", per_path / columnar);
+
+    return 0;
+}
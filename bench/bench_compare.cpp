@@ -0,0 +1,119 @@
+// Cost of comparing and hashing records straight from their encoded bytes, against canonicalizing
+// both sides first. The second stream holds the same records in canonical form: other key order,
+// smaller headers.
+//
+// usage: msgpacksearch_bench_compare [file.msgpack]
+//        the file is a stream of concatenated records.
+//        without a file, 300k synthetic records are generated.
+
+#include "bench_util.h"
+
+#include <canonical.h>
+#include <compare.h>
+#include <json.h>
+#include <msgpacksearch.h>
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        // one record per document: drop the array 32 header json_to_msgpack puts around them
+        data = json_to_msgpack(bench::generate_json_records(300000));
+        data.erase(data.begin(), data.begin() + 5);
+    }
+
+    std::vector<const uint8_t *> records;
+    std::vector<uint8_t> canonical;
+    std::vector<size_t> canonical_offsets;
+
+    for (size_t offset = 0; offset < data.size(); offset += Msgpack::skip_object(data.data() + offset))
+    {
+        records.push_back(data.data() + offset);
+        canonical_offsets.push_back(canonical.size());
+        canonicalize(data.data() + offset, data.size() - offset, canonical);
+    }
+
+    std::vector<uint8_t> copy = data;
+    size_t matches = 0;
+
+    double identical = bench::best_of(5, [&] {
+        matches = 0;
+        for (const uint8_t *record : records)
+            matches += equal(record, copy.data() + (record - data.data()));
+    });
+
+    double canonical_memcmp = bench::best_of(5, [&] {
+        matches = 0;
+        for (size_t offset : canonical_offsets)
+            matches += equal(canonical.data() + offset, canonical.data() + offset, true);
+    });
+
+    double semantic = bench::best_of(5, [&] {
+        matches = 0;
+        for (size_t record = 0; record < records.size(); record++)
+            matches += equal(records[record], canonical.data() + canonical_offsets[record]);
+    });
+
+    std::vector<uint8_t> a;
+    std::vector<uint8_t> b;
+    double materialized = bench::best_of(5, [&] {
+        matches = 0;
+        for (size_t record = 0; record < records.size(); record++)
+        {
+            a.clear();
+            b.clear();
+            canonicalize(records[record], data.size(), a);
+            canonicalize(canonical.data() + canonical_offsets[record], canonical.size(), b);
+            matches += a == b;
+        }
+    });
+
+    uint64_t sum = 0;
+    double hashed = bench::best_of(5, [&] {
+        sum = 0;
+        for (const uint8_t *record : records)
+            sum += hash(record);
+    });
+
+    // hash join of the two streams on the whole record
+    std::unordered_multimap<uint64_t, const uint8_t *> table;
+    double join = bench::best_of(3, [&] {
+        table.clear();
+        table.reserve(records.size());
+        for (const uint8_t *record : records)
+            table.emplace(hash(record), record);
+
+        matches = 0;
+        for (size_t offset : canonical_offsets)
+        {
+            const uint8_t *probe = canonical.data() + offset;
+            auto range = table.equal_range(hash(probe));
+            for (auto it = range.first; it != range.second; ++it)
+                matches += equal(it->second, probe);
+        }
+    });
+
+    bench::report("equal, identical bytes", identical, data.size(), records.size());
+    bench::report("equal, canonical memcmp", canonical_memcmp, canonical.size(), records.size());
+    bench::report("equal, semantic", semantic, data.size(), records.size());
+    bench::report("canonicalize both + compare", materialized, data.size(), records.size());
+    bench::report("hash", hashed, data.size(), records.size());
+    bench::report("hash join", join, data.size() + canonical.size(), records.size());
+    std::printf("join matches: %zu / %zu, canonicalize both / semantic equal: %.2fx\n",
+                matches, records.size(), materialized / semantic);
+
+    return 0;
+}
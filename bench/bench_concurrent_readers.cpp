@@ -0,0 +1,91 @@
+// Many threads querying one shared const Msgpack view of a large blob, plain and with a tape attached.
+//
+// usage: msgpacksearch_bench_concurrent_readers [max threads]
+//        the blob is a map of 20k records; every thread runs the same number of path lookups. scaling is the
+//        aggregate throughput relative to one thread: linear scaling reads n with n threads on n cores.
+
+#include "bench_util.h"
+
+#include <json.h>
+#include <msgpacksearch.h>
+#include <tape.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// Runs lookups_per_thread lookups in every thread, returns the wall time in seconds
+double run(const Msgpack &view, const std::vector<std::string> &paths, unsigned nmb_threads, size_t lookups_per_thread)
+{
+    return bench::best_of(3, [&] {
+        std::vector<std::thread> threads;
+
+        for (unsigned t = 0; t < nmb_threads; t++)
+        {
+            threads.emplace_back([&view, &paths, lookups_per_thread, t] {
+                size_t found = 0;
+                for (size_t i = 0; i < lookups_per_thread; i++)
+                    found += view.find_path(paths[(i * 7919 + t) % paths.size()]) != nullptr;
+                if (found != lookups_per_thread)
+                    std::abort();
+            });
+        }
+
+        for (std::thread &thread : threads)
+            thread.join();
+    });
+}
+
+}
+
+int main(int argc, const char *argv[])
+{
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned max_threads = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : std::max(4u, cores);
+    const size_t nmb_records = 20000;
+
+    std::string json = "{";
+    for (size_t i = 0; i < nmb_records; i++)
+        json += (i ? ",\"r" : "\"r") + std::to_string(i) + "\":{\"id\":" + std::to_string(i) + ",\"tags\":[\"a\",\"b\",\"c\"],\"score\":" + std::to_string(i % 100) + "}";
+    json += "}";
+
+    std::vector<uint8_t> data = json_to_msgpack(json);
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < nmb_records; i += 97)
+        paths.push_back("r" + std::to_string(i) + ".tags[2]");
+
+    Msgpack plain(data);
+    Msgpack taped(data);
+    taped.set_tape(std::make_shared<const Tape>(data.data(), data.size()));
+
+    std::printf("%u hardware threads, %zu byte blob\n", cores, data.size());
+
+    struct { const char *name; const Msgpack &view; size_t lookups; } configs[] = {
+        {"plain view", plain, 100},
+        {"view with a tape", taped, 2000},
+    };
+
+    for (const auto &config : configs)
+    {
+        double single = 0;
+
+        for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+        {
+            double seconds = run(config.view, paths, threads, config.lookups);
+            if (threads == 1)
+                single = seconds;
+
+            std::string name = std::string(config.name) + ", " + std::to_string(threads) + " threads";
+            std::printf("%-40s %10.3f ms %12.0f lookups/s  scaling %.2f\n", name.c_str(), seconds * 1e3,
+                        threads * config.lookups / seconds, threads * single / seconds);
+        }
+    }
+
+    return 0;
+}
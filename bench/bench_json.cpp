@@ -0,0 +1,207 @@
+// Compares the streaming JSON -> msgpack transcoder with a DOM-parse-then-encode baseline.
+//
+// usage: msgpacksearch_bench_json [file.json]
+//        without a file, a synthetic array of 200k records is generated.
+
+#include "bench_util.h"
+
+#include <json.h>
+#include <packer.h>
+
+#include <charconv>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace msgpacksearch;
+
+namespace {
+
+// Minimal DOM, shaped like what a typical JSON library would hand us
+struct dom_value;
+using dom_array = std::vector<dom_value>;
+using dom_object = std::vector<std::pair<std::string, dom_value>>;
+
+struct dom_value
+{
+    std::variant<std::nullptr_t, bool, int64_t, double, std::string,
+                 std::unique_ptr<dom_array>, std::unique_ptr<dom_object>> value;
+};
+
+class DomParser {
+
+public:
+    explicit DomParser(const std::string &json) : _pos(json.data()), _end(json.data() + json.size()) {}
+
+    dom_value parse()
+    {
+        ws();
+        dom_value v;
+
+        switch (*_pos)
+        {
+            case '{':
+            {
+                ++_pos;
+                auto object = std::make_unique<dom_object>();
+                ws();
+                if (*_pos == '}') { ++_pos; v.value = std::move(object); return v; }
+                while (true)
+                {
+                    ws();
+                    std::string key = string();
+                    ws(); ++_pos; // ':'
+                    object->emplace_back(std::move(key), parse());
+                    ws();
+                    if (*_pos++ == '}') break;
+                }
+                v.value = std::move(object);
+                return v;
+            }
+            case '[':
+            {
+                ++_pos;
+                auto array = std::make_unique<dom_array>();
+                ws();
+                if (*_pos == ']') { ++_pos; v.value = std::move(array); return v; }
+                while (true)
+                {
+                    array->push_back(parse());
+                    ws();
+                    if (*_pos++ == ']') break;
+                }
+                v.value = std::move(array);
+                return v;
+            }
+            case '"': v.value = string(); return v;
+            case 't': _pos += 4; v.value = true; return v;
+            case 'f': _pos += 5; v.value = false; return v;
+            case 'n': _pos += 4; v.value = nullptr; return v;
+            default:
+            {
+                const char *start = _pos;
+                bool is_integer = true;
+                while (_pos < _end && (std::isdigit(*_pos) || *_pos == '-' || *_pos == '+' || *_pos == '.' || *_pos == 'e' || *_pos == 'E'))
+                {
+                    if (*_pos == '.' || *_pos == 'e' || *_pos == 'E')
+                        is_integer = false;
+                    ++_pos;
+                }
+                if (is_integer)
+                {
+                    int64_t i;
+                    std::from_chars(start, _pos, i);
+                    v.value = i;
+                }
+                else
+                {
+                    double d;
+                    std::from_chars(start, _pos, d);
+                    v.value = d;
+                }
+                return v;
+            }
+        }
+    }
+
+private:
+    void ws()
+    {
+        while (_pos < _end && (*_pos == ' ' || *_pos == '\n' || *_pos == '\r' || *_pos == '\t'))
+            ++_pos;
+    }
+
+    std::string string()
+    {
+        std::string s;
+        ++_pos;
+        while (*_pos != '"')
+        {
+            if (*_pos == '\\')
+            {
+                ++_pos;
+                switch (*_pos)
+                {
+                    case 'n': s.push_back('\n'); break;
+                    case 't': s.push_back('\t'); break;
+                    default: s.push_back(*_pos);
+                }
+                ++_pos;
+                continue;
+            }
+            s.push_back(*_pos++);
+        }
+        ++_pos;
+        return s;
+    }
+
+    const char *_pos;
+    const char *_end;
+};
+
+void encode(const dom_value &v, Packer &packer)
+{
+    std::visit([&](auto &&value) {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, std::nullptr_t>)
+            packer.pack_nil();
+        else if constexpr (std::is_same_v<T, bool>)
+            packer.pack_bool(value);
+        else if constexpr (std::is_same_v<T, int64_t>)
+            packer.pack_int(value);
+        else if constexpr (std::is_same_v<T, double>)
+            packer.pack_double(value);
+        else if constexpr (std::is_same_v<T, std::string>)
+            packer.pack_str(value);
+        else if constexpr (std::is_same_v<T, std::unique_ptr<dom_array>>)
+        {
+            packer.pack_array(value->size());
+            for (const auto &element : *value)
+                encode(element, packer);
+        }
+        else
+        {
+            packer.pack_map(value->size());
+            for (const auto &[key, element] : *value)
+            {
+                packer.pack_str(key);
+                encode(element, packer);
+            }
+        }
+    }, v.value);
+}
+
+}
+
+int main(int argc, const char *argv[])
+{
+    std::string json = argc > 1 ? bench::read_file(argv[1]) : bench::generate_json_records(200000);
+    std::printf("input: %zu bytes of JSON\n", json.size());
+
+    std::vector<uint8_t> out;
+    out.reserve(json.size());
+
+    double transcode = bench::best_of(5, [&] {
+        out.clear();
+        json_to_msgpack(json, out);
+    });
+    size_t transcoded_size = out.size();
+
+    double dom = bench::best_of(5, [&] {
+        out.clear();
+        DomParser parser(json);
+        dom_value root = parser.parse();
+        Packer packer(out);
+        encode(root, packer);
+    });
+
+    bench::report("json_to_msgpack (streaming)", transcode, json.size());
+    bench::report("DOM parse + encode (baseline)", dom, json.size());
+    std::printf("output: %zu bytes streaming, %zu bytes baseline, speedup %.2fx\n",
+                transcoded_size, out.size(), dom / transcode);
+
+    return 0;
+}
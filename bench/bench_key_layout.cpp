@@ -0,0 +1,78 @@
+// Cost of looking up a few fields in every record of a homogeneous stream: key by key with
+// find_map_key (through Cursor::child), against a LayoutPredictor verifying each record's layout
+// against the previous one and finding interned key ids at their predicted offsets.
+//
+// usage: msgpacksearch_bench_key_layout [file.msgpack]
+//        the file is a stream of concatenated records.
+//        without a file, 300k synthetic records are generated.
+
+#include "bench_util.h"
+
+#include <cursor.h>
+#include <json.h>
+#include <key_layout.h>
+#include <msgpacksearch.h>
+
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        // one record per document: drop the array 32 header json_to_msgpack puts around them
+        data = json_to_msgpack(bench::generate_json_records(300000));
+        data.erase(data.begin(), data.begin() + 5);
+    }
+
+    std::vector<const uint8_t *> records;
+    for (size_t offset = 0; offset < data.size(); offset += Msgpack::skip_object(data.data() + offset))
+        records.push_back(data.data() + offset);
+
+    const uint8_t *end = data.data() + data.size();
+    const std::vector<std::string> keys = {"user_id", "latency", "ok", "msg"};
+    uint64_t found = 0;
+
+    double scanned = bench::best_of(5, [&] {
+        found = 0;
+        for (const uint8_t *record : records)
+        {
+            Cursor cursor(record, end - record);
+            for (const std::string &key : keys)
+                found += static_cast<bool>(cursor.child(key));
+        }
+    });
+
+    LayoutPredictor predictor;
+    std::vector<uint32_t> ids;
+    for (const std::string &key : keys)
+        ids.push_back(predictor.dictionary().intern(key));
+
+    double predicted = bench::best_of(5, [&] {
+        found = 0;
+        for (const uint8_t *record : records)
+        {
+            predictor.bind(record, end - record);
+            for (uint32_t id : ids)
+                found += predictor.find(id) != nullptr;
+        }
+    });
+
+    bench::report("find_map_key per key", scanned, data.size(), records.size());
+    bench::report("layout predicted", predicted, data.size(), records.size());
+    std::printf("found: %llu, predicted records: %llu / %llu, speedup %.2fx\n",
+                static_cast<unsigned long long>(found),
+                static_cast<unsigned long long>(predictor.statistics().hits),
+                static_cast<unsigned long long>(predictor.statistics().hits + predictor.statistics().misses),
+                scanned / predicted);
+
+    return 0;
+}
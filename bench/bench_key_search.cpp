@@ -0,0 +1,117 @@
+// "every id at any depth": a KeySearch walk against a recursive search through Cursor, on deep documents.
+//
+// usage: msgpacksearch_bench_key_search [file.msgpack]
+//        without a file, a tree of 5^8 nodes (8 levels of maps with 5 children each) is generated, and
+//        a chain of 2000 nested maps.
+
+#include "bench_util.h"
+
+#include <cursor.h>
+#include <key_search.h>
+#include <msgpacksearch.h>
+#include <packer.h>
+
+#include <string>
+#include <vector>
+
+using namespace msgpacksearch;
+
+namespace {
+
+void pack_tree(Packer &packer, int depth, uint64_t &id)
+{
+    packer.pack_map(depth ? 5 : 4);
+    packer.pack_str("id");
+    packer.pack_uint(id++);
+    packer.pack_str("name");
+    packer.pack_str("node " + std::to_string(id));
+    packer.pack_str("weights");
+    packer.pack_array(4);
+    for (int i = 0; i < 4; i++)
+        packer.pack_double(i * 0.5);
+    packer.pack_str("labels");
+    packer.pack_map(2);
+    packer.pack_str("kind");
+    packer.pack_str("tree");
+    packer.pack_str("level");
+    packer.pack_uint(depth);
+
+    if (depth)
+    {
+        packer.pack_str("children");
+        packer.pack_array(5);
+        for (int child = 0; child < 5; child++)
+            pack_tree(packer, depth - 1, id);
+    }
+}
+
+void pack_chain(Packer &packer, int depth)
+{
+    for (int level = 0; level < depth; level++)
+    {
+        packer.pack_map(3);
+        packer.pack_str("id");
+        packer.pack_uint(level);
+        packer.pack_str("note");
+        packer.pack_str("a chain link");
+        packer.pack_str("next");
+    }
+    packer.pack_nil();
+}
+
+void recursive_search(const Cursor &value, std::string_view key, size_t &matches)
+{
+    for (Cursor element = value.at(0); element; element = element.next_sibling())
+    {
+        if (value.is_map() && element.key() == key)
+            matches++;
+
+        if (element.nmb_elements())
+            recursive_search(element, key, matches);
+    }
+}
+
+void run(const char *name, const std::vector<uint8_t> &data)
+{
+    KeySearch search("id");
+    size_t recursive = 0;
+    size_t walked = 0;
+
+    double cursor_time = bench::best_of(3, [&] {
+        recursive = 0;
+        recursive_search(Cursor(data.data(), data.size()), "id", recursive);
+    });
+    double search_time = bench::best_of(3, [&] {
+        walked = search.find_all(data.data(), data.size(), [](uint32_t, const Cursor &) { return true; });
+    });
+
+    std::printf("%s: %zu bytes, %zu matches\n", name, data.size(), walked);
+    bench::report("  recursive Cursor search", cursor_time, data.size(), recursive);
+    bench::report("  KeySearch::find_all", search_time, data.size(), walked);
+    std::printf("  speedup: %.2fx\n", cursor_time / search_time);
+}
+
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        run(argv[1], std::vector<uint8_t>(file.begin(), file.end()));
+        return 0;
+    }
+
+    std::vector<uint8_t> tree;
+    Packer tree_packer(tree);
+    uint64_t id = 0;
+    pack_tree(tree_packer, 8, id);
+    run("tree", tree);
+
+    std::vector<uint8_t> chain;
+    Packer chain_packer(chain);
+    pack_chain(chain_packer, 2000);
+    run("chain", chain);
+
+    return 0;
+}
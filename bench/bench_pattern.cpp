@@ -0,0 +1,69 @@
+// "every items[*].price": a path pattern against the nested loop of index lookups it replaces.
+//
+// usage: msgpacksearch_bench_pattern
+//        one document with an array of 5000 items, each a map with a price.
+
+#include "bench_util.h"
+
+#include <decode.h>
+#include <msgpacksearch.h>
+#include <packer.h>
+#include <path.h>
+
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main()
+{
+    const uint32_t nmb_items = 5000;
+    std::vector<uint8_t> data;
+    Packer packer(data);
+
+    packer.pack_map(2);
+    packer.pack_str("order");
+    packer.pack_uint(12345);
+    packer.pack_str("items");
+    packer.pack_array(nmb_items);
+    for (uint32_t i = 0; i < nmb_items; i++)
+    {
+        packer.pack_map(3);
+        packer.pack_str("sku");
+        packer.pack_str("sku-" + std::to_string(i));
+        packer.pack_str("qty");
+        packer.pack_uint(i % 7 + 1);
+        packer.pack_str("price");
+        packer.pack_uint(i % 1000);
+    }
+
+    Msgpack doc(data);
+    uint64_t loop_sum = 0;
+    uint64_t pattern_sum = 0;
+
+    // each find_array_index skips the elements before the index again
+    double loop = bench::best_of(3, [&] {
+        loop_sum = 0;
+        msgpack_array items = doc.get_array("items");
+        for (uint32_t i = 0; i < items.nmb_elements; i++)
+        {
+            Msgpack item(doc.find_array_index(items, i), data.size());
+            loop_sum += item.get_u64("price");
+        }
+    });
+
+    const msgpack_pattern pattern = parse_pattern("items[*].price");
+    double pattern_time = bench::best_of(3, [&] {
+        pattern_sum = 0;
+        for_each_match(doc.cursor(), pattern, [&pattern_sum](const Cursor &value) {
+            uint64_t price;
+            pattern_sum += read_u64(value.data(), price) ? price : 0;
+            return true;
+        });
+    });
+
+    bench::report("nested loop, find_array_index", loop, data.size(), nmb_items);
+    bench::report("for_each_match items[*].price", pattern_time, data.size(), nmb_items);
+    std::printf("speedup: %.0fx\n", loop / pattern_time);
+
+    return loop_sum != pattern_sum;
+}
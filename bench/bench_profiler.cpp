@@ -0,0 +1,49 @@
+// Compares the shape profiler with a plain skip_object pass over the same record stream.
+//
+// usage: msgpacksearch_bench_profiler [file.msgpack]
+//        without a file, a stream of 200k synthetic records is generated.
+
+#include "bench_util.h"
+
+#include <json.h>
+#include <msgpacksearch.h>
+#include <profiler.h>
+
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        data = json_to_msgpack(bench::generate_json_records(200000));
+    }
+
+    size_t skipped = 0;
+    double skip = bench::best_of(5, [&] {
+        skipped = 0;
+        for (size_t offset = 0; offset < data.size(); skipped++)
+            offset += Msgpack::skip_object(data.data() + offset);
+    });
+
+    std::string report;
+    double profile = bench::best_of(5, [&] {
+        Profiler profiler;
+        profiler.profile_stream(data.data(), data.size());
+        report = profiler.report();
+    });
+
+    bench::report("skip_object pass", skip, data.size());
+    bench::report("Profiler::profile_stream", profile, data.size());
+    std::printf("profiler / skip: %.2fx\n\n%s", profile / skip, report.c_str());
+
+    return 0;
+}
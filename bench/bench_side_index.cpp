@@ -0,0 +1,148 @@
+// Startup cost of a persisted side-car index against rescanning the data file, and lookup speed
+// through the key hash tables against a linear key scan. Random lookups also run within a memory
+// budget, reporting the pages every lookup reads and the resident set mincore sees afterwards.
+//
+// usage: msgpacksearch_bench_side_index [file.msgpack]
+//        the file is a stream of concatenated documents, its index is written next to it.
+//        without a file, 300k synthetic records are written to a temporary file.
+
+#include "bench_util.h"
+
+#include <json.h>
+#include <mapped_file.h>
+#include <msgpacksearch.h>
+#include <packer.h>
+#include <side_index.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::string data_path = argc > 1 ? argv[1] : "/tmp/msgpacksearch_bench_side_index.msgpack";
+
+    if (argc <= 1)
+    {
+        // one document per record: drop the array 32 header json_to_msgpack puts around them
+        std::vector<uint8_t> records = json_to_msgpack(bench::generate_json_records(300000));
+        std::FILE *file = std::fopen(data_path.c_str(), "wb");
+        std::fwrite(records.data() + 5, 1, records.size() - 5, file);
+        std::fclose(file);
+    }
+
+    std::string index_path = SideIndex::default_path(data_path);
+    size_t data_size = MappedFile(data_path).size();
+
+    size_t nmb_documents = 0;
+    double scan = bench::best_of(3, [&] {
+        MappedFile data(data_path);
+        std::vector<uint64_t> boundaries;
+        for (size_t offset = 0; offset < data.size(); offset += Msgpack::skip_object(data.data() + offset))
+            boundaries.push_back(offset);
+        nmb_documents = boundaries.size();
+    });
+
+    double build = bench::best_of(1, [&] { SideIndex::build(data_path, index_path); });
+
+    std::unique_ptr<SideIndex> index;
+    double open = bench::best_of(5, [&] { index = SideIndex::open(data_path, index_path); });
+
+    if (!index)
+    {
+        std::fprintf(stderr, "index did not validate\n");
+        return 1;
+    }
+
+    bench::report("rescan document boundaries", scan, data_size, nmb_documents);
+    bench::report("SideIndex::build", build, data_size, nmb_documents);
+    bench::report("SideIndex::open", open, data_size, nmb_documents);
+    std::printf("startup: open is %.0fx faster than a rescan (%zu documents, index %zu bytes)\n\n",
+                scan / open, index->documents(), MappedFile(index_path).size());
+
+    // key lookups only go through a hash table in wide maps, measure them on 64 key documents
+    std::string wide_path = data_path + ".wide";
+    std::vector<uint8_t> wide;
+    Packer packer(wide);
+
+    for (size_t document = 0; document < 50000; document++)
+    {
+        packer.pack_map(64);
+        for (int field = 0; field < 64; field++)
+        {
+            packer.pack_str("field_" + std::to_string(field));
+            packer.pack_uint(document + field);
+        }
+    }
+
+    std::FILE *file = std::fopen(wide_path.c_str(), "wb");
+    std::fwrite(wide.data(), 1, wide.size(), file);
+    std::fclose(file);
+
+    std::unique_ptr<SideIndex> wide_index = SideIndex::open_or_build(wide_path, SideIndex::default_path(wide_path));
+    const msgpack_path path = parse_path("field_48");
+    size_t found = 0;
+
+    double hashed = bench::best_of(5, [&] {
+        found = 0;
+        for (size_t document = 0; document < wide_index->documents(); document++)
+            found += wide_index->find_path(document, path) != nullptr;
+    });
+
+    double linear = bench::best_of(5, [&] {
+        found = 0;
+        for (size_t document = 0; document < wide_index->documents(); document++)
+        {
+            const uint8_t *start = wide_index->data_file().data() + wide_index->document_offset(document);
+            found += bool(follow_path(Cursor(start, wide_index->document_size(document)), path));
+        }
+    });
+
+    bench::report("lookup field_48, key hash table", hashed, wide.size(), wide_index->documents());
+    bench::report("lookup field_48, linear key scan", linear, wide.size(), wide_index->documents());
+    std::printf("hash table / linear: %.2fx faster, found %zu\n\n", linear / hashed, found);
+
+    // random lookups within a 1 MB budget, against the same lookups with the default read-ahead
+    const MappedFile &wide_file = wide_index->data_file();
+    const size_t nmb_lookups = 20000;
+
+    wide_file.release(0, wide_file.size());
+    wide_file.advise(MappedFile::access_advice::normal);
+    double unbounded = bench::best_of(1, [&] {
+        for (size_t i = 0; i < nmb_lookups; i++)
+            found += wide_index->find_path(i * 7919 % wide_index->documents(), path) != nullptr;
+    });
+    size_t unbounded_resident = wide_file.resident_bytes();
+
+    wide_file.release(0, wide_file.size());
+    PageTracker pages(wide_file, 1 << 20);
+    size_t pages_touched = 0;
+    double bounded = bench::best_of(1, [&] {
+        for (size_t i = 0; i < nmb_lookups; i++)
+        {
+            found += wide_index->find_path(i * 7919 % wide_index->documents(), path, pages) != nullptr;
+            pages_touched += pages.pages_touched();
+        }
+    });
+
+    bench::report("random lookups, read-ahead", unbounded, 0, nmb_lookups);
+    bench::report("random lookups, 1 MB budget", bounded, 0, nmb_lookups);
+    std::printf("resident: %zu KB with read-ahead, %zu KB within the budget (%llu releases), %.2f pages per lookup\n",
+                unbounded_resident >> 10, wide_file.resident_bytes() >> 10, static_cast<unsigned long long>(pages.releases()),
+                double(pages_touched) / nmb_lookups);
+
+    wide_index.reset();
+    std::remove(wide_path.c_str());
+    std::remove(SideIndex::default_path(wide_path).c_str());
+
+    if (argc <= 1)
+    {
+        index.reset();
+        std::remove(data_path.c_str());
+        std::remove(index_path.c_str());
+    }
+
+    return 0;
+}
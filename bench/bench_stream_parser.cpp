@@ -0,0 +1,63 @@
+// Throughput of StreamParser fed in socket sized chunks, against skip_object over the whole buffer.
+//
+// usage: msgpacksearch_bench_stream_parser [file.msgpack [chunk_size]]
+//        the file is a stream of concatenated records.
+//        without a file, 300k synthetic records are generated.
+//        chunk_size defaults to 1460 bytes, a TCP segment.
+
+#include "bench_util.h"
+
+#include <json.h>
+#include <msgpacksearch.h>
+#include <stream_parser.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        // one record per document: drop the array 32 header json_to_msgpack puts around them
+        data = json_to_msgpack(bench::generate_json_records(300000));
+        data.erase(data.begin(), data.begin() + 5);
+    }
+
+    const size_t chunk_size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1460;
+    size_t records = 0;
+    size_t matches = 0;
+
+    StreamParser parser("meta.host");
+    parser.on_object([&](size_t) { records++; });
+    parser.on_match([&](const uint8_t *, size_t) { matches++; });
+
+    double streamed = bench::best_of(5, [&] {
+        records = 0;
+        matches = 0;
+        for (size_t offset = 0; offset < data.size();)
+            offset += parser.feed(data.data() + offset, std::min(chunk_size, data.size() - offset));
+    });
+
+    size_t skipped = 0;
+    double contiguous = bench::best_of(5, [&] {
+        skipped = 0;
+        for (size_t offset = 0; offset < data.size(); skipped++)
+            offset += Msgpack::skip_object(data.data() + offset);
+    });
+
+    bench::report("StreamParser, chunked, path", streamed, data.size(), records);
+    bench::report("skip_object, contiguous", contiguous, data.size(), skipped);
+    std::printf("matches: %zu / %zu records, stream parser / skip_object: %.2fx\n", matches, records, streamed / contiguous);
+
+    return 0;
+}
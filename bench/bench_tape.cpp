@@ -0,0 +1,85 @@
+// Cost of answering many different paths on one large blob: skipping over the encoded bytes for
+// every lookup, against building a tape once and following its sibling links. The tape is also
+// built on a pool, the skip pass that splits the root stays sequential and bounds the speedup.
+//
+// usage: msgpacksearch_bench_tape [file.msgpack [threads]]
+//        the file holds a single document, e.g. an array of records.
+//        without a file, an array of 300k synthetic records is generated.
+//        threads defaults to std::thread::hardware_concurrency().
+
+#include "bench_util.h"
+
+#include <json.h>
+#include <msgpacksearch.h>
+#include <tape.h>
+#include <thread_pool.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        data = json_to_msgpack(bench::generate_json_records(300000));
+    }
+
+    // dozens of paths spread over the document
+    std::vector<std::string> paths;
+    uint32_t nmb_records = Msgpack(data).cursor().nmb_elements();
+    for (uint32_t i = 0; i < 48; i++)
+    {
+        std::string record = "[" + std::to_string(uint64_t(nmb_records) * i / 48) + "]";
+        paths.push_back(record + (i % 3 == 0 ? ".meta.host" : i % 3 == 1 ? ".tags[2]" : ".latency"));
+    }
+
+    std::shared_ptr<const Tape> tape;
+    double built = bench::best_of(5, [&] {
+        tape = std::make_shared<const Tape>(data.data(), data.size());
+    });
+
+    ThreadPool pool(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0);
+    std::shared_ptr<const Tape> pooled_tape;
+    double pooled = bench::best_of(5, [&] {
+        pooled_tape = std::make_shared<const Tape>(data.data(), data.size(), &pool);
+    });
+
+    size_t found = 0;
+    Msgpack plain(data);
+    double scanned = bench::best_of(5, [&] {
+        found = 0;
+        for (const std::string &path : paths)
+            found += plain.find_path(path) != nullptr;
+    });
+
+    Msgpack taped(data);
+    taped.set_tape(tape);
+    double followed = bench::best_of(5, [&] {
+        found = 0;
+        for (const std::string &path : paths)
+            found += taped.find_path(path) != nullptr;
+    });
+
+    bench::report("tape build", built, data.size(), tape->entries().size());
+    bench::report(("tape build, " + std::to_string(pool.size()) + " threads").c_str(), pooled, data.size(),
+                  pooled_tape->entries().size());
+    bench::report("find_path, skipping", scanned, data.size() * paths.size(), paths.size());
+    bench::report("find_path, tape", followed, data.size() * paths.size(), paths.size());
+    std::printf("found: %zu / %zu, tape: %zu entries (%.1f bytes per data byte), break even after %.1f queries\n",
+                found, paths.size(), tape->entries().size(),
+                double(tape->entries().size() * sizeof(tape_entry)) / data.size(),
+                built / ((scanned - followed) / paths.size()));
+
+    return 0;
+}
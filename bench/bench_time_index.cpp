@@ -0,0 +1,71 @@
+// "replay one minute out of a day": a TimeIndex range scan against a full scan of a time sorted collection.
+//
+// usage: msgpacksearch_bench_time_index
+//        500k synthetic events, one every 0.2 s, with their timestamp at "ts" (timestamp extension).
+
+#include "bench_util.h"
+
+#include <decode.h>
+#include <msgpacksearch.h>
+#include <packer.h>
+#include <path.h>
+#include <time_index.h>
+
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main()
+{
+    const size_t nmb_records = 500000;
+    const int64_t start = 1700000000;
+    std::vector<uint8_t> data;
+    Packer packer(data);
+
+    for (size_t i = 0; i < nmb_records; i++)
+    {
+        packer.pack_map(4);
+        packer.pack_str("ts");
+        packer.pack_timestamp({start + static_cast<int64_t>(i / 5), static_cast<uint32_t>(i % 5) * 200000000});
+        packer.pack_str("host");
+        packer.pack_str("node-" + std::to_string(i % 16));
+        packer.pack_str("level");
+        packer.pack_str(i % 10 ? "info" : "warn");
+        packer.pack_str("latency");
+        packer.pack_uint(i % 997);
+    }
+
+    const msgpack_timestamp from{start + 50000, 0};
+    const msgpack_timestamp until{start + 50060, 0};
+    const msgpack_path path = parse_path("ts");
+    size_t matches = 0;
+
+    double scan = bench::best_of(3, [&] {
+        matches = 0;
+        for (size_t offset = 0; offset < data.size();)
+        {
+            size_t record_size = Msgpack::skip_object(data.data() + offset);
+            Cursor value = follow_path(Cursor(data.data() + offset, record_size), path);
+            msgpack_timestamp time;
+            matches += value && read_timestamp(value.data(), time) && !(time < from) && time < until;
+            offset += record_size;
+        }
+    });
+
+    TimeIndex index("ts");
+    double build = bench::best_of(1, [&] { index.append(data); });
+
+    const int queries = 1000;
+    size_t found = 0;
+    double query = bench::best_of(3, [&] {
+        for (int i = 0; i < queries; i++)
+            found = index.scan(from, until, [](const uint8_t *, size_t, const msgpack_timestamp &) { return true; });
+    });
+
+    bench::report("full scan, one minute", scan, data.size(), nmb_records);
+    bench::report("TimeIndex build", build, data.size(), index.records());
+    std::printf("%-40s %10.3f us per query, %zu samples\n", "TimeIndex::scan, one minute", query / queries * 1e6, index.samples());
+    std::printf("scan / indexed query: %.0fx, %zu records in range\n", scan / (query / queries), found);
+
+    return matches != found;
+}
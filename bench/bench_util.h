@@ -0,0 +1,73 @@
+#ifndef MSGPACKSEARCH_BENCH_UTIL_H
+#define MSGPACKSEARCH_BENCH_UTIL_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace bench {
+
+/// Runs fn `iterations` times and returns the best wall time in seconds
+template <typename Fn>
+double best_of(int iterations, Fn &&fn)
+{
+    double best = 1e300;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+            best = elapsed.count();
+    }
+
+    return best;
+}
+
+inline void report(const char *name, double seconds, size_t bytes, size_t items = 0)
+{
+    std::printf("%-40s %10.3f ms %10.1f MB/s", name, seconds * 1e3, bytes / seconds / 1e6);
+    if (items)
+        std::printf(" %12.0f items/s", items / seconds);
+    std::printf("\n");
+}
+
+inline std::string read_file(const char *path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/**
+ * Generates a JSON array of flat-ish log records, roughly the shape of our ingest traffic.
+ * @param[in] nmb_records number of records in the array
+ */
+inline std::string generate_json_records(size_t nmb_records)
+{
+    std::string json = "[";
+
+    for (size_t i = 0; i < nmb_records; i++)
+    {
+        if (i)
+            json += ",";
+        json += "{\"id\":" + std::to_string(i) +
+                ",\"user_id\":" + std::to_string(i % 1000) +
+                ",\"ts\":" + std::to_string(1600000000000ull + i * 37) +
+                ",\"level\":\"" + (i % 7 ? "info" : "warn") + "\"" +
+                ",\"latency\":" + std::to_string(i % 500) + "." + std::to_string(i % 10) +
+                ",\"ok\":" + (i % 13 ? "true" : "false") +
+                ",\"tags\":[\"svc-" + std::to_string(i % 17) + "\",\"eu\",\"web\"]" +
+                ",\"msg\":\"request served \\\"/api/v1/items\\\"\"" +
+                ",\"meta\":{\"host\":\"node-" + std::to_string(i % 64) + "\",\"pid\":" + std::to_string(1000 + i % 300) + "}}";
+    }
+
+    json += "]";
+    return json;
+}
+
+}
+
+#endif //MSGPACKSEARCH_BENCH_UTIL_H
@@ -0,0 +1,74 @@
+// "find all records where user_id == X": a ValueIndex query against a full scan of the collection.
+//
+// usage: msgpacksearch_bench_value_index [file.msgpack]
+//        the file is a stream of concatenated records with a user_id field.
+//        without a file, 300k synthetic records are generated.
+
+#include "bench_util.h"
+
+#include <decode.h>
+#include <json.h>
+#include <msgpacksearch.h>
+#include <path.h>
+#include <value_index.h>
+
+#include <vector>
+
+using namespace msgpacksearch;
+
+int main(int argc, const char *argv[])
+{
+    std::vector<uint8_t> data;
+
+    if (argc > 1)
+    {
+        std::string file = bench::read_file(argv[1]);
+        data.assign(file.begin(), file.end());
+    }
+    else
+    {
+        // one record per document: drop the array 32 header json_to_msgpack puts around them
+        data = json_to_msgpack(bench::generate_json_records(300000));
+        data.erase(data.begin(), data.begin() + 5);
+    }
+
+    const msgpack_path path = parse_path("user_id");
+    size_t matches = 0;
+
+    double scan = bench::best_of(3, [&] {
+        matches = 0;
+        for (size_t offset = 0; offset < data.size();)
+        {
+            size_t record_size = Msgpack::skip_object(data.data() + offset);
+            Cursor value = follow_path(Cursor(data.data() + offset, record_size), path);
+            uint64_t user_id;
+            matches += value && read_u64(value.data(), user_id) && user_id == 500;
+            offset += record_size;
+        }
+    });
+
+    ValueIndex sorted("user_id");
+    ValueIndex hashed("user_id", ValueIndex::kind::hashed);
+    double build_sorted = bench::best_of(1, [&] { sorted.append(data); });
+    double build_hashed = bench::best_of(1, [&] { hashed.append(data); });
+
+    const int queries = 1000;
+    size_t found = 0;
+    double query_sorted = bench::best_of(3, [&] {
+        for (int query = 0; query < queries; query++)
+            found = sorted.find(uint64_t(query)).size();
+    });
+    double query_hashed = bench::best_of(3, [&] {
+        for (int query = 0; query < queries; query++)
+            found = hashed.find(uint64_t(query)).size();
+    });
+
+    bench::report("full scan, user_id == 500", scan, data.size(), sorted.records());
+    bench::report("ValueIndex build, sorted", build_sorted, data.size(), sorted.records());
+    bench::report("ValueIndex build, hashed", build_hashed, data.size(), hashed.records());
+    std::printf("%-40s %10.3f us per query\n", "ValueIndex::find, sorted", query_sorted / queries * 1e6);
+    std::printf("%-40s %10.3f us per query\n", "ValueIndex::find, hashed", query_hashed / queries * 1e6);
+    std::printf("scan / sorted query: %.0fx, %zu matches per value\n", scan / (query_sorted / queries), found);
+
+    return matches == 0;
+}
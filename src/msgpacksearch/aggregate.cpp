@@ -0,0 +1,285 @@
+#include "aggregate.h"
+#include "columnar.h"
+#include "msgpacksearch.h"
+#include "decode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+
+namespace msgpacksearch
+{
+
+void numeric_aggregate::merge(const numeric_aggregate &other)
+{
+    records += other.records;
+    count += other.count;
+    sum += other.sum;
+    min = other.min < min ? other.min : min;
+    max = other.max > max ? other.max : max;
+}
+
+void aggregate_result::merge(const aggregate_result &other)
+{
+    total.merge(other.total);
+
+    if (buckets.size() < other.buckets.size())
+        buckets.resize(other.buckets.size(), 0);
+
+    for (size_t bucket = 0; bucket < other.buckets.size(); bucket++)
+        buckets[bucket] += other.buckets[bucket];
+
+    below += other.below;
+    above += other.above;
+
+    for (const auto &[key, group] : other.groups)
+        groups[key].merge(group);
+}
+
+namespace {
+
+constexpr size_t batch_rows = 4096;
+
+/// Renders a group key as text, see aggregate_query::group_by
+void render_key(const uint8_t *value, std::string &key)
+{
+    uint64_t integer;
+    bool is_signed;
+    double d;
+    bool boolean;
+    std::string_view str;
+
+    if (value && read_str(value, str))
+        key.assign(str.data(), str.size());
+    else if (value && read_integer(value, integer, is_signed))
+        key = is_signed ? std::to_string(static_cast<int64_t>(integer)) : std::to_string(integer);
+    else if (value && read_bool(value, boolean))
+        key = boolean ? "true" : "false";
+    else if (value && read_float(value, d))
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", d);
+        key = buffer;
+    }
+    else
+        key = "null";
+}
+
+/// Aggregates one chunk of a stream, shared read-only by every task of a query
+class AggregationKernel {
+
+public:
+    explicit AggregationKernel(const aggregate_query &query) : _query(query), _extractor(columns(query))
+    {
+        int column_index = 0;
+
+        if (!query.value_path.empty())
+            _value_column = column_index++;
+
+        if (!query.group_by.empty())
+            _group_column = column_index++;
+    }
+
+    aggregate_result run(const uint8_t *data, size_t size) const
+    {
+        aggregate_result result;
+        std::unordered_map<std::string, numeric_aggregate> groups;
+        record_batch batch = _extractor.make_batch(batch_rows);
+        std::string key;
+
+        result.buckets.resize(_query.histogram.nmb_buckets, 0);
+
+        for (size_t offset = 0; offset < size;)
+        {
+            batch.clear();
+            size_t consumed = _extractor.extract(data + offset, size - offset, batch, batch_rows);
+
+            if (!consumed)
+                break; // the last record is truncated
+
+            offset += consumed;
+
+            const column *values = _value_column >= 0 ? &batch.columns[_value_column] : nullptr;
+            const column *keys = _group_column >= 0 ? &batch.columns[_group_column] : nullptr;
+
+            for (size_t row = 0; row < batch.rows; row++)
+            {
+                bool has_value = values && !values->is_null(row);
+                double value = has_value ? values->float64_values[row] : 0;
+
+                add(result.total, has_value, value);
+
+                if (has_value && !result.buckets.empty())
+                    bucket(result, value);
+
+                if (keys)
+                {
+                    render_key(keys->raw_values[row], key);
+                    add(groups[key], has_value, value);
+                }
+            }
+        }
+
+        for (auto &[group_key, group] : groups)
+            result.groups.emplace(group_key, group);
+
+        return result;
+    }
+
+private:
+    static std::vector<column_spec> columns(const aggregate_query &query)
+    {
+        std::vector<column_spec> specs;
+
+        if (!query.value_path.empty())
+            specs.push_back(column_spec{query.value_path, column_type::float64});
+
+        if (!query.group_by.empty())
+            specs.push_back(column_spec{query.group_by, column_type::raw});
+
+        return specs;
+    }
+
+    static void add(numeric_aggregate &target, bool has_value, double value)
+    {
+        target.records++;
+        if (has_value)
+            target.add(value);
+    }
+
+    void bucket(aggregate_result &result, double value) const
+    {
+        const histogram_spec &histogram = _query.histogram;
+
+        if (std::isnan(value))
+            return;
+
+        if (value < histogram.low)
+            result.below++;
+        else if (value >= histogram.high)
+            result.above++;
+        else
+        {
+            size_t index = static_cast<size_t>((value - histogram.low) / (histogram.high - histogram.low) * histogram.nmb_buckets);
+            result.buckets[std::min<size_t>(index, histogram.nmb_buckets - 1)]++;
+        }
+    }
+
+    const aggregate_query &_query;
+    const ColumnarExtractor _extractor;
+    int _value_column = -1;
+    int _group_column = -1;
+};
+
+/// Runs chunks on the pool as they are cut, the destructor waits for every task so none outlives the kernel
+class ChunkRunner {
+
+public:
+    ChunkRunner(const AggregationKernel &kernel, const uint8_t *data, ThreadPool &pool) : _kernel(kernel), _data(data), _pool(pool) {}
+
+    ~ChunkRunner()
+    {
+        for (std::future<aggregate_result> &partial : _partials)
+            partial.wait();
+    }
+
+    ChunkRunner(const ChunkRunner &other) = delete;
+    ChunkRunner& operator=(const ChunkRunner &other) = delete;
+
+    void submit(size_t start, size_t end)
+    {
+        const AggregationKernel &kernel = _kernel;
+        const uint8_t *data = _data;
+        _partials.push_back(_pool.submit([&kernel, data, start, end] { return kernel.run(data + start, end - start); }));
+    }
+
+    /// Merges the partial results, rethrows the first exception of a task
+    aggregate_result merge()
+    {
+        for (std::future<aggregate_result> &partial : _partials)
+            partial.wait();
+
+        aggregate_result result;
+
+        for (std::future<aggregate_result> &partial : _partials)
+            result.merge(partial.get());
+
+        _partials.clear();
+        return result;
+    }
+
+private:
+    const AggregationKernel &_kernel;
+    const uint8_t *_data;
+    ThreadPool &_pool;
+    std::vector<std::future<aggregate_result>> _partials;
+};
+
+}
+
+aggregate_result aggregate(const uint8_t *data, size_t size, const aggregate_query &query, ThreadPool *pool)
+{
+    AggregationKernel kernel(query);
+
+    if (!pool)
+        return kernel.run(data, size);
+
+    ChunkRunner chunks(kernel, data, *pool);
+
+    for (size_t offset = 0; offset < size;)
+    {
+        size_t start = offset;
+
+        while (offset < size && offset - start < query.chunk_bytes)
+        {
+            size_t record_size = Msgpack::skip_object_bounded(data + offset, data + size);
+
+            if (!record_size)
+            {
+                size = offset; // the truncated last record is left out, as on the calling thread
+                break;
+            }
+
+            offset += record_size;
+        }
+
+        if (offset > start)
+            chunks.submit(start, offset);
+    }
+
+    return chunks.merge();
+}
+
+aggregate_result aggregate(const SideIndex &index, const aggregate_query &query, ThreadPool *pool)
+{
+    AggregationKernel kernel(query);
+    const uint8_t *data = index.data_file().data();
+
+    if (!index.documents())
+        return kernel.run(data, 0);
+
+    size_t end = index.document_offset(index.documents() - 1) + index.document_size(index.documents() - 1);
+
+    if (!pool)
+        return kernel.run(data, end);
+
+    ChunkRunner chunks(kernel, data, *pool);
+    size_t start = 0;
+
+    for (size_t document = 0; document < index.documents(); document++)
+    {
+        size_t offset = index.document_offset(document);
+
+        if (offset - start >= query.chunk_bytes)
+        {
+            chunks.submit(start, offset);
+            start = offset;
+        }
+    }
+
+    chunks.submit(start, end);
+    return chunks.merge();
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef MSGPACKSEARCH_AGGREGATE_H
+#define MSGPACKSEARCH_AGGREGATE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "side_index.h"
+#include "thread_pool.h"
+
+namespace msgpacksearch {
+
+/**
+ * numeric_aggregate - running aggregate of the numeric values of a set of records
+ *
+ * records -> number of records in the set, numeric value or not
+ * count -> number of records with a numeric value
+ * sum / min / max -> over the numeric values, widened to double
+ */
+struct numeric_aggregate
+{
+    uint64_t records = 0;
+    uint64_t count = 0;
+    double sum = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double value)
+    {
+        count++;
+        sum += value;
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+    }
+
+    void merge(const numeric_aggregate &other);
+
+    /// sum / count, NaN without values
+    double mean() const { return count ? sum / count : std::numeric_limits<double>::quiet_NaN(); }
+};
+
+/**
+ * histogram_spec - equal width buckets over [low, high)
+ *
+ * nmb_buckets -> 0 disables the histogram
+ */
+struct histogram_spec
+{
+    double low = 0;
+    double high = 0;
+    uint32_t nmb_buckets = 0;
+};
+
+/**
+ * aggregate_query - what aggregate() computes
+ *
+ * value_path -> path of the numeric value, empty to only count records
+ * group_by -> path of the group key, empty for a single group. Keys are rendered as text (strings as is,
+ *             numbers in decimal, true / false); nil, missing and non-scalar keys form the "null" group
+ * histogram -> buckets of the numeric values of all records
+ * chunk_bytes -> size of the stream chunks handed to the threads
+ */
+struct aggregate_query
+{
+    std::string value_path;
+    std::string group_by;
+    histogram_spec histogram;
+    size_t chunk_bytes = 4 << 20;
+};
+
+/**
+ * aggregate_result - outcome of aggregate()
+ *
+ * total -> aggregate over every record
+ * buckets / below / above -> histogram counts, values under low and at or over high
+ * groups -> aggregate per group key, empty without group_by
+ */
+struct aggregate_result
+{
+    numeric_aggregate total;
+    std::vector<uint64_t> buckets;
+    uint64_t below = 0;
+    uint64_t above = 0;
+    std::map<std::string, numeric_aggregate> groups;
+
+    void merge(const aggregate_result &other);
+};
+
+/**
+* Aggregates a stream of records. Values are read straight from the encoded bytes by a ColumnarExtractor,
+* no msgpack_object is built. With a pool, chunks of the stream are aggregated in parallel into per-task
+* partial results, merged at the end; the calling thread only skips over records to cut the chunks and hands
+* each one to the pool as soon as it is cut.
+* A truncated last record, e.g. of a file still being written, is left out as in TimeIndex::append.
+* @param[in] data first record of the stream
+* @param[in] size number of bytes in the stream
+* @param[in] query what to compute
+* @param[in] pool workers, NULL to aggregate on the calling thread
+* @return The aggregates
+* @throws parse_error if a path is malformed or a record has an invalid type byte
+*/
+aggregate_result aggregate(const uint8_t *data, size_t size, const aggregate_query &query, ThreadPool *pool = nullptr);
+
+/**
+* Aggregates the documents of an indexed file, chunks are cut at the indexed document boundaries so
+* the whole scan runs in parallel
+*/
+aggregate_result aggregate(const SideIndex &index, const aggregate_query &query, ThreadPool *pool = nullptr);
+
+}
+
+#endif //MSGPACKSEARCH_AGGREGATE_H
@@ -0,0 +1,990 @@
+#include "block_file.h"
+#include "decode.h"
+#include "error.h"
+#include "hash.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <system_error>
+
+#include <unistd.h>
+
+#ifdef MSGPACKSEARCH_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef MSGPACKSEARCH_LZ4
+#include <lz4.h>
+#endif
+
+namespace msgpacksearch
+{
+
+namespace block_file_format {
+
+constexpr char magic[8] = {'M', 'S', 'G', 'P', 'B', 'L', 'K', '\0'};
+constexpr uint32_t byte_order_mark = 0x01020304;
+
+/**
+ * The stored blocks come first, back to back from offset 0, followed by the block index and the trailer:
+ *
+ *     block_entry entries[nmb_blocks]          at index_offset, in stream order
+ *     char indexed_path[indexed_path_size]
+ *     file_trailer                             the last bytes of the file
+ *
+ * Readers start from the trailer, so the blocks can be written before the index is known. Version 2
+ * appends the zone maps to the index, after the indexed path:
+ *
+ *     zone_header
+ *     per zone path: uint32_t size, char path[size]
+ *     zone_entry zones[nmb_blocks * nmb_paths]     block major
+ *     uint64_t bloom_words[]                       referenced by zone_entry::bloom_offset
+ */
+struct block_entry
+{
+    uint64_t offset;
+    uint64_t first_record;
+    uint64_t stream_offset;
+    uint64_t hash; // xxhash64 of the stored bytes
+    uint32_t compressed_size;
+    uint32_t size;
+    uint32_t nmb_records;
+    uint32_t has_range;
+    double min;
+    double max;
+};
+
+struct file_trailer
+{
+    uint64_t nmb_blocks;
+    uint64_t nmb_records;
+    uint64_t index_offset;
+    uint64_t index_hash; // xxhash64 of the entries and the indexed path
+    uint32_t indexed_path_size;
+    uint32_t version;
+    uint32_t byte_order;
+    uint8_t codec;
+    uint8_t reserved[3];
+    uint64_t trailer_hash; // xxhash64 of the trailer up to this field
+    char magic[8];
+};
+
+struct zone_header
+{
+    uint32_t nmb_paths;
+    uint32_t bloom_hashes; // bit positions set per value
+};
+
+struct zone_entry
+{
+    uint64_t values;
+    uint64_t nulls;
+    double min;
+    double max;
+    uint64_t bloom_offset; // in words, from the first bloom word
+    uint32_t bloom_words; // power of two, 0 without a bloom filter
+    uint32_t reserved;
+};
+
+static_assert(sizeof(block_entry) % 8 == 0 && sizeof(file_trailer) % 8 == 0 && sizeof(zone_entry) % 8 == 0,
+              "entries must stay 8 byte aligned");
+
+}
+
+using namespace block_file_format;
+
+namespace {
+
+/// Numeric value of an object, integers are widened to double even where it is inexact
+bool widened_number(const uint8_t *object, double &value)
+{
+    uint64_t integer;
+    bool is_signed;
+
+    if (read_float(object, value))
+        return true;
+
+    if (!read_integer(object, integer, is_signed))
+        return false;
+
+    value = is_signed ? static_cast<double>(static_cast<int64_t>(integer)) : static_cast<double>(integer);
+    return true;
+}
+
+/// Object at a path of a record, NULL if the path does not resolve
+const uint8_t* find_value(const uint8_t *record, size_t size, const msgpack_path &path)
+{
+    Cursor found = follow_path(Cursor(record, size), path);
+    return found ? found.data() : nullptr;
+}
+
+bool is_null(const uint8_t *object)
+{
+    return !object || *object == 0xc0;
+}
+
+/// Bloom filter hashes, seeded per type; numbers hash their value so that every encoding of it agrees
+uint64_t string_hash(std::string_view text)
+{
+    return xxhash64(text.data(), text.size(), 1);
+}
+
+uint64_t number_hash(double number)
+{
+    number = number == 0 ? 0.0 : number; // -0.0 == 0.0
+    return xxhash64(&number, sizeof(number), 2);
+}
+
+uint64_t bool_hash(bool flag)
+{
+    uint8_t byte = flag;
+    return xxhash64(&byte, 1, 3);
+}
+
+/// Bloom filter hash of a string, number or boolean object
+bool object_hash(const uint8_t *object, uint64_t &hash)
+{
+    std::string_view text;
+    double number;
+    bool flag;
+
+    if (read_str(object, text))
+        hash = string_hash(text);
+    else if (widened_number(object, number))
+        hash = number_hash(number);
+    else if (read_bool(object, flag))
+        hash = bool_hash(flag);
+    else
+        return false;
+
+    return true;
+}
+
+/// Bit positions per value for a number of bits per value, about the optimal ln 2 * bits_per_value
+uint32_t bloom_hashes(uint32_t bits_per_value)
+{
+    return std::clamp<uint32_t>((bits_per_value * 69 + 50) / 100, 1, 16);
+}
+
+/// Calls fn with the bloom filter bits of a hash, for a filter of nmb_bits (a power of two)
+template <typename Fn>
+void bloom_bits(uint64_t hash, uint32_t nmb_hashes, uint64_t nmb_bits, Fn &&fn)
+{
+    const uint64_t step = (hash >> 32 | hash << 32) | 1;
+
+    for (uint32_t i = 0; i < nmb_hashes; i++)
+        fn((hash + i * step) & (nmb_bits - 1));
+}
+
+bool bloom_may_contain(const zone_map &zone, uint32_t nmb_hashes, uint64_t hash)
+{
+    bool found = true;
+
+    bloom_bits(hash, nmb_hashes, uint64_t(zone.bloom_words) * 64, [&zone, &found](uint64_t bit) {
+        uint64_t word;
+        std::memcpy(&word, zone.bloom + bit / 64 * sizeof(word), sizeof(word));
+        found &= (word >> (bit % 64)) & 1;
+    });
+
+    return found;
+}
+
+/// Numeric operand of a comparison
+double comparison_operand(const block_predicate &predicate)
+{
+    const double *number = std::get_if<double>(&predicate.value);
+
+    if (!number)
+        throw std::invalid_argument("comparison of " + predicate.path + " needs a number operand");
+
+    return *number;
+}
+
+/// Whether a block with a zone map may hold a record meeting a predicate
+bool zone_may_match(const zone_map &zone, uint64_t records, uint32_t nmb_hashes, const block_predicate &predicate)
+{
+    using op_type = block_predicate::op_type;
+
+    switch (predicate.op)
+    {
+        case op_type::is_null:
+            return zone.nulls > 0;
+        case op_type::not_null:
+            return zone.nulls < records;
+        case op_type::lt:
+            return zone.values && zone.min < comparison_operand(predicate);
+        case op_type::le:
+            return zone.values && zone.min <= comparison_operand(predicate);
+        case op_type::gt:
+            return zone.values && zone.max > comparison_operand(predicate);
+        case op_type::ge:
+            return zone.values && zone.max >= comparison_operand(predicate);
+        case op_type::eq:
+            break;
+    }
+
+    if (zone.nulls == records)
+        return false;
+
+    uint64_t hash;
+
+    if (const double *number = std::get_if<double>(&predicate.value))
+    {
+        if (!zone.values || !(*number >= zone.min && *number <= zone.max))
+            return false;
+
+        hash = number_hash(*number);
+    }
+    else if (const std::string *text = std::get_if<std::string>(&predicate.value))
+    {
+        hash = string_hash(*text);
+    }
+    else
+    {
+        hash = bool_hash(std::get<bool>(predicate.value));
+    }
+
+    return !zone.bloom_words || bloom_may_contain(zone, nmb_hashes, hash);
+}
+
+/// Whether the value at the path of a predicate meets it, value is NULL if the path does not resolve
+bool value_matches(const uint8_t *value, const block_predicate &predicate, double operand)
+{
+    using op_type = block_predicate::op_type;
+    double number;
+
+    switch (predicate.op)
+    {
+        case op_type::is_null:
+            return is_null(value);
+        case op_type::not_null:
+            return !is_null(value);
+        case op_type::lt:
+            return value && widened_number(value, number) && number < operand;
+        case op_type::le:
+            return value && widened_number(value, number) && number <= operand;
+        case op_type::gt:
+            return value && widened_number(value, number) && number > operand;
+        case op_type::ge:
+            return value && widened_number(value, number) && number >= operand;
+        case op_type::eq:
+            break;
+    }
+
+    if (!value)
+        return false;
+
+    std::string_view text;
+    bool flag;
+
+    if (const double *expected = std::get_if<double>(&predicate.value))
+        return widened_number(value, number) && number == *expected;
+    if (const std::string *expected = std::get_if<std::string>(&predicate.value))
+        return read_str(value, text) && text == *expected;
+
+    return read_bool(value, flag) && flag == std::get<bool>(predicate.value);
+}
+
+/**
+* Compresses a block
+* @throws std::length_error if the block is too large for the codec
+* @throws std::runtime_error if the codec fails
+*/
+void compress(block_codec codec, [[maybe_unused]] int level, const std::vector<uint8_t> &block, std::vector<uint8_t> &out)
+{
+    switch (codec)
+    {
+#ifdef MSGPACKSEARCH_ZSTD
+        case block_codec::zstd:
+        {
+            out.resize(ZSTD_compressBound(block.size()));
+            size_t size = ZSTD_compress(out.data(), out.size(), block.data(), block.size(), level ? level : ZSTD_CLEVEL_DEFAULT);
+
+            if (ZSTD_isError(size))
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(size));
+
+            out.resize(size);
+            return;
+        }
+#endif
+#ifdef MSGPACKSEARCH_LZ4
+        case block_codec::lz4:
+        {
+            if (block.size() > LZ4_MAX_INPUT_SIZE)
+                throw std::length_error("block too large for lz4");
+
+            out.resize(LZ4_compressBound(static_cast<int>(block.size())));
+            int size = LZ4_compress_fast(reinterpret_cast<const char *>(block.data()), reinterpret_cast<char *>(out.data()),
+                                         static_cast<int>(block.size()), static_cast<int>(out.size()), level ? level : 1);
+
+            if (size <= 0)
+                throw std::runtime_error("lz4: compression failed");
+
+            out.resize(size);
+            return;
+        }
+#endif
+        default:
+            out = block;
+    }
+}
+
+/**
+* Decompresses a block into out, which holds its uncompressed size
+* @return true if the block decompressed to exactly out.size() bytes
+*/
+bool decompress(block_codec codec, [[maybe_unused]] const uint8_t *block, [[maybe_unused]] size_t size, [[maybe_unused]] std::vector<uint8_t> &out)
+{
+    switch (codec)
+    {
+#ifdef MSGPACKSEARCH_ZSTD
+        case block_codec::zstd:
+        {
+            size_t decompressed = ZSTD_decompress(out.data(), out.size(), block, size);
+            return !ZSTD_isError(decompressed) && decompressed == out.size();
+        }
+#endif
+#ifdef MSGPACKSEARCH_LZ4
+        case block_codec::lz4:
+        {
+            int decompressed = LZ4_decompress_safe(reinterpret_cast<const char *>(block), reinterpret_cast<char *>(out.data()),
+                                                   static_cast<int>(size), static_cast<int>(out.size()));
+            return decompressed >= 0 && static_cast<size_t>(decompressed) == out.size();
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+}
+
+bool codec_available(block_codec codec)
+{
+    switch (codec)
+    {
+        case block_codec::none:
+            return true;
+        case block_codec::zstd:
+#ifdef MSGPACKSEARCH_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        case block_codec::lz4:
+#ifdef MSGPACKSEARCH_LZ4
+            return true;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+/**
+ * zone_builder - statistics of a zone path over the records of the pending block
+ *
+ * values / nulls / min / max -> as zone_map
+ * hashes -> bloom filter hashes of the values
+ */
+struct BlockWriter::zone_builder
+{
+    uint64_t values = 0;
+    uint64_t nulls = 0;
+    double min = 0;
+    double max = 0;
+    std::vector<uint64_t> hashes;
+};
+
+BlockWriter::BlockWriter(const std::string &path, const block_writer_options &options) :
+    _path(path), _temporary(path + ".tmp"), _options(options), _indexed_path(parse_path(options.indexed_path))
+{
+    if (!codec_available(options.codec))
+        throw std::invalid_argument("block codec not available in this build");
+
+    for (const std::string &zone_path : options.zone_paths)
+        _zone_paths.push_back(parse_path(zone_path));
+
+    _pending_zones.resize(_zone_paths.size());
+
+    _file = std::fopen(_temporary.c_str(), "wb");
+
+    if (!_file)
+        throw std::system_error(errno, std::generic_category(), "open " + _temporary);
+}
+
+BlockWriter::~BlockWriter()
+{
+    if (_file)
+    {
+        std::fclose(_file);
+        std::remove(_temporary.c_str());
+    }
+}
+
+void BlockWriter::append(const std::vector<uint8_t> &record)
+{
+    append(record.data(), record.size());
+}
+
+void BlockWriter::append(const uint8_t *record, size_t size)
+{
+    if (!_file)
+        throw std::logic_error("block file already finished");
+    if (size >= UINT32_MAX)
+        throw std::length_error("record too large for a block");
+
+    size_t object_size = size ? Msgpack::skip_object_bounded(record, record + size) : 0;
+
+    if (!size || object_size != size)
+        throw parse_error("record is not exactly one object", _stream_offset + object_size);
+
+    if (!_pending.empty() && (_pending.size() + size > _options.block_bytes || _pending.size() + size >= UINT32_MAX))
+        write_block();
+
+    if (_pending.empty())
+    {
+        _pending_info = block_info();
+        _pending_info.first_record = _records;
+        _pending_info.stream_offset = _stream_offset;
+    }
+
+    double value;
+    const uint8_t *indexed = _indexed_path.empty() ? nullptr : find_value(record, size, _indexed_path);
+
+    // NaN compares false with everything, it would make the range useless
+    if (indexed && widened_number(indexed, value) && value == value)
+    {
+        _pending_info.min = _pending_info.has_range ? std::min(_pending_info.min, value) : value;
+        _pending_info.max = _pending_info.has_range ? std::max(_pending_info.max, value) : value;
+        _pending_info.has_range = true;
+    }
+
+    for (size_t path = 0; path < _zone_paths.size(); path++)
+    {
+        zone_builder &zone = _pending_zones[path];
+        const uint8_t *found = find_value(record, size, _zone_paths[path]);
+        uint64_t hash;
+
+        if (is_null(found))
+        {
+            zone.nulls++;
+            continue;
+        }
+
+        if (widened_number(found, value) && value == value)
+        {
+            zone.min = zone.values ? std::min(zone.min, value) : value;
+            zone.max = zone.values ? std::max(zone.max, value) : value;
+            zone.values++;
+        }
+
+        if (_options.bloom_bits_per_value && object_hash(found, hash))
+            zone.hashes.push_back(hash);
+    }
+
+    _pending.insert(_pending.end(), record, record + size);
+    _pending_info.nmb_records++;
+    _records++;
+    _stream_offset += size;
+}
+
+void BlockWriter::write(const void *data, size_t size)
+{
+    if (std::fwrite(data, 1, size, _file) != size)
+        throw std::system_error(errno, std::generic_category(), "write " + _temporary);
+
+    _written += size;
+}
+
+void BlockWriter::write_block()
+{
+    compress(_options.codec, _options.level, _pending, _compressed);
+
+    if (_compressed.size() >= UINT32_MAX)
+        throw std::length_error("compressed block too large");
+
+    _pending_info.offset = _written;
+    _pending_info.compressed_size = _compressed.size();
+    _pending_info.size = _pending.size();
+    write(_compressed.data(), _compressed.size());
+
+    _blocks.push_back(_pending_info);
+    _block_hashes.push_back(xxhash64(_compressed.data(), _compressed.size()));
+    _pending.clear();
+
+    for (zone_builder &zone : _pending_zones)
+    {
+        zone_entry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.values = zone.values;
+        entry.nulls = zone.nulls;
+        entry.min = zone.min;
+        entry.max = zone.max;
+
+        // sized for the distinct values, low cardinality fields get small filters
+        std::sort(zone.hashes.begin(), zone.hashes.end());
+        zone.hashes.erase(std::unique(zone.hashes.begin(), zone.hashes.end()), zone.hashes.end());
+
+        if (!zone.hashes.empty())
+        {
+            uint64_t nmb_bits = 64;
+            while (nmb_bits < zone.hashes.size() * uint64_t(_options.bloom_bits_per_value))
+                nmb_bits <<= 1;
+
+            entry.bloom_offset = _bloom_words.size();
+            entry.bloom_words = static_cast<uint32_t>(nmb_bits / 64);
+            _bloom_words.resize(_bloom_words.size() + entry.bloom_words);
+            uint64_t *words = _bloom_words.data() + entry.bloom_offset;
+
+            for (uint64_t hash : zone.hashes)
+                bloom_bits(hash, bloom_hashes(_options.bloom_bits_per_value), nmb_bits, [words](uint64_t bit) { words[bit / 64] |= uint64_t(1) << (bit % 64); });
+        }
+
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&entry);
+        _zones.insert(_zones.end(), bytes, bytes + sizeof(entry));
+        zone = zone_builder();
+    }
+}
+
+void BlockWriter::finish()
+{
+    if (!_file)
+        throw std::logic_error("block file already finished");
+
+    if (!_pending.empty())
+        write_block();
+
+    std::vector<uint8_t> index(_blocks.size() * sizeof(block_entry) + _options.indexed_path.size());
+
+    for (size_t block = 0; block < _blocks.size(); block++)
+    {
+        const block_info &info = _blocks[block];
+        block_entry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.offset = info.offset;
+        entry.first_record = info.first_record;
+        entry.stream_offset = info.stream_offset;
+        entry.compressed_size = static_cast<uint32_t>(info.compressed_size);
+        entry.size = static_cast<uint32_t>(info.size);
+        entry.nmb_records = info.nmb_records;
+        entry.has_range = info.has_range;
+        entry.min = info.min;
+        entry.max = info.max;
+        entry.hash = _block_hashes[block];
+        std::memcpy(index.data() + block * sizeof(entry), &entry, sizeof(entry));
+    }
+
+    std::memcpy(index.data() + _blocks.size() * sizeof(block_entry), _options.indexed_path.data(), _options.indexed_path.size());
+
+    zone_header zones = {static_cast<uint32_t>(_zone_paths.size()), bloom_hashes(_options.bloom_bits_per_value)};
+    const uint8_t *zones_bytes = reinterpret_cast<const uint8_t *>(&zones);
+    index.insert(index.end(), zones_bytes, zones_bytes + sizeof(zones));
+
+    for (const std::string &zone_path : _options.zone_paths)
+    {
+        uint32_t zone_path_size = static_cast<uint32_t>(zone_path.size());
+        const uint8_t *size_bytes = reinterpret_cast<const uint8_t *>(&zone_path_size);
+        index.insert(index.end(), size_bytes, size_bytes + sizeof(zone_path_size));
+        index.insert(index.end(), zone_path.begin(), zone_path.end());
+    }
+
+    const uint8_t *bloom_bytes = reinterpret_cast<const uint8_t *>(_bloom_words.data());
+    index.insert(index.end(), _zones.begin(), _zones.end());
+    index.insert(index.end(), bloom_bytes, bloom_bytes + _bloom_words.size() * sizeof(uint64_t));
+
+    file_trailer trailer;
+    std::memset(&trailer, 0, sizeof(trailer));
+    trailer.nmb_blocks = _blocks.size();
+    trailer.nmb_records = _records;
+    trailer.index_offset = _written;
+    trailer.indexed_path_size = static_cast<uint32_t>(_options.indexed_path.size());
+    trailer.version = BlockFile::version;
+    trailer.byte_order = byte_order_mark;
+    trailer.codec = static_cast<uint8_t>(_options.codec);
+    std::memcpy(trailer.magic, magic, sizeof(magic));
+
+    write(index.data(), index.size());
+    trailer.index_hash = xxhash64(index.data(), index.size());
+    trailer.trailer_hash = xxhash64(&trailer, offsetof(file_trailer, trailer_hash));
+    write(&trailer, sizeof(trailer));
+
+    bool ok = std::fflush(_file) == 0 && ::fsync(fileno(_file)) == 0;
+    int error = errno;
+
+    if (std::fclose(_file) != 0 && ok)
+    {
+        ok = false;
+        error = errno;
+    }
+
+    _file = nullptr;
+
+    if (!ok)
+    {
+        std::remove(_temporary.c_str());
+        throw std::system_error(error, std::generic_category(), "write " + _temporary);
+    }
+
+    // readers either see the previous file or the complete new one
+    if (std::rename(_temporary.c_str(), _path.c_str()) != 0)
+    {
+        error = errno;
+        std::remove(_temporary.c_str());
+        throw std::system_error(error, std::generic_category(), "rename " + _temporary);
+    }
+}
+
+BlockFile::BlockFile(const std::string &path) : _file(path)
+{
+    const uint8_t *data = _file.data();
+    const size_t size = _file.size();
+    file_trailer trailer;
+
+    if (size < sizeof(trailer))
+        throw parse_error("not a block file", 0);
+
+    const size_t trailer_offset = size - sizeof(trailer);
+    std::memcpy(&trailer, data + trailer_offset, sizeof(trailer));
+
+    if (std::memcmp(trailer.magic, magic, sizeof(magic)) != 0)
+        throw parse_error("not a block file", trailer_offset);
+    if (!trailer.version || trailer.version > version || trailer.byte_order != byte_order_mark)
+        throw parse_error("block file version or byte order not supported", trailer_offset);
+    if (trailer.trailer_hash != xxhash64(&trailer, offsetof(file_trailer, trailer_hash)))
+        throw parse_error("corrupted block file trailer", trailer_offset);
+
+    // bound the counts by the file size before multiplying them
+    const uint64_t index_size = trailer_offset - trailer.index_offset;
+    const uint64_t entries_size = trailer.nmb_blocks * sizeof(block_entry) + trailer.indexed_path_size;
+
+    // version 1 has no zone maps, in version 2 they fill the rest of the index
+    if (trailer.nmb_blocks > size / sizeof(block_entry) || trailer.index_offset > trailer_offset ||
+        (trailer.version == 1 ? index_size != entries_size : index_size < entries_size + sizeof(zone_header)))
+        throw parse_error("truncated block index", trailer.index_offset);
+
+    const uint8_t *index = data + trailer.index_offset;
+
+    if (trailer.index_hash != xxhash64(index, index_size))
+        throw parse_error("corrupted block index", trailer.index_offset);
+    if (trailer.codec > static_cast<uint8_t>(block_codec::lz4))
+        throw parse_error("unknown block codec", trailer_offset);
+
+    _codec = static_cast<block_codec>(trailer.codec);
+
+    if (!codec_available(_codec))
+        throw std::invalid_argument("block codec not available in this build");
+
+    _indexed_path.assign(reinterpret_cast<const char *>(index) + trailer.nmb_blocks * sizeof(block_entry), trailer.indexed_path_size);
+    _blocks.reserve(trailer.nmb_blocks);
+    _block_hashes.reserve(trailer.nmb_blocks);
+
+    for (uint64_t block = 0; block < trailer.nmb_blocks; block++)
+    {
+        // entries follow blocks of any length, copy them out rather than reading them unaligned
+        block_entry entry;
+        std::memcpy(&entry, index + block * sizeof(entry), sizeof(entry));
+
+        if (entry.offset > trailer.index_offset || entry.compressed_size > trailer.index_offset - entry.offset ||
+            entry.first_record != _records || (_codec == block_codec::none && entry.compressed_size != entry.size))
+            throw parse_error("corrupted block index", trailer.index_offset + block * sizeof(entry));
+
+        block_info info;
+        info.offset = entry.offset;
+        info.compressed_size = entry.compressed_size;
+        info.size = entry.size;
+        info.first_record = entry.first_record;
+        info.stream_offset = entry.stream_offset;
+        info.nmb_records = entry.nmb_records;
+        info.has_range = entry.has_range;
+        info.min = entry.min;
+        info.max = entry.max;
+
+        _blocks.push_back(info);
+        _block_hashes.push_back(entry.hash);
+        _records += entry.nmb_records;
+    }
+
+    if (_records != trailer.nmb_records)
+        throw parse_error("corrupted block index", trailer.index_offset);
+
+    if (trailer.version >= 2)
+        read_zones(index + entries_size, index_size - entries_size, trailer.index_offset + entries_size);
+}
+
+void BlockFile::read_zones(const uint8_t *section, size_t size, size_t offset)
+{
+    size_t position = 0;
+
+    auto take = [section, size, offset, &position](void *out, size_t bytes) {
+        if (bytes > size - position)
+            throw parse_error("corrupted zone maps", offset + position);
+
+        std::memcpy(out, section + position, bytes);
+        position += bytes;
+    };
+
+    zone_header header;
+    take(&header, sizeof(header));
+
+    if (header.nmb_paths > size)
+        throw parse_error("corrupted zone maps", offset);
+
+    _bloom_hashes = header.bloom_hashes;
+
+    for (uint32_t path = 0; path < header.nmb_paths; path++)
+    {
+        uint32_t path_size;
+        take(&path_size, sizeof(path_size));
+
+        std::string name(std::min<size_t>(path_size, size), '\0');
+        take(name.data(), path_size);
+        _zone_path_names.push_back(std::move(name));
+    }
+
+    const size_t nmb_zones = _blocks.size() * header.nmb_paths;
+
+    if (nmb_zones > (size - position) / sizeof(zone_entry))
+        throw parse_error("corrupted zone maps", offset + position);
+
+    const size_t blooms = position + nmb_zones * sizeof(zone_entry);
+    const uint64_t nmb_bloom_words = (size - blooms) / sizeof(uint64_t);
+    _zones.reserve(nmb_zones);
+
+    for (size_t zone = 0; zone < nmb_zones; zone++)
+    {
+        zone_entry entry;
+        take(&entry, sizeof(entry));
+
+        if (entry.bloom_offset > nmb_bloom_words || entry.bloom_words > nmb_bloom_words - entry.bloom_offset ||
+            (entry.bloom_words & (entry.bloom_words - 1)) || (entry.bloom_words && !_bloom_hashes) ||
+            entry.values + entry.nulls > _blocks[zone / header.nmb_paths].nmb_records)
+            throw parse_error("corrupted zone maps", offset + position - sizeof(entry));
+
+        zone_map map;
+        map.values = entry.values;
+        map.nulls = entry.nulls;
+        map.min = entry.min;
+        map.max = entry.max;
+        map.bloom = entry.bloom_words ? section + blooms + entry.bloom_offset * sizeof(uint64_t) : nullptr;
+        map.bloom_words = entry.bloom_words;
+        _zones.push_back(map);
+    }
+
+    if ((size - blooms) % sizeof(uint64_t))
+        throw parse_error("corrupted zone maps", offset + blooms);
+}
+
+size_t BlockFile::find_block(uint64_t record) const
+{
+    if (record >= _records)
+        return _blocks.size();
+
+    auto it = std::upper_bound(_blocks.begin(), _blocks.end(), record,
+                               [](uint64_t value, const block_info &info) { return value < info.first_record; });
+
+    return it - _blocks.begin() - 1;
+}
+
+std::vector<size_t> BlockFile::blocks_in_range(double min, double max) const
+{
+    std::vector<size_t> out;
+
+    for (size_t block = 0; block < _blocks.size(); block++)
+    {
+        if (_blocks[block].has_range && _blocks[block].max >= min && _blocks[block].min <= max)
+            out.push_back(block);
+    }
+
+    return out;
+}
+
+bool BlockFile::may_match(size_t block, const std::vector<block_predicate> &predicates) const
+{
+    for (const block_predicate &predicate : predicates)
+    {
+        auto path = std::find(_zone_path_names.begin(), _zone_path_names.end(), predicate.path);
+
+        if (path == _zone_path_names.end())
+        {
+            // unchecked by any zone map, still reject a malformed comparison
+            if (predicate.op >= block_predicate::op_type::lt && predicate.op <= block_predicate::op_type::ge)
+                comparison_operand(predicate);
+
+            continue;
+        }
+
+        if (!zone_may_match(zone(block, path - _zone_path_names.begin()), _blocks[block].nmb_records, _bloom_hashes, predicate))
+            return false;
+    }
+
+    return true;
+}
+
+std::vector<size_t> BlockFile::blocks_matching(const std::vector<block_predicate> &predicates) const
+{
+    std::vector<size_t> out;
+
+    for (size_t block = 0; block < _blocks.size(); block++)
+    {
+        if (may_match(block, predicates))
+            out.push_back(block);
+    }
+
+    return out;
+}
+
+size_t BlockFile::scan_where(const std::vector<block_predicate> &predicates, const visitor &visit, ThreadPool *pool) const
+{
+    std::vector<msgpack_path> paths;
+    std::vector<double> operands;
+
+    for (const block_predicate &predicate : predicates)
+    {
+        paths.push_back(parse_path(predicate.path));
+        operands.push_back(predicate.op >= block_predicate::op_type::lt && predicate.op <= block_predicate::op_type::ge ?
+                           comparison_operand(predicate) : 0);
+    }
+
+    size_t visited = 0;
+
+    scan(blocks_matching(predicates), [&](const Msgpack &record, uint64_t index) {
+        for (size_t i = 0; i < predicates.size(); i++)
+        {
+            if (!value_matches(find_value(record.data(), record.size(), paths[i]), predicates[i], operands[i]))
+                return true;
+        }
+
+        visited++;
+        return visit(record, index);
+    }, pool);
+
+    return visited;
+}
+
+decoded_block BlockFile::read_block(size_t block) const
+{
+    if (block >= _blocks.size())
+        throw std::out_of_range("block index out of range");
+
+    const block_info &info = _blocks[block];
+    const uint8_t *stored = _file.data() + info.offset;
+
+    if (xxhash64(stored, info.compressed_size) != _block_hashes[block])
+        throw parse_error("block checksum mismatch", info.offset);
+
+    decoded_block decoded;
+
+    if (_codec == block_codec::none)
+    {
+        decoded.data = stored;
+        decoded.size = info.size;
+        return decoded;
+    }
+
+    decoded.storage.resize(info.size);
+
+    if (!decompress(_codec, stored, info.compressed_size, decoded.storage))
+        throw parse_error("block does not decompress to its size", info.offset);
+
+    decoded.data = decoded.storage.data();
+    decoded.size = decoded.storage.size();
+    return decoded;
+}
+
+size_t BlockFile::scan(const std::vector<size_t> &blocks, const visitor &visit, ThreadPool *pool) const
+{
+    return scan(blocks, 0, UINT64_MAX, visit, pool);
+}
+
+size_t BlockFile::scan_records(uint64_t first, uint64_t count, const visitor &visit, ThreadPool *pool) const
+{
+    if (!count || first >= _records)
+        return 0;
+
+    const uint64_t end = count < _records - first ? first + count : _records;
+    std::vector<size_t> blocks;
+
+    for (size_t block = find_block(first); block <= find_block(end - 1); block++)
+        blocks.push_back(block);
+
+    return scan(blocks, first, end, visit, pool);
+}
+
+size_t BlockFile::scan(const std::vector<size_t> &blocks, uint64_t first, uint64_t end, const visitor &visit, ThreadPool *pool) const
+{
+    std::deque<std::future<decoded_block>> decoding;
+    const size_t window = pool ? 2 * pool->size() : 0;
+    size_t submitted = 0;
+    size_t visited = 0;
+
+    // waits for the blocks still decompressing, so that no task outlives the scan
+    auto drain = [&decoding] {
+        for (std::future<decoded_block> &task : decoding)
+            task.wait();
+    };
+
+    try
+    {
+        for (size_t position = 0; position < blocks.size(); position++)
+        {
+            decoded_block decoded;
+
+            if (pool)
+            {
+                for (; submitted < blocks.size() && submitted < position + window; submitted++)
+                    decoding.push_back(pool->submit([this, block = blocks[submitted]] { return read_block(block); }));
+
+                // popped before get(), which throws the task's exception and leaves the future empty
+                std::future<decoded_block> task = std::move(decoding.front());
+                decoding.pop_front();
+                decoded = task.get();
+            }
+            else
+            {
+                decoded = read_block(blocks[position]);
+            }
+
+            const block_info &info = _blocks[blocks[position]];
+            const uint8_t *record = decoded.data;
+            const uint8_t *block_end = decoded.data + decoded.size;
+
+            for (uint64_t index = info.first_record; index < info.first_record + info.nmb_records && index < end; index++)
+            {
+                size_t record_size = record < block_end ? Msgpack::skip_object_bounded(record, block_end) : 0;
+
+                if (!record_size)
+                    throw parse_error("block does not hold its records", info.stream_offset + (record - decoded.data));
+
+                if (index >= first)
+                {
+                    visited++;
+
+                    if (!visit(Msgpack(record, record_size), index))
+                    {
+                        drain();
+                        return visited;
+                    }
+                }
+
+                record += record_size;
+            }
+        }
+    }
+    catch (...)
+    {
+        drain();
+        throw;
+    }
+
+    return visited;
+}
+
+}
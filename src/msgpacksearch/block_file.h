@@ -0,0 +1,337 @@
+#ifndef MSGPACKSEARCH_BLOCK_FILE_H
+#define MSGPACKSEARCH_BLOCK_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "mapped_file.h"
+#include "msgpacksearch.h"
+#include "path.h"
+
+namespace msgpacksearch {
+
+class ThreadPool;
+
+/// On-disk layout of a block file, defined in block_file.cpp
+namespace block_file_format {
+struct file_trailer;
+struct block_entry;
+}
+
+/**
+ * block_codec - compression of the blocks of a block file. zstd and lz4 are only available when the
+ * library is built with ENABLE_ZSTD / ENABLE_LZ4, see codec_available().
+ */
+enum class block_codec : uint8_t { none, zstd, lz4 };
+
+/// Whether this build compresses and decompresses blocks with a codec
+bool codec_available(block_codec codec);
+
+/**
+ * block_writer_options - how BlockWriter groups and compresses records
+ *
+ * codec -> compression of every block
+ * level -> compression level, 0 for the codec's default; the acceleration for lz4
+ * block_bytes -> uncompressed bytes after which a block is closed, a larger record makes a block of its own
+ * indexed_path -> path whose numeric values get a min / max per block, empty for none (see parse_path)
+ * zone_paths -> paths that get a zone map per block, see zone_map
+ * bloom_bits_per_value -> bloom filter bits per distinct value of a block, 0 for zone maps without bloom filters
+ */
+struct block_writer_options
+{
+    block_codec codec = block_codec::none;
+    int level = 0;
+    size_t block_bytes = 1 << 20;
+    std::string indexed_path;
+    std::vector<std::string> zone_paths;
+    uint32_t bloom_bits_per_value = 10;
+};
+
+/**
+ * block_info - entry of the block index
+ *
+ * offset / compressed_size -> location of the stored block in the file
+ * size -> uncompressed size of the block
+ * first_record -> index of the block's first record in the record stream
+ * stream_offset -> offset of the block's first record in the uncompressed record stream
+ * nmb_records -> records of the block
+ * has_range -> whether a record of the block has a numeric value at the indexed path
+ * min / max -> of these values, widened to double
+ */
+struct block_info
+{
+    size_t offset = 0;
+    size_t compressed_size = 0;
+    size_t size = 0;
+    uint64_t first_record = 0;
+    uint64_t stream_offset = 0;
+    uint32_t nmb_records = 0;
+    bool has_range = false;
+    double min = 0;
+    double max = 0;
+};
+
+/**
+ * zone_map - statistics of the values at one path over the records of one block
+ *
+ * values -> records with a numeric value at the path
+ * nulls -> records where the path is missing or nil
+ * min / max -> of the numeric values, widened to double; NaN is left out
+ * bloom / bloom_words -> bloom filter of the strings, numbers and booleans at the path, in the mapped
+ *                        file; NULL / 0 without one
+ */
+struct zone_map
+{
+    uint64_t values = 0;
+    uint64_t nulls = 0;
+    double min = 0;
+    double max = 0;
+    const uint8_t *bloom = nullptr;
+    uint32_t bloom_words = 0;
+};
+
+/**
+ * block_predicate - condition on the value at a path, the records of BlockFile::scan_where meet all of theirs
+ *
+ * path -> path of the value, see parse_path
+ * op -> eq: the value equals value, numbers compare by value across encodings;
+ *       lt / le / gt / ge: the value is a number and compares so with value, which must be a number;
+ *       is_null: the path is missing or nil; not_null: the value is present and not nil
+ * value -> operand of eq and of the comparisons
+ */
+struct block_predicate
+{
+    enum class op_type : uint8_t { eq, lt, le, gt, ge, is_null, not_null };
+
+    std::string path;
+    op_type op = op_type::eq;
+    std::variant<double, std::string, bool> value;
+};
+
+/**
+ * decoded_block - the records of one block, uncompressed
+ *
+ * data / size -> the concatenated records, pointing into the mapping for uncompressed blocks
+ * storage -> owns the decompressed bytes, empty for uncompressed blocks
+ */
+struct decoded_block
+{
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    std::vector<uint8_t> storage;
+};
+
+/**
+ * @brief Writes a stream of records as a block file.
+ *
+ * Records are grouped into blocks of about block_bytes, each compressed on its own so that readers
+ * decompress only the blocks they need. The block index and a trailer follow the blocks. The file is
+ * written next to its path and renamed into place by finish(), readers never see a partial file.
+ */
+class BlockWriter {
+
+public:
+
+    /**
+    * @param[in] path path of the block file
+    * @param[in] options grouping, compression and indexed path
+    * @throws std::invalid_argument if the codec is not available in this build
+    * @throws parse_error if the indexed path is malformed
+    * @throws std::system_error if the file cannot be created
+    */
+    explicit BlockWriter(const std::string &path, const block_writer_options &options = {});
+
+    /// Drops the file if finish() was not called
+    ~BlockWriter();
+
+    BlockWriter(const BlockWriter &other) = delete;
+    BlockWriter& operator=(const BlockWriter &other) = delete;
+
+    /**
+    * Appends a record
+    * @param[in] record points at the record
+    * @param[in] size encoded size of the record
+    * @throws parse_error if the bytes are not exactly one object
+    * @throws std::length_error if the record is 4 GB or more
+    * @throws std::system_error if a block cannot be written
+    */
+    void append(const uint8_t *record, size_t size);
+    void append(const std::vector<uint8_t> &record);
+
+    /**
+    * Writes the last block, the block index and the trailer, then renames the file into place
+    * @throws std::system_error if the file cannot be written or renamed
+    * @throws std::logic_error if the file was already finished
+    */
+    void finish();
+
+    /// Records appended so far
+    uint64_t records() const { return _records; }
+
+    /// Blocks written so far, the pending block excluded
+    size_t blocks() const { return _blocks.size(); }
+
+private:
+    /// Statistics of a zone path over the pending block, defined in block_file.cpp
+    struct zone_builder;
+
+    void write_block();
+    void write(const void *data, size_t size);
+
+    std::string _path;
+    std::string _temporary;
+    block_writer_options _options;
+    msgpack_path _indexed_path;
+    std::FILE *_file = nullptr;
+    uint64_t _written = 0;
+    uint64_t _records = 0;
+    uint64_t _stream_offset = 0;
+    std::vector<uint8_t> _pending;
+    block_info _pending_info;
+    std::vector<uint8_t> _compressed;
+    std::vector<block_info> _blocks;
+    std::vector<uint64_t> _block_hashes;
+    std::vector<msgpack_path> _zone_paths;
+    std::vector<uint8_t> _zones; // zone map entries of the written blocks
+    std::vector<uint64_t> _bloom_words;
+    std::vector<zone_builder> _pending_zones;
+};
+
+/**
+ * @brief Random access reader of a block file.
+ *
+ * Opening maps the file and reads the block index from its end, no block is decompressed. Reads
+ * decompress the blocks they need, on a thread pool when one is given, and hand Msgpack views over the
+ * uncompressed records to a visitor in stream order. Every block is checked against its checksum
+ * before it is decompressed.
+ *
+ * Zone maps let scan_where skip the blocks that cannot hold a record meeting its predicates, from the
+ * index alone: a block is read only if, for every predicate on a zone path, its min / max, null count
+ * and bloom filter allow a match.
+ */
+class BlockFile {
+
+public:
+
+    /// Receives a record and its index in the stream, returns false to stop the scan
+    using visitor = std::function<bool(const Msgpack &record, uint64_t index)>;
+
+    /// Format version written by this build, files of earlier versions are read too
+    static constexpr uint32_t version = 2;
+
+    /**
+    * Maps a block file
+    * @param[in] path path of the block file
+    * @throws std::system_error if the file cannot be mapped
+    * @throws parse_error if the file is not a block file, its index is corrupted or it has a version or
+    * byte order this build does not read
+    * @throws std::invalid_argument if the blocks use a codec that is not available in this build
+    */
+    explicit BlockFile(const std::string &path);
+
+    BlockFile(const BlockFile &other) = delete;
+    BlockFile& operator=(const BlockFile &other) = delete;
+
+    block_codec codec() const { return _codec; }
+
+    /// Path of the numeric values with a min / max per block, empty for none
+    const std::string& indexed_path() const { return _indexed_path; }
+
+    size_t blocks() const { return _blocks.size(); }
+
+    const block_info& block(size_t block) const { return _blocks[block]; }
+
+    /// Number of records in the file
+    uint64_t records() const { return _records; }
+
+    /// Index of the block holding a record, blocks() if the record is out of range
+    size_t find_block(uint64_t record) const;
+
+    /**
+    * Blocks that may hold records whose indexed value is within [min, max]; blocks without any
+    * numeric value at the indexed path are left out
+    */
+    std::vector<size_t> blocks_in_range(double min, double max) const;
+
+    /// Paths with a zone map per block
+    const std::vector<std::string>& zone_paths() const { return _zone_path_names; }
+
+    /// Zone map of a block for the path zone_paths()[path]
+    const zone_map& zone(size_t block, size_t path) const { return _zones[block * _zone_path_names.size() + path]; }
+
+    /**
+    * Whether a block may hold a record meeting every predicate, from its zone maps; predicates on paths
+    * without a zone map never exclude a block
+    * @throws std::invalid_argument if a comparison has no number operand
+    */
+    bool may_match(size_t block, const std::vector<block_predicate> &predicates) const;
+
+    /// Blocks that may hold a record meeting every predicate, see may_match
+    std::vector<size_t> blocks_matching(const std::vector<block_predicate> &predicates) const;
+
+    /**
+    * Decompresses one block
+    * @param[in] block index of the block
+    * @return The records of the block
+    * @throws parse_error if the block does not match its checksum or does not decompress to its size
+    * @throws std::out_of_range if there is no such block
+    */
+    decoded_block read_block(size_t block) const;
+
+    /**
+    * Visits the records of a list of blocks, in the order of the list. Up to two blocks per thread
+    * are decompressed ahead of the visitor, which always runs on the calling thread.
+    * @param[in] blocks indexes of the blocks
+    * @param[in] visit called for every record
+    * @param[in] pool threads that decompress the blocks, NULL to decompress on the calling thread
+    * @return Number of records visited
+    * @throws parse_error as read_block, or if a block does not hold its records
+    */
+    size_t scan(const std::vector<size_t> &blocks, const visitor &visit, ThreadPool *pool = nullptr) const;
+
+    /**
+    * Visits the records [first, first + count) of the stream, decompressing only the blocks that hold them
+    * @return Number of records visited
+    */
+    size_t scan_records(uint64_t first, uint64_t count, const visitor &visit, ThreadPool *pool = nullptr) const;
+
+    /**
+    * Visits the records meeting every predicate, reading only the blocks whose zone maps allow a match
+    * @param[in] predicates conditions on the records, none to visit every record
+    * @param[in] visit called for every matching record
+    * @param[in] pool threads that decompress the blocks, NULL to decompress on the calling thread
+    * @return Number of records visited
+    * @throws parse_error if a predicate path is malformed, or as scan
+    * @throws std::invalid_argument if a comparison has no number operand
+    */
+    size_t scan_where(const std::vector<block_predicate> &predicates, const visitor &visit, ThreadPool *pool = nullptr) const;
+
+    /// The mapped file
+    const MappedFile& file() const { return _file; }
+
+private:
+    /// Reads the zone maps section of a version 2 index, offset is its offset in the file
+    void read_zones(const uint8_t *section, size_t size, size_t offset);
+
+    /// Visits the records of the blocks whose index is in [first, end)
+    size_t scan(const std::vector<size_t> &blocks, uint64_t first, uint64_t end, const visitor &visit, ThreadPool *pool) const;
+
+    MappedFile _file;
+    block_codec _codec = block_codec::none;
+    std::string _indexed_path;
+    std::vector<block_info> _blocks;
+    std::vector<uint64_t> _block_hashes;
+    std::vector<std::string> _zone_path_names;
+    std::vector<zone_map> _zones; // block major
+    uint32_t _bloom_hashes = 0;
+    uint64_t _records = 0;
+};
+
+}
+
+#endif //MSGPACKSEARCH_BLOCK_FILE_H
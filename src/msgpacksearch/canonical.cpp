@@ -0,0 +1,196 @@
+#include "canonical.h"
+#include "msgpacksearch.h"
+#include "packer.h"
+#include "error.h"
+#include "decode.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+/// A canonicalized key:value pair, stored in the scratch buffer of its map
+struct map_entry
+{
+    size_t offset;
+    size_t key_size;
+    size_t size;
+};
+
+class Canonicalizer {
+
+public:
+    explicit Canonicalizer(const uint8_t *base) : _base(base) {}
+
+    /**
+    * Canonicalizes one object
+    * @param[in] start points at the object
+    * @param[in] packer receives the canonical bytes
+    * @return Number of input bytes consumed
+    */
+    size_t write(const uint8_t *start, Packer &packer);
+
+private:
+    size_t write_map(const uint8_t *start, size_t header_size, uint32_t nmb_elements, Packer &packer);
+    size_t write_array(const uint8_t *start, size_t header_size, uint32_t nmb_elements, Packer &packer);
+
+    const uint8_t *_base;
+};
+
+/// Orders encoded keys, strings by content first, then everything else by its encoded bytes
+bool key_less(const uint8_t *a, size_t a_size, const uint8_t *b, size_t b_size)
+{
+    std::string_view a_str;
+    std::string_view b_str;
+    bool a_is_str = read_str(a, a_str);
+    bool b_is_str = read_str(b, b_str);
+
+    if (a_is_str != b_is_str)
+        return a_is_str;
+
+    if (a_is_str)
+        return a_str < b_str;
+
+    int order = std::memcmp(a, b, std::min(a_size, b_size));
+    return order < 0 || (order == 0 && a_size < b_size);
+}
+
+size_t Canonicalizer::write(const uint8_t *start, Packer &packer)
+{
+    switch (*start)
+    {
+        case 0xe0 ... 0xff: // negative fixnum, already minimal
+        {
+            packer.pack_raw(start, 1);
+            return 1;
+        }
+        case 0xca: // float
+        {
+            packer.pack_raw(start, 5);
+            return 5;
+        }
+        case 0xcb: // double
+        {
+            packer.pack_raw(start, 9);
+            return 9;
+        }
+        case 0xc1: // never used
+        {
+            throw parse_error("Invalid type byte", start - _base);
+        }
+        default:
+            break;
+    }
+
+    uint32_t nmb_elements;
+    size_t header_size;
+
+    if (read_map_header(start, nmb_elements, header_size))
+        return write_map(start, header_size, nmb_elements, packer);
+
+    if (read_array_header(start, nmb_elements, header_size))
+        return write_array(start, header_size, nmb_elements, packer);
+
+    // remaining scalars, none of them walks a container inside parse_data
+    auto [read, object] = Msgpack::parse_data(start);
+
+    if (read == 0)
+        throw parse_error("Invalid type byte", start - _base);
+
+    if (std::holds_alternative<std::monostate>(object))
+        packer.pack_nil();
+    else if (std::holds_alternative<bool>(object))
+        packer.pack_bool(std::get<bool>(object));
+    else if (std::holds_alternative<uint64_t>(object))
+        packer.pack_uint(std::get<uint64_t>(object));
+    else if (std::holds_alternative<int64_t>(object))
+        packer.pack_int(std::get<int64_t>(object));
+    else if (std::holds_alternative<msgpack_str>(object))
+    {
+        auto str = std::get<msgpack_str>(object);
+        packer.pack_str(std::string_view(str.data, str.size));
+    }
+    else if (std::holds_alternative<msgpack_bin>(object))
+    {
+        auto bin = std::get<msgpack_bin>(object);
+        packer.pack_bin(bin.data, bin.size);
+    }
+    else if (std::holds_alternative<msgpack_ext>(object))
+    {
+        auto ext = std::get<msgpack_ext>(object);
+        packer.pack_ext(ext.type, ext.data, ext.size);
+        return (ext.data - start) + ext.size;
+    }
+
+    return read;
+}
+
+size_t Canonicalizer::write_map(const uint8_t *start, size_t header_size, uint32_t nmb_elements, Packer &packer)
+{
+    std::vector<uint8_t> scratch;
+    Packer entry_packer(scratch);
+    std::vector<map_entry> entries(nmb_elements);
+    size_t offset = header_size;
+
+    for (map_entry &entry : entries)
+    {
+        entry.offset = scratch.size();
+        offset += write(start + offset, entry_packer);
+        entry.key_size = scratch.size() - entry.offset;
+        offset += write(start + offset, entry_packer);
+        entry.size = scratch.size() - entry.offset;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [&](const map_entry &a, const map_entry &b) {
+        return key_less(scratch.data() + a.offset, a.key_size, scratch.data() + b.offset, b.key_size);
+    });
+
+    packer.pack_map(nmb_elements);
+
+    for (const map_entry &entry : entries)
+        packer.pack_raw(scratch.data() + entry.offset, entry.size);
+
+    return offset;
+}
+
+size_t Canonicalizer::write_array(const uint8_t *start, size_t header_size, uint32_t nmb_elements, Packer &packer)
+{
+    size_t offset = header_size;
+
+    packer.pack_array(nmb_elements);
+
+    for (uint32_t element_count = 0; element_count < nmb_elements; element_count++)
+        offset += write(start + offset, packer);
+
+    return offset;
+}
+
+}
+
+size_t canonicalize(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+    if (size == 0)
+        throw parse_error("Empty input", 0);
+
+    // the walk below trusts the headers, so the object is first checked to end within size
+    if (!Msgpack::skip_object_bounded(data, data + size))
+        throw parse_error("Truncated input", size);
+
+    Packer packer(out);
+    Canonicalizer canonicalizer(data);
+
+    return canonicalizer.write(data, packer);
+}
+
+std::vector<uint8_t> canonicalize(const uint8_t *data, size_t size)
+{
+    std::vector<uint8_t> out;
+    out.reserve(size);
+    canonicalize(data, size, out);
+    return out;
+}
+
+}
@@ -0,0 +1,32 @@
+#ifndef MSGPACKSEARCH_CANONICAL_H
+#define MSGPACKSEARCH_CANONICAL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace msgpacksearch {
+
+/**
+* Rewrites a msgpack object into canonical form:
+*   - the keys of every map are sorted, string keys bytewise by content first, then any other key by its encoded bytes
+*   - integers, strings, binaries and container headers use their smallest encoding
+*   - floats keep their width, ext payloads are copied verbatim
+*
+* Two semantically equal documents (same map contents, in any key order) have the same canonical bytes,
+* and a canonical document can be queried with Msgpack::set_sorted_keys(true) / sorted map indexes.
+*
+* @param[in] data points at the object to rewrite
+* @param[in] size number of bytes available at data
+* @param[out] out buffer the canonical bytes are appended to
+* @return Number of bytes of the input object consumed
+* @throws parse_error if the input contains an invalid type byte or the object does not end within size
+*/
+size_t canonicalize(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+/// Convenience overload returning a freshly allocated buffer
+std::vector<uint8_t> canonicalize(const uint8_t *data, size_t size);
+
+}
+
+#endif //MSGPACKSEARCH_CANONICAL_H
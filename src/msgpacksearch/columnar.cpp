@@ -0,0 +1,268 @@
+#include "columnar.h"
+#include "msgpacksearch.h"
+#include "decode.h"
+
+#include <algorithm>
+
+namespace msgpacksearch
+{
+
+void record_batch::clear()
+{
+    for (column &current : columns)
+    {
+        current.int64_values.clear();
+        current.float64_values.clear();
+        current.boolean_values.clear();
+        current.string_values.clear();
+        current.raw_values.clear();
+        current.validity.clear();
+        current.null_count = 0;
+    }
+
+    rows = 0;
+}
+
+ColumnarExtractor::ColumnarExtractor(const std::vector<column_spec> &columns) : _specs(columns), _nodes(1)
+{
+    for (uint32_t column_index = 0; column_index < _specs.size(); column_index++)
+    {
+        uint32_t node = 0;
+
+        for (const path_element &element : parse_path(_specs[column_index].path))
+            node = child(node, element);
+
+        _nodes[node].columns.push_back(column_index);
+    }
+}
+
+uint32_t ColumnarExtractor::child(uint32_t parent, const path_element &element)
+{
+    if (element.type == path_element::kind::key)
+    {
+        for (const auto &[key, node] : _nodes[parent].keys)
+            if (key == element.key)
+                return node;
+
+        _nodes[parent].keys.emplace_back(element.key, _nodes.size());
+    }
+    else
+    {
+        for (const auto &[index, node] : _nodes[parent].indexes)
+            if (index == element.index)
+                return node;
+
+        _nodes[parent].indexes.emplace_back(element.index, _nodes.size());
+    }
+
+    _nodes.emplace_back();
+    return _nodes.size() - 1;
+}
+
+record_batch ColumnarExtractor::make_batch(size_t capacity) const
+{
+    record_batch batch;
+    batch.columns.resize(_specs.size());
+
+    for (size_t column_index = 0; column_index < _specs.size(); column_index++)
+    {
+        column &current = batch.columns[column_index];
+        current.path = _specs[column_index].path;
+        current.type = _specs[column_index].type;
+        current.validity.reserve((capacity + 63) / 64);
+
+        switch (current.type)
+        {
+            case column_type::int64: current.int64_values.reserve(capacity); break;
+            case column_type::float64: current.float64_values.reserve(capacity); break;
+            case column_type::boolean: current.boolean_values.reserve(capacity); break;
+            case column_type::string: current.string_values.reserve(capacity); break;
+            case column_type::raw: current.raw_values.reserve(capacity); break;
+        }
+    }
+
+    return batch;
+}
+
+void ColumnarExtractor::append(column &target, size_t row, const uint8_t *value)
+{
+    bool valid = false;
+
+    switch (target.type)
+    {
+        case column_type::int64:
+        {
+            int64_t converted = 0;
+            valid = read_i64(value, converted);
+            target.int64_values.push_back(valid ? converted : 0);
+            break;
+        }
+        case column_type::float64:
+        {
+            double converted = 0;
+            valid = read_double(value, converted);
+            target.float64_values.push_back(valid ? converted : 0);
+            break;
+        }
+        case column_type::boolean:
+        {
+            bool converted = false;
+            valid = read_bool(value, converted);
+            target.boolean_values.push_back(valid && converted);
+            break;
+        }
+        case column_type::string:
+        {
+            std::string_view converted;
+            valid = read_str(value, converted);
+            target.string_values.push_back(converted);
+            break;
+        }
+        case column_type::raw:
+        {
+            valid = true;
+            target.raw_values.push_back(value);
+            break;
+        }
+    }
+
+    mark(target, row, valid);
+}
+
+void ColumnarExtractor::append_null(column &target, size_t row)
+{
+    switch (target.type)
+    {
+        case column_type::int64: target.int64_values.push_back(0); break;
+        case column_type::float64: target.float64_values.push_back(0); break;
+        case column_type::boolean: target.boolean_values.push_back(0); break;
+        case column_type::string: target.string_values.emplace_back(); break;
+        case column_type::raw: target.raw_values.push_back(nullptr); break;
+    }
+
+    mark(target, row, false);
+}
+
+void ColumnarExtractor::mark(column &target, size_t row, bool valid)
+{
+    if (row % 64 == 0)
+        target.validity.push_back(0);
+
+    if (valid)
+        target.validity.back() |= uint64_t(1) << (row % 64);
+    else
+        target.null_count++;
+}
+
+size_t ColumnarExtractor::walk(const uint8_t *start, uint32_t node_index, record_batch &batch, std::vector<uint8_t> &filled) const
+{
+    const trie_node &node = _nodes[node_index];
+
+    // the first of duplicate keys wins, as in find_map_key
+    for (uint32_t column_index : node.columns)
+    {
+        if (!filled[column_index])
+        {
+            append(batch.columns[column_index], batch.rows, start);
+            filled[column_index] = 1;
+        }
+    }
+
+    uint32_t nmb_elements;
+    size_t header_size;
+
+    if (!node.keys.empty() && read_map_header(start, nmb_elements, header_size))
+    {
+        size_t bytes = header_size;
+
+        for (uint32_t element_count = 0; element_count < nmb_elements; element_count++)
+        {
+            const uint8_t *key = start + bytes;
+            std::string_view key_str;
+            uint32_t member = 0;
+
+            if (read_str(key, key_str))
+            {
+                for (const auto &[child_key, child_node] : node.keys)
+                {
+                    if (child_key == key_str)
+                    {
+                        member = child_node;
+                        break;
+                    }
+                }
+            }
+
+            bytes += Msgpack::skip_object(key);
+            bytes += member ? walk(start + bytes, member, batch, filled) : Msgpack::skip_object(start + bytes);
+        }
+
+        return bytes;
+    }
+
+    if (!node.indexes.empty() && read_array_header(start, nmb_elements, header_size))
+    {
+        size_t bytes = header_size;
+
+        for (uint32_t element_count = 0; element_count < nmb_elements; element_count++)
+        {
+            uint32_t element = 0;
+
+            for (const auto &[child_index, child_node] : node.indexes)
+            {
+                if (child_index == element_count)
+                {
+                    element = child_node;
+                    break;
+                }
+            }
+
+            bytes += element ? walk(start + bytes, element, batch, filled) : Msgpack::skip_object(start + bytes);
+        }
+
+        return bytes;
+    }
+
+    return Msgpack::skip_object(start);
+}
+
+size_t ColumnarExtractor::extract_row(const uint8_t *record, record_batch &batch, std::vector<uint8_t> &filled) const
+{
+    std::fill(filled.begin(), filled.end(), 0);
+    size_t bytes = walk(record, 0, batch, filled);
+
+    for (size_t column_index = 0; column_index < _specs.size(); column_index++)
+        if (!filled[column_index])
+            append_null(batch.columns[column_index], batch.rows);
+
+    batch.rows++;
+    return bytes;
+}
+
+size_t ColumnarExtractor::extract_record(const uint8_t *record, record_batch &batch) const
+{
+    std::vector<uint8_t> filled(_specs.size());
+    return extract_row(record, batch, filled);
+}
+
+size_t ColumnarExtractor::extract(const uint8_t *data, size_t size, record_batch &batch, size_t max_rows) const
+{
+    std::vector<uint8_t> filled(_specs.size());
+    size_t offset = 0;
+
+    for (size_t row = 0; row < max_rows && offset < size; row++)
+    {
+        // the walk reads no further than the record, so the whole record is checked against size first
+        size_t record_size = Msgpack::skip_object_bounded(data + offset, data + size);
+
+        if (!record_size)
+            break;
+
+        extract_row(data + offset, batch, filled);
+        offset += record_size;
+    }
+
+    return offset;
+}
+
+}
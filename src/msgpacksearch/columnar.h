@@ -0,0 +1,136 @@
+#ifndef MSGPACKSEARCH_COLUMNAR_H
+#define MSGPACKSEARCH_COLUMNAR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "path.h"
+
+namespace msgpacksearch {
+
+/**
+ * column_type - element type of an extracted column
+ *
+ * int64 -> integers, and floats holding an integer
+ * float64 -> any number, widened to double
+ * boolean -> booleans, stored one per byte
+ * string -> views of string payloads in the input buffer
+ * raw -> pointers to the encoded values of any type, for callers decoding them themselves
+ */
+enum class column_type : uint8_t { int64, float64, boolean, string, raw };
+
+/**
+ * column_spec - one column to extract
+ *
+ * path -> path of the value in every record, see parse_path
+ * type -> type of the column, values that do not convert losslessly are null
+ */
+struct column_spec
+{
+    std::string path;
+    column_type type;
+};
+
+/**
+ * column - values of one path across the rows of a batch
+ *
+ * Only the vector matching type is filled, with one element per row; null rows hold a zero value.
+ * validity has one bit per row, least significant bit first, set for non-null rows.
+ */
+struct column
+{
+    std::string path;
+    column_type type = column_type::int64;
+    std::vector<int64_t> int64_values;
+    std::vector<double> float64_values;
+    std::vector<uint8_t> boolean_values;
+    std::vector<std::string_view> string_values;
+    std::vector<const uint8_t *> raw_values; // NULL for null rows
+    std::vector<uint64_t> validity;
+    size_t null_count = 0;
+
+    bool is_null(size_t row) const { return !(validity[row / 64] >> (row % 64) & 1); }
+};
+
+/**
+ * record_batch - a batch of rows, one column per column_spec
+ *
+ * String columns point into the buffer the rows were extracted from, it must outlive the batch.
+ */
+struct record_batch
+{
+    std::vector<column> columns;
+    size_t rows = 0;
+
+    /// Drops the rows, keeps the columns and their capacity
+    void clear();
+};
+
+/**
+ * @brief Pivots a stream of records into typed columns.
+ *
+ * The paths of all columns are merged into a trie; every record is traversed once, descending only
+ * into the members and elements that lead to a column and skipping everything else. The conversion
+ * of a column is picked once from its column_type.
+ */
+class ColumnarExtractor {
+
+public:
+
+    /**
+    * @param[in] columns the columns to extract, in batch order
+    * @throws parse_error if a path is malformed
+    */
+    explicit ColumnarExtractor(const std::vector<column_spec> &columns);
+
+    /**
+    * An empty batch with the columns of this extractor
+    * @param[in] capacity number of rows to reserve
+    */
+    record_batch make_batch(size_t capacity = 0) const;
+
+    /**
+    * Appends one row per record of a stream to a batch, a truncated last record is left in the stream
+    * @param[in] data first record of the stream
+    * @param[in] size number of bytes in the stream
+    * @param[in,out] batch batch made by make_batch
+    * @param[in] max_rows stop after this many records
+    * @return Number of bytes consumed, the offset of the first record left in the stream
+    * @throws parse_error on an invalid type byte, the offset is relative to the record
+    */
+    size_t extract(const uint8_t *data, size_t size, record_batch &batch, size_t max_rows = SIZE_MAX) const;
+
+    /**
+    * Appends the row of one record, without bounds checks
+    * @param[in] record points at a complete record, see Msgpack::skip_object_bounded
+    * @param[in,out] batch batch made by make_batch
+    * @return Encoded size of the record
+    */
+    size_t extract_record(const uint8_t *record, record_batch &batch) const;
+
+private:
+    struct trie_node
+    {
+        std::vector<std::pair<std::string, uint32_t>> keys; // child nodes by map key
+        std::vector<std::pair<uint32_t, uint32_t>> indexes; // child nodes by array index
+        std::vector<uint32_t> columns; // columns reading the value at this node
+    };
+
+    uint32_t child(uint32_t parent, const path_element &element);
+    size_t walk(const uint8_t *start, uint32_t node_index, record_batch &batch, std::vector<uint8_t> &filled) const;
+    size_t extract_row(const uint8_t *record, record_batch &batch, std::vector<uint8_t> &filled) const;
+    static void append(column &target, size_t row, const uint8_t *value);
+    static void append_null(column &target, size_t row);
+    static void mark(column &target, size_t row, bool valid);
+
+    std::vector<column_spec> _specs;
+    std::vector<trie_node> _nodes; // _nodes[0] is the record root
+};
+
+}
+
+#endif //MSGPACKSEARCH_COLUMNAR_H
@@ -0,0 +1,560 @@
+#include "compare.h"
+#include "msgpacksearch.h"
+#include "packer.h"
+#include "error.h"
+#include "decode.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+/// Families of equal(), integers of every width and signedness form one
+enum class family : uint8_t { nil, boolean, integer, float_, str, bin, array, map, ext };
+
+/**
+ * item - decoded header of one object
+ *
+ * header -> bytes up to the payload or the first element, the whole object for numbers
+ * integer -> value of integers and booleans, bits of floats
+ * negative -> integers: the value is an int64_t below 0
+ * width -> floats: 4 or 8
+ * size -> payload bytes of strings, binaries and ext, elements of arrays, key:value pairs of maps
+ */
+struct item
+{
+    family kind;
+    size_t header;
+    uint64_t integer = 0;
+    bool negative = false;
+    uint8_t width = 0;
+    int8_t ext_type = 0;
+    uint32_t size = 0;
+
+    size_t scalar_length() const { return header + (kind == family::str || kind == family::bin || kind == family::ext ? size : 0); }
+};
+
+item decode(const uint8_t *p, const uint8_t *base)
+{
+    const uint8_t type = *p;
+
+    switch (type)
+    {
+        case 0x80 ... 0x8f: return item{family::map, 1, 0, false, 0, 0, type & 0x0fu};
+        case 0x90 ... 0x9f: return item{family::array, 1, 0, false, 0, 0, type & 0x0fu};
+        case 0xa0 ... 0xbf: return item{family::str, 1, 0, false, 0, 0, type & 0x1fu};
+        case 0xc0: return item{family::nil, 1};
+        case 0xc2: case 0xc3: return item{family::boolean, 1, type & 1u};
+        case 0xc4: return item{family::bin, 2, 0, false, 0, 0, p[1]};
+        case 0xc5: return item{family::bin, 3, 0, false, 0, 0, load_be16(p + 1)};
+        case 0xc6: return item{family::bin, 5, 0, false, 0, 0, load_be32(p + 1)};
+        case 0xc7: return item{family::ext, 3, 0, false, 0, static_cast<int8_t>(p[2]), p[1]};
+        case 0xc8: return item{family::ext, 4, 0, false, 0, static_cast<int8_t>(p[3]), load_be16(p + 1)};
+        case 0xc9: return item{family::ext, 6, 0, false, 0, static_cast<int8_t>(p[5]), load_be32(p + 1)};
+        case 0xca: return item{family::float_, 5, load_be32(p + 1), false, 4};
+        case 0xcb: return item{family::float_, 9, load_be64(p + 1), false, 8};
+        case 0xd4: return item{family::ext, 2, 0, false, 0, static_cast<int8_t>(p[1]), 1};
+        case 0xd5: return item{family::ext, 2, 0, false, 0, static_cast<int8_t>(p[1]), 2};
+        case 0xd6: return item{family::ext, 2, 0, false, 0, static_cast<int8_t>(p[1]), 4};
+        case 0xd7: return item{family::ext, 2, 0, false, 0, static_cast<int8_t>(p[1]), 8};
+        case 0xd8: return item{family::ext, 2, 0, false, 0, static_cast<int8_t>(p[1]), 16};
+        case 0xd9: return item{family::str, 2, 0, false, 0, 0, p[1]};
+        case 0xda: return item{family::str, 3, 0, false, 0, 0, load_be16(p + 1)};
+        case 0xdb: return item{family::str, 5, 0, false, 0, 0, load_be32(p + 1)};
+        case 0xdc: return item{family::array, 3, 0, false, 0, 0, load_be16(p + 1)};
+        case 0xdd: return item{family::array, 5, 0, false, 0, 0, load_be32(p + 1)};
+        case 0xde: return item{family::map, 3, 0, false, 0, 0, load_be16(p + 1)};
+        case 0xdf: return item{family::map, 5, 0, false, 0, 0, load_be32(p + 1)};
+        default: break;
+    }
+
+    item integer{family::integer, 1};
+
+    if (!read_integer(p, integer.integer, integer.negative))
+        throw parse_error("Invalid type byte", p - base);
+
+    switch (type)
+    {
+        case 0xcc: case 0xd0: integer.header = 2; break;
+        case 0xcd: case 0xd1: integer.header = 3; break;
+        case 0xce: case 0xd2: integer.header = 5; break;
+        case 0xcf: case 0xd3: integer.header = 9; break;
+        default: break;
+    }
+
+    return integer;
+}
+
+template <typename T>
+int three_way(T a, T b)
+{
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+/// Float bits mapped so that unsigned order is numeric order, -0.0 before 0.0 and NaNs at the ends
+uint64_t ordered_bits(const item &value)
+{
+    double d;
+
+    if (value.width == 4)
+    {
+        uint32_t bits = static_cast<uint32_t>(value.integer);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        d = f;
+    }
+    else
+        std::memcpy(&d, &value.integer, sizeof(d));
+
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return bits >> 63 ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+/// A key:value pair of a map
+struct member
+{
+    const uint8_t *key;
+    const uint8_t *value;
+};
+
+/// Walks two objects side by side, advancing both pointers past the objects when they compare equal
+class Comparer {
+
+public:
+    Comparer(const uint8_t *a_base, const uint8_t *b_base) : _a_base(a_base), _b_base(b_base) {}
+
+    bool equal_at(const uint8_t *&a, const uint8_t *&b);
+    int compare_at(const uint8_t *&a, const uint8_t *&b);
+
+private:
+    static constexpr uint32_t max_matched_members = 32; // larger maps are sorted instead
+
+    bool equal_maps(const uint8_t *&a, const uint8_t *&b, uint32_t nmb_members);
+    bool equal_members(const uint8_t *&a, const uint8_t *&b, uint32_t nmb_members);
+    std::vector<member> sorted_members(const uint8_t *&start, uint32_t nmb_members, const uint8_t *base) const;
+
+    const uint8_t *_a_base;
+    const uint8_t *_b_base;
+};
+
+std::vector<member> Comparer::sorted_members(const uint8_t *&start, uint32_t nmb_members, const uint8_t *base) const
+{
+    std::vector<member> members(nmb_members);
+
+    for (member &current : members)
+    {
+        current.key = start;
+        start += Msgpack::skip_object(start);
+        current.value = start;
+        start += Msgpack::skip_object(start);
+    }
+
+    // duplicate keys keep their order, as in canonicalize
+    Comparer side(base, base);
+    std::stable_sort(members.begin(), members.end(), [&side](const member &x, const member &y) {
+        const uint8_t *x_key = x.key;
+        const uint8_t *y_key = y.key;
+        return side.compare_at(x_key, y_key) < 0;
+    });
+
+    return members;
+}
+
+bool Comparer::equal_maps(const uint8_t *&a, const uint8_t *&b, uint32_t nmb_members)
+{
+    // same keys in the same order is the common case
+    for (uint32_t position = 0; position < nmb_members; position++)
+    {
+        const uint8_t *a_key = a;
+        const uint8_t *b_key = b;
+
+        if (!equal_at(a, b))
+        {
+            a = a_key;
+            b = b_key;
+            return equal_members(a, b, nmb_members - position);
+        }
+
+        // equal keys at the same position pair up in key order too, their values must be equal
+        if (!equal_at(a, b))
+            return false;
+    }
+
+    return true;
+}
+
+bool Comparer::equal_members(const uint8_t *&a, const uint8_t *&b, uint32_t nmb_members)
+{
+    if (nmb_members > max_matched_members)
+    {
+        std::vector<member> a_members = sorted_members(a, nmb_members, _a_base);
+        std::vector<member> b_members = sorted_members(b, nmb_members, _b_base);
+
+        for (uint32_t index = 0; index < nmb_members; index++)
+        {
+            if (!equal_at(a_members[index].key, b_members[index].key) ||
+                !equal_at(a_members[index].value, b_members[index].value))
+                return false;
+        }
+
+        return true;
+    }
+
+    // small maps: every member of a is matched with the first unused member of b with an equal key,
+    // duplicate keys pair up in order of appearance
+    member b_members[max_matched_members];
+    bool used[max_matched_members] = {};
+
+    for (uint32_t index = 0; index < nmb_members; index++)
+    {
+        b_members[index].key = b;
+        b += Msgpack::skip_object(b);
+        b_members[index].value = b;
+        b += Msgpack::skip_object(b);
+    }
+
+    for (uint32_t position = 0; position < nmb_members; position++)
+    {
+        uint32_t match = 0;
+        const uint8_t *a_value = a;
+
+        for (; match < nmb_members; match++)
+        {
+            const uint8_t *b_key = b_members[match].key;
+            a_value = a;
+
+            if (!used[match] && equal_at(a_value, b_key))
+                break;
+        }
+
+        if (match == nmb_members)
+            return false;
+
+        used[match] = true;
+        a = a_value;
+
+        const uint8_t *b_value = b_members[match].value;
+        if (!equal_at(a, b_value))
+            return false;
+    }
+
+    return true;
+}
+
+bool Comparer::equal_at(const uint8_t *&a, const uint8_t *&b)
+{
+    const item x = decode(a, _a_base);
+    const item y = decode(b, _b_base);
+
+    if (x.kind != y.kind)
+        return false;
+
+    switch (x.kind)
+    {
+        case family::nil:
+            break;
+        case family::boolean:
+        case family::integer:
+            if (x.integer != y.integer || x.negative != y.negative)
+                return false;
+            break;
+        case family::float_:
+            if (x.width != y.width || x.integer != y.integer)
+                return false;
+            break;
+        case family::ext:
+            if (x.ext_type != y.ext_type)
+                return false;
+            [[fallthrough]];
+        case family::str:
+        case family::bin:
+            if (x.size != y.size || std::memcmp(a + x.header, b + y.header, x.size) != 0)
+                return false;
+            break;
+        case family::array:
+        {
+            if (x.size != y.size)
+                return false;
+
+            a += x.header;
+            b += y.header;
+
+            for (uint32_t element = 0; element < x.size; element++)
+                if (!equal_at(a, b))
+                    return false;
+
+            return true;
+        }
+        case family::map:
+        {
+            if (x.size != y.size)
+                return false;
+
+            a += x.header;
+            b += y.header;
+            return equal_maps(a, b, x.size);
+        }
+    }
+
+    a += x.scalar_length();
+    b += y.scalar_length();
+    return true;
+}
+
+int Comparer::compare_at(const uint8_t *&a, const uint8_t *&b)
+{
+    const item x = decode(a, _a_base);
+    const item y = decode(b, _b_base);
+    int order = three_way(x.kind, y.kind);
+
+    if (order)
+        return order;
+
+    switch (x.kind)
+    {
+        case family::nil:
+            break;
+        case family::boolean:
+            order = three_way(x.integer, y.integer);
+            break;
+        case family::integer:
+            if (x.negative != y.negative)
+                order = x.negative ? -1 : 1;
+            else if (x.negative)
+                order = three_way(static_cast<int64_t>(x.integer), static_cast<int64_t>(y.integer));
+            else
+                order = three_way(x.integer, y.integer);
+            break;
+        case family::float_:
+            order = three_way(ordered_bits(x), ordered_bits(y));
+            if (!order)
+                order = three_way(x.width, y.width);
+            break;
+        case family::ext:
+            order = three_way(x.ext_type, y.ext_type);
+            if (order)
+                break;
+            [[fallthrough]];
+        case family::str:
+        case family::bin:
+            order = std::memcmp(a + x.header, b + y.header, std::min(x.size, y.size));
+            order = order ? three_way(order, 0) : three_way(x.size, y.size);
+            break;
+        case family::array:
+        {
+            a += x.header;
+            b += y.header;
+
+            for (uint32_t element = 0; element < std::min(x.size, y.size); element++)
+                if ((order = compare_at(a, b)))
+                    return order;
+
+            if ((order = three_way(x.size, y.size)))
+                return order;
+
+            return 0;
+        }
+        case family::map:
+        {
+            a += x.header;
+            b += y.header;
+            std::vector<member> a_members = sorted_members(a, x.size, _a_base);
+            std::vector<member> b_members = sorted_members(b, y.size, _b_base);
+
+            for (uint32_t index = 0; index < std::min(x.size, y.size); index++)
+            {
+                if ((order = compare_at(a_members[index].key, b_members[index].key)) ||
+                    (order = compare_at(a_members[index].value, b_members[index].value)))
+                    return order;
+            }
+
+            return three_way(x.size, y.size);
+        }
+    }
+
+    if (!order)
+    {
+        a += x.scalar_length();
+        b += y.scalar_length();
+    }
+
+    return order;
+}
+
+/// Seed of a family, so that e.g. a string and a binary with the same bytes hash differently
+uint64_t family_seed(family kind, uint64_t seed)
+{
+    return seed + (static_cast<uint64_t>(kind) + 1) * xxhash_detail::prime1;
+}
+
+uint64_t hash_at(const uint8_t *&p, uint64_t seed, const uint8_t *base)
+{
+    const item x = decode(p, base);
+    const uint64_t kind_seed = family_seed(x.kind, seed);
+    uint8_t buffer[10];
+
+    switch (x.kind)
+    {
+        case family::nil:
+        case family::boolean:
+        case family::integer:
+        case family::float_:
+        {
+            buffer[0] = x.negative;
+            buffer[1] = x.width;
+            std::memcpy(buffer + 2, &x.integer, sizeof(x.integer));
+            p += x.header;
+            return xxhash64(buffer, sizeof(buffer), kind_seed);
+        }
+        case family::str:
+        case family::bin:
+        case family::ext:
+        {
+            uint64_t h = xxhash64(p + x.header, x.size, kind_seed + static_cast<uint8_t>(x.ext_type));
+            p += x.scalar_length();
+            return h;
+        }
+        case family::array:
+        {
+            // elements chain the hash, their order counts
+            uint64_t h = kind_seed + x.size;
+            p += x.header;
+
+            for (uint32_t element = 0; element < x.size; element++)
+                h = hash_at(p, h, base);
+
+            return xxhash64(&h, sizeof(h), kind_seed);
+        }
+        case family::map:
+        {
+            // members are summed, their order does not count
+            uint64_t sum = 0;
+            p += x.header;
+
+            for (uint32_t position = 0; position < x.size; position++)
+            {
+                uint64_t key_hash = hash_at(p, seed, base);
+                sum += hash_at(p, key_hash, base);
+            }
+
+            return xxhash64(&sum, sizeof(sum), kind_seed + x.size);
+        }
+    }
+
+    return 0;
+}
+
+const uint8_t* encode(const msgpack_object &object, std::vector<uint8_t> &scratch)
+{
+    Packer packer(scratch);
+
+    if (std::holds_alternative<std::monostate>(object))
+        packer.pack_nil();
+    else if (std::holds_alternative<bool>(object))
+        packer.pack_bool(std::get<bool>(object));
+    else if (std::holds_alternative<uint64_t>(object))
+        packer.pack_uint(std::get<uint64_t>(object));
+    else if (std::holds_alternative<int64_t>(object))
+        packer.pack_int(std::get<int64_t>(object));
+    else if (std::holds_alternative<double>(object))
+        packer.pack_double(std::get<double>(object));
+    else if (std::holds_alternative<msgpack_str>(object))
+    {
+        auto str = std::get<msgpack_str>(object);
+        packer.pack_str(std::string_view(str.data, str.size));
+    }
+    else if (std::holds_alternative<msgpack_bin>(object))
+    {
+        auto bin = std::get<msgpack_bin>(object);
+        packer.pack_bin(bin.data, bin.size);
+    }
+    else if (std::holds_alternative<msgpack_ext>(object))
+    {
+        auto ext = std::get<msgpack_ext>(object);
+        packer.pack_ext(ext.type, ext.data, ext.size);
+    }
+    else if (std::holds_alternative<msgpack_array>(object))
+    {
+        auto array = std::get<msgpack_array>(object);
+        packer.pack_array(array.nmb_elements);
+        packer.pack_raw(array.start, array.size);
+    }
+    else
+    {
+        auto map = std::get<msgpack_map>(object);
+        packer.pack_map(map.nmb_elements);
+        packer.pack_raw(map.start, map.size);
+    }
+
+    return scratch.data();
+}
+
+}
+
+bool equal(const uint8_t *a, const uint8_t *b, bool canonical)
+{
+    size_t a_size = Msgpack::skip_object(a);
+
+    if (a_size == Msgpack::skip_object(b) && std::memcmp(a, b, a_size) == 0)
+        return true;
+
+    if (canonical)
+        return false;
+
+    Comparer comparer(a, b);
+    return comparer.equal_at(a, b);
+}
+
+bool equal(const Cursor &a, const Cursor &b, bool canonical)
+{
+    return equal(a.data(), b.data(), canonical);
+}
+
+int compare(const uint8_t *a, const uint8_t *b)
+{
+    Comparer comparer(a, b);
+    return comparer.compare_at(a, b);
+}
+
+int compare(const Cursor &a, const Cursor &b)
+{
+    return compare(a.data(), b.data());
+}
+
+uint64_t hash(const uint8_t *value, uint64_t seed)
+{
+    return hash_at(value, seed, value);
+}
+
+uint64_t hash(const Cursor &value, uint64_t seed)
+{
+    return hash(value.data(), seed);
+}
+
+bool equal(const msgpack_object &a, const msgpack_object &b)
+{
+    std::vector<uint8_t> a_scratch;
+    std::vector<uint8_t> b_scratch;
+    return equal(encode(a, a_scratch), encode(b, b_scratch));
+}
+
+int compare(const msgpack_object &a, const msgpack_object &b)
+{
+    std::vector<uint8_t> a_scratch;
+    std::vector<uint8_t> b_scratch;
+    return compare(encode(a, a_scratch), encode(b, b_scratch));
+}
+
+uint64_t hash(const msgpack_object &value, uint64_t seed)
+{
+    std::vector<uint8_t> scratch;
+    return hash(encode(value, scratch), seed);
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef MSGPACKSEARCH_COMPARE_H
+#define MSGPACKSEARCH_COMPARE_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "cursor.h"
+#include "types.h"
+
+/// Semantic equality, ordering and hashing of encoded objects, without building msgpack_objects.
+///
+/// Two objects are equal when canonicalize() turns them into the same bytes: integers compare by value
+/// whatever their width or signedness, strings and binaries by content, maps by their members in key
+/// order (duplicate keys in order of appearance), floats by their bits and width, ext by type and payload.
+/// Integers and floats are distinct families, 1 and 1.0 are not equal.
+
+namespace msgpacksearch {
+
+/**
+* Semantic equality of two encoded objects. Identical bytes are recognized with one memcmp first.
+* @param[in] a points at the first object
+* @param[in] b points at the second object
+* @param[in] canonical both objects are known to be canonical (see canonicalize), the memcmp is the answer
+* @return true if the objects are equal
+* @throws parse_error on an invalid type byte
+*/
+bool equal(const uint8_t *a, const uint8_t *b, bool canonical = false);
+
+/// Same, for the objects under two cursors
+bool equal(const Cursor &a, const Cursor &b, bool canonical = false);
+
+/**
+* Total order of encoded objects, consistent with equal(). Families sort as nil, boolean, integer, float,
+* string, binary, array, map, ext; integers and floats by value (float 32 before an equal float 64),
+* strings and binaries bytewise, arrays element by element, maps member by member in key order.
+* @param[in] a points at the first object
+* @param[in] b points at the second object
+* @return negative, 0 or positive as a is less than, equal to or greater than b
+* @throws parse_error on an invalid type byte
+*/
+int compare(const uint8_t *a, const uint8_t *b);
+
+/// Same, for the objects under two cursors
+int compare(const Cursor &a, const Cursor &b);
+
+/**
+* Hash of an encoded object, consistent with equal(): equal objects hash equal whatever their encoding.
+* Scalars are hashed with XXH64, arrays chain the hashes of their elements, maps combine the hashes of
+* their members without depending on their order.
+* @param[in] value points at the object
+* @param[in] seed hash seed
+* @return The 64 bit hash
+* @throws parse_error on an invalid type byte
+*/
+uint64_t hash(const uint8_t *value, uint64_t seed = 0);
+
+/// Same, for the object under a cursor
+uint64_t hash(const Cursor &value, uint64_t seed = 0);
+
+/// Same functions for decoded objects. Scalars are re-encoded and containers copied into a scratch buffer,
+/// doubles compare as float 64; prefer the pointer and Cursor overloads on hot paths.
+bool equal(const msgpack_object &a, const msgpack_object &b);
+int compare(const msgpack_object &a, const msgpack_object &b);
+uint64_t hash(const msgpack_object &value, uint64_t seed = 0);
+
+}
+
+#endif //MSGPACKSEARCH_COMPARE_H
@@ -0,0 +1,130 @@
+#include "cursor.h"
+#include "msgpacksearch.h"
+#include "decode.h"
+#include "instrumentation.h"
+
+namespace msgpacksearch
+{
+
+Cursor::Cursor(const uint8_t *data, size_t length) : Cursor(length ? data : nullptr, data + length, nullptr, 0) {}
+
+Cursor::Cursor(const uint8_t *pos, const uint8_t *end, const uint8_t *key, uint32_t remaining) :
+    _pos(pos), _end(end), _key(key), _remaining(remaining)
+{
+    if (!_pos || _pos >= _end)
+    {
+        _pos = nullptr;
+        return;
+    }
+
+    size_t header_size;
+
+    if (read_map_header(_pos, _nmb_elements, header_size))
+        _kind = kind::map;
+    else if (read_array_header(_pos, _nmb_elements, header_size))
+        _kind = kind::array;
+    else
+        return;
+
+    _elements = _pos + header_size;
+}
+
+Cursor Cursor::child(std::string_view key) const
+{
+    if (_kind != kind::map)
+        return Cursor();
+
+    const uint8_t *current = _elements;
+
+    for (uint32_t element_count = 0; element_count < _nmb_elements; element_count++)
+    {
+        std::string_view current_key;
+        const uint8_t *value = current + Msgpack::skip_object(current);
+
+        MSGPACKSEARCH_COUNT(keys_compared, 1);
+
+        if (read_str(current, current_key) && current_key == key)
+        {
+            MSGPACKSEARCH_COUNT(bytes_skipped, current - _elements);
+            return Cursor(value, _end, current, _nmb_elements - element_count - 1);
+        }
+
+        current = value + Msgpack::skip_object(value);
+    }
+
+    MSGPACKSEARCH_COUNT(bytes_skipped, current - _elements);
+    return Cursor();
+}
+
+Cursor Cursor::at(uint32_t index) const
+{
+    if (_kind == kind::scalar || index >= _nmb_elements)
+        return Cursor();
+
+    const uint8_t *current = _elements;
+
+    if (_kind == kind::array)
+    {
+        for (uint32_t element_count = 0; element_count < index; element_count++)
+            current += Msgpack::skip_object(current);
+
+        MSGPACKSEARCH_COUNT(bytes_skipped, current - _elements);
+        return Cursor(current, _end, nullptr, _nmb_elements - index - 1);
+    }
+
+    for (uint32_t element_count = 0; element_count < index; element_count++)
+    {
+        current += Msgpack::skip_object(current);
+        current += Msgpack::skip_object(current);
+    }
+
+    MSGPACKSEARCH_COUNT(bytes_skipped, current - _elements);
+    return Cursor(current + Msgpack::skip_object(current), _end, current, _nmb_elements - index - 1);
+}
+
+Cursor Cursor::next_sibling() const
+{
+    if (!valid() || _remaining == 0)
+        return Cursor();
+
+    const uint8_t *next = _pos + length();
+
+    if (!_key)
+        return Cursor(next, _end, nullptr, _remaining - 1);
+
+    return Cursor(next + Msgpack::skip_object(next), _end, next, _remaining - 1);
+}
+
+msgpack_object Cursor::value() const
+{
+    if (!valid())
+        return msgpack_object();
+
+    return Msgpack::parse_data(_pos).second;
+}
+
+std::string_view Cursor::key() const
+{
+    std::string_view key;
+
+    if (_key)
+        read_str(_key, key);
+
+    return key;
+}
+
+size_t Cursor::length() const
+{
+    if (!valid())
+        return 0;
+
+    if (_kind == kind::map)
+        return (_elements - _pos) + Msgpack::skip_map(_elements, _nmb_elements);
+
+    if (_kind == kind::array)
+        return (_elements - _pos) + Msgpack::skip_array(_elements, _nmb_elements);
+
+    return Msgpack::skip_object(_pos);
+}
+
+}
@@ -0,0 +1,103 @@
+#ifndef MSGPACKSEARCH_CURSOR_H
+#define MSGPACKSEARCH_CURSOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+#include "types.h"
+
+namespace msgpacksearch {
+
+/**
+ * @brief Cheap, copyable position in a msgpack blob.
+ *
+ * A cursor points at one object and keeps its decoded container header (element count, start of the
+ * elements) plus how many siblings follow it in the parent container, so descending and iterating
+ * never re-decode headers that were already read. Operations that fail return an invalid cursor,
+ * check with valid() / operator bool.
+ */
+class Cursor {
+
+public:
+
+    /// An invalid cursor
+    Cursor() = default;
+
+    /**
+    * Cursor on the root object of a blob
+    * @param[in] data points at the root object
+    * @param[in] length number of bytes in the blob
+    */
+    Cursor(const uint8_t *data, size_t length);
+
+    bool valid() const { return _pos != nullptr; }
+    explicit operator bool() const { return valid(); }
+
+    bool is_map() const { return _kind == kind::map; }
+    bool is_array() const { return _kind == kind::array; }
+
+    /// Number of key:value pairs of a map or elements of an array, 0 for any other object
+    uint32_t nmb_elements() const { return _nmb_elements; }
+
+    /**
+    * Descends into a map member
+    * @param[in] key key to search for
+    * @return Cursor on the value of the key, invalid if this is not a map or the key is missing
+    */
+    Cursor child(std::string_view key) const;
+
+    /**
+    * Descends into the n-th element of an array, or the n-th value of a map
+    * @param[in] index index of the element
+    * @return Cursor on the element, invalid if out of range or this is not a container
+    */
+    Cursor at(uint32_t index) const;
+
+    /**
+    * Moves to the next element of the parent container (the next value, for map members)
+    * @return Cursor on the sibling, invalid once the end of the parent is reached
+    */
+    Cursor next_sibling() const;
+
+    /// Decodes the object the cursor points at
+    msgpack_object value() const;
+
+    /// Key of the member when the cursor was reached through a map, empty otherwise
+    std::string_view key() const;
+
+    /// Pointer to the first byte of the object
+    const uint8_t* data() const { return _pos; }
+
+    /// End of the blob the cursor walks
+    const uint8_t* end() const { return _end; }
+
+    /// Number of bytes of the encoded object, containers are skipped to find their end
+    size_t length() const;
+
+private:
+    friend class KeySearch;
+
+    enum class kind : uint8_t { scalar, map, array };
+
+    /**
+    * Decodes the header of the object at pos
+    * @param[in] pos points at the object
+    * @param[in] end end of the blob
+    * @param[in] key key of the object in its parent map, or nullptr
+    * @param[in] remaining number of siblings after the object
+    */
+    Cursor(const uint8_t *pos, const uint8_t *end, const uint8_t *key, uint32_t remaining);
+
+    const uint8_t *_pos = nullptr;
+    const uint8_t *_end = nullptr;
+    const uint8_t *_elements = nullptr; // first element of a container
+    const uint8_t *_key = nullptr;
+    uint32_t _nmb_elements = 0;
+    uint32_t _remaining = 0;
+    kind _kind = kind::scalar;
+};
+
+}
+
+#endif //MSGPACKSEARCH_CURSOR_H
@@ -0,0 +1,678 @@
+#ifndef MSGPACKSEARCH_DECODE_H
+#define MSGPACKSEARCH_DECODE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <byteswap.h>
+
+#include "error.h"
+#include "types.h"
+
+/// Small inline decoders for the raw bytes, shared by the lookup paths that must not build a msgpack_object.
+
+namespace msgpacksearch {
+
+inline uint16_t load_be16(const uint8_t *p)
+{
+    uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __bswap_16(value);
+}
+
+inline uint32_t load_be32(const uint8_t *p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __bswap_32(value);
+}
+
+inline uint64_t load_be64(const uint8_t *p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __bswap_64(value);
+}
+
+/**
+* Classifies an object by its type byte
+* @param[in] type_byte first byte of the object
+* @return the family of the object, msgpack_type::invalid for 0xc1
+*/
+inline msgpack_type type_of(uint8_t type_byte)
+{
+    switch (type_byte)
+    {
+        case 0x00 ... 0x7f: return msgpack_type::uint;
+        case 0x80 ... 0x8f: return msgpack_type::map;
+        case 0x90 ... 0x9f: return msgpack_type::array;
+        case 0xa0 ... 0xbf: return msgpack_type::str;
+        case 0xc0: return msgpack_type::nil;
+        case 0xc2 ... 0xc3: return msgpack_type::boolean;
+        case 0xc4 ... 0xc6: return msgpack_type::bin;
+        case 0xc7 ... 0xc9: return msgpack_type::ext;
+        case 0xca ... 0xcb: return msgpack_type::float_;
+        case 0xcc ... 0xcf: return msgpack_type::uint;
+        case 0xd0 ... 0xd3: return msgpack_type::int_;
+        case 0xd4 ... 0xd8: return msgpack_type::ext;
+        case 0xd9 ... 0xdb: return msgpack_type::str;
+        case 0xdc ... 0xdd: return msgpack_type::array;
+        case 0xde ... 0xdf: return msgpack_type::map;
+        case 0xe0 ... 0xff: return msgpack_type::int_;
+        default: return msgpack_type::invalid;
+    }
+}
+
+/**
+* Reads a string object
+* @param[in] start points at the object
+* @param[out] out the string payload, untouched if the object is not a string
+* @return true if the object is a string
+*/
+inline bool read_str(const uint8_t *start, std::string_view &out)
+{
+    switch (*start)
+    {
+        case 0xa0 ... 0xbf: // fixstr
+            out = std::string_view((const char *)(start + 1), *start & 0b00011111);
+            return true;
+        case 0xd9: // str 8
+            out = std::string_view((const char *)(start + 2), *(start + 1));
+            return true;
+        case 0xda: // str 16
+            out = std::string_view((const char *)(start + 3), load_be16(start + 1));
+            return true;
+        case 0xdb: // str 32
+            out = std::string_view((const char *)(start + 5), load_be32(start + 1));
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+* Reads an integer object of any width and signedness
+* @param[in] start points at the object
+* @param[out] value the value, as uint64_t if positive (is_signed false) or as int64_t if negative (is_signed true)
+* @param[out] is_signed true if the value is negative
+* @return true if the object is an integer
+*/
+inline bool read_integer(const uint8_t *start, uint64_t &value, bool &is_signed)
+{
+    int64_t signed_value;
+
+    switch (*start)
+    {
+        case 0x00 ... 0x7f: // positive fixnum
+            value = *start;
+            is_signed = false;
+            return true;
+        case 0xcc: // uint 8
+            value = *(start + 1);
+            is_signed = false;
+            return true;
+        case 0xcd: // uint 16
+            value = load_be16(start + 1);
+            is_signed = false;
+            return true;
+        case 0xce: // uint 32
+            value = load_be32(start + 1);
+            is_signed = false;
+            return true;
+        case 0xcf: // uint 64
+            value = load_be64(start + 1);
+            is_signed = false;
+            return true;
+        case 0xe0 ... 0xff: // negative fixnum
+            signed_value = static_cast<int8_t>(*start);
+            break;
+        case 0xd0: // int 8
+            signed_value = static_cast<int8_t>(*(start + 1));
+            break;
+        case 0xd1: // int 16
+            signed_value = static_cast<int16_t>(load_be16(start + 1));
+            break;
+        case 0xd2: // int 32
+            signed_value = static_cast<int32_t>(load_be32(start + 1));
+            break;
+        case 0xd3: // int 64
+            signed_value = static_cast<int64_t>(load_be64(start + 1));
+            break;
+        default:
+            return false;
+    }
+
+    is_signed = signed_value < 0;
+    value = static_cast<uint64_t>(signed_value);
+    return true;
+}
+
+/**
+* Reads a float 32 or float 64 object
+* @param[in] start points at the object
+* @param[out] value the value, widened to double
+* @return true if the object is a float
+*/
+inline bool read_float(const uint8_t *start, double &value)
+{
+    if (*start == 0xca)
+    {
+        uint32_t bits = load_be32(start + 1);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        value = f;
+        return true;
+    }
+
+    if (*start == 0xcb)
+    {
+        uint64_t bits = load_be64(start + 1);
+        std::memcpy(&value, &bits, sizeof(value));
+        return true;
+    }
+
+    return false;
+}
+
+/**
+* Reads any numeric object as uint64_t, if the conversion is lossless
+* @param[in] start points at the object
+* @param[out] value the value, untouched on failure
+* @return false for non-numeric objects, negative values and non-integral or out of range floats
+*/
+inline bool read_u64(const uint8_t *start, uint64_t &value)
+{
+    uint64_t integer;
+    bool is_signed;
+    double d;
+
+    if (read_integer(start, integer, is_signed))
+    {
+        if (is_signed)
+            return false;
+        value = integer;
+        return true;
+    }
+
+    if (read_float(start, d) && d >= 0 && d < 18446744073709551616.0 && d == static_cast<double>(static_cast<uint64_t>(d)))
+    {
+        value = static_cast<uint64_t>(d);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+* Reads any numeric object as int64_t, if the conversion is lossless
+* @param[in] start points at the object
+* @param[out] value the value, untouched on failure
+* @return false for non-numeric objects, unsigned values above INT64_MAX and non-integral or out of range floats
+*/
+inline bool read_i64(const uint8_t *start, int64_t &value)
+{
+    uint64_t integer;
+    bool is_signed;
+    double d;
+
+    if (read_integer(start, integer, is_signed))
+    {
+        if (!is_signed && integer > static_cast<uint64_t>(INT64_MAX))
+            return false;
+        value = static_cast<int64_t>(integer);
+        return true;
+    }
+
+    if (read_float(start, d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == static_cast<double>(static_cast<int64_t>(d)))
+    {
+        value = static_cast<int64_t>(d);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+* Reads any numeric object as double, if the conversion is lossless
+* @param[in] start points at the object
+* @param[out] value the value, untouched on failure
+* @return false for non-numeric objects and integers that a double cannot represent exactly
+*/
+inline bool read_double(const uint8_t *start, double &value)
+{
+    uint64_t integer;
+    bool is_signed;
+
+    if (read_float(start, value))
+        return true;
+
+    if (!read_integer(start, integer, is_signed))
+        return false;
+
+    if (is_signed)
+    {
+        int64_t signed_value = static_cast<int64_t>(integer);
+        double d = static_cast<double>(signed_value);
+        if (d < -9223372036854775808.0 || static_cast<int64_t>(d) != signed_value)
+            return false;
+        value = d;
+        return true;
+    }
+
+    double d = static_cast<double>(integer);
+    if (d >= 18446744073709551616.0 || static_cast<uint64_t>(d) != integer)
+        return false;
+    value = d;
+    return true;
+}
+
+/**
+* Reads a bool object
+* @param[in] start points at the object
+* @param[out] value the value, untouched on failure
+* @return true if the object is a bool
+*/
+inline bool read_bool(const uint8_t *start, bool &value)
+{
+    if (*start != 0xc2 && *start != 0xc3)
+        return false;
+
+    value = *start == 0xc3;
+    return true;
+}
+
+/**
+* Reads an ext object without copying its payload
+* @param[in] start points at the object
+* @param[out] ext type, size and location of the payload in the buffer, untouched on failure
+* @return true if the object is an ext
+*/
+inline bool read_ext(const uint8_t *start, msgpack_ext &ext)
+{
+    switch (*start)
+    {
+        case 0xd4: ext = msgpack_ext(static_cast<int8_t>(start[1]), 1, start + 2); return true; // fixext 1
+        case 0xd5: ext = msgpack_ext(static_cast<int8_t>(start[1]), 2, start + 2); return true; // fixext 2
+        case 0xd6: ext = msgpack_ext(static_cast<int8_t>(start[1]), 4, start + 2); return true; // fixext 4
+        case 0xd7: ext = msgpack_ext(static_cast<int8_t>(start[1]), 8, start + 2); return true; // fixext 8
+        case 0xd8: ext = msgpack_ext(static_cast<int8_t>(start[1]), 16, start + 2); return true; // fixext 16
+        case 0xc7: ext = msgpack_ext(static_cast<int8_t>(start[2]), start[1], start + 3); return true; // ext 8
+        case 0xc8: ext = msgpack_ext(static_cast<int8_t>(start[3]), load_be16(start + 1), start + 4); return true; // ext 16
+        case 0xc9: ext = msgpack_ext(static_cast<int8_t>(start[5]), load_be32(start + 1), start + 6); return true; // ext 32
+        default: return false;
+    }
+}
+
+/**
+* Decodes the payload of a timestamp extension (-1), in any of its three widths:
+* 32 bits of seconds, 30 bits of nanoseconds and 34 bits of seconds, or 32 bits of nanoseconds and
+* 64 bits of signed seconds
+* @param[in] ext the ext object
+* @param[out] timestamp the instant, untouched on failure
+* @return true if the ext is a valid timestamp
+*/
+inline bool decode_timestamp(const msgpack_ext &ext, msgpack_timestamp &timestamp)
+{
+    if (ext.type != -1)
+        return false;
+
+    switch (ext.size)
+    {
+        case 4: // timestamp 32
+            timestamp.seconds = load_be32(ext.data);
+            timestamp.nanoseconds = 0;
+            return true;
+        case 8: // timestamp 64
+        {
+            uint64_t packed = load_be64(ext.data);
+
+            if ((packed >> 34) > 999999999)
+                return false;
+
+            timestamp.seconds = static_cast<int64_t>(packed & 0x3ffffffffull);
+            timestamp.nanoseconds = static_cast<uint32_t>(packed >> 34);
+            return true;
+        }
+        case 12: // timestamp 96
+        {
+            uint32_t nanoseconds = load_be32(ext.data);
+
+            if (nanoseconds > 999999999)
+                return false;
+
+            timestamp.seconds = static_cast<int64_t>(load_be64(ext.data + 4));
+            timestamp.nanoseconds = nanoseconds;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+* Reads a timestamp object, see decode_timestamp
+* @param[in] start points at the object
+* @param[out] timestamp the instant, untouched on failure
+* @return true if the object is a valid timestamp
+*/
+inline bool read_timestamp(const uint8_t *start, msgpack_timestamp &timestamp)
+{
+    msgpack_ext ext;
+    return read_ext(start, ext) && decode_timestamp(ext, timestamp);
+}
+
+/**
+* Size of the header of an object: the type byte and the length or ext type fields that follow it.
+* Nil, booleans and fixed size numbers are a single byte header followed by their value as payload.
+* @param[in] type type byte of the object
+* @return Number of header bytes, up to the payload or first element; 0 for 0xc1
+*/
+inline size_t header_size(uint8_t type)
+{
+    if (type <= 0xbf || type >= 0xe0)
+        return 1;
+
+    switch (type)
+    {
+        case 0xc1: return 0;
+        case 0xc4: case 0xd9: return 2;
+        case 0xc5: case 0xda: case 0xdc: case 0xde: return 3;
+        case 0xc6: case 0xdb: case 0xdd: case 0xdf: return 5;
+        case 0xc7: return 3;
+        case 0xc8: return 4;
+        case 0xc9: return 6;
+        case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: return 2;
+        default: return 1;
+    }
+}
+
+/**
+* Size of the payload of an object
+* @param[in] header points at a complete header (see header_size)
+* @return Number of payload bytes after the header, 0 for containers
+*/
+inline uint64_t payload_size(const uint8_t *header)
+{
+    uint8_t type = header[0];
+
+    if (type >= 0xa0 && type <= 0xbf)
+        return type & 0x1f;
+
+    switch (type)
+    {
+        case 0xc4: case 0xc7: case 0xd9: return header[1];
+        case 0xc5: case 0xc8: case 0xda: return load_be16(header + 1);
+        case 0xc6: case 0xc9: case 0xdb: return load_be32(header + 1);
+        case 0xca: return 4;
+        case 0xcb: return 8;
+        case 0xcc: case 0xd0: return 1;
+        case 0xcd: case 0xd1: return 2;
+        case 0xce: case 0xd2: return 4;
+        case 0xcf: case 0xd3: return 8;
+        case 0xd4: return 1;
+        case 0xd5: return 2;
+        case 0xd6: return 4;
+        case 0xd7: return 8;
+        case 0xd8: return 16;
+        default: return 0;
+    }
+}
+
+/**
+* Reads the header of a map object
+* @param[in] start points at the object
+* @param[out] nmb_elements number of key:value pairs
+* @param[out] header_size number of bytes before the first key
+* @return true if the object is a map
+*/
+inline bool read_map_header(const uint8_t *start, uint32_t &nmb_elements, size_t &header_size)
+{
+    switch (*start)
+    {
+        case 0x80 ... 0x8f: // fixmap
+            nmb_elements = *start & 0b00001111;
+            header_size = 1;
+            return true;
+        case TYPE_MASK::MAP16:
+            nmb_elements = load_be16(start + 1);
+            header_size = 3;
+            return true;
+        case TYPE_MASK::MAP32:
+            nmb_elements = load_be32(start + 1);
+            header_size = 5;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+* Reads the header of an array object
+* @param[in] start points at the object
+* @param[out] nmb_elements number of elements
+* @param[out] header_size number of bytes before the first element
+* @return true if the object is an array
+*/
+inline bool read_array_header(const uint8_t *start, uint32_t &nmb_elements, size_t &header_size)
+{
+    switch (*start)
+    {
+        case 0x90 ... 0x9f: // fixarray
+            nmb_elements = *start & 0b00001111;
+            header_size = 1;
+            return true;
+        case TYPE_MASK::ARRAY16:
+            nmb_elements = load_be16(start + 1);
+            header_size = 3;
+            return true;
+        case TYPE_MASK::ARRAY32:
+            nmb_elements = load_be32(start + 1);
+            header_size = 5;
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * object_header - an object met by a DocumentWalker
+ *
+ * position -> offset of the object in the buffer
+ * key_size -> encoded size of the key before it in a map, 0 without one
+ * type -> type byte of the object
+ * header -> bytes before the payload, or before the first element of a container
+ * payload -> bytes of the value of a scalar, 0 for containers
+ * nmb_elements -> elements of a container, key:value pairs for maps
+ * container / map -> whether the object is a map or an array / a map
+ */
+struct object_header
+{
+    size_t position = 0;
+    size_t key_size = 0;
+    uint8_t type = 0;
+    size_t header = 0;
+    uint64_t payload = 0;
+    uint32_t nmb_elements = 0;
+    bool container = false;
+    bool map = false;
+};
+
+/**
+ * @brief Pre-order walk of the objects of a buffer, with an explicit stack instead of recursion.
+ *
+ * next() decodes the next object, and its key in a map, without moving; the caller then enter()s a
+ * container with elements or skip()s the object. Every header, payload and key is checked against the end
+ * of the buffer before it is read, so truncated or corrupted input throws instead of reading past it.
+ * Frame is what the caller keeps per open container, handed back when the container ends.
+ */
+template <typename Frame>
+class DocumentWalker {
+
+public:
+
+    /**
+     * level - container whose elements are not all walked yet
+     *
+     * remaining -> elements left, key:value pairs for maps
+     * map -> whether elements are preceded by a key
+     * frame -> what the caller keeps for the container
+     */
+    struct level
+    {
+        uint32_t remaining;
+        bool map;
+        Frame frame;
+    };
+
+    /**
+    * @param[in] data the whole buffer, offsets are relative to it
+    * @param[in] size bytes available from data
+    * @param[in] position offset of the first object, or of its key
+    * @param[in] count number of sibling objects to walk
+    * @param[in] members whether every sibling is preceded by its key
+    * @param[in] root frame of the run of siblings
+    */
+    DocumentWalker(const uint8_t *data, size_t size, size_t position, uint32_t count, bool members, Frame root)
+        : _data(data), _size(size), _position(position)
+    {
+        if (count)
+            _stack.push_back(level{count, members, std::move(root)});
+    }
+
+    /// Whether every object was walked
+    bool done() const { return _stack.empty(); }
+
+    /// Offset of the next object, or of its key; past the last object once done
+    size_t position() const { return _position; }
+
+    /// Innermost open container, the parent of the object returned by next()
+    level& parent() { return _stack.back(); }
+
+    /**
+    * Decodes the next object and skips its key
+    * @return The object, valid until the next call
+    * @throws parse_error on an invalid type byte or an object running past size
+    */
+    const object_header& next()
+    {
+        _object.key_size = _stack.back().map ? key_size(_position) : 0;
+        read_header(_position + _object.key_size, _object);
+        return _object;
+    }
+
+    /// Moves into the container returned by next(), which must have elements
+    void enter(Frame frame)
+    {
+        _position = _object.position + _object.header;
+        _stack.push_back(level{_object.nmb_elements, _object.map, std::move(frame)});
+    }
+
+    /**
+    * Moves past the object returned by next()
+    * @param[in] close called with every container the object ends, innermost first
+    */
+    template <typename Close>
+    void skip(Close &&close)
+    {
+        _position = _object.position + _object.header + _object.payload;
+
+        // the value is complete, so may be the containers it ends
+        while (!_stack.empty() && !--_stack.back().remaining)
+        {
+            close(_stack.back());
+            _stack.pop_back();
+        }
+    }
+
+    void skip() { skip([](level &) {}); }
+
+private:
+    /// Decodes the header of the object at position, checking it and its payload against size
+    void read_header(size_t position, object_header &object) const
+    {
+        if (position >= _size)
+            throw parse_error("object runs past the end of the buffer", position);
+
+        const uint8_t *start = _data + position;
+        const uint8_t type = *start;
+
+        object.position = position;
+        object.type = type;
+        object.header = 1;
+        object.payload = 0;
+        object.nmb_elements = 0;
+        object.container = false;
+        object.map = false;
+
+        if (type <= 0x7f || type >= 0xe0) // fixints, the most common scalars
+        {
+        }
+        else if (type >= 0xa0 && type <= 0xbf) // fixstr
+        {
+            object.payload = type & 0x1f;
+        }
+        else
+        {
+            object.header = header_size(type);
+
+            if (!object.header)
+                throw parse_error("invalid type byte", position);
+            if (object.header > _size - position)
+                throw parse_error("object runs past the end of the buffer", position);
+
+            size_t header;
+            object.map = read_map_header(start, object.nmb_elements, header);
+            object.container = object.map || read_array_header(start, object.nmb_elements, header);
+
+            // every element takes at least a byte, a larger count is a truncated or corrupted header
+            if (object.container && object.nmb_elements > _size - position - object.header)
+                throw parse_error("object runs past the end of the buffer", position);
+
+            if (!object.container)
+                object.payload = payload_size(start);
+        }
+
+        if (object.payload > _size - position - object.header)
+            throw parse_error("object runs past the end of the buffer", position);
+    }
+
+    /// Encoded size of the key at position, keys may be containers
+    size_t key_size(size_t position) const
+    {
+        if (position < _size && _data[position] >= 0xa0 && _data[position] <= 0xbf) // fixstr, the most common keys
+        {
+            size_t size = 1 + (_data[position] & 0x1f);
+
+            if (size > _size - position)
+                throw parse_error("object runs past the end of the buffer", position);
+
+            return size;
+        }
+
+        object_header key;
+        size_t current = position;
+        uint64_t pending = 1; // objects left to skip, the elements of a container key included
+
+        while (pending--)
+        {
+            read_header(current, key);
+            pending += key.map ? 2 * static_cast<uint64_t>(key.nmb_elements) : key.nmb_elements;
+            current += key.header + key.payload;
+        }
+
+        return current - position;
+    }
+
+    const uint8_t *_data;
+    size_t _size;
+    size_t _position;
+    std::vector<level> _stack;
+    object_header _object;
+};
+}
+
+#endif //MSGPACKSEARCH_DECODE_H
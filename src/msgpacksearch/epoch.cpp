@@ -0,0 +1,90 @@
+#include "epoch.h"
+
+#include <atomic>
+
+namespace msgpacksearch
+{
+
+namespace
+{
+
+/**
+ * reader_slot - epoch announced by one thread, slots are reused by later threads and never freed
+ *
+ * epoch -> epoch the thread reads in, 0 while it reads nothing
+ * claimed -> whether a running thread owns the slot
+ * next -> next slot of the list
+ */
+struct alignas(64) reader_slot
+{
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> claimed{true};
+    reader_slot *next = nullptr;
+};
+
+std::atomic<uint64_t> current_epoch{1};
+std::atomic<reader_slot*> slots{nullptr};
+
+reader_slot* claim_slot()
+{
+    for (reader_slot *slot = slots.load(); slot; slot = slot->next)
+    {
+        if (!slot->claimed.load(std::memory_order_relaxed) && !slot->claimed.exchange(true))
+            return slot;
+    }
+
+    reader_slot *slot = new reader_slot;
+    slot->next = slots.load();
+
+    while (!slots.compare_exchange_weak(slot->next, slot))
+        ;
+
+    return slot;
+}
+
+/// Slot of the calling thread, given back when the thread exits
+struct thread_slot
+{
+    reader_slot *slot = claim_slot();
+    uint32_t depth = 0;
+
+    ~thread_slot() { slot->claimed.store(false); }
+};
+
+thread_local thread_slot reader;
+
+}
+
+EpochGuard::EpochGuard()
+{
+    // announced before the caller loads shared state: a writer that reads no announcement after
+    // replacing it knows the replaced state cannot be loaded any more
+    if (reader.depth++ == 0)
+        reader.slot->epoch.store(current_epoch.load());
+}
+
+EpochGuard::~EpochGuard()
+{
+    if (--reader.depth == 0)
+        reader.slot->epoch.store(0, std::memory_order_release);
+}
+
+uint64_t EpochGuard::advance()
+{
+    return current_epoch.fetch_add(1);
+}
+
+bool EpochGuard::quiescent(uint64_t epoch)
+{
+    for (reader_slot *slot = slots.load(); slot; slot = slot->next)
+    {
+        uint64_t announced = slot->epoch.load();
+
+        if (announced && announced <= epoch)
+            return false;
+    }
+
+    return true;
+}
+
+}
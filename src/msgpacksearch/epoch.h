@@ -0,0 +1,41 @@
+#ifndef MSGPACKSEARCH_EPOCH_H
+#define MSGPACKSEARCH_EPOCH_H
+
+#include <cstdint>
+
+namespace msgpacksearch {
+
+/**
+ * @brief Epoch based reclamation of state shared between threads.
+ *
+ * A reader announces the current epoch in a slot of its own thread while it reads, so readers never
+ * write to a shared cache line. A writer that replaces shared state ends the epoch and keeps what it
+ * replaced until every reader announced in that epoch or an earlier one is done. Guards nest, the
+ * outermost one announces.
+ */
+class EpochGuard {
+
+public:
+    EpochGuard();
+    ~EpochGuard();
+
+    EpochGuard(const EpochGuard &other) = delete;
+    EpochGuard& operator=(const EpochGuard &other) = delete;
+
+    /**
+    * Ends the current epoch, call it after the replaced state is unreachable for new readers
+    * @return The epoch that ended, what was replaced is retired with it
+    */
+    static uint64_t advance();
+
+    /**
+    * Whether what was retired with an epoch can be freed
+    * @param[in] epoch value returned by advance
+    * @return true if no reader announced in epoch or before is still running
+    */
+    static bool quiescent(uint64_t epoch);
+};
+
+}
+
+#endif //MSGPACKSEARCH_EPOCH_H
@@ -19,6 +19,25 @@ private:
     std::string message;
 };
 
+class parse_error : public std::exception {
+
+public:
+    parse_error(const std::string& message, size_t position) : message(message + " at offset " + std::to_string(position)), position(position) {};
+
+    virtual const char *what() const throw() {
+        return message.c_str();
+    }
+
+    /// byte offset into the input at which parsing failed
+    size_t offset() const {
+        return position;
+    }
+
+private:
+    std::string message;
+    size_t position;
+};
+
 }
 
 
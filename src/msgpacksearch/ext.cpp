@@ -0,0 +1,16 @@
+#include "ext.h"
+
+namespace msgpacksearch
+{
+
+ExtRegistry::ExtRegistry()
+{
+    register_decoder<msgpack_timestamp>(timestamp_ext_type, decode_timestamp);
+}
+
+void ExtRegistry::unregister(int8_t type)
+{
+    _slots[static_cast<uint8_t>(type)] = slot();
+}
+
+}
@@ -0,0 +1,123 @@
+#ifndef MSGPACKSEARCH_EXT_H
+#define MSGPACKSEARCH_EXT_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+
+#include "decode.h"
+#include "types.h"
+
+namespace msgpacksearch {
+
+/// Ext type of the standard timestamp extension
+constexpr int8_t timestamp_ext_type = -1;
+
+/**
+ * @brief Typed decoders of ext payloads, keyed on the ext type.
+ *
+ * Each ext type has at most one decoder, producing one C++ type; decoding looks the decoder up in a
+ * flat table and never copies the payload before handing it over. A new registry knows the timestamp
+ * extension (-1, as msgpack_timestamp), in its 32, 64 and 96 bit widths.
+ *
+ * Registering is not thread-safe, decoding from a registry that is no longer modified is.
+ */
+class ExtRegistry {
+
+public:
+
+    /// Decoder of the payload of an ext, returns false if the payload is invalid
+    template <typename T>
+    using decoder = std::function<bool(const msgpack_ext &ext, T &out)>;
+
+    /// A registry with the timestamp decoder
+    ExtRegistry();
+
+    /**
+    * Registers the decoder of an ext type, replacing the previous one
+    * @param[in] type the ext type
+    * @param[in] decode the decoder
+    */
+    template <typename T>
+    void register_decoder(int8_t type, decoder<T> decode)
+    {
+        slot &target = _slots[static_cast<uint8_t>(type)];
+        target.produces = std::type_index(typeid(T));
+        target.decode = [decode = std::move(decode)](const msgpack_ext &ext, void *out) {
+            return decode(ext, *static_cast<T *>(out));
+        };
+    }
+
+    /// Removes the decoder of an ext type, the timestamp one included
+    void unregister(int8_t type);
+
+    /// True if the ext type has a decoder
+    bool has_decoder(int8_t type) const { return static_cast<bool>(_slots[static_cast<uint8_t>(type)].decode); }
+
+    /**
+    * Decodes an ext
+    * @param[in] ext the ext object
+    * @return The decoded value, std::nullopt if its type has no decoder or the decoder rejected the payload
+    * @throws std::invalid_argument if the decoder of the type produces another type than T
+    */
+    template <typename T>
+    std::optional<T> decode(const msgpack_ext &ext) const
+    {
+        const slot &source = _slots[static_cast<uint8_t>(ext.type)];
+
+        if (!source.decode)
+            return std::nullopt;
+
+        if (source.produces != std::type_index(typeid(T)))
+            throw std::invalid_argument("the decoder of ext type " + std::to_string(ext.type) + " produces another type");
+
+        T out{};
+
+        if (!source.decode(ext, &out))
+            return std::nullopt;
+
+        return out;
+    }
+
+    /**
+    * Decodes the ext object at a location
+    * @param[in] value points at the object, NULL for a missing value
+    * @return The decoded value, std::nullopt if the value is missing, not an ext, or not decoded (see above)
+    * @throws std::invalid_argument if the decoder of the type produces another type than T
+    */
+    template <typename T>
+    std::optional<T> decode(const uint8_t *value) const
+    {
+        msgpack_ext ext;
+
+        if (!value || !read_ext(value, ext))
+            return std::nullopt;
+
+        return decode<T>(ext);
+    }
+
+private:
+    /**
+     * slot - decoder of one ext type
+     *
+     * produces -> type written to the output of decode
+     * decode -> the type erased decoder, empty without one
+     */
+    struct slot
+    {
+        std::type_index produces = std::type_index(typeid(void));
+        std::function<bool(const msgpack_ext &, void *)> decode;
+    };
+
+    std::array<slot, 256> _slots;
+};
+
+}
+
+#endif //MSGPACKSEARCH_EXT_H
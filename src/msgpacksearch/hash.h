@@ -0,0 +1,123 @@
+#ifndef MSGPACKSEARCH_HASH_H
+#define MSGPACKSEARCH_HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/// XXH64 (https://github.com/Cyan4973/xxHash), used for persisted key hashes and checksums. The output
+/// matches the reference implementation on little endian hosts, so files stay readable by other tools.
+
+namespace msgpacksearch {
+
+namespace xxhash_detail {
+
+constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t load64(const uint8_t *p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t load32(const uint8_t *p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input)
+{
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t value)
+{
+    acc ^= round(0, value);
+    return acc * prime1 + prime4;
+}
+
+}
+
+/**
+* Hashes a byte range with XXH64
+* @param[in] data first byte to hash
+* @param[in] length number of bytes
+* @param[in] seed hash seed
+* @return the 64 bit hash
+*/
+inline uint64_t xxhash64(const void *data, size_t length, uint64_t seed = 0)
+{
+    using namespace xxhash_detail;
+
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const uint8_t *const end = p + length;
+    uint64_t h;
+
+    if (length >= 32)
+    {
+        const uint8_t *const limit = end - 32;
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+
+        do
+        {
+            v1 = round(v1, load64(p));
+            v2 = round(v2, load64(p + 8));
+            v3 = round(v3, load64(p + 16));
+            v4 = round(v4, load64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    }
+    else
+    {
+        h = seed + prime5;
+    }
+
+    h += static_cast<uint64_t>(length);
+
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ round(0, load64(p)), 27) * prime1 + prime4;
+
+    if (p + 4 <= end)
+    {
+        h = rotl(h ^ (static_cast<uint64_t>(load32(p)) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for (; p < end; p++)
+        h = rotl(h ^ (*p * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+}
+
+#endif //MSGPACKSEARCH_HASH_H
@@ -0,0 +1,148 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace msgpacksearch
+{
+
+#ifdef MSGPACKSEARCH_INSTRUMENTATION
+
+namespace instrumentation {
+
+namespace {
+
+lookup_stats load(const thread_counters &c)
+{
+    lookup_stats stats;
+    stats.objects_decoded = c.objects_decoded.load(std::memory_order_relaxed);
+    stats.bytes_skipped = c.bytes_skipped.load(std::memory_order_relaxed);
+    stats.keys_compared = c.keys_compared.load(std::memory_order_relaxed);
+    stats.max_depth = c.max_depth.load(std::memory_order_relaxed);
+    stats.lookups = c.lookups.load(std::memory_order_relaxed);
+    stats.lookup_nanoseconds = c.lookup_nanoseconds.load(std::memory_order_relaxed);
+    stats.max_lookup_nanoseconds = c.max_lookup_nanoseconds.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void accumulate(lookup_stats &total, const lookup_stats &stats)
+{
+    total.objects_decoded += stats.objects_decoded;
+    total.bytes_skipped += stats.bytes_skipped;
+    total.keys_compared += stats.keys_compared;
+    total.max_depth = std::max(total.max_depth, stats.max_depth);
+    total.lookups += stats.lookups;
+    total.lookup_nanoseconds += stats.lookup_nanoseconds;
+    total.max_lookup_nanoseconds = std::max(total.max_lookup_nanoseconds, stats.max_lookup_nanoseconds);
+}
+
+/// Live thread counters plus the totals of threads that exited
+struct registry
+{
+    std::mutex mutex;
+    std::vector<const thread_counters *> threads;
+    lookup_stats retired;
+};
+
+registry& global_registry()
+{
+    static registry instance;
+    return instance;
+}
+
+}
+
+thread_counters::thread_counters()
+{
+    registry &r = global_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(this);
+}
+
+thread_counters::~thread_counters()
+{
+    registry &r = global_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    accumulate(r.retired, load(*this));
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+}
+
+}
+
+lookup_stats thread_lookup_stats()
+{
+    return instrumentation::load(instrumentation::counters());
+}
+
+lookup_stats global_lookup_stats()
+{
+    instrumentation::registry &r = instrumentation::global_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    lookup_stats total = r.retired;
+    for (const instrumentation::thread_counters *c : r.threads)
+        instrumentation::accumulate(total, instrumentation::load(*c));
+
+    return total;
+}
+
+void reset_thread_lookup_stats()
+{
+    instrumentation::thread_counters &c = instrumentation::counters();
+    c.objects_decoded.store(0, std::memory_order_relaxed);
+    c.bytes_skipped.store(0, std::memory_order_relaxed);
+    c.keys_compared.store(0, std::memory_order_relaxed);
+    c.max_depth.store(0, std::memory_order_relaxed);
+    c.lookups.store(0, std::memory_order_relaxed);
+    c.lookup_nanoseconds.store(0, std::memory_order_relaxed);
+    c.max_lookup_nanoseconds.store(0, std::memory_order_relaxed);
+}
+
+#else
+
+lookup_stats thread_lookup_stats()
+{
+    return lookup_stats();
+}
+
+lookup_stats global_lookup_stats()
+{
+    return lookup_stats();
+}
+
+void reset_thread_lookup_stats()
+{
+}
+
+#endif
+
+std::string to_prometheus(const lookup_stats &stats, const std::string &prefix)
+{
+    std::string out;
+
+    auto metric = [&](const char *name, const char *type, const char *help, const std::string &value) {
+        out += "# HELP " + prefix + "_" + name + " " + help + "\n";
+        out += "# TYPE " + prefix + "_" + name + " " + type + "\n";
+        out += prefix + "_" + name + " " + value + "\n";
+    };
+
+    auto seconds = [](uint64_t nanoseconds) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9f", nanoseconds / 1e9);
+        return std::string(buffer);
+    };
+
+    metric("objects_decoded_total", "counter", "Objects decoded by parse_data.", std::to_string(stats.objects_decoded));
+    metric("bytes_skipped_total", "counter", "Bytes skipped while searching for keys and indexes.", std::to_string(stats.bytes_skipped));
+    metric("keys_compared_total", "counter", "Map keys compared against searched keys.", std::to_string(stats.keys_compared));
+    metric("lookup_depth_max", "gauge", "Deepest path followed by a single lookup.", std::to_string(stats.max_depth));
+    metric("lookups_total", "counter", "Key, index and path lookups.", std::to_string(stats.lookups));
+    metric("lookup_seconds_total", "counter", "Time spent in lookups.", seconds(stats.lookup_nanoseconds));
+    metric("lookup_seconds_max", "gauge", "Slowest single lookup.", seconds(stats.max_lookup_nanoseconds));
+
+    return out;
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef MSGPACKSEARCH_INSTRUMENTATION_H
+#define MSGPACKSEARCH_INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Hot path counters, compiled in only when MSGPACKSEARCH_INSTRUMENTATION is defined
+ * (cmake -DENABLE_INSTRUMENTATION=ON). Without it the MSGPACKSEARCH_* macros expand to nothing and
+ * the snapshot functions report zeros.
+ *
+ * Every thread owns its counters, only the owning thread writes them so updates are plain relaxed
+ * stores, without read-modify-write instructions.
+ */
+
+namespace msgpacksearch {
+
+/**
+ * lookup_stats - snapshot of the instrumentation counters
+ *
+ * objects_decoded -> parse_data calls, nested containers included
+ * bytes_skipped -> bytes stepped over while searching for a key or an index
+ * keys_compared -> map keys compared against a searched key
+ * max_depth -> deepest path followed by a single lookup
+ * lookups -> number of key, index and path lookups
+ * lookup_nanoseconds -> total time spent in those lookups
+ * max_lookup_nanoseconds -> slowest single lookup
+ */
+struct lookup_stats
+{
+    uint64_t objects_decoded = 0;
+    uint64_t bytes_skipped = 0;
+    uint64_t keys_compared = 0;
+    uint64_t max_depth = 0;
+    uint64_t lookups = 0;
+    uint64_t lookup_nanoseconds = 0;
+    uint64_t max_lookup_nanoseconds = 0;
+};
+
+/// Counters of the calling thread
+lookup_stats thread_lookup_stats();
+
+/// Counters summed over every thread, including threads that already exited (max_* are maxima)
+lookup_stats global_lookup_stats();
+
+/// Zeroes the counters of the calling thread
+void reset_thread_lookup_stats();
+
+/**
+* Formats a snapshot in the Prometheus text exposition format
+* @param[in] stats the snapshot
+* @param[in] prefix metric name prefix
+* @return one HELP/TYPE/value block per counter
+*/
+std::string to_prometheus(const lookup_stats &stats, const std::string &prefix = "msgpacksearch");
+
+#ifdef MSGPACKSEARCH_INSTRUMENTATION
+
+namespace instrumentation {
+
+/// Per-thread counters, registered with a global registry for global_lookup_stats()
+struct thread_counters
+{
+    thread_counters();
+    ~thread_counters();
+
+    std::atomic<uint64_t> objects_decoded{0};
+    std::atomic<uint64_t> bytes_skipped{0};
+    std::atomic<uint64_t> keys_compared{0};
+    std::atomic<uint64_t> max_depth{0};
+    std::atomic<uint64_t> lookups{0};
+    std::atomic<uint64_t> lookup_nanoseconds{0};
+    std::atomic<uint64_t> max_lookup_nanoseconds{0};
+};
+
+inline thread_counters& counters()
+{
+    thread_local thread_counters instance;
+    return instance;
+}
+
+inline void add(std::atomic<uint64_t> &counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void max(std::atomic<uint64_t> &counter, uint64_t n)
+{
+    if (n > counter.load(std::memory_order_relaxed))
+        counter.store(n, std::memory_order_relaxed);
+}
+
+/// Times one lookup
+class lookup_timer {
+
+public:
+    lookup_timer() : _start(std::chrono::steady_clock::now()) {}
+
+    ~lookup_timer()
+    {
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+        thread_counters &c = counters();
+        add(c.lookups, 1);
+        add(c.lookup_nanoseconds, elapsed);
+        max(c.max_lookup_nanoseconds, elapsed);
+    }
+
+private:
+    std::chrono::steady_clock::time_point _start;
+};
+
+}
+
+#define MSGPACKSEARCH_COUNT(counter, n) ::msgpacksearch::instrumentation::add(::msgpacksearch::instrumentation::counters().counter, (n))
+#define MSGPACKSEARCH_MAX(counter, n) ::msgpacksearch::instrumentation::max(::msgpacksearch::instrumentation::counters().counter, (n))
+#define MSGPACKSEARCH_TIME_LOOKUP() ::msgpacksearch::instrumentation::lookup_timer _msgpacksearch_lookup_timer
+
+#else
+
+#define MSGPACKSEARCH_COUNT(counter, n) ((void)0)
+#define MSGPACKSEARCH_MAX(counter, n) ((void)0)
+#define MSGPACKSEARCH_TIME_LOOKUP() ((void)0)
+
+#endif
+
+}
+
+#endif //MSGPACKSEARCH_INSTRUMENTATION_H
@@ -0,0 +1,447 @@
+#include "json.h"
+#include "packer.h"
+#include "error.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <string>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+/// An open JSON object or array whose msgpack header still has to be back-patched
+struct json_frame
+{
+    size_t header;
+    uint32_t nmb_elements;
+    bool is_map;
+};
+
+class JsonTranscoder {
+
+public:
+    JsonTranscoder(std::string_view json, std::vector<uint8_t> &out) :
+        _begin(json.data()), _pos(json.data()), _end(json.data() + json.size()), _packer(out) {}
+
+    void run();
+
+private:
+    [[noreturn]] void fail(const char *message) const
+    {
+        throw parse_error(message, _pos - _begin);
+    }
+
+    void skip_whitespace()
+    {
+        while (_pos < _end && (*_pos == ' ' || *_pos == '\n' || *_pos == '\r' || *_pos == '\t'))
+            ++_pos;
+    }
+
+    void expect(char c)
+    {
+        if (_pos == _end || *_pos != c)
+            fail("unexpected character");
+        ++_pos;
+    }
+
+    void expect_literal(std::string_view literal)
+    {
+        if (static_cast<size_t>(_end - _pos) < literal.size() || std::string_view(_pos, literal.size()) != literal)
+            fail("invalid literal");
+        _pos += literal.size();
+    }
+
+    void parse_key();
+    void parse_string();
+    void parse_escaped_string(const char *start);
+    uint32_t parse_hex4();
+    void append_utf8(uint32_t code_point);
+    void parse_number();
+
+    const char *_begin;
+    const char *_pos;
+    const char *_end;
+    Packer _packer;
+    std::string _scratch; // decoded strings that contain escapes
+    std::vector<json_frame> _stack;
+};
+
+void JsonTranscoder::run()
+{
+    while (true)
+    {
+        skip_whitespace();
+
+        if (_pos == _end)
+            fail("unexpected end of input");
+
+        switch (*_pos)
+        {
+            case '{':
+            {
+                ++_pos;
+                _stack.push_back({_packer.begin_map(), 0, true});
+                skip_whitespace();
+
+                if (_pos < _end && *_pos == '}')
+                {
+                    ++_pos;
+                    _stack.pop_back(); // the reserved header already says 0 elements
+                    break;
+                }
+
+                parse_key();
+                continue;
+            }
+            case '[':
+            {
+                ++_pos;
+                _stack.push_back({_packer.begin_array(), 0, false});
+                skip_whitespace();
+
+                if (_pos < _end && *_pos == ']')
+                {
+                    ++_pos;
+                    _stack.pop_back();
+                    break;
+                }
+
+                continue;
+            }
+            case '"':
+            {
+                parse_string();
+                break;
+            }
+            case 't':
+            {
+                expect_literal("true");
+                _packer.pack_bool(true);
+                break;
+            }
+            case 'f':
+            {
+                expect_literal("false");
+                _packer.pack_bool(false);
+                break;
+            }
+            case 'n':
+            {
+                expect_literal("null");
+                _packer.pack_nil();
+                break;
+            }
+            case '-':
+            case '0' ... '9':
+            {
+                parse_number();
+                break;
+            }
+            default:
+            {
+                fail("unexpected character");
+            }
+        }
+
+        // a value has been completed, close every container it completes
+        bool more_values = false;
+
+        while (!_stack.empty())
+        {
+            json_frame &frame = _stack.back();
+            frame.nmb_elements++;
+            skip_whitespace();
+
+            if (_pos == _end)
+                fail("unexpected end of input");
+
+            if (*_pos == ',')
+            {
+                ++_pos;
+                if (frame.is_map)
+                    parse_key();
+                more_values = true;
+                break;
+            }
+
+            if (*_pos != (frame.is_map ? '}' : ']'))
+                fail("expected ',' or a closing bracket");
+
+            ++_pos;
+            if (frame.is_map)
+                _packer.end_map(frame.header, frame.nmb_elements);
+            else
+                _packer.end_array(frame.header, frame.nmb_elements);
+            _stack.pop_back();
+        }
+
+        if (!more_values)
+            break;
+    }
+
+    skip_whitespace();
+
+    if (_pos != _end)
+        fail("trailing characters after the JSON value");
+}
+
+void JsonTranscoder::parse_key()
+{
+    skip_whitespace();
+    if (_pos == _end || *_pos != '"')
+        fail("expected an object key");
+    parse_string();
+    skip_whitespace();
+    expect(':');
+}
+
+void JsonTranscoder::parse_string()
+{
+    ++_pos; // opening quote
+    const char *start = _pos;
+
+    // fast path, strings without escapes are copied straight from the input
+    while (_pos < _end)
+    {
+        const unsigned char c = *_pos;
+
+        if (c == '"')
+        {
+            _packer.pack_str(std::string_view(start, _pos - start));
+            ++_pos;
+            return;
+        }
+
+        if (c == '\\')
+        {
+            parse_escaped_string(start);
+            return;
+        }
+
+        if (c < 0x20)
+            fail("control character in string");
+
+        ++_pos;
+    }
+
+    fail("unterminated string");
+}
+
+void JsonTranscoder::parse_escaped_string(const char *start)
+{
+    _scratch.assign(start, _pos);
+
+    while (_pos < _end)
+    {
+        const unsigned char c = *_pos;
+
+        if (c == '"')
+        {
+            _packer.pack_str(_scratch);
+            ++_pos;
+            return;
+        }
+
+        if (c < 0x20)
+            fail("control character in string");
+
+        if (c != '\\')
+        {
+            _scratch.push_back(c);
+            ++_pos;
+            continue;
+        }
+
+        if (++_pos == _end)
+            break;
+
+        switch (*_pos++)
+        {
+            case '"': _scratch.push_back('"'); break;
+            case '\\': _scratch.push_back('\\'); break;
+            case '/': _scratch.push_back('/'); break;
+            case 'b': _scratch.push_back('\b'); break;
+            case 'f': _scratch.push_back('\f'); break;
+            case 'n': _scratch.push_back('\n'); break;
+            case 'r': _scratch.push_back('\r'); break;
+            case 't': _scratch.push_back('\t'); break;
+            case 'u':
+            {
+                uint32_t code_point = parse_hex4();
+
+                if (code_point >= 0xd800 && code_point <= 0xdbff) // high surrogate, a low one must follow
+                {
+                    if (_end - _pos < 2 || _pos[0] != '\\' || _pos[1] != 'u')
+                        fail("unpaired surrogate in unicode escape");
+                    _pos += 2;
+
+                    uint32_t low = parse_hex4();
+                    if (low < 0xdc00 || low > 0xdfff)
+                        fail("invalid low surrogate in unicode escape");
+
+                    code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                }
+                else if (code_point >= 0xdc00 && code_point <= 0xdfff)
+                {
+                    fail("unpaired surrogate in unicode escape");
+                }
+
+                append_utf8(code_point);
+                break;
+            }
+            default:
+            {
+                --_pos;
+                fail("invalid escape sequence");
+            }
+        }
+    }
+
+    fail("unterminated string");
+}
+
+uint32_t JsonTranscoder::parse_hex4()
+{
+    if (_end - _pos < 4)
+        fail("truncated unicode escape");
+
+    uint32_t value = 0;
+
+    for (int i = 0; i < 4; i++, _pos++)
+    {
+        const char c = *_pos;
+        value <<= 4;
+
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            fail("invalid hex digit in unicode escape");
+    }
+
+    return value;
+}
+
+void JsonTranscoder::append_utf8(uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        _scratch.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800)
+    {
+        _scratch.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+        _scratch.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+    else if (code_point < 0x10000)
+    {
+        _scratch.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+        _scratch.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        _scratch.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+    else
+    {
+        _scratch.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+        _scratch.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+        _scratch.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+        _scratch.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+}
+
+void JsonTranscoder::parse_number()
+{
+    const char *start = _pos;
+    bool is_integer = true;
+
+    if (*_pos == '-')
+        ++_pos;
+
+    // int part: a single 0, or a non-zero digit followed by digits
+    if (_pos == _end || *_pos < '0' || *_pos > '9')
+        fail("invalid number");
+
+    if (*_pos == '0')
+        ++_pos;
+    else
+        while (_pos < _end && *_pos >= '0' && *_pos <= '9')
+            ++_pos;
+
+    if (_pos < _end && *_pos == '.')
+    {
+        is_integer = false;
+        ++_pos;
+        if (_pos == _end || *_pos < '0' || *_pos > '9')
+            fail("invalid number");
+        while (_pos < _end && *_pos >= '0' && *_pos <= '9')
+            ++_pos;
+    }
+
+    if (_pos < _end && (*_pos == 'e' || *_pos == 'E'))
+    {
+        is_integer = false;
+        ++_pos;
+        if (_pos < _end && (*_pos == '+' || *_pos == '-'))
+            ++_pos;
+        if (_pos == _end || *_pos < '0' || *_pos > '9')
+            fail("invalid number");
+        while (_pos < _end && *_pos >= '0' && *_pos <= '9')
+            ++_pos;
+    }
+
+    if (is_integer)
+    {
+        if (*start == '-')
+        {
+            int64_t value;
+            auto [ptr, ec] = std::from_chars(start, _pos, value);
+            if (ec == std::errc())
+            {
+                _packer.pack_int(value);
+                return;
+            }
+        }
+        else
+        {
+            uint64_t value;
+            auto [ptr, ec] = std::from_chars(start, _pos, value);
+            if (ec == std::errc())
+            {
+                _packer.pack_uint(value);
+                return;
+            }
+        }
+        // out of the 64 bit range, fall back to a double
+    }
+
+    double value;
+    auto [ptr, ec] = std::from_chars(start, _pos, value);
+    if (ec == std::errc::result_out_of_range)
+        value = std::strtod(std::string(start, _pos).c_str(), nullptr); // saturates to +-inf / 0
+    else if (ec != std::errc())
+        fail("invalid number");
+
+    _packer.pack_double(value);
+}
+
+}
+
+void json_to_msgpack(std::string_view json, std::vector<uint8_t> &out)
+{
+    JsonTranscoder transcoder(json, out);
+    transcoder.run();
+}
+
+std::vector<uint8_t> json_to_msgpack(std::string_view json)
+{
+    std::vector<uint8_t> out;
+    out.reserve(json.size());
+    json_to_msgpack(json, out);
+    return out;
+}
+
+}
@@ -0,0 +1,28 @@
+#ifndef MSGPACKSEARCH_JSON_H
+#define MSGPACKSEARCH_JSON_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace msgpacksearch {
+
+/**
+* Transcodes a JSON text directly into msgpack, without building an intermediate DOM.
+*
+* Objects and arrays are emitted with map 32 / array 32 headers whose element counts are
+* back-patched once the closing bracket is reached, scalars use their smallest encoding.
+* Integers that fit into int64_t/uint64_t are packed as integers, every other number as a double.
+*
+* @param[in] json the JSON text, must hold exactly one value (surrounding whitespace allowed)
+* @param[out] out buffer the msgpack bytes are appended to
+* @throws parse_error if the input is not valid JSON
+*/
+void json_to_msgpack(std::string_view json, std::vector<uint8_t> &out);
+
+/// Convenience overload returning a freshly allocated buffer
+std::vector<uint8_t> json_to_msgpack(std::string_view json);
+
+}
+
+#endif //MSGPACKSEARCH_JSON_H
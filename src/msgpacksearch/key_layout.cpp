@@ -0,0 +1,270 @@
+#include "key_layout.h"
+#include "decode.h"
+#include "error.h"
+#include "msgpacksearch.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+/// True if the bits of data selected by mask are those of expected
+bool masked_equal(const uint8_t *data, const uint8_t *expected, const uint8_t *mask, size_t size)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t a, b, m;
+        std::memcpy(&a, data + i, 8);
+        std::memcpy(&b, expected + i, 8);
+        std::memcpy(&m, mask + i, 8);
+
+        if ((a ^ b) & m)
+            return false;
+    }
+
+    for (; i < size; i++)
+    {
+        if ((data[i] ^ expected[i]) & mask[i])
+            return false;
+    }
+
+    return true;
+}
+
+/// Bits of a value's type byte that determine its size, the others carry the value itself
+uint8_t type_mask(uint8_t type)
+{
+    if (type <= 0x7f) // positive fixint
+        return 0x80;
+    if (type >= 0xe0) // negative fixint
+        return 0xe0;
+    if (type == 0xc2 || type == 0xc3)
+        return 0xfe;
+    return 0xff;
+}
+
+/// Whether the payload size of a value is in its header: strings, binaries and ext values other than fixext
+bool variable_length(uint8_t type)
+{
+    return (type >= 0xa0 && type <= 0xbf) || (type >= 0xc4 && type <= 0xc9) || (type >= 0xd9 && type <= 0xdb);
+}
+
+}
+
+uint32_t KeyDictionary::intern(std::string_view key)
+{
+    auto it = _ids.find(key);
+
+    if (it != _ids.end())
+        return it->second;
+
+    uint32_t id = static_cast<uint32_t>(_keys.size());
+    _keys.emplace_back(key);
+    _ids.emplace(_keys.back(), id);
+    return id;
+}
+
+uint32_t KeyDictionary::find(std::string_view key) const
+{
+    auto it = _ids.find(key);
+    return it == _ids.end() ? npos : it->second;
+}
+
+std::string_view KeyDictionary::key(uint32_t id) const
+{
+    if (id >= _keys.size())
+        throw std::out_of_range("unknown key id " + std::to_string(id));
+
+    return _keys[id];
+}
+
+LayoutPredictor::LayoutPredictor(std::shared_ptr<KeyDictionary> dictionary) : _dictionary(std::move(dictionary))
+{
+    if (!_dictionary)
+        throw std::invalid_argument("LayoutPredictor needs a dictionary");
+}
+
+bool LayoutPredictor::bind(const uint8_t *map, size_t size)
+{
+    try
+    {
+        if (!_segments.empty() && verify(map, size))
+        {
+            _map = map;
+            _counters.hits++;
+            return true;
+        }
+
+        _counters.misses++;
+        learn(map, size);
+    }
+    catch (...)
+    {
+        // nothing is bound, verify may have shifted the previous record's members and a partial layout
+        // must not be verified against the next record
+        _segments.clear();
+        _members.clear();
+        _map = nullptr;
+        throw;
+    }
+
+    return false;
+}
+
+bool LayoutPredictor::verify(const uint8_t *map, size_t size)
+{
+    int64_t shift = 0;
+
+    for (size_t i = 0; i < _segments.size(); i++)
+    {
+        const segment &run = _segments[i];
+        size_t start = run.start + shift;
+
+        if (start + (run.end - run.start) > size ||
+            !masked_equal(map + start, _template.data() + run.start, _mask.data() + run.start, run.end - run.start))
+            return false;
+
+        _shifts[i] = shift;
+
+        if (i + 1 == _segments.size())
+            break;
+
+        // the headers before the skipped value matched, so it starts where predicted; only its size may differ
+        size_t skipped = run.end + shift;
+
+        if (skipped >= size)
+            return false;
+
+        size_t skipped_size = Msgpack::skip_object_bounded(map + skipped, map + size);
+
+        if (!skipped_size)
+            return false;
+
+        shift += static_cast<int64_t>(skipped_size) - static_cast<int64_t>(_segments[i + 1].start - run.end);
+    }
+
+    return true;
+}
+
+void LayoutPredictor::learn(const uint8_t *map, size_t size)
+{
+    _map = map;
+    _template.clear();
+    _mask.clear();
+    _segments.clear();
+    _members.assign(_dictionary->size(), member{npos, 0});
+
+    uint32_t nmb_elements = 0;
+    size_t position = 0;
+
+    if (!size || !read_map_header(map, nmb_elements, position))
+        return;
+
+    if (position > size)
+        throw parse_error("map runs past the end of the buffer", size);
+
+    _template.assign(map, map + position);
+    _mask.assign(position, 0xff);
+
+    size_t run_start = 0;
+
+    for (uint32_t i = 0; i < nmb_elements; i++)
+    {
+        size_t key = position;
+        position = learn_item(map, size, position, true, run_start);
+
+        std::string_view key_bytes;
+        if (read_str(map + key, key_bytes))
+        {
+            uint32_t id = _dictionary->intern(key_bytes);
+
+            if (id >= _members.size())
+                _members.resize(id + 1, member{npos, 0});
+
+            // the first of duplicate keys wins
+            if (_members[id].offset == npos)
+                _members[id] = member{position, _segments.size()};
+        }
+
+        position = learn_item(map, size, position, false, run_start);
+    }
+
+    _segments.push_back(segment{run_start, position});
+    _shifts.assign(_segments.size(), 0);
+}
+
+size_t LayoutPredictor::learn_item(const uint8_t *map, size_t size, size_t position, bool is_key, size_t &run_start)
+{
+    if (position >= size)
+        throw parse_error("map runs past the end of the buffer", size);
+
+    uint8_t type = map[position];
+    uint32_t nmb_elements = 0;
+    size_t header = 0;
+
+    bool container = read_map_header(map + position, nmb_elements, header) || read_array_header(map + position, nmb_elements, header);
+
+    if (container || (!is_key && variable_length(type)))
+    {
+        size_t skipped_size = Msgpack::skip_object_bounded(map + position, map + size);
+
+        if (!skipped_size)
+            throw parse_error("map runs past the end of the buffer", size);
+
+        // containers and variable length values are skipped rather than compared, they end the run; the
+        // template keeps map offsets
+        _segments.push_back(segment{run_start, position});
+        run_start = position + skipped_size;
+        _template.resize(run_start, 0);
+        _mask.resize(run_start, 0);
+        return run_start;
+    }
+
+    header = header_size(type);
+
+    if (!header)
+        throw parse_error("invalid type byte", position);
+    if (position + header > size)
+        throw parse_error("map runs past the end of the buffer", size);
+
+    uint64_t payload = payload_size(map + position);
+
+    if (position + header + payload > size)
+        throw parse_error("map runs past the end of the buffer", size);
+
+    _template.insert(_template.end(), map + position, map + position + header + payload);
+    _mask.push_back(is_key ? 0xff : type_mask(type));
+    _mask.insert(_mask.end(), header - 1, 0xff);
+    _mask.insert(_mask.end(), payload, is_key ? 0xff : 0x00);
+    return position + header + payload;
+}
+
+const uint8_t* LayoutPredictor::find(uint32_t key_id) const
+{
+    if (!_map || key_id >= _members.size() || _members[key_id].offset == npos)
+        return nullptr;
+
+    const member &value = _members[key_id];
+    return _map + value.offset + _shifts[value.segment];
+}
+
+const uint8_t* LayoutPredictor::find(std::string_view key) const
+{
+    uint32_t id = _dictionary->find(key);
+    return id == KeyDictionary::npos ? nullptr : find(id);
+}
+
+size_t LayoutPredictor::size() const
+{
+    if (!_map || _segments.empty())
+        return 0;
+
+    return _segments.back().end + _shifts.back();
+}
+
+}
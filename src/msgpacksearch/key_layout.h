@@ -0,0 +1,164 @@
+#ifndef MSGPACKSEARCH_KEY_LAYOUT_H
+#define MSGPACKSEARCH_KEY_LAYOUT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace msgpacksearch {
+
+/**
+ * @brief Interns map keys into small integer ids.
+ *
+ * Streams of records repeat the same keys in every record; resolving a key to its id once lets the
+ * lookups of every record compare integers instead of key bytes. Ids are dense, in order of first
+ * appearance, and never change. One dictionary can be shared by the LayoutPredictors of several paths.
+ */
+class KeyDictionary {
+
+public:
+
+    /// Id of a key that was never interned
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    /**
+    * Returns the id of a key, assigning the next one if the key is new
+    * @param[in] key the key bytes
+    * @return The id of the key
+    */
+    uint32_t intern(std::string_view key);
+
+    /**
+    * @param[in] key the key bytes
+    * @return The id of the key, npos if it was never interned
+    */
+    uint32_t find(std::string_view key) const;
+
+    /**
+    * @param[in] id id returned by intern()
+    * @return The key bytes, valid as long as the dictionary
+    * @throws std::out_of_range if the id was never assigned
+    */
+    std::string_view key(uint32_t id) const;
+
+    /// Number of interned keys, the next id
+    size_t size() const { return _keys.size(); }
+
+private:
+    std::deque<std::string> _keys; // stable addresses, viewed by _ids
+    std::unordered_map<std::string_view, uint32_t> _ids;
+};
+
+/**
+ * @brief Predicts the layout of a map from the previous map at the same path.
+ *
+ * Records of a homogeneous stream encode the same keys in the same order, with values of the same
+ * types: the offset of every member is the same as in the previous record, up to the size of the
+ * containers, strings, binaries and ext values before it. bind() remembers the bytes of a record's
+ * headers and keys; the next record is verified against them with one masked compare per run of
+ * members between such values, which are skipped by their headers, so a message or host name of
+ * another length still matches. Once a record is bound, looking up a key id is a table lookup,
+ * present or missing.
+ *
+ * The prediction is verified, never trusted: the key bytes alone at a predicted offset could be the
+ * content of a preceding value, so every header before it is compared too. A record whose layout differs
+ * is walked once, which becomes the layout predicted for the next one. As in find_map_key, the first
+ * of duplicate keys wins. One predictor follows the maps at one path; use one per nested map.
+ */
+class LayoutPredictor {
+
+public:
+
+    /**
+    * counters - predictions made by a LayoutPredictor
+    *
+    * hits -> records whose layout was predicted
+    * misses -> records walked to learn their layout
+    */
+    struct counters
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    /**
+    * @param[in] dictionary dictionary the keys are interned into, shared with other predictors or a new one
+    */
+    explicit LayoutPredictor(std::shared_ptr<KeyDictionary> dictionary = std::make_shared<KeyDictionary>());
+
+    /**
+    * Binds a record to the following lookups
+    * @param[in] map points at the map object, must stay valid while it is bound
+    * @param[in] size bytes available from map, at least the size of the map
+    * @return true if the layout of the previous record was verified to match, false if the record was
+    *         walked to learn its layout, or is not a map (no key is found then)
+    * @throws parse_error on an invalid type byte or a map running past size, nothing is bound then
+    */
+    bool bind(const uint8_t *map, size_t size);
+
+    /**
+    * Finds the value of a key in the bound record
+    * @param[in] key_id id of the key in the dictionary
+    * @return Pointer to the value, NULL if the record has no such key
+    */
+    const uint8_t* find(uint32_t key_id) const;
+
+    /// Same, resolving the key through the dictionary first; prefer ids on hot paths
+    const uint8_t* find(std::string_view key) const;
+
+    /// Size of the bound map, 0 if the bound record is not a map
+    size_t size() const;
+
+    KeyDictionary& dictionary() const { return *_dictionary; }
+
+    const counters& statistics() const { return _counters; }
+
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    /**
+     * segment - run of members of the layout compared at once
+     *
+     * start -> offset of the run in the template
+     * end -> offset of the skipped value that follows, or of the end of the map for the last run
+     */
+    struct segment
+    {
+        size_t start;
+        size_t end;
+    };
+
+    /**
+     * member - where a key's value is in the layout
+     *
+     * offset -> offset of the value in the template, npos if the layout has no such key
+     * segment -> run whose shift applies to the offset
+     */
+    struct member
+    {
+        size_t offset;
+        size_t segment;
+    };
+
+    bool verify(const uint8_t *map, size_t size);
+    void learn(const uint8_t *map, size_t size);
+    size_t learn_item(const uint8_t *map, size_t size, size_t position, bool is_key, size_t &run_start);
+
+    std::shared_ptr<KeyDictionary> _dictionary;
+    std::vector<uint8_t> _template; // headers and keys of the last learned map
+    std::vector<uint8_t> _mask; // bits of _template that must match, payloads of values are free
+    std::vector<segment> _segments;
+    std::vector<member> _members; // by key id
+    std::vector<int64_t> _shifts; // by segment, offset in the bound map minus offset in the template
+    const uint8_t *_map = nullptr;
+    counters _counters;
+};
+
+}
+
+#endif //MSGPACKSEARCH_KEY_LAYOUT_H
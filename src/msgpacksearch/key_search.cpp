@@ -0,0 +1,106 @@
+#include "key_search.h"
+#include "decode.h"
+#include "error.h"
+#include "instrumentation.h"
+#include "msgpacksearch.h"
+
+#include <cstring>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+constexpr uint32_t no_match = UINT32_MAX;
+
+/// KeySearch keeps nothing per open container
+struct no_frame {};
+
+}
+
+KeySearch::KeySearch(std::string_view key) : KeySearch(std::vector<std::string>{std::string(key)}) {}
+
+KeySearch::KeySearch(std::vector<std::string> keys) : _keys(std::move(keys))
+{
+    for (uint32_t index = 0; index < _keys.size(); index++)
+    {
+        const std::string &key = _keys[index];
+
+        if (match(key) != no_match)
+            continue;
+
+        if (key.size() >= _by_length.size())
+            _by_length.resize(key.size() + 1);
+
+        _by_length[key.size()].push_back(index);
+
+        if (!key.empty())
+            _first_bytes.set(static_cast<uint8_t>(key[0]));
+    }
+}
+
+uint32_t KeySearch::match(std::string_view key) const
+{
+    if (key.size() >= _by_length.size() || (!key.empty() && !_first_bytes.test(static_cast<uint8_t>(key[0]))))
+        return no_match;
+
+    for (uint32_t index : _by_length[key.size()])
+    {
+        MSGPACKSEARCH_COUNT(keys_compared, 1);
+
+        if (std::memcmp(_keys[index].data(), key.data(), key.size()) == 0)
+            return index;
+    }
+
+    return no_match;
+}
+
+size_t KeySearch::find_all(const uint8_t *data, size_t size, const visitor &visit) const
+{
+    DocumentWalker<no_frame> walker(data, size, 0, 1, false, no_frame{});
+    const uint8_t *end = data + size;
+    size_t matches = 0;
+
+    do
+    {
+        const object_header &object = walker.next();
+        const uint8_t *start = data + object.position;
+        const uint8_t *key = object.key_size ? start - object.key_size : nullptr;
+        std::string_view current_key;
+
+        if (key && read_str(key, current_key))
+        {
+            uint32_t matched = match(current_key);
+
+            if (matched != no_match)
+            {
+                matches++;
+
+                if (!visit(matched, Cursor(start, end, key, walker.parent().remaining - 1)))
+                    return matches;
+            }
+        }
+
+        if (object.container && object.nmb_elements)
+            walker.enter(no_frame{});
+        else
+            walker.skip();
+    }
+    while (!walker.done());
+
+    return matches;
+}
+
+std::vector<key_match> KeySearch::find_all(const uint8_t *data, size_t size) const
+{
+    std::vector<key_match> out;
+
+    find_all(data, size, [&out](uint32_t key, const Cursor &value) {
+        out.push_back(key_match{key, value});
+        return true;
+    });
+
+    return out;
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef MSGPACKSEARCH_KEY_SEARCH_H
+#define MSGPACKSEARCH_KEY_SEARCH_H
+
+#include <bitset>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cursor.h"
+
+namespace msgpacksearch {
+
+/**
+ * key_match - one occurrence of a searched key
+ *
+ * key -> index of the key in KeySearch::keys()
+ * value -> cursor on the value of the key, its key() and next_sibling() work as for Cursor::child
+ */
+struct key_match
+{
+    uint32_t key;
+    Cursor value;
+};
+
+/**
+ * @brief Finds every occurrence of a set of keys at any depth of a document, like jq's ..|.key?
+ *
+ * The document is walked once, in document order, with an explicit stack of the open containers: no
+ * recursion and no msgpack_object is built. Each string key of each map is matched against the set by
+ * its length and first byte before any comparison, scalars are skipped through their header. Values of
+ * matching keys are searched too, so nested occurrences are found after the enclosing one.
+ */
+class KeySearch {
+
+public:
+
+    /// Receives a match, returns false to stop the search
+    using visitor = std::function<bool(uint32_t key, const Cursor &value)>;
+
+    /// Search for one key
+    explicit KeySearch(std::string_view key);
+
+    /**
+    * Search for a set of keys
+    * @param[in] keys the keys, the first of duplicate keys wins
+    */
+    explicit KeySearch(std::vector<std::string> keys);
+
+    /**
+    * Visits the occurrences of the keys in a document
+    * @param[in] data points at the root object
+    * @param[in] size bytes available from data
+    * @param[in] visit called for every match, in document order
+    * @return Number of matches visited
+    * @throws parse_error on an invalid type byte or an object running past size, after the matches before it
+    */
+    size_t find_all(const uint8_t *data, size_t size, const visitor &visit) const;
+
+    /**
+    * Occurrences of the keys in a document
+    * @param[in] data points at the root object
+    * @param[in] size bytes available from data
+    * @return The matches, in document order
+    * @throws parse_error on an invalid type byte or an object running past size
+    */
+    std::vector<key_match> find_all(const uint8_t *data, size_t size) const;
+
+    /// The searched keys
+    const std::vector<std::string>& keys() const { return _keys; }
+
+    /// Index in keys() of a key, UINT32_MAX if it is not searched
+    uint32_t match(std::string_view key) const;
+
+private:
+    std::vector<std::string> _keys;
+    std::vector<std::vector<uint32_t>> _by_length; // key indexes, by key length
+    std::bitset<256> _first_bytes; // first bytes of the non-empty keys
+};
+
+}
+
+#endif //MSGPACKSEARCH_KEY_SEARCH_H
@@ -0,0 +1,99 @@
+#include "lookup_cache.h"
+
+#include <cstring>
+
+namespace msgpacksearch
+{
+
+LookupCache::LookupCache(size_t memory_cap) : _memory_cap(memory_cap) {}
+
+std::string LookupCache::make_key(uint64_t buffer_id, std::string_view path)
+{
+    std::string key(sizeof(buffer_id) + path.size(), '\0');
+    std::memcpy(&key[0], &buffer_id, sizeof(buffer_id));
+    std::memcpy(&key[sizeof(buffer_id)], path.data(), path.size());
+    return key;
+}
+
+size_t LookupCache::entry_memory(const std::string &key)
+{
+    // list node + hash node + the key itself, when it does not fit the small string buffer
+    return sizeof(entry) + 4 * sizeof(void *) + 2 * sizeof(void *) + sizeof(std::string_view) +
+           (key.size() > 15 ? key.size() : 0);
+}
+
+std::optional<size_t> LookupCache::find(uint64_t buffer_id, std::string_view path)
+{
+    std::string key = make_key(buffer_id, path);
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _entries.find(key);
+
+    if (it == _entries.end())
+    {
+        _stats.misses++;
+        return std::nullopt;
+    }
+
+    _stats.hits++;
+    _lru.splice(_lru.begin(), _lru, it->second);
+    return it->second->offset;
+}
+
+void LookupCache::insert(uint64_t buffer_id, std::string_view path, size_t offset)
+{
+    std::string key = make_key(buffer_id, path);
+    const size_t memory = entry_memory(key);
+
+    if (memory > _memory_cap)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _entries.find(key);
+
+    if (it != _entries.end())
+    {
+        it->second->offset = offset;
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return;
+    }
+
+    _lru.push_front(entry{std::move(key), offset});
+    _entries.emplace(_lru.front().key, _lru.begin());
+    _stats.entries++;
+    _stats.memory += memory;
+
+    evict();
+}
+
+void LookupCache::evict()
+{
+    while (_stats.memory > _memory_cap && !_lru.empty())
+    {
+        entry &last = _lru.back();
+        _stats.memory -= entry_memory(last.key);
+        _stats.entries--;
+        _stats.evictions++;
+        _entries.erase(last.key);
+        _lru.pop_back();
+    }
+}
+
+void LookupCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _entries.clear();
+    _lru.clear();
+    _stats.entries = 0;
+    _stats.memory = 0;
+}
+
+LookupCache::stats LookupCache::statistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+}
@@ -0,0 +1,95 @@
+#ifndef MSGPACKSEARCH_LOOKUP_CACHE_H
+#define MSGPACKSEARCH_LOOKUP_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace msgpacksearch {
+
+/**
+ * @brief Bounded, thread-safe LRU memo of path -> byte offset lookups.
+ *
+ * Entries are keyed by (buffer id, path expression), so one cache can be shared by every view of the same
+ * immutable buffer. Paths that do not resolve are cached too, as LookupCache::npos. Once the estimated
+ * memory of the entries exceeds the cap, the least recently used entries are evicted.
+ */
+class LookupCache {
+
+public:
+
+    /// Cached offset of a path that does not resolve
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    /**
+    * stats - counters of a LookupCache
+    */
+    struct stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t memory = 0; // estimated bytes held by the entries
+    };
+
+    /**
+    * @param[in] memory_cap upper bound of the estimated memory used by the entries, in bytes
+    */
+    explicit LookupCache(size_t memory_cap = 1 << 20);
+
+    LookupCache(const LookupCache &other) = delete;
+    LookupCache& operator=(const LookupCache &other) = delete;
+
+    /**
+    * Looks up a memoized path, counts a hit or a miss
+    * @param[in] buffer_id identity of the buffer the path was evaluated on
+    * @param[in] path the path expression
+    * @return The offset of the value from the start of the buffer, npos for a known missing path,
+    *         or std::nullopt if the path is not cached
+    */
+    std::optional<size_t> find(uint64_t buffer_id, std::string_view path);
+
+    /**
+    * Memoizes a path, evicting least recently used entries to stay under the memory cap
+    * @param[in] buffer_id identity of the buffer the path was evaluated on
+    * @param[in] path the path expression
+    * @param[in] offset offset of the value from the start of the buffer, or npos
+    */
+    void insert(uint64_t buffer_id, std::string_view path, size_t offset);
+
+    /// Drops every entry, counters are kept
+    void clear();
+
+    /// Snapshot of the counters
+    stats statistics() const;
+
+    size_t memory_cap() const { return _memory_cap; }
+
+private:
+    struct entry
+    {
+        std::string key;
+        size_t offset;
+    };
+
+    static std::string make_key(uint64_t buffer_id, std::string_view path);
+    static size_t entry_memory(const std::string &key);
+
+    void evict();
+
+    const size_t _memory_cap;
+    mutable std::mutex _mutex;
+    std::list<entry> _lru; // most recently used first
+    std::unordered_map<std::string_view, std::list<entry>::iterator> _entries; // views into _lru keys
+    stats _stats;
+};
+
+}
+
+#endif //MSGPACKSEARCH_LOOKUP_CACHE_H
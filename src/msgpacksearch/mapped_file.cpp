@@ -0,0 +1,205 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace msgpacksearch
+{
+
+MappedFile::MappedFile(const std::string &path) : _path(path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+
+    struct stat info;
+
+    if (::fstat(fd, &info) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "stat " + path);
+    }
+
+    _size = static_cast<size_t>(info.st_size);
+    _mtime_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+
+    if (_size)
+    {
+        void *mapping = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (mapping == MAP_FAILED)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "mmap " + path);
+        }
+
+        _data = static_cast<const uint8_t *>(mapping);
+    }
+
+    _fd = fd;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept :
+    _fd(std::exchange(other._fd, -1)),
+    _data(std::exchange(other._data, nullptr)),
+    _size(std::exchange(other._size, 0)),
+    _mtime_ns(other._mtime_ns),
+    _path(std::move(other._path))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        _fd = std::exchange(other._fd, -1);
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _mtime_ns = other._mtime_ns;
+        _path = std::move(other._path);
+    }
+
+    return *this;
+}
+
+void MappedFile::unmap()
+{
+    if (_data)
+        ::munmap(const_cast<uint8_t *>(_data), _size);
+    if (_fd >= 0)
+        ::close(_fd);
+
+    _fd = -1;
+    _data = nullptr;
+    _size = 0;
+}
+
+size_t MappedFile::page_size()
+{
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+std::pair<size_t, size_t> MappedFile::page_range(size_t offset, size_t length) const
+{
+    if (offset >= _size || !length)
+        return {0, 0};
+
+    size_t start = offset - offset % page_size();
+    size_t end = offset + std::min(length, _size - offset);
+
+    return {start, end - start};
+}
+
+void MappedFile::advise(access_advice advice) const
+{
+    if (!_data)
+        return;
+
+    int flag = advice == access_advice::random ? MADV_RANDOM : advice == access_advice::sequential ? MADV_SEQUENTIAL : MADV_NORMAL;
+    ::madvise(const_cast<uint8_t *>(_data), _size, flag);
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    auto [start, range] = page_range(offset, length);
+
+    if (!range)
+        return;
+
+    ::posix_fadvise(_fd, static_cast<off_t>(start), static_cast<off_t>(range), POSIX_FADV_WILLNEED);
+    ::madvise(const_cast<uint8_t *>(_data) + start, range, MADV_WILLNEED);
+}
+
+void MappedFile::release(size_t offset, size_t length) const
+{
+    auto [start, range] = page_range(offset, length);
+
+    if (!range)
+        return;
+
+    // unmap the pages first, the page cache only drops pages that no process maps
+    ::madvise(const_cast<uint8_t *>(_data) + start, range, MADV_DONTNEED);
+    ::posix_fadvise(_fd, static_cast<off_t>(start), static_cast<off_t>(range), POSIX_FADV_DONTNEED);
+}
+
+size_t MappedFile::resident_bytes(size_t offset, size_t length) const
+{
+    auto [start, range] = page_range(offset, length);
+
+    if (!range)
+        return 0;
+
+    std::vector<unsigned char> pages((range + page_size() - 1) / page_size());
+
+    if (::mincore(const_cast<uint8_t *>(_data) + start, range, pages.data()) != 0)
+        throw std::system_error(errno, std::generic_category(), "mincore " + _path);
+
+    return std::count_if(pages.begin(), pages.end(), [](unsigned char page) { return page & 1; }) * page_size();
+}
+
+PageTracker::PageTracker(const MappedFile &file, size_t max_resident_bytes) :
+    _file(file), _max_resident_bytes(max_resident_bytes), _page_size(MappedFile::page_size())
+{
+    _file.advise(MappedFile::access_advice::random);
+}
+
+void PageTracker::begin_query()
+{
+    if (tracked_bytes() > _max_resident_bytes)
+    {
+        _file.release(0, _file.size());
+        _resident_pages.clear();
+        _releases++;
+    }
+
+    _query_pages.clear();
+    _queries++;
+}
+
+void PageTracker::touch(size_t offset, size_t length)
+{
+    if (!length)
+        return;
+
+    for (size_t page = offset / _page_size; page <= (offset + length - 1) / _page_size; page++)
+    {
+        _query_pages.insert(page);
+        _resident_pages.insert(page);
+    }
+}
+
+void PageTracker::prefetch(size_t offset, size_t length)
+{
+    // a single page comes in with its fault just as fast
+    if (length <= 1 || offset / _page_size == (offset + length - 1) / _page_size)
+        return;
+
+    for (size_t page = offset / _page_size; page <= (offset + length - 1) / _page_size; page++)
+    {
+        if (!_resident_pages.count(page))
+        {
+            _file.prefetch(offset, length);
+            return;
+        }
+    }
+}
+
+}
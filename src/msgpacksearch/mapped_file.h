@@ -0,0 +1,159 @@
+#ifndef MSGPACKSEARCH_MAPPED_FILE_H
+#define MSGPACKSEARCH_MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+namespace msgpacksearch {
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * Owns the mapping, movable but not copyable. The size and modification time are captured when the file
+ * is opened, so they describe exactly the bytes that were mapped. The descriptor stays open with the
+ * mapping, for the page cache hints of prefetch() and release().
+ */
+class MappedFile {
+
+public:
+
+    /// Expected access pattern of the mapping, see advise()
+    enum class access_advice : uint8_t { normal, random, sequential };
+
+    /// An empty mapping
+    MappedFile() = default;
+
+    /**
+    * Maps a file
+    * @param[in] path path of the file
+    * @throws std::system_error if the file cannot be opened, stat'ed or mapped
+    */
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile& operator=(const MappedFile &other) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile& operator=(MappedFile &&other) noexcept;
+
+    /// First byte of the file, NULL for an empty file
+    const uint8_t* data() const { return _data; }
+
+    size_t size() const { return _size; }
+
+    /// Modification time of the file when it was opened, in nanoseconds since the epoch
+    int64_t mtime_ns() const { return _mtime_ns; }
+
+    const std::string& path() const { return _path; }
+
+    /**
+    * Tells the kernel how the mapping will be read. random stops the read-ahead around every page fault,
+    * which otherwise fills memory with the neighbours of sparse lookups. A hint, errors are ignored.
+    */
+    void advise(access_advice advice) const;
+
+    /**
+    * Starts reading a range into the page cache ahead of its use (madvise and posix_fadvise WILLNEED),
+    * as one request instead of one fault per page. A hint, errors are ignored.
+    * @param[in] offset start of the range, rounded down to a page
+    * @param[in] length bytes of the range, clipped to the file
+    */
+    void prefetch(size_t offset, size_t length) const;
+
+    /**
+    * Drops a range from the resident set of the process (madvise DONTNEED) and its clean pages from
+    * the page cache (posix_fadvise DONTNEED). The mapping stays valid, pages are read again on access.
+    * A hint, errors are ignored.
+    * @param[in] offset start of the range, rounded down to a page
+    * @param[in] length bytes of the range, clipped to the file
+    */
+    void release(size_t offset, size_t length) const;
+
+    /**
+    * Bytes of a range that are in memory, from mincore
+    * @param[in] offset start of the range, rounded down to a page
+    * @param[in] length bytes of the range, clipped to the file
+    * @return Resident bytes, counted in whole pages
+    * @throws std::system_error if mincore fails
+    */
+    size_t resident_bytes(size_t offset = 0, size_t length = SIZE_MAX) const;
+
+    /// Size of a memory page
+    static size_t page_size();
+
+private:
+    void unmap();
+
+    /// Page aligned start and length of a range clipped to the file, length 0 if it is empty
+    std::pair<size_t, size_t> page_range(size_t offset, size_t length) const;
+
+    int _fd = -1;
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+    int64_t _mtime_ns = 0;
+    std::string _path;
+};
+
+/**
+ * @brief Keeps the pages of a mapped file read by lookups within a memory budget.
+ *
+ * Lookups report the byte ranges they read with touch(), and the ranges they are about to read with
+ * prefetch() so that several pages come in with one request. The tracker counts the distinct pages of
+ * every query and the pages read since the last release; when those exceed the budget at the start of
+ * a query, the whole mapping is released. A query larger than the budget completes over it.
+ *
+ * The tracker advises random access on the file, so page faults do not pull in read-ahead that the
+ * budget does not see. Not thread-safe: use one tracker per reader thread. Trackers of the same file
+ * release each other's pages, which costs re-reads but not correctness.
+ */
+class PageTracker {
+
+public:
+
+    /**
+    * @param[in] file the mapping to track, must outlive the tracker
+    * @param[in] max_resident_bytes budget of the pages read between two releases
+    */
+    PageTracker(const MappedFile &file, size_t max_resident_bytes);
+
+    /// Starts a query, releasing the mapping first if the pages read since the last release exceed the budget
+    void begin_query();
+
+    /// Records that the current query read a range
+    void touch(size_t offset, size_t length);
+
+    /// Prefetches a range the current query is about to read, if it spans pages not read since the last release
+    void prefetch(size_t offset, size_t length);
+
+    /// Distinct pages read by the current (or last) query
+    size_t pages_touched() const { return _query_pages.size(); }
+
+    /// Bytes of the pages read since the last release, the tracked resident set
+    size_t tracked_bytes() const { return _resident_pages.size() * _page_size; }
+
+    size_t max_resident_bytes() const { return _max_resident_bytes; }
+
+    /// Number of queries started
+    uint64_t queries() const { return _queries; }
+
+    /// Number of times the mapping was released to stay within the budget
+    uint64_t releases() const { return _releases; }
+
+private:
+    const MappedFile &_file;
+    size_t _max_resident_bytes;
+    size_t _page_size;
+    std::unordered_set<size_t> _resident_pages; // page numbers read since the last release
+    std::unordered_set<size_t> _query_pages;
+    uint64_t _queries = 0;
+    uint64_t _releases = 0;
+};
+
+}
+
+#endif //MSGPACKSEARCH_MAPPED_FILE_H
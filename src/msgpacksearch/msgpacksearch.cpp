@@ -1,6 +1,10 @@
 #include "msgpacksearch.h"
 #include "error.h"
+#include "decode.h"
+#include "path.h"
+#include "instrumentation.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <bits/byteswap.h>
@@ -10,8 +14,115 @@
 namespace msgpacksearch
 {
 
+namespace {
+
+/**
+* Orders a map key against a string key, the canonical order puts all string keys
+* (sorted bytewise by content) before keys of any other type
+* @return <0, 0 or >0 if the key at start sorts before, equal to or after key
+*/
+int compare_key(const uint8_t *start, std::string_view key)
+{
+    std::string_view current;
+
+    if (!read_str(start, current))
+        return 1;
+
+    return current.compare(key);
+}
+
+/// Decodes a located value with one of the read_* decoders, std::nullopt if missing or of another type
+template <typename T, bool (*Read)(const uint8_t *, T &)>
+std::optional<T> try_read(const uint8_t *value)
+{
+    T out;
+
+    if (value && Read(value, out))
+        return out;
+
+    return std::nullopt;
+}
+
+/// Throwing counterpart of try_read
+template <typename T, bool (*Read)(const uint8_t *, T &)>
+T read_or_throw(const uint8_t *value, const char *message)
+{
+    T out;
+
+    if (!value || !Read(value, out))
+        throw bad_object_type(message);
+
+    return out;
+}
+
+}
+
+const Msgpack::view_state Msgpack::_empty_state;
+
 Msgpack::Msgpack(const uint8_t *data, size_t length) : _data(data), _size(length), _offset(0) {}
 
+Msgpack::Msgpack(const Msgpack &other) : _data(other._data), _size(other._size), _offset(other._offset)
+{
+    std::lock_guard<std::mutex> lock(other._publish_mutex);
+
+    // the current state is the last one published, a view without any keeps the empty state
+    if (other._current)
+    {
+        _current = other._current;
+        _state.store(_current.get());
+    }
+}
+
+Msgpack::pinned_state::pinned_state(const Msgpack &view) : _view(view)
+{
+    // announced before the load: publish frees a replaced state only once no reader announced before it
+    _guard.emplace();
+    _state = _view._state.load();
+}
+
+Msgpack::pinned_state::~pinned_state()
+{
+    _guard.reset();
+
+    // readers free what was replaced while they ran, without waiting on a running publish
+    if (_view._has_retired.load())
+    {
+        std::unique_lock<std::mutex> lock(_view._publish_mutex, std::try_to_lock);
+
+        if (lock.owns_lock())
+            _view.reclaim();
+    }
+}
+
+template <typename Update>
+void Msgpack::publish(Update &&update)
+{
+    std::lock_guard<std::mutex> lock(_publish_mutex);
+
+    // only publish frees states, so the current one stays valid under the mutex
+    auto next = std::make_shared<view_state>(*_state.load());
+    update(*next);
+
+    std::shared_ptr<const view_state> replaced = std::move(_current);
+    _current = std::move(next);
+    _state.store(_current.get());
+
+    if (replaced)
+    {
+        _retired.emplace_back(EpochGuard::advance(), std::move(replaced));
+        _has_retired.store(true);
+    }
+
+    reclaim();
+}
+
+void Msgpack::reclaim() const
+{
+    auto end = std::remove_if(_retired.begin(), _retired.end(), [](const auto &retired) { return EpochGuard::quiescent(retired.first); });
+    _retired.erase(end, _retired.end());
+    _has_retired.store(!_retired.empty());
+}
+
 Msgpack::Msgpack(const char *data, size_t length) : Msgpack((uint8_t *)data, length) {}
 
 Msgpack::Msgpack(const std::vector<uint8_t> &data) : Msgpack(data.data(), data.size()) {}
@@ -20,6 +131,8 @@ Msgpack::Msgpack(const std::vector<char> &data) : Msgpack((uint8_t *)data.data()
 
 std::pair<size_t, msgpack_object> Msgpack::parse_data(const uint8_t* start)
 {
+     MSGPACKSEARCH_COUNT(objects_decoded, 1);
+
      switch (*start)
      {
          case 0x00 ... 0x7f: // positive fixnum
@@ -36,9 +149,7 @@ std::pair<size_t, msgpack_object> Msgpack::parse_data(const uint8_t* start)
             // +--------+
             // |111YYYYY|
             // +--------+
-            // TODO convert 5-bit negative integer to negative int64_t
-
-            return std::make_pair<size_t, msgpack_object>(1, static_cast<int64_t>(*start));
+            return std::make_pair<size_t, msgpack_object>(1, static_cast<int64_t>(static_cast<int8_t>(*start)));
 
          }
          case 0xc0 ... 0xdf: // variable length types
@@ -138,7 +249,10 @@ std::pair<size_t, msgpack_object> Msgpack::parse_data(const uint8_t* start)
                         // |  0xca  |XXXXXXXX|XXXXXXXX|XXXXXXXX|XXXXXXXX|
                         // +--------+--------+--------+--------+--------+
 
-                        // ??
+                        double value;
+                        read_float(start, value);
+
+                        return std::make_pair<size_t, msgpack_object>(5, (double)value);
 
                     }
                     case 0xcb:  // double
@@ -147,7 +261,10 @@ std::pair<size_t, msgpack_object> Msgpack::parse_data(const uint8_t* start)
                         // |  0xcb  |YYYYYYYY|YYYYYYYY|YYYYYYYY|YYYYYYYY|YYYYYYYY|YYYYYYYY|YYYYYYYY|YYYYYYYY|
                         // +--------+--------+--------+--------+--------+--------+--------+--------+--------+
 
-                        // ?
+                        double value;
+                        read_float(start, value);
+
+                        return std::make_pair<size_t, msgpack_object>(9, (double)value);
 
                     }
                     case 0xcc:  // unsigned int  8
@@ -204,7 +321,7 @@ std::pair<size_t, msgpack_object> Msgpack::parse_data(const uint8_t* start)
                         // |  0xd0  |ZZZZZZZZ|
                         // +--------+--------+
 
-                        return std::make_pair<size_t, msgpack_object>(2, (int64_t)(*(start + 1)));
+                        return std::make_pair<size_t, msgpack_object>(2, (int64_t)(int8_t)(*(start + 1)));
                     }
                     case 0xd1:  // signed int 16
                     {
@@ -278,7 +395,7 @@ std::pair<size_t, msgpack_object> Msgpack::parse_data(const uint8_t* start)
                         // +--------+--------+--------+--------+--------+--------+--------+--------+--------+--------+
                         // |  0xd8  |  type  |                                  data                                 ...
                         // +--------+--------+--------+--------+--------+--------+--------+--------+--------+--------+
-                        return std::make_pair<size_t, msgpack_ext>(17, msgpack_ext(*(start + 1), 16, start + 2));
+                        return std::make_pair<size_t, msgpack_ext>(18, msgpack_ext(*(start + 1), 16, start + 2));
                     }
 
                     case 0xd9:  // str 8
@@ -423,44 +540,138 @@ std::pair<size_t, msgpack_object> Msgpack::parse_data(const uint8_t* start)
 
 }
 
-const uint8_t* Msgpack::find_map_key(const msgpack_map &map, const std::string &key)
+const uint8_t* Msgpack::find_map_key(const msgpack_map &map, const std::string &key) const
 {   
     return find_map_key(map.start, map.nmb_elements, key);
 }
 
-const uint8_t* Msgpack::find_map_key(const uint8_t *start, const uint32_t nmb_elements, const std::string &key)
+const uint8_t* Msgpack::find_map_key(const uint8_t *start, const uint32_t nmb_elements, const std::string &key) const
+{
+    return find_map_key(start, nmb_elements, key, state()->sorted_keys);
+}
+
+const uint8_t* Msgpack::find_map_key(const uint8_t *start, const uint32_t nmb_elements, const std::string &key, bool sorted)
 {
     uint32_t element_count = 0;
     size_t offset = 0;
 
     while (element_count < nmb_elements)
     {
-        auto [key_read, current_key] = parse_data(start + offset);
-        offset += key_read;
+        std::string_view current_key;
 
-        if (std::holds_alternative<msgpack_str>(current_key))
+        if (read_str(start + offset, current_key))
         {
-            msgpack_str temp = std::get<msgpack_str>(current_key);
-            std::string cpp_string = std::string(temp.data, temp.size);
+            MSGPACKSEARCH_COUNT(keys_compared, 1);
 
-            if (key == cpp_string)
-                return start + offset; // the location of the value in the key:value pair
+            if (current_key == key)
+            {
+                MSGPACKSEARCH_COUNT(bytes_skipped, offset);
+                return start + offset + skip_object(start + offset); // the location of the value in the key:value pair
+            }
 
+            if (sorted && current_key > key)
+                break; // sorted keys, the key would have been found by now
+        }
+        else if (sorted)
+        {
+            break; // non-string keys sort after every string key
         }
 
+        offset += skip_object(start + offset);
         offset += skip_object(start + offset);
         element_count++;
     }
 
+    MSGPACKSEARCH_COUNT(bytes_skipped, offset);
     return nullptr;
 }
 
-const uint8_t* Msgpack::find_array_index(const msgpack_array &array, const uint32_t index)
+const uint8_t* Msgpack::find_map_key(const map_index &index, const std::string &key) const
+{
+    const uint8_t *key_start = nullptr;
+
+    if (index.sorted)
+    {
+        size_t low = 0;
+        size_t high = index.key_offsets.size();
+
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            MSGPACKSEARCH_COUNT(keys_compared, 1);
+            int order = compare_key(index.start + index.key_offsets[middle], key);
+
+            if (order == 0)
+            {
+                key_start = index.start + index.key_offsets[middle];
+                break;
+            }
+
+            if (order < 0)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+    }
+    else
+    {
+        for (size_t key_offset : index.key_offsets)
+        {
+            MSGPACKSEARCH_COUNT(keys_compared, 1);
+            if (compare_key(index.start + key_offset, key) == 0)
+            {
+                key_start = index.start + key_offset;
+                break;
+            }
+        }
+    }
+
+    if (!key_start)
+        return nullptr;
+
+    return key_start + skip_object(key_start);
+}
+
+map_index Msgpack::build_map_index(const msgpack_map &map) const
+{
+    map_index index;
+    index.start = map.start;
+    index.key_offsets.reserve(map.nmb_elements);
+
+    size_t offset = 0;
+    std::string_view previous;
+    bool previous_is_str = false;
+
+    for (uint32_t element_count = 0; element_count < map.nmb_elements; element_count++)
+    {
+        std::string_view current;
+        bool current_is_str = read_str(map.start + offset, current);
+
+        if (element_count > 0 && index.sorted)
+        {
+            if (!previous_is_str && current_is_str)
+                index.sorted = false; // a string key after a non-string key
+            else if (previous_is_str && current_is_str && previous >= current)
+                index.sorted = false;
+        }
+
+        index.key_offsets.push_back(offset);
+        previous = current;
+        previous_is_str = current_is_str;
+
+        offset += skip_object(map.start + offset);
+        offset += skip_object(map.start + offset);
+    }
+
+    return index;
+}
+
+const uint8_t* Msgpack::find_array_index(const msgpack_array &array, const uint32_t index) const
 {
     return find_array_index(array.start, array.nmb_elements, index);
 }
 
-const uint8_t* Msgpack::find_array_index(const uint8_t *start, const uint32_t nmb_elements, const uint32_t index)
+const uint8_t* Msgpack::find_array_index(const uint8_t *start, const uint32_t nmb_elements, const uint32_t index) const
 {
     if (index >= nmb_elements)
         return nullptr;
@@ -474,6 +685,7 @@ const uint8_t* Msgpack::find_array_index(const uint8_t *start, const uint32_t nm
         element_count++;
     }
 
+    MSGPACKSEARCH_COUNT(bytes_skipped, offset);
     return start + offset;
 }
 
@@ -573,7 +785,7 @@ size_t Msgpack::skip_object(const uint8_t* start)
                         std::memcpy(&size, start + 1, sizeof(size));;
                         size = __bswap_32(size);
 
-                        return 5 + size;
+                        return 6 + (size_t)size;
 
                     }
                     case 0xca:  // float
@@ -841,7 +1053,50 @@ size_t Msgpack::skip_array(const uint8_t* start, const size_t nmb_elements)
     return offset;
 }
 
-msgpack_object Msgpack::get(const std::string &key)
+size_t Msgpack::skip_object_bounded(const uint8_t* start, const uint8_t* end)
+{
+    const uint8_t *current = start;
+    uint64_t pending = 1; // objects left to skip, nested elements included
+
+    while (pending)
+    {
+        if (current >= end)
+            return 0;
+
+        if (type_of(*current) == msgpack_type::invalid)
+            throw parse_error("Invalid type byte", current - start);
+
+        // headers near end are decoded from a zero padded copy, never past end
+        uint8_t padded[9] = {};
+        const uint8_t *header = current;
+
+        if (end - current < static_cast<ptrdiff_t>(sizeof(padded)))
+        {
+            std::memcpy(padded, current, end - current);
+            header = padded;
+        }
+
+        uint32_t nmb_elements;
+        size_t header_size;
+
+        if (read_map_header(header, nmb_elements, header_size))
+            pending += 2 * static_cast<uint64_t>(nmb_elements);
+        else if (read_array_header(header, nmb_elements, header_size))
+            pending += nmb_elements;
+        else
+            header_size = skip_object(header);
+
+        if (header_size > static_cast<size_t>(end - current))
+            return 0;
+
+        current += header_size;
+        pending--;
+    }
+
+    return current - start;
+}
+
+msgpack_object Msgpack::get(const std::string &key) const
 {
     try {
         return this->operator[](key);
@@ -851,7 +1106,7 @@ msgpack_object Msgpack::get(const std::string &key)
     }
 }
 
-std::string_view Msgpack::get_sv(const std::string &key)
+std::string_view Msgpack::get_sv(const std::string &key) const
 {
     try {
         auto object = this->operator[](key);
@@ -863,7 +1118,7 @@ std::string_view Msgpack::get_sv(const std::string &key)
     }
 }
 
-int Msgpack::get_int(const std::string &key)
+int Msgpack::get_int(const std::string &key) const
 {
     try {
         auto object = this->operator[](key);
@@ -875,7 +1130,7 @@ int Msgpack::get_int(const std::string &key)
     }
 }
 
-bool Msgpack::get_bool(const std::string &key)
+bool Msgpack::get_bool(const std::string &key) const
 {
     try {
         auto object = this->operator[](key);
@@ -887,7 +1142,7 @@ bool Msgpack::get_bool(const std::string &key)
     }
 }
 
-msgpack_map Msgpack::get_map(const std::string &key)
+msgpack_map Msgpack::get_map(const std::string &key) const
 {
     try {
         auto object = this->operator[](key);
@@ -899,7 +1154,7 @@ msgpack_map Msgpack::get_map(const std::string &key)
     }
 }
 
-msgpack_array Msgpack::get_array(const std::string &key)
+msgpack_array Msgpack::get_array(const std::string &key) const
 {
     try {
         auto object = this->operator[](key);
@@ -911,7 +1166,7 @@ msgpack_array Msgpack::get_array(const std::string &key)
     }
 }
 
-msgpack_bin Msgpack::get_bin(const std::string &key)
+msgpack_bin Msgpack::get_bin(const std::string &key) const
 {
     try {
         auto object = this->operator[](key);
@@ -922,7 +1177,7 @@ msgpack_bin Msgpack::get_bin(const std::string &key)
     }
 }
 
-msgpack_ext Msgpack::get_ext(const std::string &key)
+msgpack_ext Msgpack::get_ext(const std::string &key) const
 {
     try {
         auto object = this->operator[](key);
@@ -934,7 +1189,7 @@ msgpack_ext Msgpack::get_ext(const std::string &key)
     }
 }
 
-msgpack_object Msgpack::get(const int index)
+msgpack_object Msgpack::get(const int index) const
 {
     try {
         return this->operator[](index);
@@ -944,7 +1199,7 @@ msgpack_object Msgpack::get(const int index)
     }
 }
 
-std::string_view Msgpack::get_sv(const int index)
+std::string_view Msgpack::get_sv(const int index) const
 {
     try {
         auto object = this->operator[](index);
@@ -956,7 +1211,7 @@ std::string_view Msgpack::get_sv(const int index)
     }
 }
 
-int Msgpack::get_int(const int index)
+int Msgpack::get_int(const int index) const
 {
     try {
         auto object = this->operator[](index);
@@ -968,7 +1223,7 @@ int Msgpack::get_int(const int index)
     }
 }
 
-bool Msgpack::get_bool(const int index)
+bool Msgpack::get_bool(const int index) const
 {
     try {
         auto object = this->operator[](index);
@@ -980,7 +1235,7 @@ bool Msgpack::get_bool(const int index)
     }
 }
 
-msgpack_map Msgpack::get_map(const int index)
+msgpack_map Msgpack::get_map(const int index) const
 {
     try {
         auto object = this->operator[](index);
@@ -992,7 +1247,7 @@ msgpack_map Msgpack::get_map(const int index)
     }
 }
 
-msgpack_array Msgpack::get_array(const int index)
+msgpack_array Msgpack::get_array(const int index) const
 {
     try {
         auto object = this->operator[](index);
@@ -1004,7 +1259,7 @@ msgpack_array Msgpack::get_array(const int index)
     }
 }
 
-msgpack_bin Msgpack::get_bin(const int index)
+msgpack_bin Msgpack::get_bin(const int index) const
 {
     try {
         auto object = this->operator[](index);
@@ -1015,7 +1270,7 @@ msgpack_bin Msgpack::get_bin(const int index)
     }
 }
 
-msgpack_ext Msgpack::get_ext(const int index)
+msgpack_ext Msgpack::get_ext(const int index) const
 {
     try {
         auto object = this->operator[](index);
@@ -1026,8 +1281,162 @@ msgpack_ext Msgpack::get_ext(const int index)
     }
 }
 
-msgpack_object Msgpack::operator[](const std::string &key)
+const uint8_t* Msgpack::locate(const std::string &key) const
+{
+    MSGPACKSEARCH_TIME_LOOKUP();
+    MSGPACKSEARCH_MAX(max_depth, 1);
+
+    uint32_t nmb_elements;
+    size_t header_size;
+
+    if (!this->_data || this->_offset >= this->_size || !read_map_header(this->_data + this->_offset, nmb_elements, header_size))
+        return nullptr;
+
+    pinned_state current = state();
+
+    if (const Tape *tape = current->tape.get())
+        return tape_object(*tape, tape->child(0, key));
+
+    return find_map_key(this->_data + this->_offset + header_size, nmb_elements, key, current->sorted_keys);
+}
+
+const uint8_t* Msgpack::locate(const int index) const
 {
+    MSGPACKSEARCH_TIME_LOOKUP();
+    MSGPACKSEARCH_MAX(max_depth, 1);
+
+    uint32_t nmb_elements;
+    size_t header_size;
+
+    if (!this->_data || this->_offset >= this->_size || !read_array_header(this->_data + this->_offset, nmb_elements, header_size))
+        return nullptr;
+
+    if (index < 0 || (uint32_t)index >= nmb_elements)
+        return nullptr;
+
+    pinned_state current = state();
+
+    if (const Tape *tape = current->tape.get())
+        return tape_object(*tape, tape->at(0, index));
+
+    return find_array_index(this->_data + this->_offset + header_size, nmb_elements, index);
+}
+
+uint64_t Msgpack::get_u64(const std::string &key) const
+{
+    return read_or_throw<uint64_t, read_u64>(locate(key), "Msgpack object is not an unsigned integer");
+}
+
+int64_t Msgpack::get_i64(const std::string &key) const
+{
+    return read_or_throw<int64_t, read_i64>(locate(key), "Msgpack object is not a signed integer");
+}
+
+double Msgpack::get_double(const std::string &key) const
+{
+    return read_or_throw<double, read_double>(locate(key), "Msgpack object is not a number");
+}
+
+std::string_view Msgpack::get_string_view(const std::string &key) const
+{
+    return read_or_throw<std::string_view, read_str>(locate(key), "Msgpack object is not a string");
+}
+
+std::optional<uint64_t> Msgpack::try_get_u64(const std::string &key) const
+{
+    return try_read<uint64_t, read_u64>(locate(key));
+}
+
+std::optional<int64_t> Msgpack::try_get_i64(const std::string &key) const
+{
+    return try_read<int64_t, read_i64>(locate(key));
+}
+
+std::optional<double> Msgpack::try_get_double(const std::string &key) const
+{
+    return try_read<double, read_double>(locate(key));
+}
+
+std::optional<bool> Msgpack::try_get_bool(const std::string &key) const
+{
+    return try_read<bool, read_bool>(locate(key));
+}
+
+std::optional<std::string_view> Msgpack::try_get_string_view(const std::string &key) const
+{
+    return try_read<std::string_view, read_str>(locate(key));
+}
+
+msgpack_timestamp Msgpack::get_timestamp(const std::string &key) const
+{
+    return read_or_throw<msgpack_timestamp, read_timestamp>(locate(key), "Msgpack object is not a timestamp");
+}
+
+std::optional<msgpack_timestamp> Msgpack::try_get_timestamp(const std::string &key) const
+{
+    return try_read<msgpack_timestamp, read_timestamp>(locate(key));
+}
+
+uint64_t Msgpack::get_u64(const int index) const
+{
+    return read_or_throw<uint64_t, read_u64>(locate(index), "Msgpack object is not an unsigned integer");
+}
+
+int64_t Msgpack::get_i64(const int index) const
+{
+    return read_or_throw<int64_t, read_i64>(locate(index), "Msgpack object is not a signed integer");
+}
+
+double Msgpack::get_double(const int index) const
+{
+    return read_or_throw<double, read_double>(locate(index), "Msgpack object is not a number");
+}
+
+std::string_view Msgpack::get_string_view(const int index) const
+{
+    return read_or_throw<std::string_view, read_str>(locate(index), "Msgpack object is not a string");
+}
+
+std::optional<uint64_t> Msgpack::try_get_u64(const int index) const
+{
+    return try_read<uint64_t, read_u64>(locate(index));
+}
+
+std::optional<int64_t> Msgpack::try_get_i64(const int index) const
+{
+    return try_read<int64_t, read_i64>(locate(index));
+}
+
+std::optional<double> Msgpack::try_get_double(const int index) const
+{
+    return try_read<double, read_double>(locate(index));
+}
+
+std::optional<bool> Msgpack::try_get_bool(const int index) const
+{
+    return try_read<bool, read_bool>(locate(index));
+}
+
+std::optional<std::string_view> Msgpack::try_get_string_view(const int index) const
+{
+    return try_read<std::string_view, read_str>(locate(index));
+}
+
+msgpack_timestamp Msgpack::get_timestamp(const int index) const
+{
+    return read_or_throw<msgpack_timestamp, read_timestamp>(locate(index), "Msgpack object is not a timestamp");
+}
+
+std::optional<msgpack_timestamp> Msgpack::try_get_timestamp(const int index) const
+{
+    return try_read<msgpack_timestamp, read_timestamp>(locate(index));
+}
+
+msgpack_object Msgpack::operator[](const std::string &key) const
+{
+    MSGPACKSEARCH_TIME_LOOKUP();
+    MSGPACKSEARCH_MAX(max_depth, 1);
+
     uint32_t nmb_elements;
     uint8_t *map_data;
 
@@ -1062,7 +1471,9 @@ msgpack_object Msgpack::operator[](const std::string &key)
         }
     }
 
-    const uint8_t *value = find_map_key(map_data, nmb_elements, key);
+    pinned_state current = state();
+    const Tape *tape = current->tape.get();
+    const uint8_t *value = tape ? tape_object(*tape, tape->child(0, key)) : find_map_key(map_data, nmb_elements, key, current->sorted_keys);
 
     if (value)
         return parse_data(value).second;
@@ -1072,8 +1483,11 @@ msgpack_object Msgpack::operator[](const std::string &key)
 
 }
 
-msgpack_object Msgpack::operator[](const int index)
+msgpack_object Msgpack::operator[](const int index) const
 {
+    MSGPACKSEARCH_TIME_LOOKUP();
+    MSGPACKSEARCH_MAX(max_depth, 1);
+
     uint32_t nmb_elements;
     uint8_t *array_data;
 
@@ -1111,29 +1525,124 @@ msgpack_object Msgpack::operator[](const int index)
     if (index >= nmb_elements)
         throw std::out_of_range("Index exceeds the size of the array");
 
-    const uint8_t *value = find_array_index(array_data, nmb_elements, index);
+    pinned_state current = state();
+    const Tape *tape = current->tape.get();
+    const uint8_t *value = tape ? tape_object(*tape, tape->at(0, index)) : find_array_index(array_data, nmb_elements, index);
+
+    if (value)
+        return parse_data(value).second;
+
+    return msgpack_object();
+
+}
+
+msgpack_object Msgpack::at_path(const std::string &path) const
+{
+    const uint8_t *value = find_path(path);
 
     if (value)
         return parse_data(value).second;
 
     return msgpack_object();
+}
+
+const uint8_t* Msgpack::find_path(const std::string &path) const
+{
+    MSGPACKSEARCH_TIME_LOOKUP();
+
+    pinned_state current = state();
+
+    if (current->cache)
+    {
+        std::optional<size_t> offset = current->cache->find(current->buffer_id, path);
+
+        // an offset past the buffer was cached for another one under the same id, it is looked up again
+        if (offset && *offset == LookupCache::npos)
+            return nullptr;
+
+        if (offset && *offset < this->_size)
+            return this->_data + *offset;
+    }
+
+    msgpack_path steps = parse_path(path);
+    MSGPACKSEARCH_MAX(max_depth, steps.size());
+
+    const uint8_t *value = current->tape ? tape_object(*current->tape, current->tape->follow(0, steps)) : follow_path(cursor(), steps).data();
 
+    if (current->cache)
+        current->cache->insert(current->buffer_id, path, value ? value - this->_data : LookupCache::npos);
+
+    return value;
+}
+
+void Msgpack::set_cache(std::shared_ptr<LookupCache> cache, uint64_t buffer_id)
+{
+        if (cache && !buffer_id)
+            throw std::invalid_argument("A lookup cache needs the id of the buffer");
+
+        publish([&cache, buffer_id](view_state &next) {
+            next.cache = std::move(cache);
+            next.buffer_id = buffer_id;
+        });
+}
+
+std::shared_ptr<LookupCache> Msgpack::cache() const
+{
+        return state()->cache;
+}
+
+void Msgpack::set_tape(std::shared_ptr<const Tape> tape)
+{
+        if (tape && tape->data() != this->_data + this->_offset)
+            throw std::invalid_argument("The tape was built on another object");
+
+        publish([&tape](view_state &next) { next.tape = std::move(tape); });
+}
+
+std::shared_ptr<const Tape> Msgpack::tape() const
+{
+        return state()->tape;
 }
 
-const uint8_t *Msgpack::data()
+const uint8_t* Msgpack::tape_object(const Tape &tape, uint32_t entry)
+{
+        return entry == Tape::npos ? nullptr : tape.object(entry);
+}
+
+size_t Msgpack::for_each_match(const std::string &pattern, const pattern_visitor &visit) const
+{
+    return msgpacksearch::for_each_match(cursor(), parse_pattern(pattern), visit);
+}
+
+Cursor Msgpack::cursor() const
+{
+        return Cursor(this->_data + this->_offset, this->_size - this->_offset);
+}
+
+const uint8_t *Msgpack::data() const
 {
         return this->_data;
 }
 
-const size_t Msgpack::offset()
+size_t Msgpack::offset() const
 {
         return this->_offset;
 }
 
-const size_t Msgpack::size()
+size_t Msgpack::size() const
 {
         return this->_size;
 }
 
+void Msgpack::set_sorted_keys(bool sorted)
+{
+        publish([sorted](view_state &next) { next.sorted_keys = sorted; });
+}
+
+bool Msgpack::sorted_keys() const
+{
+        return state()->sorted_keys;
+}
+
 
 } // namespace msgpacksearch
\ No newline at end of file
@@ -1,19 +1,35 @@
 #ifndef CMAKE_MSGPACKSEARCH_H
 #define CMAKE_MSGPACKSEARCH_H
 
+#include <atomic>
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <variant>
 #include <string>
 #include <utility>
+#include <optional>
+#include <string_view>
 
 #include "types.h"
+#include "cursor.h"
+#include "epoch.h"
+#include "lookup_cache.h"
+#include "path.h"
+#include "tape.h"
 
 namespace msgpacksearch {
 
 
-/// @brief Thin wrapper class for reading msgpack data. Read only. Probably will be called Msgpack_View in the near future.
+/**
+ * @brief Thin wrapper class for reading msgpack data. Read only. Probably will be called Msgpack_View in the near future.
+ *
+ * Every const member function is safe to call from any number of threads on one view. The setters
+ * (set_cache, set_tape, set_sorted_keys) may run concurrently with readers: each publishes a new
+ * immutable state with one atomic store, and lookups read whichever state was current when they started.
+ * A replaced state, with the cache and tape it holds, is freed once no lookup of the view is running.
+ */
 class Msgpack {
 
 public:
@@ -23,37 +39,134 @@ public:
     explicit Msgpack(const std::vector<char> &data);
     explicit Msgpack(const uint8_t *data, size_t length);
     explicit Msgpack(const char *data, size_t length);
-    explicit Msgpack(const Msgpack &other) = default;
+
+    /// A view of the same data, with what is attached to other at the time of the copy
+    explicit Msgpack(const Msgpack &other);
 
     Msgpack& operator=(const Msgpack &other) = default;
     Msgpack(Msgpack const && other) = delete;
 
     /// Key access of a map
-    msgpack_object operator[](const std::string &key);
+    msgpack_object operator[](const std::string &key) const;
 
     /// index access of an array
-    msgpack_object operator[](const int index);
+    msgpack_object operator[](const int index) const;
+
+    /**
+    * Cursor on the root object, for navigating without building intermediate msgpack_objects
+    * @return Cursor positioned at offset() in the data
+    */
+    Cursor cursor() const;
+
+    /**
+    * Evaluates a path expression from the root object, see parse_path for the syntax
+    * @param[in] path the path expression, e.g. "a.b[2].c"
+    * @return The value at the path, or std::monostate if the path does not resolve
+    * @throws parse_error if the expression is malformed
+    */
+    msgpack_object at_path(const std::string &path) const;
+
+    /**
+    * Finds the location of the value at a path, memoized by the attached LookupCache if there is one
+    * @param[in] path the path expression
+    * @return The location of the value, or NULL if the path does not resolve
+    * @throws parse_error if the expression is malformed
+    */
+    const uint8_t* find_path(const std::string &path) const;
+
+    /**
+    * Visits the values selected by a path pattern from the root object, see parse_pattern for the syntax
+    * @param[in] pattern the pattern, e.g. "items[*].price" or "items[-3:]"
+    * @param[in] visit called for every selected value in document order, returns false to stop
+    * @return Number of values visited
+    * @throws parse_error if the pattern is malformed
+    */
+    size_t for_each_match(const std::string &pattern, const pattern_visitor &visit) const;
+
+    /**
+    * Attaches a lookup cache. Views of the same immutable buffer can share one cache by passing the same buffer_id.
+    * The id must not be reused for another buffer while the cache holds its entries: an address is not an
+    * identity, a freed buffer's address is handed out again.
+    * @param[in] cache the cache, nullptr to detach
+    * @param[in] buffer_id identity of the buffer, required with a cache
+    * @throws std::invalid_argument if a cache is given without a buffer_id
+    */
+    void set_cache(std::shared_ptr<LookupCache> cache, uint64_t buffer_id = 0);
+
+    /**
+    * Getter for the attached cache
+    * @return the attached lookup cache, or nullptr
+    */
+    std::shared_ptr<LookupCache> cache() const;
+
+    /**
+    * Attaches a tape of the root object. Key, index and path lookups then follow the tape instead of
+    * skipping over the data; views of the same buffer can share one tape.
+    * @param[in] tape tape built on data() + offset(), nullptr to detach
+    * @throws std::invalid_argument if the tape was built on another object
+    */
+    void set_tape(std::shared_ptr<const Tape> tape);
+
+    /**
+    * Getter for the attached tape
+    * @return the attached tape, or nullptr
+    */
+    std::shared_ptr<const Tape> tape() const;
 
     /// Key based search of an Object
-    msgpack_object get(const std::string &key);
-    std::string_view get_sv(const std::string &key);
-    int get_int(const std::string &key);
-    bool get_bool(const std::string &key);
-    msgpack_map get_map(const std::string &key);
-    msgpack_array get_array(const std::string &key);
-    msgpack_bin get_bin(const std::string &key);
-    msgpack_ext get_ext(const std::string &key);
+    msgpack_object get(const std::string &key) const;
+    std::string_view get_sv(const std::string &key) const;
+    int get_int(const std::string &key) const;
+    bool get_bool(const std::string &key) const;
+    msgpack_map get_map(const std::string &key) const;
+    msgpack_array get_array(const std::string &key) const;
+    msgpack_bin get_bin(const std::string &key) const;
+    msgpack_ext get_ext(const std::string &key) const;
 
 
     /// Index based search of an array
-    msgpack_object get(const int index);
-    std::string_view get_sv(const int index);
-    int get_int(const int index);
-    bool get_bool(const int index);
-    msgpack_map get_map(const int index);
-    msgpack_array get_array(const int index);
-    msgpack_bin get_bin(const int index);
-    msgpack_ext get_ext(const int index);
+    msgpack_object get(const int index) const;
+    std::string_view get_sv(const int index) const;
+    int get_int(const int index) const;
+    bool get_bool(const int index) const;
+    msgpack_map get_map(const int index) const;
+    msgpack_array get_array(const int index) const;
+    msgpack_bin get_bin(const int index) const;
+    msgpack_ext get_ext(const int index) const;
+
+    /**
+    * Typed getters, decoding the value straight from its type byte without building a msgpack_object.
+    * Numbers widen losslessly across the int, uint and float encodings (e.g. get_i64 accepts a uint 8,
+    * get_double accepts an int 32 but get_u64 rejects -1 or 1.5). get_timestamp decodes the timestamp
+    * extension (-1) in any of its widths.
+    * The get_* versions throw bad_object_type if the key/index is missing or the value does not convert,
+    * the try_get_* versions return std::nullopt instead and never throw.
+    */
+    uint64_t get_u64(const std::string &key) const;
+    int64_t get_i64(const std::string &key) const;
+    double get_double(const std::string &key) const;
+    std::string_view get_string_view(const std::string &key) const;
+    msgpack_timestamp get_timestamp(const std::string &key) const;
+
+    std::optional<uint64_t> try_get_u64(const std::string &key) const;
+    std::optional<int64_t> try_get_i64(const std::string &key) const;
+    std::optional<double> try_get_double(const std::string &key) const;
+    std::optional<bool> try_get_bool(const std::string &key) const;
+    std::optional<std::string_view> try_get_string_view(const std::string &key) const;
+    std::optional<msgpack_timestamp> try_get_timestamp(const std::string &key) const;
+
+    uint64_t get_u64(const int index) const;
+    int64_t get_i64(const int index) const;
+    double get_double(const int index) const;
+    std::string_view get_string_view(const int index) const;
+    msgpack_timestamp get_timestamp(const int index) const;
+
+    std::optional<uint64_t> try_get_u64(const int index) const;
+    std::optional<int64_t> try_get_i64(const int index) const;
+    std::optional<double> try_get_double(const int index) const;
+    std::optional<bool> try_get_bool(const int index) const;
+    std::optional<std::string_view> try_get_string_view(const int index) const;
+    std::optional<msgpack_timestamp> try_get_timestamp(const int index) const;
 
     /**
     * Finds the location of a key in a given map
@@ -62,7 +175,7 @@ public:
     * @param[in] key key to search for.
     * @return The location of the value in the key:value pair, or NULL if not found.
     */
-    const uint8_t* find_map_key(const msgpack_map &map, const std::string &key);
+    const uint8_t* find_map_key(const msgpack_map &map, const std::string &key) const;
 
     /**
     * Finds the location of a key in a given map
@@ -72,7 +185,24 @@ public:
     * @param[in] key key to search for.
     * @return The location of the value in the key:value pair, or NULL if not found.
     */
-    const uint8_t* find_map_key(const uint8_t *start, const uint32_t nmb_elements, const std::string &key);
+    const uint8_t* find_map_key(const uint8_t *start, const uint32_t nmb_elements, const std::string &key) const;
+
+    /**
+    * Finds the location of a key using a prebuilt key index, binary search if the index is sorted
+    *
+    * @param[in] index index of the map to search, see build_map_index.
+    * @param[in] key key to search for.
+    * @return The location of the value in the key:value pair, or NULL if not found.
+    */
+    const uint8_t* find_map_key(const map_index &index, const std::string &key) const;
+
+    /**
+    * Builds an offset index over the keys of a map, detecting whether they are sorted
+    *
+    * @param[in] map map to index.
+    * @return The key index, one linear pass over the map.
+    */
+    map_index build_map_index(const msgpack_map &map) const;
 
     /**
     * Finds the location of an index in an array
@@ -81,7 +211,7 @@ public:
     * @param[in] index index to search for.
     * @return The location of the value @ index, or NULL if not found.
     */
-    const uint8_t* find_array_index(const msgpack_array &array, const uint32_t index);
+    const uint8_t* find_array_index(const msgpack_array &array, const uint32_t index) const;
 
     /**
     * Finds the location of an index in an array
@@ -91,14 +221,14 @@ public:
     * @param[in] index index to search for.
     * @return The location of the value @ index, or NULL if not found.
     */
-    const uint8_t* find_array_index(const uint8_t *start, const uint32_t nmb_elements, const uint32_t index);
+    const uint8_t* find_array_index(const uint8_t *start, const uint32_t nmb_elements, const uint32_t index) const;
 
     /**
     * Skips an object in the msgpack blob
     * @param[in] start points at the object to skip
     * @return Number of bytes skipped
     */
-    size_t skip_object(const uint8_t* start);
+    static size_t skip_object(const uint8_t* start);
 
     /**
     * Skips a map in the msgpack blob
@@ -106,7 +236,7 @@ public:
     * @param[in] nmb_elements number of elements in the map
     * @return Number of bytes skipped
     */
-    size_t skip_map(const uint8_t* start, const size_t nmb_elements);
+    static size_t skip_map(const uint8_t* start, const size_t nmb_elements);
 
     /**
     * Skips an array in the msgpack blob
@@ -114,37 +244,141 @@ public:
     * @param[in] nmb_elements number of elements in the array
     * @return Number of bytes skipped
     */
-    size_t skip_array(const uint8_t* start, const size_t nmb_elements);
+    static size_t skip_array(const uint8_t* start, const size_t nmb_elements);
+
+    /**
+    * Skips an object without reading past the end of the buffer, for buffers that may end mid-object
+    * @param[in] start points at the object to skip
+    * @param[in] end end of the buffer
+    * @return Number of bytes skipped, 0 if the object runs past end
+    * @throws parse_error on an invalid type byte, the offset is relative to start
+    */
+    static size_t skip_object_bounded(const uint8_t* start, const uint8_t* end);
 
     /**
     * Parses an object in the msgpack blob
     * @param[in] start points at the start of the object to parse
     * @return Number of bytes parsed, and the msgpack object
     */
-    std::pair<size_t, msgpack_object> parse_data(const uint8_t* start);
+    static std::pair<size_t, msgpack_object> parse_data(const uint8_t* start);
 
     /**
     * Getter for _data
     * @return const pointer to the raw data
     */
-    const uint8_t* data();
+    const uint8_t* data() const;
 
     /**
     * Getter for _size
     * @return size of the data in bytes
     */
-    const size_t size();
+    size_t size() const;
 
     /**
     * Getter for _offset
     * @return offset into the data
     */
-    const size_t offset();
+    size_t offset() const;
+
+    /**
+    * Declares that every map in the document has its keys in canonical (bytewise) order,
+    * see canonicalize(). Key scans then stop as soon as they pass the position of the key.
+    * @param[in] sorted true if the document is known to be canonical
+    */
+    void set_sorted_keys(bool sorted);
+
+    /**
+    * Getter for the sorted keys declaration
+    * @return true if the document was declared to have sorted map keys
+    */
+    bool sorted_keys() const;
 
 private:
+    /**
+    * Finds the value of a key in the root map without decoding it
+    * @return The location of the value, or NULL if the root is not a map or the key is missing
+    */
+    const uint8_t* locate(const std::string &key) const;
+
+    /**
+    * Finds an element of the root array without decoding it
+    * @return The location of the element, or NULL if the root is not an array or the index is out of range
+    */
+    const uint8_t* locate(const int index) const;
+
+    /**
+    * find_map_key with the sorted keys declaration of a state the caller already pinned
+    * @param[in] sorted see set_sorted_keys
+    */
+    static const uint8_t* find_map_key(const uint8_t *start, const uint32_t nmb_elements, const std::string &key, bool sorted);
+
+    /// Object of a tape entry, NULL for Tape::npos
+    static const uint8_t* tape_object(const Tape &tape, uint32_t entry);
+
+    /**
+     * view_state - what is attached to a view. A state is never modified once published: setters publish
+     * a changed copy, so readers use the state they loaded without locking.
+     *
+     * sorted_keys -> see set_sorted_keys
+     * cache / buffer_id -> see set_cache
+     * tape -> see set_tape
+     */
+    struct view_state
+    {
+        bool sorted_keys = false;
+        std::shared_ptr<LookupCache> cache;
+        uint64_t buffer_id = 0;
+        std::shared_ptr<const Tape> tape;
+    };
+
+    /// State of a view nothing was attached to
+    static const view_state _empty_state;
+
+    /**
+     * @brief The current state of a view, kept alive while the pin exists.
+     *
+     * A pin announces its thread's epoch before it loads the state, so a state replaced in a later
+     * epoch is never loaded by it, see EpochGuard.
+     */
+    class pinned_state {
+
+    public:
+        explicit pinned_state(const Msgpack &view);
+        ~pinned_state();
+
+        pinned_state(const pinned_state &other) = delete;
+        pinned_state& operator=(const pinned_state &other) = delete;
+
+        const view_state* operator->() const { return _state; }
+
+    private:
+        const Msgpack &_view;
+        std::optional<EpochGuard> _guard;
+        const view_state *_state;
+    };
+
+    /// The current state, pinned for as long as the result is in scope
+    pinned_state state() const { return pinned_state(*this); }
+
+    /**
+    * Publishes a copy of the current state changed by update
+    * @param[in] update function changing a view_state
+    */
+    template <typename Update>
+    void publish(Update &&update);
+
+    /// Frees the replaced states no running lookup may read, _publish_mutex must be held
+    void reclaim() const;
+
     const uint8_t *_data;
     const size_t _size;
     const size_t _offset;
+    std::atomic<const view_state*> _state{&_empty_state};
+
+    std::shared_ptr<const view_state> _current; // the last published state, NULL for _empty_state
+    mutable std::vector<std::pair<uint64_t, std::shared_ptr<const view_state>>> _retired; // replaced states lookups may still read, with the epoch they were replaced in
+    mutable std::atomic<bool> _has_retired{false};
+    mutable std::mutex _publish_mutex; // serializes publish, reclaim and copies
 };
 
 }
@@ -0,0 +1,246 @@
+#include "packer.h"
+#include "types.h"
+
+#include <cstring>
+#include <byteswap.h>
+
+namespace msgpacksearch
+{
+
+void Packer::put_be16(uint8_t type, uint16_t value)
+{
+    uint8_t bytes[3];
+    bytes[0] = type;
+    value = __bswap_16(value);
+    std::memcpy(bytes + 1, &value, sizeof(value));
+    _buffer.insert(_buffer.end(), bytes, bytes + sizeof(bytes));
+}
+
+void Packer::put_be32(uint8_t type, uint32_t value)
+{
+    uint8_t bytes[5];
+    bytes[0] = type;
+    value = __bswap_32(value);
+    std::memcpy(bytes + 1, &value, sizeof(value));
+    _buffer.insert(_buffer.end(), bytes, bytes + sizeof(bytes));
+}
+
+void Packer::put_be64(uint8_t type, uint64_t value)
+{
+    uint8_t bytes[9];
+    bytes[0] = type;
+    value = __bswap_64(value);
+    std::memcpy(bytes + 1, &value, sizeof(value));
+    _buffer.insert(_buffer.end(), bytes, bytes + sizeof(bytes));
+}
+
+void Packer::patch_be32(size_t offset, uint32_t value)
+{
+    value = __bswap_32(value);
+    std::memcpy(_buffer.data() + offset, &value, sizeof(value));
+}
+
+void Packer::pack_nil()
+{
+    put_u8(0xc0);
+}
+
+void Packer::pack_bool(bool value)
+{
+    put_u8(value ? 0xc3 : 0xc2);
+}
+
+void Packer::pack_uint(uint64_t value)
+{
+    if (value <= 0x7f)
+        put_u8(static_cast<uint8_t>(value)); // positive fixnum
+    else if (value <= 0xff)
+    {
+        put_u8(0xcc);
+        put_u8(static_cast<uint8_t>(value));
+    }
+    else if (value <= 0xffff)
+        put_be16(0xcd, static_cast<uint16_t>(value));
+    else if (value <= 0xffffffff)
+        put_be32(0xce, static_cast<uint32_t>(value));
+    else
+        put_be64(0xcf, value);
+}
+
+void Packer::pack_int(int64_t value)
+{
+    if (value >= 0)
+    {
+        pack_uint(static_cast<uint64_t>(value));
+        return;
+    }
+
+    if (value >= -32)
+        put_u8(static_cast<uint8_t>(value)); // negative fixnum
+    else if (value >= INT8_MIN)
+    {
+        put_u8(0xd0);
+        put_u8(static_cast<uint8_t>(value));
+    }
+    else if (value >= INT16_MIN)
+        put_be16(0xd1, static_cast<uint16_t>(value));
+    else if (value >= INT32_MIN)
+        put_be32(0xd2, static_cast<uint32_t>(value));
+    else
+        put_be64(0xd3, static_cast<uint64_t>(value));
+}
+
+void Packer::pack_float(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_be32(0xca, bits);
+}
+
+void Packer::pack_double(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_be64(0xcb, bits);
+}
+
+void Packer::pack_str(std::string_view value)
+{
+    const size_t size = value.size();
+
+    if (size <= 31)
+        put_u8(static_cast<uint8_t>(0xa0 | size)); // fixstr
+    else if (size <= 0xff)
+    {
+        put_u8(0xd9);
+        put_u8(static_cast<uint8_t>(size));
+    }
+    else if (size <= 0xffff)
+        put_be16(0xda, static_cast<uint16_t>(size));
+    else
+        put_be32(0xdb, static_cast<uint32_t>(size));
+
+    pack_raw(reinterpret_cast<const uint8_t *>(value.data()), size);
+}
+
+void Packer::pack_bin(const uint8_t *data, uint32_t size)
+{
+    if (size <= 0xff)
+    {
+        put_u8(0xc4);
+        put_u8(static_cast<uint8_t>(size));
+    }
+    else if (size <= 0xffff)
+        put_be16(0xc5, static_cast<uint16_t>(size));
+    else
+        put_be32(0xc6, size);
+
+    pack_raw(data, size);
+}
+
+void Packer::pack_ext(int8_t type, const uint8_t *data, uint32_t size)
+{
+    switch (size)
+    {
+        case 1: put_u8(0xd4); break;
+        case 2: put_u8(0xd5); break;
+        case 4: put_u8(0xd6); break;
+        case 8: put_u8(0xd7); break;
+        case 16: put_u8(0xd8); break;
+        default:
+        {
+            if (size <= 0xff)
+            {
+                put_u8(0xc7);
+                put_u8(static_cast<uint8_t>(size));
+            }
+            else if (size <= 0xffff)
+                put_be16(0xc8, static_cast<uint16_t>(size));
+            else
+                put_be32(0xc9, size);
+        }
+    }
+
+    put_u8(static_cast<uint8_t>(type));
+    pack_raw(data, size);
+}
+
+void Packer::pack_timestamp(const msgpack_timestamp &timestamp)
+{
+    uint8_t payload[12];
+
+    if (timestamp.seconds >= 0 && (static_cast<uint64_t>(timestamp.seconds) >> 34) == 0)
+    {
+        uint64_t packed = static_cast<uint64_t>(timestamp.nanoseconds) << 34 | static_cast<uint64_t>(timestamp.seconds);
+
+        if ((packed >> 32) == 0) // timestamp 32, seconds only
+        {
+            uint32_t seconds = __bswap_32(static_cast<uint32_t>(packed));
+            std::memcpy(payload, &seconds, sizeof(seconds));
+            pack_ext(-1, payload, 4);
+            return;
+        }
+
+        packed = __bswap_64(packed); // timestamp 64
+        std::memcpy(payload, &packed, sizeof(packed));
+        pack_ext(-1, payload, 8);
+        return;
+    }
+
+    uint32_t nanoseconds = __bswap_32(timestamp.nanoseconds); // timestamp 96
+    uint64_t seconds = __bswap_64(static_cast<uint64_t>(timestamp.seconds));
+    std::memcpy(payload, &nanoseconds, sizeof(nanoseconds));
+    std::memcpy(payload + 4, &seconds, sizeof(seconds));
+    pack_ext(-1, payload, 12);
+}
+
+void Packer::pack_array(uint32_t nmb_elements)
+{
+    if (nmb_elements <= 15)
+        put_u8(static_cast<uint8_t>(0x90 | nmb_elements)); // fixarray
+    else if (nmb_elements <= 0xffff)
+        put_be16(TYPE_MASK::ARRAY16, static_cast<uint16_t>(nmb_elements));
+    else
+        put_be32(TYPE_MASK::ARRAY32, nmb_elements);
+}
+
+void Packer::pack_map(uint32_t nmb_elements)
+{
+    if (nmb_elements <= 15)
+        put_u8(static_cast<uint8_t>(0x80 | nmb_elements)); // fixmap
+    else if (nmb_elements <= 0xffff)
+        put_be16(TYPE_MASK::MAP16, static_cast<uint16_t>(nmb_elements));
+    else
+        put_be32(TYPE_MASK::MAP32, nmb_elements);
+}
+
+void Packer::pack_raw(const uint8_t *data, size_t size)
+{
+    _buffer.insert(_buffer.end(), data, data + size);
+}
+
+size_t Packer::begin_array()
+{
+    size_t header = _buffer.size();
+    put_be32(TYPE_MASK::ARRAY32, 0);
+    return header;
+}
+
+void Packer::end_array(size_t header, uint32_t nmb_elements)
+{
+    patch_be32(header + 1, nmb_elements);
+}
+
+size_t Packer::begin_map()
+{
+    size_t header = _buffer.size();
+    put_be32(TYPE_MASK::MAP32, 0);
+    return header;
+}
+
+void Packer::end_map(size_t header, uint32_t nmb_elements)
+{
+    patch_be32(header + 1, nmb_elements);
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef MSGPACKSEARCH_PACKER_H
+#define MSGPACKSEARCH_PACKER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+
+namespace msgpacksearch {
+
+/// @brief Appends msgpack encoded objects to a byte buffer. Scalars always use the smallest encoding.
+class Packer {
+
+public:
+
+    explicit Packer(std::vector<uint8_t> &buffer) : _buffer(buffer) {}
+
+    void pack_nil();
+    void pack_bool(bool value);
+    void pack_uint(uint64_t value);
+    void pack_int(int64_t value);
+    void pack_float(float value);
+    void pack_double(double value);
+    void pack_str(std::string_view value);
+    void pack_bin(const uint8_t *data, uint32_t size);
+    void pack_ext(int8_t type, const uint8_t *data, uint32_t size);
+
+    /// Timestamp extension (-1), in the smallest of its 32, 64 and 96 bit widths
+    void pack_timestamp(const msgpack_timestamp &timestamp);
+
+    /// Container headers, the caller packs the elements afterwards
+    void pack_array(uint32_t nmb_elements);
+    void pack_map(uint32_t nmb_elements);
+
+    /**
+    * Appends already encoded msgpack bytes
+    * @param[in] data points at the encoded bytes
+    * @param[in] size number of bytes to copy
+    */
+    void pack_raw(const uint8_t *data, size_t size);
+
+    /**
+    * Reserves an array 32 header whose element count is not known yet
+    * @return offset of the header in the buffer, to be passed to end_array
+    */
+    size_t begin_array();
+
+    /**
+    * Back-patches the element count of a header reserved by begin_array
+    * @param[in] header offset returned by begin_array
+    * @param[in] nmb_elements number of elements packed since begin_array
+    */
+    void end_array(size_t header, uint32_t nmb_elements);
+
+    /// Map equivalents of begin_array / end_array, nmb_elements counts key:value pairs
+    size_t begin_map();
+    void end_map(size_t header, uint32_t nmb_elements);
+
+    std::vector<uint8_t>& buffer() { return _buffer; }
+
+private:
+    void put_u8(uint8_t value) { _buffer.push_back(value); }
+    void put_be16(uint8_t type, uint16_t value);
+    void put_be32(uint8_t type, uint32_t value);
+    void put_be64(uint8_t type, uint64_t value);
+    void patch_be32(size_t offset, uint32_t value);
+
+    std::vector<uint8_t> &_buffer;
+};
+
+}
+
+#endif //MSGPACKSEARCH_PACKER_H
@@ -0,0 +1,414 @@
+#include "path.h"
+#include "error.h"
+#include "decode.h"
+#include "msgpacksearch.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+/**
+* Parses the selector between brackets of a pattern: *, an index, negative from the end, or a slice
+* start:stop:step whose parts are optional
+* @return false if the selector is none of these
+*/
+bool parse_selector(std::string_view selector, pattern_element &element)
+{
+    auto parse_int = [](std::string_view text, int64_t &value) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    };
+
+    if (selector == "*")
+    {
+        element.type = pattern_element::kind::wildcard;
+        return true;
+    }
+
+    size_t colon = selector.find(':');
+
+    if (colon == std::string_view::npos)
+    {
+        element.type = pattern_element::kind::index;
+        return parse_int(selector, element.index);
+    }
+
+    element.type = pattern_element::kind::slice;
+    std::string_view start = selector.substr(0, colon);
+    std::string_view stop = selector.substr(colon + 1);
+    std::string_view step;
+
+    colon = stop.find(':');
+    if (colon != std::string_view::npos)
+    {
+        step = stop.substr(colon + 1);
+        stop = stop.substr(0, colon);
+    }
+
+    if ((!start.empty() && !parse_int(start, element.start)) || (!stop.empty() && !parse_int(stop, element.stop)))
+        return false;
+
+    if (!step.empty())
+    {
+        auto [ptr, ec] = std::from_chars(step.data(), step.data() + step.size(), element.step);
+        if (ec != std::errc() || ptr != step.data() + step.size() || !element.step)
+            return false;
+    }
+
+    return true;
+}
+
+/// Parser of paths (path_element) and patterns (pattern_element), which only differ inside brackets and for *
+template <typename Element>
+std::vector<Element> parse_steps(std::string_view expression)
+{
+    constexpr bool pattern = std::is_same_v<Element, pattern_element>;
+    std::vector<Element> path;
+    size_t pos = 0;
+    bool need_key = false; // a '.' was read, a bare key must follow
+
+    while (pos < expression.size())
+    {
+        const char c = expression[pos];
+
+        if (c == '.')
+        {
+            if (path.empty() || need_key)
+                throw parse_error("Empty key in path", pos);
+
+            need_key = true;
+            pos++;
+            continue;
+        }
+
+        if (c == ']')
+            throw parse_error("Unbalanced ']' in path", pos);
+
+        if (c == '[')
+        {
+            if (need_key)
+                throw parse_error("Expected a key after '.'", pos);
+
+            pos++;
+            Element element;
+
+            if (pos < expression.size() && expression[pos] == '"')
+            {
+                // quoted key, \" and \\ are the only escapes
+                element.type = Element::kind::key;
+                pos++;
+
+                while (pos < expression.size() && expression[pos] != '"')
+                {
+                    if (expression[pos] == '\\' && pos + 1 < expression.size())
+                        pos++;
+                    element.key.push_back(expression[pos++]);
+                }
+
+                if (pos >= expression.size())
+                    throw parse_error("Unterminated quoted key in path", pos);
+                pos++;
+            }
+            else
+            {
+                element.type = Element::kind::index;
+                size_t end = expression.find(']', pos);
+
+                if (end == std::string_view::npos)
+                    throw parse_error("Unterminated '[' in path", pos);
+
+                if constexpr (pattern)
+                {
+                    if (!parse_selector(expression.substr(pos, end - pos), element))
+                        throw parse_error("Invalid array index or slice in path", pos);
+                }
+                else
+                {
+                    auto [ptr, ec] = std::from_chars(expression.data() + pos, expression.data() + end, element.index);
+                    if (ec != std::errc() || ptr != expression.data() + end)
+                        throw parse_error("Invalid array index in path", pos);
+                }
+
+                pos = end;
+            }
+
+            if (pos >= expression.size() || expression[pos] != ']')
+                throw parse_error("Expected ']' in path", pos);
+
+            pos++;
+            path.push_back(std::move(element));
+            continue;
+        }
+
+        if (!path.empty() && !need_key)
+            throw parse_error("Expected '.' or '[' in path", pos);
+
+        size_t start = pos;
+        while (pos < expression.size() && expression[pos] != '.' && expression[pos] != '[' && expression[pos] != ']')
+            pos++;
+
+        Element element;
+        element.type = Element::kind::key;
+        element.key = std::string(expression.substr(start, pos - start));
+
+        if constexpr (pattern)
+        {
+            if (element.key == "*")
+                element.type = Element::kind::wildcard;
+        }
+
+        path.push_back(std::move(element));
+        need_key = false;
+    }
+
+    if (need_key)
+        throw parse_error("Path ends with '.'", pos);
+
+    return path;
+}
+
+/**
+* Visits the matches of the steps of a pattern from first on
+* @return false once the visitor stopped the evaluation
+*/
+bool match_steps(const Cursor &from, const msgpack_pattern &pattern, size_t first, const pattern_visitor &visit, size_t &matches)
+{
+    if (first == pattern.size())
+    {
+        matches++;
+        return visit(from);
+    }
+
+    const pattern_element &element = pattern[first];
+    const int64_t nmb_elements = from.nmb_elements();
+
+    switch (element.type)
+    {
+        case pattern_element::kind::key:
+        {
+            Cursor member = from.child(element.key);
+            return !member || match_steps(member, pattern, first + 1, visit, matches);
+        }
+
+        case pattern_element::kind::index:
+        {
+            int64_t index = element.index < 0 ? element.index + nmb_elements : element.index;
+
+            if (!from.is_array() || index < 0 || index >= nmb_elements)
+                return true;
+
+            return match_steps(from.at(static_cast<uint32_t>(index)), pattern, first + 1, visit, matches);
+        }
+
+        case pattern_element::kind::wildcard:
+        {
+            // siblings are reached from the previous element, one forward pass over the container
+            for (Cursor value = from.at(0); value; value = value.next_sibling())
+            {
+                if (!match_steps(value, pattern, first + 1, visit, matches))
+                    return false;
+            }
+
+            return true;
+        }
+
+        case pattern_element::kind::slice:
+        {
+            if (!from.is_array())
+                return true;
+
+            auto clamp = [nmb_elements](int64_t bound) {
+                if (bound < 0)
+                    bound += nmb_elements;
+                return std::min(std::max<int64_t>(bound, 0), nmb_elements);
+            };
+
+            const int64_t start = clamp(element.start);
+            const int64_t stop = clamp(element.stop);
+            Cursor value = start < stop ? from.at(static_cast<uint32_t>(start)) : Cursor();
+
+            for (int64_t index = start; value; index += element.step)
+            {
+                if (!match_steps(value, pattern, first + 1, visit, matches))
+                    return false;
+
+                // nothing past the last selected element is skipped
+                if (index + element.step >= stop)
+                    break;
+
+                for (uint32_t skipped = 0; value && skipped < element.step; skipped++)
+                    value = value.next_sibling();
+            }
+
+            return true;
+        }
+    }
+
+    return true;
+}
+
+}
+
+msgpack_path parse_path(std::string_view expression)
+{
+    return parse_steps<path_element>(expression);
+}
+
+msgpack_pattern parse_pattern(std::string_view expression)
+{
+    return parse_steps<pattern_element>(expression);
+}
+
+size_t for_each_match(const Cursor &from, const msgpack_pattern &pattern, const pattern_visitor &visit)
+{
+    size_t matches = 0;
+
+    if (from)
+        match_steps(from, pattern, 0, visit, matches);
+
+    return matches;
+}
+
+Cursor follow_path(Cursor from, const msgpack_path &path)
+{
+    for (const path_element &element : path)
+    {
+        if (!from)
+            break;
+
+        if (element.type == path_element::kind::key)
+            from = from.child(element.key);
+        else
+            from = from.is_array() ? from.at(element.index) : Cursor();
+    }
+
+    return from;
+}
+
+namespace {
+
+/// State of a bounded scan, shared by its steps
+struct bounded_scan
+{
+    const uint8_t *end;
+    const uint8_t *limit; // end, or the byte budget if it is smaller
+    size_t max_elements;
+    lookup_result result;
+
+    /// Status of a skip that did not fit before limit
+    lookup_status cut() const { return limit < end ? lookup_status::over_budget : lookup_status::truncated; }
+};
+
+/**
+* Moves current from a container to its member with the given key or element at the given index
+* @return found if the step resolved, why the scan stops otherwise
+*/
+lookup_status step_bounded(const uint8_t *&current, bounded_scan &scan, bool is_key, std::string_view key, uint32_t index)
+{
+    if (current >= scan.end)
+        return lookup_status::truncated;
+
+    // headers near the end are decoded from a zero padded copy
+    uint8_t header[5] = {};
+    std::memcpy(header, current, std::min<size_t>(sizeof(header), scan.end - current));
+
+    uint32_t nmb_elements;
+    size_t header_size;
+
+    if (is_key ? !read_map_header(header, nmb_elements, header_size) : !read_array_header(header, nmb_elements, header_size))
+        return lookup_status::missing;
+
+    if (header_size > static_cast<size_t>(scan.end - current))
+        return lookup_status::truncated;
+
+    current += header_size;
+
+    if (!is_key && index >= nmb_elements)
+        return lookup_status::missing;
+
+    uint32_t nmb_scanned = is_key ? nmb_elements : index + 1;
+
+    for (uint32_t element = 0; element < nmb_scanned; element++)
+    {
+        if (scan.result.elements_scanned >= scan.max_elements)
+            return lookup_status::over_budget;
+
+        scan.result.elements_scanned++;
+
+        if (is_key)
+        {
+            size_t key_size = Msgpack::skip_object_bounded(current, scan.limit);
+            if (!key_size)
+                return scan.cut();
+
+            std::string_view member;
+            bool match = read_str(current, member) && member == key;
+            current += key_size;
+
+            if (match)
+                return lookup_status::found;
+        }
+        else if (element == index)
+            return lookup_status::found;
+
+        size_t value_size = Msgpack::skip_object_bounded(current, scan.limit);
+        if (!value_size)
+            return scan.cut();
+
+        current += value_size;
+    }
+
+    return lookup_status::missing;
+}
+
+/// Completes the result once the steps stopped at current
+lookup_result finish_bounded(const uint8_t *data, const uint8_t *current, bounded_scan &scan, lookup_status status)
+{
+    scan.result.bytes_scanned = current - data;
+
+    if (status == lookup_status::found)
+    {
+        scan.result.value = current;
+        scan.result.size = Msgpack::skip_object_bounded(current, scan.end);
+
+        if (!scan.result.size)
+            status = lookup_status::truncated;
+    }
+
+    scan.result.status = status;
+    return scan.result;
+}
+
+}
+
+lookup_result find_path_bounded(const uint8_t *data, size_t available, const msgpack_path &path, const lookup_budget &budget)
+{
+    bounded_scan scan{data + available, data + std::min(available, budget.max_bytes), budget.max_elements, {}};
+    const uint8_t *current = data;
+    lookup_status status = lookup_status::found;
+
+    for (const path_element &element : path)
+    {
+        status = step_bounded(current, scan, element.type == path_element::kind::key, element.key, element.index);
+        if (status != lookup_status::found)
+            break;
+    }
+
+    return finish_bounded(data, current, scan, status);
+}
+
+lookup_result find_key_bounded(const uint8_t *data, size_t available, std::string_view key, const lookup_budget &budget)
+{
+    bounded_scan scan{data + available, data + std::min(available, budget.max_bytes), budget.max_elements, {}};
+    const uint8_t *current = data;
+
+    return finish_bounded(data, current, scan, step_bounded(current, scan, true, key, 0));
+}
+
+}
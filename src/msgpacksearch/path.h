@@ -0,0 +1,180 @@
+#ifndef MSGPACKSEARCH_PATH_H
+#define MSGPACKSEARCH_PATH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cursor.h"
+
+namespace msgpacksearch {
+
+/**
+ * path_element - one step of a path expression
+ *
+ * type -> whether the step selects a map key or an array index
+ * key -> key to select, for key steps
+ * index -> index to select, for index steps
+ */
+struct path_element
+{
+    enum class kind { key, index };
+
+    kind type;
+    std::string key;
+    uint32_t index = 0;
+};
+
+typedef std::vector<path_element> msgpack_path;
+
+/**
+* Parses a path expression. Keys are separated by '.', array indexes are written in brackets and keys
+* that contain '.', '[' or ']' can be quoted in brackets:
+*
+*     a.b[2].c        ["a.b"].c       [0][1]
+*
+* @param[in] expression the path expression
+* @return The parsed steps, empty for an empty expression (the root)
+* @throws parse_error if the expression is malformed
+*/
+msgpack_path parse_path(std::string_view expression);
+
+/**
+* Follows a parsed path from a cursor
+* @param[in] from the cursor to start at
+* @param[in] path steps to follow
+* @return Cursor on the value, invalid if any step does not resolve
+*/
+Cursor follow_path(Cursor from, const msgpack_path &path);
+
+/**
+ * pattern_element - one step of a path pattern
+ *
+ * type -> whether the step selects a map key, an array index, every member or element, or an array slice
+ * key -> key to select, for key steps
+ * index -> index to select, for index steps; negative indexes count from the end
+ * start / stop / step -> elements start, start + step, ... before stop, for slice steps; negative bounds
+ * count from the end
+ */
+struct pattern_element
+{
+    enum class kind { key, index, wildcard, slice };
+
+    kind type;
+    std::string key;
+    int64_t index = 0;
+    int64_t start = 0;
+    int64_t stop = INT64_MAX;
+    uint32_t step = 1;
+};
+
+typedef std::vector<pattern_element> msgpack_pattern;
+
+/// Receives a value selected by a pattern, returns false to stop the evaluation
+using pattern_visitor = std::function<bool(const Cursor &value)>;
+
+/**
+* Parses a path pattern: a path expression (see parse_path) whose steps may also be a wildcard, a negative
+* index or a slice of an array. A bare * selects every value of a map or element of an array, ["*"] is
+* the key "*". Slice parts are optional, the step must be positive:
+*
+*     items[*].price      metrics.*       items[2:10]     items[-1]       items[::2]      [-3:]
+*
+* @param[in] expression the pattern
+* @return The parsed steps, empty for an empty expression (the root)
+* @throws parse_error if the expression is malformed
+*/
+msgpack_pattern parse_pattern(std::string_view expression);
+
+/**
+* Visits the values selected by a pattern, in document order. Containers are read in one forward pass
+* per step, and no list of the matches is built.
+* @param[in] from the cursor to start at
+* @param[in] pattern steps to follow
+* @param[in] visit called for every selected value
+* @return Number of values visited
+*/
+size_t for_each_match(const Cursor &from, const msgpack_pattern &pattern, const pattern_visitor &visit);
+
+/**
+* Copies cursors on the values selected by a pattern to an output iterator, in document order
+* @param[in] from the cursor to start at
+* @param[in] pattern steps to follow
+* @param[in] out output iterator of Cursor
+* @return The iterator past the last copied cursor
+*/
+template <typename OutputIt>
+OutputIt copy_matches(const Cursor &from, const msgpack_pattern &pattern, OutputIt out)
+{
+    for_each_match(from, pattern, [&out](const Cursor &value) {
+        *out++ = value;
+        return true;
+    });
+
+    return out;
+}
+
+/**
+ * lookup_budget - limits of a bounded lookup
+ *
+ * max_bytes -> bytes from the start of the data that may be scanned to reach the value
+ * max_elements -> map members and array elements that may be examined, across all steps
+ */
+struct lookup_budget
+{
+    size_t max_bytes = SIZE_MAX;
+    size_t max_elements = SIZE_MAX;
+};
+
+/**
+ * lookup_status - outcome of a bounded lookup
+ *
+ * found -> the value is complete in the data
+ * missing -> the path does not resolve
+ * over_budget -> the value was not reached within the budget, the path may still resolve
+ * truncated -> the data ends before the value was reached or before its end
+ */
+enum class lookup_status : uint8_t { found, missing, over_budget, truncated };
+
+/**
+ * lookup_result - outcome of find_path_bounded
+ *
+ * status -> see lookup_status
+ * value / size -> the value for found, NULL / 0 otherwise; truncated values keep their start and a size of 0
+ * bytes_scanned -> offset at which the scan stopped
+ * elements_scanned -> map members and array elements examined
+ */
+struct lookup_result
+{
+    lookup_status status = lookup_status::missing;
+    const uint8_t *value = nullptr;
+    size_t size = 0;
+    size_t bytes_scanned = 0;
+    size_t elements_scanned = 0;
+};
+
+/**
+* Follows a path within a budget, for routing on a few header fields of messages that may be huge or
+* only partly received. The scan stops at the first occurrence of every key and never reads past
+* available bytes or, for the members before the value, past budget.max_bytes.
+* @param[in] data points at the root object
+* @param[in] available number of bytes of the root object that can be read, it may be truncated
+* @param[in] path steps to follow
+* @param[in] budget limits of the scan, unlimited by default
+* @return The value and why the scan stopped
+* @throws parse_error on an invalid type byte within the scanned bytes
+*/
+lookup_result find_path_bounded(const uint8_t *data, size_t available, const msgpack_path &path,
+                                const lookup_budget &budget = lookup_budget());
+
+/**
+* Same, for one key of the root map
+*/
+lookup_result find_key_bounded(const uint8_t *data, size_t available, std::string_view key,
+                               const lookup_budget &budget = lookup_budget());
+
+}
+
+#endif //MSGPACKSEARCH_PATH_H
@@ -0,0 +1,341 @@
+#include "profiler.h"
+#include "msgpacksearch.h"
+#include "decode.h"
+#include "error.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+// trie steps that are not map keys start with a NUL byte, which no path expression can contain
+const std::string array_step("\0[*]", 4);
+const std::string non_string_key_step("\0[?]", 4);
+
+const char *const type_names[] = {"nil", "bool", "uint", "int", "float", "str", "bin", "array", "map", "ext", "invalid"};
+
+/// Appends a step to a path in the parse_path syntax, quoting keys that need it
+void append_step(std::string &path, const std::string &step)
+{
+    if (!step.empty() && step[0] == '\0')
+    {
+        path.append(step, 1, std::string::npos);
+        return;
+    }
+
+    bool bare = !step.empty() && step.find_first_of(".[]\"\\") == std::string::npos;
+
+    if (bare)
+    {
+        if (!path.empty())
+            path += '.';
+        path += step;
+        return;
+    }
+
+    path += "[\"";
+    for (char c : step)
+    {
+        if (c == '"' || c == '\\')
+            path += '\\';
+        path += c;
+    }
+    path += "\"]";
+}
+
+void append_json_string(std::string &out, const std::string &value)
+{
+    out += '"';
+    for (unsigned char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+}
+
+Profiler::Profiler() : _nodes(1) {}
+
+size_t Profiler::child(size_t parent, std::string_view step)
+{
+    auto it = _nodes[parent].children.find(step);
+
+    if (it != _nodes[parent].children.end())
+        return it->second;
+
+    size_t index = _nodes.size();
+    uint32_t depth = _nodes[parent].profile.depth + 1;
+    _nodes[parent].children.emplace(std::string(step), index);
+    _nodes.emplace_back();
+    _nodes.back().profile.depth = depth;
+    _nodes.back().step = std::string(step);
+    return index;
+}
+
+size_t Profiler::member(size_t parent, std::string_view step, uint32_t position)
+{
+    std::vector<size_t> &hints = _nodes[parent].member_hints;
+
+    if (position < hints.size() && hints[position] && _nodes[hints[position]].step == step)
+        return hints[position];
+
+    size_t index = child(parent, step);
+
+    std::vector<size_t> &updated = _nodes[parent].member_hints; // child() may have moved _nodes
+    if (position >= updated.size())
+        updated.resize(position + 1, 0);
+    updated[position] = index;
+
+    return index;
+}
+
+void Profiler::record(size_t node_index, uint8_t type_byte, size_t bytes, const object_header *container, uint32_t key_position)
+{
+    path_profile &profile = _nodes[node_index].profile;
+    profile.count++;
+    profile.types[static_cast<size_t>(type_of(type_byte))]++;
+    profile.total_bytes += bytes;
+    profile.min_bytes = std::min<uint64_t>(profile.min_bytes, bytes);
+    profile.max_bytes = std::max<uint64_t>(profile.max_bytes, bytes);
+
+    if (container)
+    {
+        profile.containers++;
+        profile.total_width += container->nmb_elements;
+        profile.min_width = std::min<uint64_t>(profile.min_width, container->nmb_elements);
+        profile.max_width = std::max<uint64_t>(profile.max_width, container->nmb_elements);
+    }
+
+    if (key_position != UINT32_MAX)
+    {
+        if (key_position >= profile.key_positions.size())
+            profile.key_positions.resize(key_position + 1, 0);
+        profile.key_positions[key_position]++;
+    }
+}
+
+size_t Profiler::profile(const uint8_t *data, size_t size)
+{
+    DocumentWalker<walk_frame> walker(data, size, 0, 1, false, walk_frame{});
+
+    // a container is recorded once its last element is walked, its bytes include the subtree
+    auto close = [this, &walker](const DocumentWalker<walk_frame>::level &closed) {
+        const walk_frame &frame = closed.frame;
+
+        if (frame.node != SIZE_MAX)
+            record(frame.node, frame.header.type, walker.position() - frame.header.position, &frame.header, frame.key_position);
+    };
+
+    do
+    {
+        const object_header &object = walker.next();
+        const auto &parent = walker.parent();
+        const walk_frame &siblings = parent.frame;
+        uint32_t key_position = UINT32_MAX;
+        size_t node_index = 0;
+
+        if (siblings.node != SIZE_MAX && parent.map)
+        {
+            key_position = siblings.header.nmb_elements - parent.remaining;
+            std::string_view key;
+            node_index = read_str(data + object.position - object.key_size, key) ? member(siblings.node, key, key_position)
+                                                                                 : member(siblings.node, non_string_key_step, key_position);
+        }
+        else if (siblings.node != SIZE_MAX)
+        {
+            node_index = siblings.elements;
+        }
+
+        _max_depth = std::max(_max_depth, siblings.depth);
+
+        if (object.container && object.nmb_elements)
+        {
+            size_t elements = object.map ? node_index : child(node_index, array_step);
+            walker.enter(walk_frame{node_index, elements, object, key_position, siblings.depth + 1});
+            continue;
+        }
+
+        record(node_index, object.type, object.header + object.payload, object.container ? &object : nullptr, key_position);
+        walker.skip(close);
+    }
+    while (!walker.done());
+
+    _documents++;
+    return walker.position();
+}
+
+size_t Profiler::profile_stream(const uint8_t *data, size_t size)
+{
+    size_t offset = 0;
+    size_t documents = 0;
+
+    while (offset < size)
+    {
+        offset += profile(data + offset, size - offset);
+        documents++;
+    }
+
+    return documents;
+}
+
+void Profiler::collect(size_t node_index, const std::string &path, std::map<std::string, path_profile> &out) const
+{
+    const node &current = _nodes[node_index];
+
+    if (current.profile.count)
+        out.emplace(path, current.profile);
+
+    for (const auto &[step, child_index] : current.children)
+    {
+        std::string child_path = path;
+        append_step(child_path, step);
+        collect(child_index, child_path, out);
+    }
+}
+
+std::map<std::string, path_profile> Profiler::paths() const
+{
+    std::map<std::string, path_profile> out;
+    collect(0, "", out);
+    return out;
+}
+
+std::string Profiler::report() const
+{
+    std::string out;
+    char line[256];
+
+    std::snprintf(line, sizeof(line), "documents: %llu, max depth: %u\n",
+                  (unsigned long long)_documents, _max_depth);
+    out += line;
+
+    for (const auto &[path, profile] : paths())
+    {
+        out += path.empty() ? "$" : path;
+
+        std::snprintf(line, sizeof(line), "  count=%llu depth=%u bytes(avg/min/max)=%.1f/%llu/%llu",
+                      (unsigned long long)profile.count, profile.depth, (double)profile.total_bytes / profile.count,
+                      (unsigned long long)profile.min_bytes, (unsigned long long)profile.max_bytes);
+        out += line;
+
+        if (profile.containers)
+        {
+            std::snprintf(line, sizeof(line), " width(avg/min/max)=%.1f/%llu/%llu",
+                          (double)profile.total_width / profile.containers,
+                          (unsigned long long)profile.min_width, (unsigned long long)profile.max_width);
+            out += line;
+        }
+
+        out += " types=";
+        bool first = true;
+        for (size_t type = 0; type < profile.types.size(); type++)
+        {
+            if (!profile.types[type])
+                continue;
+            std::snprintf(line, sizeof(line), "%s%s:%llu", first ? "" : ",", type_names[type], (unsigned long long)profile.types[type]);
+            out += line;
+            first = false;
+        }
+
+        if (!profile.key_positions.empty())
+        {
+            out += " positions=";
+            first = true;
+            for (size_t position = 0; position < profile.key_positions.size(); position++)
+            {
+                if (!profile.key_positions[position])
+                    continue;
+                std::snprintf(line, sizeof(line), "%s%zu:%llu", first ? "" : ",", position, (unsigned long long)profile.key_positions[position]);
+                out += line;
+                first = false;
+            }
+        }
+
+        out += '\n';
+    }
+
+    return out;
+}
+
+std::string Profiler::report_json() const
+{
+    std::string out = "{\"documents\":" + std::to_string(_documents) + ",\"max_depth\":" + std::to_string(_max_depth) + ",\"paths\":[";
+    bool first_path = true;
+
+    for (const auto &[path, profile] : paths())
+    {
+        if (!first_path)
+            out += ',';
+        first_path = false;
+
+        out += "{\"path\":";
+        append_json_string(out, path);
+        out += ",\"count\":" + std::to_string(profile.count);
+        out += ",\"depth\":" + std::to_string(profile.depth);
+        out += ",\"bytes\":{\"total\":" + std::to_string(profile.total_bytes) +
+               ",\"min\":" + std::to_string(profile.min_bytes) +
+               ",\"max\":" + std::to_string(profile.max_bytes) + "}";
+
+        if (profile.containers)
+        {
+            out += ",\"width\":{\"containers\":" + std::to_string(profile.containers) +
+                   ",\"total\":" + std::to_string(profile.total_width) +
+                   ",\"min\":" + std::to_string(profile.min_width) +
+                   ",\"max\":" + std::to_string(profile.max_width) + "}";
+        }
+
+        out += ",\"types\":{";
+        bool first = true;
+        for (size_t type = 0; type < profile.types.size(); type++)
+        {
+            if (!profile.types[type])
+                continue;
+            if (!first)
+                out += ',';
+            out += std::string("\"") + type_names[type] + "\":" + std::to_string(profile.types[type]);
+            first = false;
+        }
+        out += '}';
+
+        if (!profile.key_positions.empty())
+        {
+            out += ",\"key_positions\":{";
+            first = true;
+            for (size_t position = 0; position < profile.key_positions.size(); position++)
+            {
+                if (!profile.key_positions[position])
+                    continue;
+                if (!first)
+                    out += ',';
+                out += "\"" + std::to_string(position) + "\":" + std::to_string(profile.key_positions[position]);
+                first = false;
+            }
+            out += '}';
+        }
+
+        out += '}';
+    }
+
+    out += "]}";
+    return out;
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef MSGPACKSEARCH_PROFILER_H
+#define MSGPACKSEARCH_PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "decode.h"
+#include "types.h"
+
+namespace msgpacksearch {
+
+/**
+ * path_profile - statistics of every object found at one path
+ *
+ * count -> number of objects seen at the path
+ * types -> histogram of the object families, indexed by msgpack_type
+ * total_bytes / min_bytes / max_bytes -> encoded size of the objects, containers included their subtree
+ * total_width / min_width / max_width -> element counts, for the maps and arrays at the path
+ * containers -> number of maps and arrays at the path (denominator of total_width)
+ * depth -> nesting depth of the path, the root is 0
+ * key_positions -> number of times the key was seen at each position of its parent map, indexed by position
+ */
+struct path_profile
+{
+    uint64_t count = 0;
+    std::array<uint64_t, static_cast<size_t>(msgpack_type::invalid) + 1> types{};
+    uint64_t total_bytes = 0;
+    uint64_t min_bytes = UINT64_MAX;
+    uint64_t max_bytes = 0;
+    uint64_t containers = 0;
+    uint64_t total_width = 0;
+    uint64_t min_width = UINT64_MAX;
+    uint64_t max_width = 0;
+    uint32_t depth = 0;
+    std::vector<uint64_t> key_positions;
+};
+
+/**
+ * @brief One pass shape profiler over msgpack documents.
+ *
+ * Walks every object once, visiting scalars with the same type dispatch as skip_object, and aggregates
+ * per-path statistics across all profiled documents. Paths use the parse_path syntax with `[*]` standing
+ * for every element of an array, e.g. `items[*].price`; the root is the empty path. The report is meant
+ * to drive indexing decisions: wide maps are hash index candidates, long arrays offset index candidates,
+ * and key_positions shows which fields could move to the front of their maps.
+ */
+class Profiler {
+
+public:
+
+    Profiler();
+
+    /**
+    * Profiles one document
+    * @param[in] data points at the document
+    * @param[in] size number of bytes available at data
+    * @return Number of bytes of the document
+    * @throws parse_error on an invalid type byte or a document running past size
+    */
+    size_t profile(const uint8_t *data, size_t size);
+
+    /**
+    * Profiles a stream of concatenated documents
+    * @param[in] data points at the first document
+    * @param[in] size number of bytes in the stream
+    * @return Number of documents profiled
+    */
+    size_t profile_stream(const uint8_t *data, size_t size);
+
+    /// Number of documents profiled so far
+    uint64_t documents() const { return _documents; }
+
+    /// Deepest nesting seen in any document
+    uint32_t max_depth() const { return _max_depth; }
+
+    /// Statistics of every path seen so far, sorted by path
+    std::map<std::string, path_profile> paths() const;
+
+    /// Human readable report, one line per path
+    std::string report() const;
+
+    /// The same statistics as a JSON document, for tooling
+    std::string report_json() const;
+
+private:
+    struct node
+    {
+        path_profile profile;
+        std::string step; // key, or a marker for array elements and non-string keys
+        std::map<std::string, size_t, std::less<>> children;
+        std::vector<size_t> member_hints; // child last seen at each map position, homogeneous maps skip the lookup
+    };
+
+    size_t child(size_t parent, std::string_view step);
+    size_t member(size_t parent, std::string_view step, uint32_t position);
+    /**
+     * walk_frame - container being profiled
+     *
+     * node -> trie node of the container, SIZE_MAX for the document itself
+     * elements -> trie node of its elements for arrays, the container's for maps
+     * header -> header of the container
+     * key_position -> position of the container in its parent map, UINT32_MAX outside of maps
+     * depth -> nesting depth of the elements
+     */
+    struct walk_frame
+    {
+        size_t node = SIZE_MAX;
+        size_t elements = 0;
+        object_header header;
+        uint32_t key_position = UINT32_MAX;
+        uint32_t depth = 0;
+    };
+
+    /// Adds an object to the statistics of a node, container is NULL for scalars
+    void record(size_t node_index, uint8_t type_byte, size_t bytes, const object_header *container, uint32_t key_position);
+    void collect(size_t node_index, const std::string &path, std::map<std::string, path_profile> &out) const;
+
+    std::vector<node> _nodes; // path trie, _nodes[0] is the root
+    uint64_t _documents = 0;
+    uint32_t _max_depth = 0;
+};
+
+}
+
+#endif //MSGPACKSEARCH_PROFILER_H
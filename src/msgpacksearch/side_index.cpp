@@ -0,0 +1,618 @@
+#include "side_index.h"
+#include "decode.h"
+#include "error.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+namespace msgpacksearch
+{
+
+namespace side_index_format {
+
+constexpr char magic[8] = {'M', 'S', 'G', 'P', 'I', 'D', 'X', '\0'};
+constexpr uint32_t byte_order_mark = 0x01020304;
+
+/**
+ * The index file is the header followed by five packed sections, in this order:
+ *
+ *     uint64_t documents[nmb_documents + 1]   document boundaries, the last one is the data size
+ *     map_entry maps[nmb_maps]                 sorted by offset
+ *     key_slot slots[nmb_slots]                open addressing tables, one per map entry
+ *     array_entry arrays[nmb_arrays]           sorted by offset
+ *     uint64_t checkpoints[nmb_checkpoints]    element offsets, checkpoint_interval apart
+ *
+ * Offsets are byte offsets into the data file, except key_slot::key_offset which is relative to its map.
+ */
+struct file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t data_size;
+    int64_t data_mtime_ns;
+    uint64_t data_hash; // SideIndex::sample_hash of the data file
+    uint32_t checkpoint_interval;
+    uint32_t reserved;
+    uint64_t nmb_documents;
+    uint64_t nmb_maps;
+    uint64_t nmb_slots;
+    uint64_t nmb_arrays;
+    uint64_t nmb_checkpoints;
+    uint64_t payload_hash; // xxhash64 of the sections
+    uint64_t header_hash; // xxhash64 of the header up to this field
+};
+
+struct map_entry
+{
+    uint64_t offset;
+    uint64_t first_slot;
+    uint32_t nmb_slots; // power of two, 0 if the map has no string keys or is too large for key_slot
+    uint32_t nmb_elements;
+};
+
+struct key_slot
+{
+    uint32_t hash_tag; // upper half of the xxhash64 of the key payload, the lower half picks the slot
+    uint32_t key_offset; // from the start of the map, 0 for an empty slot
+};
+
+struct array_entry
+{
+    uint64_t offset;
+    uint64_t first_checkpoint;
+    uint32_t nmb_checkpoints;
+    uint32_t nmb_elements;
+};
+
+static_assert(sizeof(file_header) % 8 == 0 && sizeof(map_entry) % 8 == 0 &&
+              sizeof(key_slot) % 8 == 0 && sizeof(array_entry) % 8 == 0, "sections must stay 8 byte aligned");
+
+}
+
+using namespace side_index_format;
+
+namespace {
+
+/// Walks the documents of a data file and collects the sections of its index
+class IndexBuilder {
+
+public:
+    IndexBuilder(const uint8_t *data, size_t size, const side_index_options &options) :
+        _base(data), _end(data + size), _options(options) {}
+
+    void run()
+    {
+        size_t offset = 0;
+
+        while (_base + offset < _end)
+        {
+            documents.push_back(offset);
+            offset += walk(_base + offset);
+        }
+
+        documents.push_back(offset);
+    }
+
+    std::vector<uint64_t> documents;
+    std::vector<map_entry> maps;
+    std::vector<key_slot> slots;
+    std::vector<array_entry> arrays;
+    std::vector<uint64_t> checkpoints;
+
+private:
+    size_t walk(const uint8_t *start)
+    {
+        if (start >= _end)
+            throw parse_error("Truncated document", start - _base);
+
+        if (type_of(*start) == msgpack_type::invalid)
+            throw parse_error("Invalid type byte", start - _base);
+
+        // headers near the end of the mapping are decoded from a zero padded copy, never past the mapping
+        uint8_t padded[9] = {};
+        const uint8_t *header = start;
+
+        if (_end - start < static_cast<ptrdiff_t>(sizeof(padded)))
+        {
+            std::memcpy(padded, start, _end - start);
+            header = padded;
+        }
+
+        uint32_t nmb_elements;
+        size_t header_size;
+        size_t bytes;
+
+        if (read_map_header(header, nmb_elements, header_size))
+            bytes = walk_map(start, nmb_elements, header_size);
+        else if (read_array_header(header, nmb_elements, header_size))
+            bytes = walk_array(start, nmb_elements, header_size);
+        else
+            bytes = Msgpack::skip_object(header);
+
+        if (bytes > static_cast<size_t>(_end - start))
+            throw parse_error("Truncated document", _end - _base);
+
+        return bytes;
+    }
+
+    size_t walk_map(const uint8_t *start, uint32_t nmb_elements, size_t bytes)
+    {
+        bool indexed = nmb_elements >= _options.min_map_keys;
+        size_t entry = maps.size();
+        std::vector<std::pair<uint64_t, uint64_t>> keys; // hash, key offset
+
+        // the entry is pushed before the children, so the maps section stays sorted by offset
+        if (indexed)
+            maps.push_back(map_entry{static_cast<uint64_t>(start - _base), 0, 0, nmb_elements});
+
+        for (uint32_t element_count = 0; element_count < nmb_elements; element_count++)
+        {
+            const uint8_t *key = start + bytes;
+            std::string_view key_str;
+
+            bytes += walk(key);
+
+            if (indexed && read_str(key, key_str))
+                keys.emplace_back(xxhash64(key_str.data(), key_str.size()), key - start);
+
+            bytes += walk(start + bytes);
+        }
+
+        // maps past 4GB keep their entry without a table, lookups scan them
+        if (indexed && !keys.empty() && keys.back().second <= UINT32_MAX)
+        {
+            // load factor of at most 2/3
+            uint32_t nmb_slots = 1;
+            while (2 * nmb_slots < 3 * keys.size())
+                nmb_slots <<= 1;
+
+            maps[entry].first_slot = slots.size();
+            maps[entry].nmb_slots = nmb_slots;
+            slots.resize(slots.size() + nmb_slots, key_slot{0, 0});
+
+            key_slot *table = &slots[maps[entry].first_slot];
+
+            // insertion in document order keeps the first of duplicate keys first on the probe sequence
+            for (const auto &[hash, key_offset] : keys)
+            {
+                uint32_t slot = hash & (nmb_slots - 1);
+                while (table[slot].key_offset)
+                    slot = (slot + 1) & (nmb_slots - 1);
+                table[slot] = key_slot{static_cast<uint32_t>(hash >> 32), static_cast<uint32_t>(key_offset)};
+            }
+        }
+
+        return bytes;
+    }
+
+    size_t walk_array(const uint8_t *start, uint32_t nmb_elements, size_t bytes)
+    {
+        bool indexed = nmb_elements >= _options.min_array_elements;
+        size_t entry = arrays.size();
+        std::vector<uint64_t> local_checkpoints;
+
+        if (indexed)
+            arrays.push_back(array_entry{static_cast<uint64_t>(start - _base), 0, 0, nmb_elements});
+
+        for (uint32_t element_count = 0; element_count < nmb_elements; element_count++)
+        {
+            if (indexed && element_count % _options.checkpoint_interval == 0)
+                local_checkpoints.push_back(start + bytes - _base);
+
+            bytes += walk(start + bytes);
+        }
+
+        if (indexed)
+        {
+            arrays[entry].first_checkpoint = checkpoints.size();
+            arrays[entry].nmb_checkpoints = local_checkpoints.size();
+            checkpoints.insert(checkpoints.end(), local_checkpoints.begin(), local_checkpoints.end());
+        }
+
+        return bytes;
+    }
+
+    const uint8_t *const _base;
+    const uint8_t *const _end;
+    const side_index_options &_options;
+};
+
+template <typename T>
+void append_section(std::vector<uint8_t> &out, const std::vector<T> &section)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(section.data());
+    out.insert(out.end(), bytes, bytes + section.size() * sizeof(T));
+}
+
+void write_file(const std::string &path, const void *header, size_t header_size, const std::vector<uint8_t> &payload)
+{
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+
+    if (!file)
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+
+    bool ok = std::fwrite(header, 1, header_size, file) == header_size &&
+              std::fwrite(payload.data(), 1, payload.size(), file) == payload.size() &&
+              std::fflush(file) == 0 && ::fsync(fileno(file)) == 0;
+    int error = errno;
+
+    if (std::fclose(file) != 0 && ok)
+    {
+        ok = false;
+        error = errno;
+    }
+
+    if (!ok)
+    {
+        std::remove(path.c_str());
+        throw std::system_error(error, std::generic_category(), "write " + path);
+    }
+}
+
+}
+
+std::string SideIndex::default_path(const std::string &data_path)
+{
+    return data_path + ".msidx";
+}
+
+uint64_t SideIndex::sample_hash(const uint8_t *data, size_t size)
+{
+    constexpr size_t block_size = 64 * 1024;
+    constexpr size_t nmb_blocks = 16;
+
+    if (size <= block_size * nmb_blocks)
+        return xxhash64(data, size, size);
+
+    // evenly spaced blocks, the first and the last included
+    uint64_t hash = size;
+
+    for (size_t block = 0; block < nmb_blocks; block++)
+        hash = xxhash64(data + (size - block_size) * block / (nmb_blocks - 1), block_size, hash);
+
+    return hash;
+}
+
+size_t SideIndex::build(const std::string &data_path, const std::string &index_path, const side_index_options &options)
+{
+    MappedFile data(data_path);
+
+    side_index_options checked = options;
+    checked.checkpoint_interval = std::max<uint32_t>(checked.checkpoint_interval, 1);
+
+    IndexBuilder builder(data.data(), data.size(), checked);
+    builder.run();
+
+    std::vector<uint8_t> payload;
+    append_section(payload, builder.documents);
+    append_section(payload, builder.maps);
+    append_section(payload, builder.slots);
+    append_section(payload, builder.arrays);
+    append_section(payload, builder.checkpoints);
+
+    file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = byte_order_mark;
+    header.data_size = data.size();
+    header.data_mtime_ns = data.mtime_ns();
+    header.data_hash = sample_hash(data.data(), data.size());
+    header.checkpoint_interval = checked.checkpoint_interval;
+    header.nmb_documents = builder.documents.size() - 1;
+    header.nmb_maps = builder.maps.size();
+    header.nmb_slots = builder.slots.size();
+    header.nmb_arrays = builder.arrays.size();
+    header.nmb_checkpoints = builder.checkpoints.size();
+    header.payload_hash = xxhash64(payload.data(), payload.size());
+    header.header_hash = xxhash64(&header, offsetof(file_header, header_hash));
+
+    // readers either see the previous index or the complete new one
+    std::string temporary = index_path + ".tmp";
+    write_file(temporary, &header, sizeof(header), payload);
+
+    if (std::rename(temporary.c_str(), index_path.c_str()) != 0)
+    {
+        int error = errno;
+        std::remove(temporary.c_str());
+        throw std::system_error(error, std::generic_category(), "rename " + temporary);
+    }
+
+    return header.nmb_documents;
+}
+
+side_index_status SideIndex::validate(const MappedFile &data, const MappedFile &index)
+{
+    file_header header;
+
+    if (index.size() < sizeof(header))
+        return index.size() >= sizeof(magic) && std::memcmp(index.data(), magic, sizeof(magic)) == 0 ?
+               side_index_status::corrupt : side_index_status::bad_format;
+
+    std::memcpy(&header, index.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version || header.byte_order != byte_order_mark)
+        return side_index_status::bad_format;
+
+    if (header.header_hash != xxhash64(&header, offsetof(file_header, header_hash)))
+        return side_index_status::corrupt;
+
+    // bound the counts by the file size before multiplying them
+    const uint64_t limit = index.size();
+
+    if (header.nmb_documents >= limit || header.nmb_maps > limit || header.nmb_slots > limit ||
+        header.nmb_arrays > limit || header.nmb_checkpoints > limit)
+        return side_index_status::corrupt;
+
+    uint64_t payload_size = (header.nmb_documents + 1) * sizeof(uint64_t) +
+                            header.nmb_maps * sizeof(map_entry) +
+                            header.nmb_slots * sizeof(key_slot) +
+                            header.nmb_arrays * sizeof(array_entry) +
+                            header.nmb_checkpoints * sizeof(uint64_t);
+
+    if (sizeof(header) + payload_size != index.size())
+        return side_index_status::corrupt;
+
+    if (header.payload_hash != xxhash64(index.data() + sizeof(header), payload_size))
+        return side_index_status::corrupt;
+
+    if (header.data_size != data.size() || header.data_mtime_ns != data.mtime_ns() ||
+        header.data_hash != sample_hash(data.data(), data.size()))
+        return side_index_status::stale;
+
+    return side_index_status::ok;
+}
+
+side_index_status SideIndex::check(const std::string &data_path, const std::string &index_path)
+{
+    side_index_status status;
+    open(data_path, index_path, &status);
+    return status;
+}
+
+std::unique_ptr<SideIndex> SideIndex::open(const std::string &data_path, const std::string &index_path, side_index_status *status)
+{
+    side_index_status ignored;
+    side_index_status &result = status ? *status : ignored;
+
+    MappedFile data(data_path);
+    MappedFile index;
+
+    try
+    {
+        index = MappedFile(index_path);
+    }
+    catch (const std::system_error &e)
+    {
+        if (e.code() != std::errc::no_such_file_or_directory)
+            throw;
+
+        result = side_index_status::missing;
+        return nullptr;
+    }
+
+    result = validate(data, index);
+
+    if (result != side_index_status::ok)
+        return nullptr;
+
+    return std::unique_ptr<SideIndex>(new SideIndex(std::move(data), std::move(index)));
+}
+
+std::unique_ptr<SideIndex> SideIndex::open_or_build(const std::string &data_path, const std::string &index_path, const side_index_options &options)
+{
+    std::unique_ptr<SideIndex> opened = open(data_path, index_path);
+
+    if (opened)
+        return opened;
+
+    build(data_path, index_path, options);
+    opened = open(data_path, index_path);
+
+    if (!opened)
+        throw std::system_error(std::make_error_code(std::errc::io_error), "data file changed while indexing " + data_path);
+
+    return opened;
+}
+
+SideIndex::SideIndex(MappedFile &&data, MappedFile &&index) : _data(std::move(data)), _index(std::move(index))
+{
+    const uint8_t *section = _index.data();
+
+    _header = reinterpret_cast<const file_header *>(section);
+    section += sizeof(file_header);
+    _documents = reinterpret_cast<const uint64_t *>(section);
+    section += (_header->nmb_documents + 1) * sizeof(uint64_t);
+    _maps = reinterpret_cast<const map_entry *>(section);
+    section += _header->nmb_maps * sizeof(map_entry);
+    _slots = reinterpret_cast<const key_slot *>(section);
+    section += _header->nmb_slots * sizeof(key_slot);
+    _arrays = reinterpret_cast<const array_entry *>(section);
+    section += _header->nmb_arrays * sizeof(array_entry);
+    _checkpoints = reinterpret_cast<const uint64_t *>(section);
+}
+
+size_t SideIndex::documents() const
+{
+    return _header->nmb_documents;
+}
+
+size_t SideIndex::document_offset(size_t document) const
+{
+    return _documents[document];
+}
+
+size_t SideIndex::document_size(size_t document) const
+{
+    return _documents[document + 1] - _documents[document];
+}
+
+Msgpack SideIndex::document(size_t document) const
+{
+    return Msgpack(_data.data() + document_offset(document), document_size(document));
+}
+
+size_t SideIndex::indexed_maps() const
+{
+    return _header->nmb_maps;
+}
+
+size_t SideIndex::indexed_arrays() const
+{
+    return _header->nmb_arrays;
+}
+
+const map_entry* SideIndex::find_map(size_t offset) const
+{
+    const map_entry *end = _maps + _header->nmb_maps;
+    const map_entry *it = std::lower_bound(_maps, end, offset,
+                                           [](const map_entry &entry, size_t value) { return entry.offset < value; });
+
+    return it != end && it->offset == offset ? it : nullptr;
+}
+
+const array_entry* SideIndex::find_array(size_t offset) const
+{
+    const array_entry *end = _arrays + _header->nmb_arrays;
+    const array_entry *it = std::lower_bound(_arrays, end, offset,
+                                             [](const array_entry &entry, size_t value) { return entry.offset < value; });
+
+    return it != end && it->offset == offset ? it : nullptr;
+}
+
+const uint8_t* SideIndex::find_map_key(const uint8_t *map, std::string_view key) const
+{
+    return find_map_key(map, key, nullptr);
+}
+
+const uint8_t* SideIndex::find_map_key(const uint8_t *map, std::string_view key, PageTracker *pages) const
+{
+    const uint8_t *base = _data.data();
+    const map_entry *entry = map >= base && map < base + _data.size() ? find_map(map - base) : nullptr;
+
+    if (!entry || !entry->nmb_slots)
+    {
+        Cursor cursor(map, base + _data.size() - map);
+        Cursor found = cursor.child(key);
+
+        // the scan reads up to the value, or the whole map when the key is missing
+        if (pages)
+            pages->touch(map - base, found ? found.data() - map + 1 : cursor.is_map() ? cursor.length() : 1);
+
+        return found ? found.data() : nullptr;
+    }
+
+    const key_slot *table = _slots + entry->first_slot;
+    const uint32_t mask = entry->nmb_slots - 1;
+    const uint64_t hash = xxhash64(key.data(), key.size());
+    const uint32_t hash_tag = hash >> 32;
+
+    for (uint32_t slot = hash & mask; table[slot].key_offset; slot = (slot + 1) & mask)
+    {
+        if (table[slot].hash_tag != hash_tag)
+            continue;
+
+        std::string_view candidate;
+        const uint8_t *key_start = map + table[slot].key_offset;
+        const size_t key_size = Msgpack::skip_object(key_start);
+
+        if (pages)
+            pages->touch(key_start - base, key_size + 1);
+
+        if (read_str(key_start, candidate) && candidate == key)
+            return key_start + key_size;
+    }
+
+    return nullptr;
+}
+
+const uint8_t* SideIndex::find_array_index(const uint8_t *array, uint32_t index) const
+{
+    return find_array_index(array, index, nullptr);
+}
+
+const uint8_t* SideIndex::find_array_index(const uint8_t *array, uint32_t index, PageTracker *pages) const
+{
+    const uint8_t *base = _data.data();
+    const array_entry *entry = array >= base && array < base + _data.size() ? find_array(array - base) : nullptr;
+
+    if (!entry)
+    {
+        Cursor cursor(array, base + _data.size() - array);
+        Cursor found = cursor.is_array() ? cursor.at(index) : Cursor();
+
+        if (pages)
+            pages->touch(array - base, found ? found.data() - array + 1 : 1);
+
+        return found ? found.data() : nullptr;
+    }
+
+    if (index >= entry->nmb_elements)
+        return nullptr;
+
+    const uint32_t interval = _header->checkpoint_interval;
+    const uint64_t checkpoint = entry->first_checkpoint + index / interval;
+    const uint8_t *start = base + _checkpoints[checkpoint];
+    const uint8_t *current = start;
+
+    // the next checkpoint bounds the bytes skipped to reach the element
+    if (pages && index / interval + 1 < entry->nmb_checkpoints)
+        pages->prefetch(_checkpoints[checkpoint], _checkpoints[checkpoint + 1] - _checkpoints[checkpoint]);
+
+    for (uint32_t element_count = 0; element_count < index % interval; element_count++)
+        current += Msgpack::skip_object(current);
+
+    if (pages)
+        pages->touch(start - base, current - start + 1);
+
+    return current;
+}
+
+const uint8_t* SideIndex::find_path(size_t document, const msgpack_path &path) const
+{
+    return find_path(document, path, nullptr);
+}
+
+const uint8_t* SideIndex::find_path(size_t document, const std::string &path) const
+{
+    return find_path(document, parse_path(path), nullptr);
+}
+
+const uint8_t* SideIndex::find_path(size_t document, const msgpack_path &path, PageTracker &pages) const
+{
+    pages.begin_query();
+    return find_path(document, path, &pages);
+}
+
+const uint8_t* SideIndex::find_path(size_t document, const std::string &path, PageTracker &pages) const
+{
+    return find_path(document, parse_path(path), pages);
+}
+
+const uint8_t* SideIndex::find_path(size_t document, const msgpack_path &path, PageTracker *pages) const
+{
+    const uint8_t *current = _data.data() + document_offset(document);
+
+    for (const path_element &element : path)
+    {
+        if (element.type == path_element::kind::key)
+            current = find_map_key(current, element.key, pages);
+        else
+            current = find_array_index(current, element.index, pages);
+
+        if (!current)
+            return nullptr;
+    }
+
+    return current;
+}
+
+}
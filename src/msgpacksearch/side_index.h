@@ -0,0 +1,201 @@
+#ifndef MSGPACKSEARCH_SIDE_INDEX_H
+#define MSGPACKSEARCH_SIDE_INDEX_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.h"
+#include "msgpacksearch.h"
+#include "path.h"
+
+namespace msgpacksearch {
+
+/// On-disk layout of the index file, defined in side_index.cpp
+namespace side_index_format {
+struct file_header;
+struct map_entry;
+struct key_slot;
+struct array_entry;
+}
+
+/**
+ * side_index_options - what SideIndex::build indexes
+ *
+ * min_map_keys -> maps with at least this many pairs get a key hash table, smaller maps are scanned
+ * min_array_elements -> arrays with at least this many elements get checkpoints, smaller arrays are skipped through
+ * checkpoint_interval -> number of elements between two array checkpoints
+ */
+struct side_index_options
+{
+    uint32_t min_map_keys = 32;
+    uint32_t min_array_elements = 64;
+    uint32_t checkpoint_interval = 32;
+};
+
+/**
+ * side_index_status - outcome of validating an index file against its data file
+ *
+ * ok -> the index describes the data file
+ * missing -> there is no index file
+ * bad_format -> not an index file, or a version / byte order this build does not read
+ * corrupt -> header or payload checksum mismatch, or truncated sections
+ * stale -> the data file changed (size, modification time or sampled content hash) since the index was built
+ */
+enum class side_index_status : uint8_t { ok, missing, bad_format, corrupt, stale };
+
+/**
+ * @brief Persistent index of a file of concatenated msgpack documents, stored next to the data file.
+ *
+ * The index holds the document boundaries, a hash table of the keys of every large map and offset
+ * checkpoints of every large array. Both files are mmapped on open, so opening costs one pass over
+ * the (small) index for its checksum and no pass over the data. Every lookup falls back to a
+ * linear scan for maps and arrays that were too small to be indexed.
+ *
+ * The index records the size, modification time and a sampled hash of the data file, open() refuses
+ * an index that no longer matches. Files are written in host byte order.
+ */
+class SideIndex {
+
+public:
+
+    /// Format version written by this build
+    static constexpr uint32_t version = 1;
+
+    /// Conventional index path for a data file: data_path + ".msidx"
+    static std::string default_path(const std::string &data_path);
+
+    /**
+    * Scans a data file and writes its index, atomically replacing any previous index
+    * @param[in] data_path file of concatenated msgpack documents
+    * @param[in] index_path path of the index file
+    * @param[in] options what to index
+    * @return Number of documents in the data file
+    * @throws std::system_error if a file cannot be read or written
+    * @throws parse_error if the data file is not a sequence of valid documents
+    */
+    static size_t build(const std::string &data_path, const std::string &index_path, const side_index_options &options = {});
+
+    /**
+    * Validates an index against its data file
+    * @param[in] data_path the data file
+    * @param[in] index_path the index file
+    * @return side_index_status::ok if open() would accept the index
+    * @throws std::system_error if the data file cannot be mapped
+    */
+    static side_index_status check(const std::string &data_path, const std::string &index_path);
+
+    /**
+    * Maps a data file and its index
+    * @param[in] data_path the data file
+    * @param[in] index_path the index file
+    * @param[out] status why the index was refused, may be NULL
+    * @return The opened index, or nullptr if the index is missing or does not validate
+    * @throws std::system_error if the data file cannot be mapped
+    */
+    static std::unique_ptr<SideIndex> open(const std::string &data_path, const std::string &index_path, side_index_status *status = nullptr);
+
+    /**
+    * Opens an index, (re)building it first if it is missing or does not validate
+    * @param[in] data_path the data file
+    * @param[in] index_path the index file
+    * @param[in] options what to index, if the index has to be built
+    * @return The opened index
+    * @throws std::system_error, parse_error as build()
+    */
+    static std::unique_ptr<SideIndex> open_or_build(const std::string &data_path, const std::string &index_path, const side_index_options &options = {});
+
+    SideIndex(const SideIndex &other) = delete;
+    SideIndex& operator=(const SideIndex &other) = delete;
+
+    /// Number of documents in the data file
+    size_t documents() const;
+
+    /// Offset of a document in the data file
+    size_t document_offset(size_t document) const;
+
+    /// Encoded size of a document
+    size_t document_size(size_t document) const;
+
+    /**
+    * View of one document
+    * @param[in] document index of the document, < documents()
+    * @return Msgpack reading the mapped data file
+    */
+    Msgpack document(size_t document) const;
+
+    /// Number of maps with a key hash table
+    size_t indexed_maps() const;
+
+    /// Number of arrays with checkpoints
+    size_t indexed_arrays() const;
+
+    /// The mapped data file
+    const MappedFile& data_file() const { return _data; }
+
+    /**
+    * Finds the value of a key in a map of the data file, through its hash table if the map is indexed
+    * @param[in] map points at a map inside the mapped data file
+    * @param[in] key key to search for
+    * @return The location of the value, or NULL if the key is missing or map is not a map
+    */
+    const uint8_t* find_map_key(const uint8_t *map, std::string_view key) const;
+
+    /**
+    * Finds an element of an array of the data file, skipping from the nearest checkpoint if the array is indexed
+    * @param[in] array points at an array inside the mapped data file
+    * @param[in] index index of the element
+    * @return The location of the element, or NULL if out of range or array is not an array
+    */
+    const uint8_t* find_array_index(const uint8_t *array, uint32_t index) const;
+
+    /**
+    * Follows a path from the root of a document, see parse_path
+    * @param[in] document index of the document
+    * @param[in] path steps to follow
+    * @return The location of the value, or NULL if the path does not resolve
+    */
+    const uint8_t* find_path(size_t document, const msgpack_path &path) const;
+    const uint8_t* find_path(size_t document, const std::string &path) const;
+
+    /**
+    * Follows a path within the memory budget of a tracker over data_file(), for data files larger than
+    * memory. The lookup starts a query on the tracker, records the pages it reads up to the first byte
+    * of the value, and prefetches the range between two checkpoints of an array in one request.
+    * @param[in] document index of the document
+    * @param[in] path steps to follow
+    * @param[in,out] pages tracker of data_file(), pages.pages_touched() reports the pages of the lookup
+    * @return The location of the value, or NULL if the path does not resolve
+    */
+    const uint8_t* find_path(size_t document, const msgpack_path &path, PageTracker &pages) const;
+    const uint8_t* find_path(size_t document, const std::string &path, PageTracker &pages) const;
+
+private:
+    SideIndex(MappedFile &&data, MappedFile &&index);
+
+    static side_index_status validate(const MappedFile &data, const MappedFile &index);
+    static uint64_t sample_hash(const uint8_t *data, size_t size);
+
+    const side_index_format::map_entry* find_map(size_t offset) const;
+    const side_index_format::array_entry* find_array(size_t offset) const;
+
+    /// Lookups of the public find_* functions, recording the pages they read in pages if it is set
+    const uint8_t* find_map_key(const uint8_t *map, std::string_view key, PageTracker *pages) const;
+    const uint8_t* find_array_index(const uint8_t *array, uint32_t index, PageTracker *pages) const;
+    const uint8_t* find_path(size_t document, const msgpack_path &path, PageTracker *pages) const;
+
+    MappedFile _data;
+    MappedFile _index;
+    const side_index_format::file_header *_header;
+    const uint64_t *_documents; // nmb_documents + 1 boundaries
+    const side_index_format::map_entry *_maps; // sorted by offset
+    const side_index_format::key_slot *_slots;
+    const side_index_format::array_entry *_arrays; // sorted by offset
+    const uint64_t *_checkpoints;
+};
+
+}
+
+#endif //MSGPACKSEARCH_SIDE_INDEX_H
@@ -0,0 +1,328 @@
+#include "stream_parser.h"
+#include "decode.h"
+#include "error.h"
+#include "msgpacksearch.h"
+
+#include <algorithm>
+
+namespace msgpacksearch
+{
+
+StreamParser::StreamParser(const std::string &path) : _path(parse_path(path))
+{
+}
+
+void StreamParser::reset()
+{
+    _stack.clear();
+    _header_size = 0;
+    _header_needed = 0;
+    _skip = 0;
+    _offset = 0;
+    _complete = false;
+    _collecting_key = false;
+    _match.clear();
+    _capturing = false;
+    _matched = false;
+    _match_delivered = false;
+    _object_delivered = false;
+}
+
+void StreamParser::resume(std::function<void()> &waiter)
+{
+    if (waiter)
+    {
+        std::function<void()> pending = std::move(waiter);
+        waiter = nullptr;
+        pending();
+    }
+}
+
+void StreamParser::consume(const uint8_t *data, size_t size)
+{
+    if (_capturing)
+        _match.insert(_match.end(), data, data + size);
+
+    if (_collecting_key)
+        _key.append(reinterpret_cast<const char *>(data), size);
+
+    _offset += size;
+}
+
+size_t StreamParser::feed(const uint8_t *data, size_t size)
+{
+    if (_complete)
+        reset();
+
+    size_t position = 0;
+
+    while (position < size && !_complete)
+    {
+        if (_skip)
+        {
+            size_t bytes = static_cast<size_t>(std::min<uint64_t>(_skip, size - position));
+            consume(data + position, bytes);
+            position += bytes;
+            _skip -= bytes;
+
+            if (!_skip)
+                end_value();
+
+            continue;
+        }
+
+        if (!_header_size)
+        {
+            if (!_stack.empty() && !_capturing)
+            {
+                size_t bytes = skip_items(data + position, data + size);
+                position += bytes;
+                _offset += bytes;
+
+                if (position == size)
+                    break;
+            }
+
+            _header_needed = header_size(data[position]);
+            if (!_header_needed)
+                throw parse_error("Unexpected type 0xc1", _offset);
+
+            _value_depth = classify(data[position], _value_is_key, _collecting_key);
+
+            // values that end in this chunk and need no descent are handled in one go
+            if (_value_depth == off_path || _value_depth == _path.size())
+            {
+                size_t bytes = skip_bounded(data + position, data + size);
+
+                if (bytes)
+                {
+                    whole_value(data + position, bytes);
+                    _offset += bytes;
+                    position += bytes;
+                    end_value();
+                    continue;
+                }
+            }
+        }
+
+        size_t bytes = std::min(_header_needed - _header_size, size - position);
+        std::copy(data + position, data + position + bytes, _header + _header_size);
+        _header_size += bytes;
+        _offset += bytes;
+        position += bytes;
+
+        if (_header_size == _header_needed)
+            begin_value();
+    }
+
+    return position;
+}
+
+uint32_t StreamParser::classify(uint8_t type, bool &is_key, bool &collect_key) const
+{
+    is_key = false;
+    collect_key = false;
+
+    if (_stack.empty())
+        return _path.empty() ? off_path : 0;
+
+    if (_matched)
+        return off_path;
+
+    const frame &parent = _stack.back();
+
+    if (parent.map && parent.position % 2 == 0)
+    {
+        is_key = true;
+        collect_key = parent.path_depth != off_path && !parent.member_matched &&
+                      _path[parent.path_depth].type == path_element::kind::key && type_of(type) == msgpack_type::str;
+        return off_path;
+    }
+
+    if (parent.map)
+        return parent.next_on_path ? parent.path_depth + 1 : off_path;
+
+    if (parent.path_depth != off_path && _path[parent.path_depth].type == path_element::kind::index &&
+        _path[parent.path_depth].index == parent.position)
+        return parent.path_depth + 1;
+
+    return off_path;
+}
+
+size_t StreamParser::skip_bounded(const uint8_t *start, const uint8_t *end) const
+{
+    try
+    {
+        return Msgpack::skip_object_bounded(start, end);
+    }
+    catch (const parse_error &e)
+    {
+        throw parse_error("Unexpected type 0xc1", _offset + e.offset());
+    }
+}
+
+size_t StreamParser::skip_items(const uint8_t *start, const uint8_t *end)
+{
+    frame &parent = _stack.back();
+    const uint8_t *current = start;
+    size_t bytes;
+
+    // the last item is left to the caller, ending the container goes through end_value
+    if (_matched || parent.path_depth == off_path)
+    {
+        // nothing left to find in the container
+        while (parent.remaining > 1 && (bytes = skip_bounded(current, end)))
+        {
+            current += bytes;
+            parent.remaining--;
+            parent.position++;
+        }
+    }
+    else if (parent.map && !parent.member_matched && _path[parent.path_depth].type == path_element::kind::key)
+    {
+        // members with another key than the path step
+        const std::string &wanted = _path[parent.path_depth].key;
+        std::string_view key;
+
+        while (parent.remaining > 2 && parent.position % 2 == 0 && (bytes = skip_bounded(current, end)))
+        {
+            if (read_str(current, key) && key == wanted)
+                break;
+
+            size_t value_bytes = skip_bounded(current + bytes, end);
+            if (!value_bytes)
+                break;
+
+            current += bytes + value_bytes;
+            parent.remaining -= 2;
+            parent.position += 2;
+        }
+    }
+
+    return current - start;
+}
+
+void StreamParser::whole_value(const uint8_t *value, size_t size)
+{
+    if (_value_depth == _path.size() && !_capturing && !_matched)
+    {
+        _capturing = true;
+        _capture_level = _stack.size();
+        _match.clear();
+    }
+
+    if (_capturing)
+        _match.insert(_match.end(), value, value + size);
+
+    if (_value_is_key)
+        _stack.back().next_on_path = false;
+
+    std::string_view key;
+    if (_collecting_key && read_str(value, key))
+    {
+        frame &parent = _stack.back();
+
+        if (key == _path[parent.path_depth].key)
+        {
+            parent.next_on_path = true;
+            parent.member_matched = true;
+        }
+
+        _collecting_key = false;
+    }
+}
+
+void StreamParser::begin_value()
+{
+    uint32_t path_depth = _value_depth;
+
+    if (path_depth == _path.size() && !_capturing && !_matched)
+    {
+        _capturing = true;
+        _capture_level = _stack.size();
+        _match.clear();
+    }
+
+    if (_capturing)
+        _match.insert(_match.end(), _header, _header + _header_size);
+
+    if (_value_is_key)
+    {
+        _stack.back().next_on_path = false;
+        _key.clear();
+    }
+
+    // containers on the path keep their depth, everything under the captured value is off the path
+    uint32_t child_depth = path_depth < _path.size() ? path_depth : off_path;
+    uint32_t nmb_elements = 0;
+    size_t header_size = 0;
+    uint64_t payload = 0;
+    bool map = read_map_header(_header, nmb_elements, header_size);
+    bool container = map || read_array_header(_header, nmb_elements, header_size);
+
+    if (!container)
+        payload = payload_size(_header);
+
+    _header_size = 0;
+
+    if (container && nmb_elements)
+        _stack.push_back(frame{map ? uint64_t(nmb_elements) * 2 : nmb_elements, 0, child_depth, map, false, false});
+    else if (payload)
+        _skip = payload;
+    else
+        end_value();
+}
+
+void StreamParser::end_value()
+{
+    for (;;)
+    {
+        if (_collecting_key)
+        {
+            frame &parent = _stack.back();
+
+            if (_key == _path[parent.path_depth].key)
+            {
+                parent.next_on_path = true;
+                parent.member_matched = true;
+            }
+
+            _collecting_key = false;
+        }
+
+        if (_capturing && _stack.size() == _capture_level)
+        {
+            _capturing = false;
+            _matched = true;
+
+            if (_on_match)
+                _on_match(_match.data(), _match.size());
+
+            resume(_resume_match);
+        }
+
+        if (_stack.empty())
+        {
+            _complete = true;
+
+            if (_on_object)
+                _on_object(_offset);
+
+            // the object ended without the value, a waiter registered after the match waits for the next object
+            if (!_match_delivered)
+                resume(_resume_match);
+            resume(_resume_object);
+            return;
+        }
+
+        frame &parent = _stack.back();
+        parent.position++;
+
+        if (--parent.remaining)
+            return;
+
+        _stack.pop_back();
+    }
+}
+
+}
@@ -0,0 +1,181 @@
+#ifndef MSGPACKSEARCH_STREAM_PARSER_H
+#define MSGPACKSEARCH_STREAM_PARSER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "path.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define MSGPACKSEARCH_HAS_COROUTINES 1
+#endif
+
+namespace msgpacksearch {
+
+/**
+ * @brief Resumable push parser for msgpack arriving in arbitrary chunks, e.g. from a non-blocking socket.
+ *
+ * Bytes are pushed with feed() as they arrive; the parser keeps only its position (a pending header,
+ * the bytes left in a payload and an explicit stack of open containers), never the data itself, so
+ * the caller decides whether to buffer the frame. feed() stops at the end of every root object.
+ *
+ * An optional path is evaluated while the bytes go by: the value at the path is copied out and
+ * reported as soon as its last byte arrived, e.g. to route a message before its body was received.
+ * As in find_map_key, the first of duplicate keys wins.
+ *
+ * Events are delivered to callbacks and, when compiled as C++20, to coroutines awaiting next_match()
+ * and next_object(). Both fire from inside feed(); they must not feed the same parser.
+ */
+class StreamParser {
+
+public:
+
+    /**
+    * @param[in] path path of the value to report for every root object, empty for none (see parse_path)
+    * @throws parse_error if the path is malformed
+    */
+    explicit StreamParser(const std::string &path = std::string());
+
+    StreamParser(const StreamParser &other) = delete;
+    StreamParser& operator=(const StreamParser &other) = delete;
+
+    /**
+    * Parses the next chunk of the stream. Once a root object is complete, the next call starts a new one.
+    * @param[in] data the chunk
+    * @param[in] size number of bytes in the chunk
+    * @return Number of bytes consumed: all of them, or up to the end of the root object that completed
+    * @throws parse_error on a never used type byte, the offset is relative to the start of the root object
+    */
+    size_t feed(const uint8_t *data, size_t size);
+
+    /// Same, for a chunk in a char buffer
+    size_t feed(const char *data, size_t size) { return feed(reinterpret_cast<const uint8_t *>(data), size); }
+
+    /// Starts over on a new root object, e.g. after a connection reset
+    void reset();
+
+    /// True once the last byte of the root object was consumed
+    bool complete() const { return _complete; }
+
+    /// Bytes of the root object consumed so far, its encoded size once complete
+    size_t object_size() const { return _offset; }
+
+    /// Number of containers currently open
+    size_t depth() const { return _stack.size(); }
+
+    /// True once the value at the path was received completely
+    bool matched() const { return _matched; }
+
+    /// Encoded value at the path, valid when matched()
+    const std::vector<uint8_t>& match() const { return _match; }
+
+    /// Called with the encoded value at the path, as soon as it was received
+    void on_match(std::function<void(const uint8_t *value, size_t size)> callback) { _on_match = std::move(callback); }
+
+    /// Called with the size of every root object, when its last byte was received
+    void on_object(std::function<void(size_t size)> callback) { _on_object = std::move(callback); }
+
+#ifdef MSGPACKSEARCH_HAS_COROUTINES
+
+    /// Awaiter of next_match(), resumes with the value at the path or NULL if the object ended without it
+    struct match_awaiter
+    {
+        StreamParser &parser;
+
+        bool await_ready() const { return !parser._match_delivered && (parser._matched || parser._complete); }
+        void await_suspend(std::coroutine_handle<> handle) { parser._resume_match = [handle] { handle.resume(); }; }
+        const std::vector<uint8_t>* await_resume()
+        {
+            parser._match_delivered = true;
+            return parser._matched ? &parser._match : nullptr;
+        }
+    };
+
+    /// Awaiter of next_object(), resumes with the size of the root object
+    struct object_awaiter
+    {
+        StreamParser &parser;
+
+        bool await_ready() const { return !parser._object_delivered && parser._complete; }
+        void await_suspend(std::coroutine_handle<> handle) { parser._resume_object = [handle] { handle.resume(); }; }
+        size_t await_resume()
+        {
+            parser._object_delivered = true;
+            return parser._offset;
+        }
+    };
+
+    /// co_await the value at the path of the current root object, once per object
+    match_awaiter next_match() { return match_awaiter{*this}; }
+
+    /// co_await the end of the current root object, once per object
+    object_awaiter next_object() { return object_awaiter{*this}; }
+
+#endif
+
+private:
+    static constexpr uint32_t off_path = UINT32_MAX;
+
+    /**
+     * frame - one open container
+     *
+     * remaining -> items left, keys and values both count for maps
+     * position -> index of the next item
+     * path_depth -> number of path steps leading to this container, off_path if it is not on the path
+     * member_matched -> the key of the path step was seen, later duplicates are ignored
+     * next_on_path -> the value after the current key is on the path
+     */
+    struct frame
+    {
+        uint64_t remaining;
+        uint32_t position;
+        uint32_t path_depth;
+        bool map;
+        bool member_matched;
+        bool next_on_path;
+    };
+
+    uint32_t classify(uint8_t type, bool &is_key, bool &collect_key) const;
+    size_t skip_bounded(const uint8_t *start, const uint8_t *end) const;
+    size_t skip_items(const uint8_t *start, const uint8_t *end);
+    void whole_value(const uint8_t *value, size_t size);
+    void begin_value();
+    void end_value();
+    void consume(const uint8_t *data, size_t size);
+    static void resume(std::function<void()> &waiter);
+
+    msgpack_path _path;
+    std::vector<frame> _stack;
+    uint8_t _header[9];
+    size_t _header_size = 0;
+    size_t _header_needed = 0;
+    uint64_t _skip = 0; // payload bytes left in the current value
+    size_t _offset = 0;
+    bool _complete = false;
+    uint32_t _value_depth = off_path; // path depth of the value whose header is being read
+    bool _value_is_key = false;
+
+    std::string _key; // key compared with the path, collected across chunks
+    bool _collecting_key = false;
+    std::vector<uint8_t> _match;
+    size_t _capture_level = 0; // stack depth at which the captured value started
+    bool _capturing = false;
+    bool _matched = false;
+
+    std::function<void(const uint8_t *, size_t)> _on_match;
+    std::function<void(size_t)> _on_object;
+
+    // coroutine waiters, type erased so the layout does not depend on the language version
+    std::function<void()> _resume_match;
+    std::function<void()> _resume_object;
+    bool _match_delivered = false;
+    bool _object_delivered = false;
+};
+
+}
+
+#endif //MSGPACKSEARCH_STREAM_PARSER_H
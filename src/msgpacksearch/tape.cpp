@@ -0,0 +1,339 @@
+#include "tape.h"
+#include "decode.h"
+#include "error.h"
+#include "instrumentation.h"
+#include "msgpacksearch.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+bool is_map(uint8_t type)
+{
+    return (type >= 0x80 && type <= 0x8f) || type == TYPE_MASK::MAP16 || type == TYPE_MASK::MAP32;
+}
+
+/**
+ * tape_frame - what a tape build keeps per container whose elements are not all read yet
+ *
+ * entry -> index of the container entry, npos for the run of siblings a chunk is built on
+ * count -> number of elements
+ * table -> start of the element table of an array in the chunk's elements, npos without one
+ */
+struct tape_frame
+{
+    uint32_t entry;
+    uint32_t count;
+    uint32_t table;
+};
+
+/**
+ * tape_chunk - entries of a run of sibling objects, entry indexes are relative to the chunk
+ *
+ * entries / elements / tables -> as the members of Tape
+ * siblings -> entries of the objects of the run
+ * end -> offset past the last object of the run
+ */
+struct tape_chunk
+{
+    std::vector<tape_entry> entries;
+    std::vector<uint32_t> elements;
+    std::unordered_map<uint32_t, uint32_t> tables;
+    std::vector<uint32_t> siblings;
+    size_t end = 0;
+};
+
+/**
+* Builds the entries of count sibling objects, the members of a map if members is set
+* @param[in] data the whole buffer, offsets are relative to it
+* @param[in] size bytes available from data
+* @param[in] position offset of the first object, or of its key
+* @param[in] count number of objects
+* @param[in] members whether every object is preceded by its key
+* @param[out] chunk the entries
+* @throws parse_error on an invalid type byte or an object running past size
+* @throws std::length_error if the run has more than Tape::npos - 1 values
+*/
+void build_chunk(const uint8_t *data, size_t size, size_t position, uint32_t count, bool members, tape_chunk &chunk)
+{
+    constexpr uint32_t npos = Tape::npos;
+    std::vector<tape_entry> &entries = chunk.entries;
+    DocumentWalker<tape_frame> walker(data, size, position, count, members, tape_frame{npos, count, npos});
+
+    while (!walker.done())
+    {
+        if (entries.size() >= npos - 1)
+            throw std::length_error("too many objects for a tape");
+
+        const object_header &object = walker.next();
+        const uint32_t index = static_cast<uint32_t>(entries.size());
+
+        entries.push_back(tape_entry{static_cast<uint64_t>(object.position) << 8 | object.type, index + 1,
+                                     static_cast<uint32_t>(object.key_size)});
+
+        auto &parent = walker.parent();
+
+        if (parent.frame.table != npos)
+            chunk.elements[parent.frame.table + parent.frame.count - parent.remaining] = index;
+        else if (parent.frame.entry == npos)
+            chunk.siblings.push_back(index);
+
+        if (object.container && object.nmb_elements)
+        {
+            uint32_t table = npos;
+
+            if (!object.map && object.nmb_elements >= Tape::table_threshold)
+            {
+                table = static_cast<uint32_t>(chunk.elements.size());
+                chunk.elements.resize(chunk.elements.size() + object.nmb_elements);
+                chunk.tables.emplace(index, table);
+            }
+
+            walker.enter(tape_frame{index, object.nmb_elements, table});
+            continue;
+        }
+
+        walker.skip([&entries](const DocumentWalker<tape_frame>::level &closed) {
+            if (closed.frame.entry != npos)
+                entries[closed.frame.entry].next = static_cast<uint32_t>(entries.size());
+        });
+    }
+
+    chunk.end = walker.position();
+}
+
+/**
+* Offset past an object, for the skip pass of a parallel build
+* @throws parse_error on an invalid type byte or an object running past size
+*/
+size_t skip_checked(const uint8_t *data, size_t size, size_t position)
+{
+    if (position >= size)
+        throw parse_error("object runs past the end of the buffer", position);
+
+    size_t object_size;
+
+    try
+    {
+        object_size = Msgpack::skip_object_bounded(data + position, data + size);
+    }
+    catch (const parse_error &e)
+    {
+        throw parse_error("invalid type byte", position + e.offset());
+    }
+
+    if (!object_size)
+        throw parse_error("object runs past the end of the buffer", position);
+
+    return position + object_size;
+}
+
+}
+
+Tape::Tape(const uint8_t *data, size_t size, ThreadPool *pool, size_t chunk_bytes) : _data(data)
+{
+    uint32_t nmb_elements = 0;
+    size_t header = 0;
+    bool map = false;
+    bool array = false;
+
+    // headers are at most 5 bytes, the size check keeps them within the buffer
+    if (pool && pool->size() > 1 && size / 2 >= std::max<size_t>(chunk_bytes, 8))
+    {
+        map = read_map_header(data, nmb_elements, header);
+        array = !map && read_array_header(data, nmb_elements, header);
+    }
+
+    if (!nmb_elements)
+    {
+        tape_chunk chunk;
+
+        // a guess of one value per 8 bytes, to avoid most of the reallocations on typical documents
+        chunk.entries.reserve(size / 8 + 1);
+        build_chunk(data, size, 0, 1, false, chunk);
+
+        _entries = std::move(chunk.entries);
+        _elements = std::move(chunk.elements);
+        _tables = std::move(chunk.tables);
+        _size = chunk.end;
+        return;
+    }
+
+    // the skip pass finds where runs of about chunk_bytes of elements start, the runs are then
+    // built in parallel with chunk relative indexes, and rebased while they are copied into place
+    struct run
+    {
+        size_t position;
+        uint32_t count;
+    };
+
+    std::vector<run> runs{run{header, 0}};
+    size_t position = header;
+
+    for (uint32_t element = 0; element < nmb_elements; element++)
+    {
+        if (position - runs.back().position >= chunk_bytes)
+            runs.push_back(run{position, 0});
+
+        if (map)
+            position = skip_checked(data, size, position);
+
+        position = skip_checked(data, size, position);
+        runs.back().count++;
+    }
+
+    std::vector<tape_chunk> chunks(runs.size());
+    std::vector<std::future<void>> built;
+
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        size_t run_end = i + 1 < runs.size() ? runs[i + 1].position : position;
+
+        built.push_back(pool->submit([data, run_end, map, &chunk = chunks[i], start = runs[i]] {
+            chunk.entries.reserve((run_end - start.position) / 8 + 1);
+            build_chunk(data, run_end, start.position, start.count, map, chunk);
+        }));
+    }
+
+    // every task must end before chunks goes out of scope, even if one of them failed
+    for (std::future<void> &task : built)
+        task.wait();
+    for (std::future<void> &task : built)
+        task.get();
+
+    std::vector<uint32_t> entry_bases(chunks.size());
+    std::vector<uint32_t> element_bases(chunks.size());
+    uint64_t nmb_entries = 1;
+    uint64_t nmb_table_elements = array && nmb_elements >= table_threshold ? nmb_elements : 0;
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        entry_bases[i] = static_cast<uint32_t>(nmb_entries);
+        element_bases[i] = static_cast<uint32_t>(nmb_table_elements);
+        nmb_entries += chunks[i].entries.size();
+        nmb_table_elements += chunks[i].elements.size();
+
+        if (nmb_entries >= npos - 1 || nmb_table_elements >= npos)
+            throw std::length_error("too many objects for a tape");
+    }
+
+    _entries.resize(nmb_entries);
+    _elements.resize(nmb_table_elements);
+    _entries[0] = tape_entry{data[0], static_cast<uint32_t>(nmb_entries), 0};
+    _size = chunks.back().end;
+
+    std::vector<std::future<void>> copied;
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        copied.push_back(pool->submit([this, &chunk = chunks[i], entry_base = entry_bases[i], element_base = element_bases[i]] {
+            tape_entry *entries = _entries.data() + entry_base;
+
+            for (size_t entry = 0; entry < chunk.entries.size(); entry++)
+            {
+                entries[entry] = chunk.entries[entry];
+                entries[entry].next += entry_base;
+            }
+
+            for (size_t element = 0; element < chunk.elements.size(); element++)
+                _elements[element_base + element] = chunk.elements[element] + entry_base;
+        }));
+    }
+
+    for (std::future<void> &task : copied)
+        task.wait();
+
+    // the root's element table, then the tables of the chunks, in document order
+    if (array && nmb_elements >= table_threshold)
+    {
+        _tables.emplace(0, 0);
+        uint32_t *table = _elements.data();
+
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            for (uint32_t sibling : chunks[i].siblings)
+                *table++ = sibling + entry_bases[i];
+        }
+    }
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        for (const auto &[entry, start] : chunks[i].tables)
+            _tables.emplace(entry + entry_bases[i], start + element_bases[i]);
+    }
+}
+
+uint32_t Tape::child(uint32_t entry, std::string_view key) const
+{
+    if (entry >= _entries.size() || !is_map(_entries[entry].type()))
+        return npos;
+
+    for (uint32_t member = entry + 1; member < _entries[entry].next; member = _entries[member].next)
+    {
+        const tape_entry &current = _entries[member];
+
+        // a string key takes 1 to 5 header bytes before its payload, other sizes never match
+        if (current.key_size <= key.size() || current.key_size > key.size() + 5)
+            continue;
+
+        std::string_view current_key;
+        if (read_str(_data + current.offset() - current.key_size, current_key))
+        {
+            MSGPACKSEARCH_COUNT(keys_compared, 1);
+
+            if (current_key == key)
+                return member;
+        }
+    }
+
+    return npos;
+}
+
+uint32_t Tape::at(uint32_t entry, uint32_t index) const
+{
+    uint32_t nmb_elements = 0;
+    size_t header = 0;
+
+    if (entry >= _entries.size() || !read_array_header(object(entry), nmb_elements, header) || index >= nmb_elements)
+        return npos;
+
+    if (nmb_elements >= table_threshold)
+        return _elements[_tables.at(entry) + index];
+
+    uint32_t element = entry + 1;
+
+    for (uint32_t i = 0; i < index; i++)
+        element = _entries[element].next;
+
+    return element;
+}
+
+uint32_t Tape::follow(uint32_t entry, const msgpack_path &path) const
+{
+    for (const path_element &element : path)
+    {
+        if (entry == npos)
+            break;
+
+        entry = element.type == path_element::kind::key ? child(entry, element.key) : at(entry, element.index);
+    }
+
+    return entry;
+}
+
+size_t Tape::object_size(uint32_t entry) const
+{
+    // the next entry starts after its own key, if it is a map member
+    uint32_t next = _entries[entry].next;
+    size_t end = next < _entries.size() ? _entries[next].offset() - _entries[next].key_size : _size;
+    return end - _entries[entry].offset();
+}
+
+}
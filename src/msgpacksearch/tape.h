@@ -0,0 +1,137 @@
+#ifndef MSGPACKSEARCH_TAPE_H
+#define MSGPACKSEARCH_TAPE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "path.h"
+
+namespace msgpacksearch {
+
+class ThreadPool;
+
+/**
+ * tape_entry - one object of a Tape, in document order. Map keys have no entry of their own, they
+ * are the key_size bytes right before the entry of their value.
+ *
+ * position -> offset of the object in the data, shifted left by 8, or'ed with its type byte
+ * next -> index of the entry following the object and everything under it: the next sibling
+ * key_size -> encoded size of the member's key for values of a map, 0 otherwise
+ */
+struct tape_entry
+{
+    uint64_t position;
+    uint32_t next;
+    uint32_t key_size;
+
+    /// Offset of the object in the data
+    size_t offset() const { return position >> 8; }
+
+    /// Type byte of the object
+    uint8_t type() const { return static_cast<uint8_t>(position); }
+};
+
+/**
+ * @brief Flat index of every object of a document, for documents queried with many paths.
+ *
+ * Built in one pass, the tape holds a fixed size entry per value in document order: the elements of a
+ * container follow its entry, and every entry knows the index of its next sibling. Subtrees are skipped
+ * in O(1) and children enumerated without decoding a header, from entry + 1 along next up to the
+ * container's own next. Arrays of at least table_threshold elements also get a table of their element
+ * entries, for O(1) index access.
+ *
+ * Large maps and arrays can be built on a thread pool: a sequential pass skips over the members of the root
+ * to split them in runs of about chunk_bytes, whose entries are built in parallel and then rebased into
+ * place. The tape is the same as the one of a sequential build.
+ *
+ * A tape describes one immutable buffer and is only valid with it. Attach it to a Msgpack view with
+ * Msgpack::set_tape to serve its lookups.
+ */
+class Tape {
+
+public:
+
+    /// Entry index of a lookup that does not resolve
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    /// Arrays with at least this many elements get an element table
+    static constexpr uint32_t table_threshold = 32;
+
+    /// Bytes of root members built by one task of a parallel build
+    static constexpr size_t default_chunk_bytes = 1 << 20;
+
+    /// An empty tape
+    Tape() = default;
+
+    /**
+    * Builds the tape of an object
+    * @param[in] data points at the object, must outlive the tape
+    * @param[in] size bytes available from data
+    * @param[in] pool threads that build the members of a root container of at least 2 * chunk_bytes, NULL
+    * to build on the calling thread
+    * @param[in] chunk_bytes bytes of root members built by one task
+    * @throws parse_error on an invalid type byte or an object running past size
+    * @throws std::length_error if the object has more than UINT32_MAX - 1 values
+    */
+    Tape(const uint8_t *data, size_t size, ThreadPool *pool = nullptr, size_t chunk_bytes = default_chunk_bytes);
+
+    /**
+    * Finds a member of a map
+    * @param[in] entry index of the map entry
+    * @param[in] key key to search for, the first of duplicate keys wins
+    * @return Index of the value entry, npos if the entry is not a map or the key is missing
+    */
+    uint32_t child(uint32_t entry, std::string_view key) const;
+
+    /**
+    * Finds an element of an array
+    * @param[in] entry index of the array entry
+    * @param[in] index index of the element
+    * @return Index of the element entry, npos if the entry is not an array or the index is out of range
+    */
+    uint32_t at(uint32_t entry, uint32_t index) const;
+
+    /**
+    * Follows a parsed path from an entry
+    * @param[in] entry index of the entry to start at, 0 for the root
+    * @param[in] path steps to follow
+    * @return Index of the value entry, npos if any step does not resolve
+    */
+    uint32_t follow(uint32_t entry, const msgpack_path &path) const;
+
+    /// Pointer to the object of an entry
+    const uint8_t* object(uint32_t entry) const { return _data + _entries[entry].offset(); }
+
+    /// Pointer to the key of a map member's entry, NULL outside maps
+    const uint8_t* key(uint32_t entry) const
+    {
+        return _entries[entry].key_size ? object(entry) - _entries[entry].key_size : nullptr;
+    }
+
+    /// Encoded size of the object of an entry, containers included
+    size_t object_size(uint32_t entry) const;
+
+    const std::vector<tape_entry>& entries() const { return _entries; }
+
+    /// Root object the tape describes
+    const uint8_t* data() const { return _data; }
+
+    /// Encoded size of the root object
+    size_t size() const { return _size; }
+
+    bool empty() const { return _entries.empty(); }
+
+private:
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+    std::vector<tape_entry> _entries;
+    std::vector<uint32_t> _elements; // element entries of the large arrays, contiguous per array
+    std::unordered_map<uint32_t, uint32_t> _tables; // array entry -> start of its elements in _elements
+};
+
+}
+
+#endif //MSGPACKSEARCH_TAPE_H
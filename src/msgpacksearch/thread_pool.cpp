@@ -0,0 +1,51 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace msgpacksearch
+{
+
+ThreadPool::ThreadPool(size_t nmb_threads)
+{
+    if (!nmb_threads)
+        nmb_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t thread = 0; thread < nmb_threads; thread++)
+        _threads.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _wake.notify_all();
+
+    for (std::thread &thread : _threads)
+        thread.join();
+}
+
+void ThreadPool::run()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+
+            if (_tasks.empty())
+                return;
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef MSGPACKSEARCH_THREAD_POOL_H
+#define MSGPACKSEARCH_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace msgpacksearch {
+
+/**
+ * @brief Fixed set of worker threads running tasks in submission order.
+ *
+ * The destructor runs the tasks still queued, then joins the workers.
+ */
+class ThreadPool {
+
+public:
+
+    /**
+    * @param[in] nmb_threads number of workers, 0 for std::thread::hardware_concurrency()
+    */
+    explicit ThreadPool(size_t nmb_threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &other) = delete;
+    ThreadPool& operator=(const ThreadPool &other) = delete;
+
+    /**
+    * Queues a task
+    * @param[in] fn callable without arguments
+    * @return future of the result of fn, exceptions thrown by fn are rethrown by get()
+    */
+    template <typename Fn>
+    std::future<std::invoke_result_t<Fn>> submit(Fn &&fn)
+    {
+        // std::function needs a copyable target, the task itself is move only
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Fn>()>>(std::forward<Fn>(fn));
+        std::future<std::invoke_result_t<Fn>> result = task->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.emplace_back([task] { (*task)(); });
+        }
+
+        _wake.notify_one();
+        return result;
+    }
+
+    /// Number of workers
+    size_t size() const { return _threads.size(); }
+
+private:
+    void run();
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _stopping = false;
+};
+
+}
+
+#endif //MSGPACKSEARCH_THREAD_POOL_H
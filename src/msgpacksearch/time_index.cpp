@@ -0,0 +1,149 @@
+#include "time_index.h"
+#include "decode.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace msgpacksearch
+{
+
+TimeIndex::TimeIndex(const std::string &path, size_t interval) : _path(parse_path(path)), _interval(interval)
+{
+    if (!interval)
+        throw std::invalid_argument("TimeIndex: the sample interval must be positive");
+}
+
+bool TimeIndex::read_time(const uint8_t *record, size_t size, msgpack_timestamp &time) const
+{
+    Cursor value = follow_path(Cursor(record, size), _path);
+    return value && read_timestamp(value.data(), time);
+}
+
+size_t TimeIndex::append(const uint8_t *data, size_t size)
+{
+    size_t offset = _indexed_bytes;
+
+    if (size < offset)
+        throw std::invalid_argument("TimeIndex::append: the collection shrank");
+
+    _data = data;
+
+    size_t added = 0;
+
+    while (offset < size)
+    {
+        size_t record_size = Msgpack::skip_object_bounded(data + offset, data + size);
+
+        if (!record_size)
+            break;
+
+        msgpack_timestamp time;
+
+        if (read_time(data + offset, record_size, time))
+        {
+            if (!_samples.empty() && time < _last)
+                throw std::invalid_argument("TimeIndex::append: the record at offset " + std::to_string(offset) +
+                                            " is older than the one before it");
+
+            if (_samples.empty() || _since_sample >= _interval)
+            {
+                _samples.push_back(sample{time, offset});
+                _since_sample = 0;
+            }
+
+            _last = time;
+        }
+        else
+        {
+            _untimed++;
+        }
+
+        offset += record_size;
+        _indexed_bytes = offset;
+        _since_sample++;
+        _records++;
+        added++;
+    }
+
+    return added;
+}
+
+size_t TimeIndex::append(const std::vector<uint8_t> &data)
+{
+    return append(data.data(), data.size());
+}
+
+uint64_t TimeIndex::seek(const msgpack_timestamp &from) const
+{
+    if (_samples.empty())
+        return _indexed_bytes;
+
+    // the last sample older than from, every record before it is older too; records before the first
+    // sample have no timestamp
+    auto it = std::lower_bound(_samples.begin(), _samples.end(), from,
+                               [](const sample &entry, const msgpack_timestamp &value) { return entry.time < value; });
+
+    return it == _samples.begin() ? it->offset : (it - 1)->offset;
+}
+
+uint64_t TimeIndex::lower_bound(const msgpack_timestamp &from) const
+{
+    uint64_t offset = seek(from);
+
+    while (offset < _indexed_bytes)
+    {
+        size_t record_size = Msgpack::skip_object(_data + offset);
+        msgpack_timestamp time;
+
+        if (read_time(_data + offset, record_size, time) && !(time < from))
+            break;
+
+        offset += record_size;
+    }
+
+    return offset;
+}
+
+size_t TimeIndex::scan(const msgpack_timestamp &from, const msgpack_timestamp &until, const visitor &visit) const
+{
+    size_t visited = 0;
+
+    if (!(from < until))
+        return visited;
+
+    for (uint64_t offset = lower_bound(from); offset < _indexed_bytes;)
+    {
+        size_t record_size = Msgpack::skip_object(_data + offset);
+        msgpack_timestamp time;
+
+        if (read_time(_data + offset, record_size, time))
+        {
+            if (!(time < until))
+                break;
+
+            visited++;
+
+            if (!visit(_data + offset, record_size, time))
+                break;
+        }
+
+        offset += record_size;
+    }
+
+    return visited;
+}
+
+std::deque<Msgpack> TimeIndex::range(const msgpack_timestamp &from, const msgpack_timestamp &until) const
+{
+    // Msgpack is neither movable nor assignable, a deque constructs the views in place
+    std::deque<Msgpack> out;
+
+    scan(from, until, [&out](const uint8_t *record, size_t size, const msgpack_timestamp &) {
+        out.emplace_back(record, size);
+        return true;
+    });
+
+    return out;
+}
+
+}
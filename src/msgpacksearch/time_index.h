@@ -0,0 +1,125 @@
+#ifndef MSGPACKSEARCH_TIME_INDEX_H
+#define MSGPACKSEARCH_TIME_INDEX_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "msgpacksearch.h"
+#include "path.h"
+
+namespace msgpacksearch {
+
+/**
+ * @brief Sparse index of a collection of records sorted by the timestamp found at one path.
+ *
+ * The collection is a buffer of concatenated records, e.g. a mmapped log file, whose timestamps (the
+ * timestamp extension) never decrease. append() reads every record once and keeps the offset and
+ * timestamp of one record in every interval; scan() binary-searches these samples for the first record
+ * of a time range, skips at most interval records, then streams forward until the range ends. A scan
+ * costs O(log(records / interval) + interval + output) instead of a pass over the collection.
+ *
+ * Records without a timestamp at the path are counted but never returned. Results point into the
+ * buffer passed to the last append().
+ */
+class TimeIndex {
+
+public:
+
+    /// Records between two samples by default
+    static constexpr size_t default_interval = 64;
+
+    /// Receives a record of a scan and its timestamp, returns false to stop the scan
+    using visitor = std::function<bool(const uint8_t *record, size_t size, const msgpack_timestamp &time)>;
+
+    /**
+    * @param[in] path path of the timestamp in every record, see parse_path
+    * @param[in] interval records between two samples, trades index size against the records skipped by a scan
+    * @throws parse_error if the path is malformed
+    * @throws std::invalid_argument if interval is 0
+    */
+    explicit TimeIndex(const std::string &path, size_t interval = default_interval);
+
+    /**
+    * Indexes the records appended to the collection since the previous call. The first indexed_bytes()
+    * bytes must be unchanged, the buffer itself may have moved. A partially written record at the end
+    * of the buffer is left for the next call.
+    * @param[in] data start of the collection
+    * @param[in] size number of bytes in the collection
+    * @return Number of records added
+    * @throws parse_error on an invalid type byte
+    * @throws std::invalid_argument if the collection shrank, or a record is older than the one before it;
+    * the records before it stay indexed
+    */
+    size_t append(const uint8_t *data, size_t size);
+    size_t append(const std::vector<uint8_t> &data);
+
+    /**
+    * Visits the records whose timestamp lies in [from, until), in collection order
+    * @param[in] from start of the range, inclusive
+    * @param[in] until end of the range, exclusive
+    * @param[in] visit called for every record in the range
+    * @return Number of records visited
+    */
+    size_t scan(const msgpack_timestamp &from, const msgpack_timestamp &until, const visitor &visit) const;
+
+    /**
+    * Records whose timestamp lies in [from, until)
+    * @param[in] from start of the range, inclusive
+    * @param[in] until end of the range, exclusive
+    * @return Views of the records, in collection order
+    */
+    std::deque<Msgpack> range(const msgpack_timestamp &from, const msgpack_timestamp &until) const;
+
+    /**
+    * Offset of the first record at or after a timestamp
+    * @param[in] from the timestamp
+    * @return The offset, indexed_bytes() if every record is older
+    */
+    uint64_t lower_bound(const msgpack_timestamp &from) const;
+
+    /// Number of records scanned so far
+    size_t records() const { return _records; }
+
+    /// Number of records without a timestamp at the path
+    size_t untimed() const { return _untimed; }
+
+    /// Number of samples kept
+    size_t samples() const { return _samples.size(); }
+
+    /// Number of leading bytes of the collection that were indexed
+    size_t indexed_bytes() const { return _indexed_bytes; }
+
+private:
+    /**
+     * sample - one record every interval
+     *
+     * time -> timestamp of the record
+     * offset -> offset of the record in the collection
+     */
+    struct sample
+    {
+        msgpack_timestamp time;
+        uint64_t offset;
+    };
+
+    bool read_time(const uint8_t *record, size_t size, msgpack_timestamp &time) const;
+    uint64_t seek(const msgpack_timestamp &from) const;
+
+    const msgpack_path _path;
+    const size_t _interval;
+    const uint8_t *_data = nullptr;
+    size_t _indexed_bytes = 0;
+    size_t _records = 0;
+    size_t _untimed = 0;
+    size_t _since_sample = 0; // records since the last sample
+    msgpack_timestamp _last; // timestamp of the newest timed record
+    std::vector<sample> _samples;
+};
+
+}
+
+#endif //MSGPACKSEARCH_TIME_INDEX_H
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <variant>
+#include <vector>
 
 namespace msgpacksearch
 {
@@ -13,6 +14,23 @@ enum TYPE_MASK {
     ARRAY32 = 0xdd,
 };
 
+/**
+ * msgpack_type - family of an encoded object, independent of its width
+ */
+enum class msgpack_type : uint8_t {
+    nil,
+    boolean,
+    uint,
+    int_,
+    float_,
+    str,
+    bin,
+    array,
+    map,
+    ext,
+    invalid,
+};
+
 /**
  * msgpack_str - represents a string object
  *
@@ -78,12 +96,46 @@ struct msgpack_array
  * type -> type code for the ext type
  */
 struct msgpack_ext {
+    msgpack_ext() : type(0), size(0), data(nullptr) {}
     msgpack_ext(int8_t type, uint32_t size, const uint8_t *data) : type(type), size(size), data(data) {}
     int8_t type;
     uint32_t size;
     const uint8_t* data;
 };
 
+/**
+ * msgpack_timestamp - instant of the timestamp extension type (-1)
+ *
+ * seconds -> seconds since 1970-01-01 00:00:00 UTC, negative before
+ * nanoseconds -> nanoseconds within the second, always below 1000000000
+ */
+struct msgpack_timestamp
+{
+    int64_t seconds = 0;
+    uint32_t nanoseconds = 0;
+
+    bool operator==(const msgpack_timestamp &other) const { return seconds == other.seconds && nanoseconds == other.nanoseconds; }
+    bool operator!=(const msgpack_timestamp &other) const { return !(*this == other); }
+    bool operator<(const msgpack_timestamp &other) const
+    {
+        return seconds < other.seconds || (seconds == other.seconds && nanoseconds < other.nanoseconds);
+    }
+};
+
+/**
+ * map_index - offset index over the keys of one map
+ *
+ * start -> pointer to the start of the map data
+ * key_offsets -> offset of every key from start, in map order
+ * sorted -> true if the keys are in canonical (bytewise) order, lookups then binary search
+ */
+struct map_index
+{
+    const uint8_t* start = nullptr;
+    std::vector<size_t> key_offsets;
+    bool sorted = true;
+};
+
 typedef std::variant<std::monostate,
         bool,
         uint64_t,
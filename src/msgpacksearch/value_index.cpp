@@ -0,0 +1,314 @@
+#include "value_index.h"
+#include "decode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace msgpacksearch
+{
+
+namespace {
+
+// leading byte of a key, orders the value families
+constexpr char nil_tag = 0x10;
+constexpr char false_tag = 0x20;
+constexpr char true_tag = 0x21;
+constexpr char number_tag = 0x30;
+constexpr char string_tag = 0x40;
+
+void append_be64(std::string &key, uint64_t value)
+{
+    for (int shift = 56; shift >= 0; shift -= 8)
+        key += static_cast<char>(value >> shift);
+}
+
+/// Maps a double onto an unsigned integer with the same order
+uint64_t ordered_bits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits & 0x8000000000000000ULL ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+/**
+ * Numbers are the tag and the ordered bits of their nearest double. Integers of magnitude 2^53 and above
+ * can share a double with their neighbours, they get the exact value as a tie breaker; every other
+ * number has a unique double, so keys of equal numbers are equal whatever their encoding.
+ */
+void encode_integer(uint64_t value, bool negative, std::string &key)
+{
+    const int64_t signed_value = static_cast<int64_t>(value);
+
+    key = number_tag;
+    append_be64(key, ordered_bits(negative ? static_cast<double>(signed_value) : static_cast<double>(value)));
+
+    if (negative ? signed_value <= -(1LL << 53) : value >= (1ULL << 53))
+    {
+        key += negative ? '\0' : '\1';
+        append_be64(key, value);
+    }
+}
+
+bool encode_double(double value, std::string &key)
+{
+    if (std::isnan(value))
+        return false;
+
+    // integral doubles are keyed as the integer they hold
+    if (value >= -9223372036854775808.0 && value < 0 && value == std::trunc(value))
+    {
+        encode_integer(static_cast<uint64_t>(static_cast<int64_t>(value)), true, key);
+        return true;
+    }
+
+    if (value >= 0 && value < 18446744073709551616.0 && value == std::trunc(value))
+    {
+        encode_integer(static_cast<uint64_t>(value), false, key);
+        return true;
+    }
+
+    key = number_tag;
+    append_be64(key, ordered_bits(value));
+    return true;
+}
+
+void encode_string(std::string_view value, std::string &key)
+{
+    key = string_tag;
+    key.append(value.data(), value.size());
+}
+
+}
+
+ValueIndex::ValueIndex(const std::string &path, kind type) : _path(parse_path(path)), _type(type) {}
+
+bool ValueIndex::encode_key(const uint8_t *value, std::string &key)
+{
+    uint64_t integer;
+    bool is_signed;
+    double d;
+    bool boolean;
+    std::string_view str;
+
+    if (*value == 0xc0)
+    {
+        key = nil_tag;
+        return true;
+    }
+
+    if (read_bool(value, boolean))
+    {
+        key = boolean ? true_tag : false_tag;
+        return true;
+    }
+
+    if (read_integer(value, integer, is_signed))
+    {
+        encode_integer(integer, is_signed, key);
+        return true;
+    }
+
+    if (read_float(value, d))
+        return encode_double(d, key);
+
+    if (read_str(value, str))
+    {
+        encode_string(str, key);
+        return true;
+    }
+
+    return false;
+}
+
+bool ValueIndex::encode_key(const msgpack_object &value, std::string &key)
+{
+    if (std::holds_alternative<std::monostate>(value))
+        key = nil_tag;
+    else if (const bool *boolean = std::get_if<bool>(&value))
+        key = *boolean ? true_tag : false_tag;
+    else if (const uint64_t *uint = std::get_if<uint64_t>(&value))
+        encode_integer(*uint, false, key);
+    else if (const int64_t *integer = std::get_if<int64_t>(&value))
+        encode_integer(static_cast<uint64_t>(*integer), *integer < 0, key);
+    else if (const double *d = std::get_if<double>(&value))
+        return encode_double(*d, key);
+    else if (const msgpack_str *str = std::get_if<msgpack_str>(&value))
+        encode_string(std::string_view(str->data, str->size), key);
+    else
+        return false;
+
+    return true;
+}
+
+size_t ValueIndex::append(const uint8_t *data, size_t size)
+{
+    size_t offset = indexed_bytes();
+
+    if (size < offset)
+        throw std::invalid_argument("ValueIndex::append: the collection shrank");
+
+    _data = data;
+
+    std::vector<std::pair<std::string, uint64_t>> batch;
+    size_t added = 0;
+
+    while (offset < size)
+    {
+        size_t record_size = Msgpack::skip_object_bounded(data + offset, data + size);
+
+        if (!record_size)
+            break;
+
+        Cursor value = follow_path(Cursor(data + offset, record_size), _path);
+        std::string key;
+
+        if (value && encode_key(value.data(), key))
+        {
+            if (_type == kind::sorted)
+                batch.emplace_back(std::move(key), offset);
+            else
+                _hashed[key].push_back(offset);
+            _entries++;
+        }
+
+        offset += record_size;
+        _boundaries.push_back(offset);
+        added++;
+    }
+
+    if (!batch.empty())
+    {
+        // offsets grow with the collection, stable sorting and merging keep equal keys in offset order
+        auto by_key = [](const std::pair<std::string, uint64_t> &a, const std::pair<std::string, uint64_t> &b) {
+            return a.first < b.first;
+        };
+
+        std::stable_sort(batch.begin(), batch.end(), by_key);
+
+        size_t old_size = _sorted.size();
+        _sorted.insert(_sorted.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        std::inplace_merge(_sorted.begin(), _sorted.begin() + old_size, _sorted.end(), by_key);
+    }
+
+    return added;
+}
+
+size_t ValueIndex::append(const std::vector<uint8_t> &data)
+{
+    return append(data.data(), data.size());
+}
+
+std::vector<uint64_t> ValueIndex::find_offsets(const std::string &key) const
+{
+    std::vector<uint64_t> offsets;
+
+    if (_type == kind::hashed)
+    {
+        auto it = _hashed.find(key);
+        if (it != _hashed.end())
+            offsets = it->second;
+        return offsets;
+    }
+
+    auto it = std::lower_bound(_sorted.begin(), _sorted.end(), key,
+                               [](const std::pair<std::string, uint64_t> &entry, const std::string &value) { return entry.first < value; });
+
+    for (; it != _sorted.end() && it->first == key; ++it)
+        offsets.push_back(it->second);
+
+    return offsets;
+}
+
+std::vector<uint64_t> ValueIndex::range_offsets(const std::string &low, const std::string &high) const
+{
+    std::vector<uint64_t> offsets;
+
+    auto it = std::lower_bound(_sorted.begin(), _sorted.end(), low,
+                               [](const std::pair<std::string, uint64_t> &entry, const std::string &value) { return entry.first < value; });
+
+    for (; it != _sorted.end() && it->first <= high; ++it)
+        offsets.push_back(it->second);
+
+    return offsets;
+}
+
+std::vector<uint64_t> ValueIndex::find_offsets(const msgpack_object &value) const
+{
+    std::string key;
+
+    if (!encode_key(value, key))
+        return std::vector<uint64_t>();
+
+    return find_offsets(key);
+}
+
+std::deque<Msgpack> ValueIndex::find(const msgpack_object &value) const
+{
+    return views(find_offsets(value));
+}
+
+std::deque<Msgpack> ValueIndex::find(std::string_view value) const
+{
+    std::string key;
+    encode_string(value, key);
+    return views(find_offsets(key));
+}
+
+std::deque<Msgpack> ValueIndex::find(const char *value) const
+{
+    return find(std::string_view(value));
+}
+
+std::deque<Msgpack> ValueIndex::range(const msgpack_object &low, const msgpack_object &high) const
+{
+    if (_type != kind::sorted)
+        throw std::logic_error("ValueIndex::range needs a sorted index");
+
+    std::string low_key;
+    std::string high_key;
+
+    if (!encode_key(low, low_key) || !encode_key(high, high_key))
+        return std::deque<Msgpack>();
+
+    return views(range_offsets(low_key, high_key));
+}
+
+std::deque<Msgpack> ValueIndex::range(std::string_view low, std::string_view high) const
+{
+    if (_type != kind::sorted)
+        throw std::logic_error("ValueIndex::range needs a sorted index");
+
+    std::string low_key;
+    std::string high_key;
+    encode_string(low, low_key);
+    encode_string(high, high_key);
+    return views(range_offsets(low_key, high_key));
+}
+
+Msgpack ValueIndex::record(uint64_t offset) const
+{
+    auto it = std::lower_bound(_boundaries.begin(), _boundaries.end(), offset);
+
+    if (it == _boundaries.end() || *it != offset || it + 1 == _boundaries.end())
+        return Msgpack();
+
+    return Msgpack(_data + offset, *(it + 1) - offset);
+}
+
+std::deque<Msgpack> ValueIndex::views(const std::vector<uint64_t> &offsets) const
+{
+    // Msgpack is neither movable nor assignable, a deque constructs the views in place
+    std::deque<Msgpack> out;
+
+    for (uint64_t offset : offsets)
+    {
+        auto it = std::lower_bound(_boundaries.begin(), _boundaries.end(), offset);
+        out.emplace_back(_data + offset, static_cast<size_t>(*(it + 1) - offset));
+    }
+
+    return out;
+}
+
+}
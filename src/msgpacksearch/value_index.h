@@ -0,0 +1,120 @@
+#ifndef MSGPACKSEARCH_VALUE_INDEX_H
+#define MSGPACKSEARCH_VALUE_INDEX_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "msgpacksearch.h"
+#include "path.h"
+
+namespace msgpacksearch {
+
+/**
+ * @brief Secondary index of the value found at one path in every record of a collection.
+ *
+ * The collection is a buffer of concatenated records, e.g. a mmapped file. Records whose value at the
+ * path is nil, a boolean, a number or a string are indexed, other records are counted but not indexed.
+ * Numbers compare by value across encodings, so uint 8 42, int 32 42 and float 64 42.0 are one key.
+ *
+ * A sorted index keeps (key, offset) pairs in one sorted vector and answers equality and range queries,
+ * a hashed index answers equality queries only. append() indexes the records added to a growing
+ * buffer since the previous call; query results point into the buffer passed to the last append().
+ */
+class ValueIndex {
+
+public:
+
+    enum class kind : uint8_t { sorted, hashed };
+
+    /**
+    * @param[in] path path of the indexed value in every record, see parse_path
+    * @param[in] type sorted or hashed
+    * @throws parse_error if the path is malformed
+    */
+    explicit ValueIndex(const std::string &path, kind type = kind::sorted);
+
+    /**
+    * Indexes the records appended to the collection since the previous call. The first indexed_bytes()
+    * bytes must be unchanged, the buffer itself may have moved (a file that was remapped after growing).
+    * A partially written record at the end of the buffer is left for the next call.
+    * @param[in] data start of the collection
+    * @param[in] size number of bytes in the collection
+    * @return Number of records added
+    * @throws parse_error on an invalid type byte
+    */
+    size_t append(const uint8_t *data, size_t size);
+    size_t append(const std::vector<uint8_t> &data);
+
+    /**
+    * Records whose value equals a given value
+    * @param[in] value the value, std::monostate for nil
+    * @return Views of the matching records, in collection order
+    */
+    std::deque<Msgpack> find(const msgpack_object &value) const;
+    std::deque<Msgpack> find(std::string_view value) const;
+    std::deque<Msgpack> find(const char *value) const;
+
+    /**
+    * Records whose value lies in [low, high], by the key order: nil < booleans < numbers < strings
+    * @param[in] low lower bound, inclusive
+    * @param[in] high upper bound, inclusive
+    * @return Views of the matching records, sorted by value
+    * @throws std::logic_error on a hashed index
+    */
+    std::deque<Msgpack> range(const msgpack_object &low, const msgpack_object &high) const;
+    std::deque<Msgpack> range(std::string_view low, std::string_view high) const;
+
+    /// Offsets of the records whose value equals a given value, in collection order
+    std::vector<uint64_t> find_offsets(const msgpack_object &value) const;
+
+    /**
+    * View of one record
+    * @param[in] offset offset of the record, as returned by find_offsets
+    * @return Msgpack reading the buffer passed to the last append()
+    */
+    Msgpack record(uint64_t offset) const;
+
+    /// Number of records scanned so far
+    size_t records() const { return _boundaries.size() - 1; }
+
+    /// Number of records with an indexable value at the path
+    size_t entries() const { return _entries; }
+
+    /// Number of leading bytes of the collection that were indexed
+    size_t indexed_bytes() const { return _boundaries.back(); }
+
+    kind type() const { return _type; }
+
+    /**
+    * Encodes a value as an index key, keys compare (bytewise) in value order
+    * @param[in] value points at an encoded value
+    * @param[out] key the key
+    * @return false if the value cannot be indexed (containers, bin, ext, NaN)
+    */
+    static bool encode_key(const uint8_t *value, std::string &key);
+    static bool encode_key(const msgpack_object &value, std::string &key);
+
+private:
+    std::deque<Msgpack> views(const std::vector<uint64_t> &offsets) const;
+    std::vector<uint64_t> find_offsets(const std::string &key) const;
+    std::vector<uint64_t> range_offsets(const std::string &low, const std::string &high) const;
+
+    const msgpack_path _path;
+    const kind _type;
+    const uint8_t *_data = nullptr;
+    std::vector<uint64_t> _boundaries{0}; // record offsets, the last one is indexed_bytes()
+    size_t _entries = 0;
+
+    std::vector<std::pair<std::string, uint64_t>> _sorted; // by key, then offset
+    std::unordered_map<std::string, std::vector<uint64_t>> _hashed;
+};
+
+}
+
+#endif //MSGPACKSEARCH_VALUE_INDEX_H
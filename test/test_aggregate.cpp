@@ -0,0 +1,185 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/aggregate.h"
+#include "msgpacksearch/error.h"
+#include "test_records.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+std::vector<uint8_t> make_records()
+{
+    return json_records({R"({"latency": 10, "level": "info"})",
+                         R"({"latency": 2.5, "level": "warn"})",
+                         R"({"latency": -4, "level": "info"})",
+                         R"({"latency": "slow", "level": 3})", // not a number
+                         R"({"latency": 100, "level": null})",
+                         R"({})"}); // neither value nor key
+}
+
+/// make_records() repeated, so the stream spans many chunks
+std::vector<uint8_t> make_stream(size_t copies)
+{
+    std::vector<uint8_t> records = make_records();
+    std::vector<uint8_t> stream;
+
+    for (size_t copy = 0; copy < copies; copy++)
+        stream.insert(stream.end(), records.begin(), records.end());
+
+    return stream;
+}
+
+void expect_equal(const numeric_aggregate &expected, const numeric_aggregate &actual)
+{
+    EXPECT_EQ(expected.records, actual.records);
+    EXPECT_EQ(expected.count, actual.count);
+    EXPECT_DOUBLE_EQ(expected.sum, actual.sum);
+    EXPECT_EQ(expected.min, actual.min);
+    EXPECT_EQ(expected.max, actual.max);
+}
+
+void expect_equal(const aggregate_result &expected, const aggregate_result &actual)
+{
+    expect_equal(expected.total, actual.total);
+    EXPECT_EQ(expected.buckets, actual.buckets);
+    EXPECT_EQ(expected.below, actual.below);
+    EXPECT_EQ(expected.above, actual.above);
+    ASSERT_EQ(expected.groups.size(), actual.groups.size());
+
+    for (const auto &[key, group] : expected.groups)
+    {
+        ASSERT_EQ(1, actual.groups.count(key)) << key;
+        expect_equal(group, actual.groups.at(key));
+    }
+}
+
+}
+
+TEST(aggregate, Totals)
+{
+    std::vector<uint8_t> records = make_records();
+    aggregate_query query;
+    query.value_path = "latency";
+    query.histogram = histogram_spec{0, 20, 4};
+
+    aggregate_result result = aggregate(records.data(), records.size(), query);
+
+    EXPECT_EQ(6, result.total.records);
+    EXPECT_EQ(4, result.total.count);
+    EXPECT_DOUBLE_EQ(108.5, result.total.sum);
+    EXPECT_EQ(-4, result.total.min);
+    EXPECT_EQ(100, result.total.max);
+    EXPECT_DOUBLE_EQ(108.5 / 4, result.total.mean());
+    EXPECT_EQ(std::vector<uint64_t>({1, 0, 1, 0}), result.buckets);
+    EXPECT_EQ(1, result.below);
+    EXPECT_EQ(1, result.above);
+    EXPECT_TRUE(result.groups.empty());
+
+    // only counting
+    result = aggregate(records.data(), records.size(), aggregate_query());
+    EXPECT_EQ(6, result.total.records);
+    EXPECT_EQ(0, result.total.count);
+    EXPECT_TRUE(std::isnan(result.total.mean()));
+    EXPECT_TRUE(result.buckets.empty());
+
+    query.value_path = "latency[";
+    EXPECT_THROW(aggregate(records.data(), records.size(), query), parse_error);
+}
+
+TEST(aggregate, GroupBy)
+{
+    std::vector<uint8_t> records = make_records();
+    aggregate_query query;
+    query.value_path = "latency";
+    query.group_by = "level";
+
+    aggregate_result result = aggregate(records.data(), records.size(), query);
+
+    ASSERT_EQ(4, result.groups.size());
+    EXPECT_EQ(2, result.groups["info"].records);
+    EXPECT_DOUBLE_EQ(6, result.groups["info"].sum);
+    EXPECT_EQ(-4, result.groups["info"].min);
+    EXPECT_EQ(1, result.groups["warn"].count);
+    EXPECT_EQ(1, result.groups["3"].records);
+    EXPECT_EQ(0, result.groups["3"].count);
+    EXPECT_EQ(2, result.groups["null"].records);
+    EXPECT_EQ(1, result.groups["null"].count);
+    EXPECT_EQ(100, result.groups["null"].max);
+}
+
+TEST(aggregate, Parallel)
+{
+    std::vector<uint8_t> stream = make_stream(1000);
+    aggregate_query query;
+    query.value_path = "latency";
+    query.group_by = "level";
+    query.histogram = histogram_spec{-10, 110, 12};
+    query.chunk_bytes = 1000;
+
+    aggregate_result single = aggregate(stream.data(), stream.size(), query);
+    EXPECT_EQ(6000, single.total.records);
+    EXPECT_EQ(2000, single.groups["info"].records);
+
+    ThreadPool pool(4);
+    EXPECT_EQ(4, pool.size());
+    expect_equal(single, aggregate(stream.data(), stream.size(), query, &pool));
+
+    // the same documents through a side index, chunked at its document boundaries
+    std::string data_path = ::testing::TempDir() + "msgpacksearch_aggregate.msgpack";
+    std::string index_path = SideIndex::default_path(data_path);
+    {
+        std::ofstream out(data_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(stream.data()), stream.size());
+    }
+
+    std::unique_ptr<SideIndex> index = SideIndex::open_or_build(data_path, index_path);
+    ASSERT_NE(nullptr, index);
+    expect_equal(single, aggregate(*index, query));
+    expect_equal(single, aggregate(*index, query, &pool));
+
+    index.reset();
+    std::remove(data_path.c_str());
+    std::remove(index_path.c_str());
+}
+
+TEST(aggregate, TruncatedStream)
+{
+    // {"v": 1} then a map whose second member is missing
+    std::vector<uint8_t> stream = {0x81, 0xa1, 'v', 0x01, 0x82, 0xa1, 'v', 0x01};
+    aggregate_query query;
+    query.value_path = "v";
+    query.chunk_bytes = 1;
+
+    ThreadPool pool(2);
+    aggregate_result result = aggregate(stream.data(), stream.size(), query, &pool);
+    EXPECT_EQ(1, result.total.records);
+    EXPECT_EQ(1, result.total.sum);
+    expect_equal(result, aggregate(stream.data(), stream.size(), query));
+
+    std::vector<uint8_t> invalid = {0x81, 0xa1, 'v', 0x01, 0xc1};
+    EXPECT_THROW(aggregate(invalid.data(), invalid.size(), query, &pool), parse_error);
+    EXPECT_THROW(aggregate(invalid.data(), invalid.size(), query), parse_error);
+}
+
+TEST(thread_pool, Submit)
+{
+    ThreadPool pool(2);
+    std::vector<std::future<size_t>> results;
+
+    for (size_t task = 0; task < 100; task++)
+        results.push_back(pool.submit([task] { return task * task; }));
+
+    for (size_t task = 0; task < 100; task++)
+        EXPECT_EQ(task * task, results[task].get());
+
+    std::future<void> failed = pool.submit([] { throw std::runtime_error("task"); });
+    EXPECT_THROW(failed.get(), std::runtime_error);
+}
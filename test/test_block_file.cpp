@@ -0,0 +1,476 @@
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/block_file.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/packer.h"
+#include "msgpacksearch/thread_pool.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// Record i: {"id": i, "price": i % 1000 or a string every 7 records, "pad": "..."}
+std::vector<uint8_t> make_record(uint64_t i)
+{
+    std::vector<uint8_t> record;
+    Packer packer(record);
+
+    packer.pack_map(3);
+    packer.pack_str("id");
+    packer.pack_uint(i);
+    packer.pack_str("price");
+    if (i % 7 == 3)
+        packer.pack_str("n/a");
+    else
+        packer.pack_double((i % 1000) + 0.5);
+    packer.pack_str("pad");
+    packer.pack_str(std::string(i % 50, 'x'));
+
+    return record;
+}
+
+std::string write_records(const std::string &name, uint64_t nmb_records, const block_writer_options &options)
+{
+    std::string path = ::testing::TempDir() + name;
+    BlockWriter writer(path, options);
+
+    for (uint64_t i = 0; i < nmb_records; i++)
+        writer.append(make_record(i));
+
+    EXPECT_EQ(nmb_records, writer.records());
+    writer.finish();
+    return path;
+}
+
+/// Record i of the zone map tests, region and latency grow along the stream
+std::vector<uint8_t> make_event(uint64_t i)
+{
+    std::vector<uint8_t> record;
+    Packer packer(record);
+    bool has_user = i % 3 == 0 || i % 5 != 0;
+
+    packer.pack_map(has_user ? 6 : 5);
+    packer.pack_str("id");
+    packer.pack_uint(i);
+    packer.pack_str("region");
+    packer.pack_str("r" + std::to_string(i / 1000));
+    packer.pack_str("latency");
+    packer.pack_double((i / 1000) * 100.0 + i % 100);
+    packer.pack_str("level");
+    packer.pack_str(i % 500 ? "info" : "error");
+    packer.pack_str("ok");
+    packer.pack_bool(i % 2 == 0);
+
+    if (has_user)
+    {
+        packer.pack_str("user");
+        if (i % 3 == 0)
+            packer.pack_nil();
+        else
+            packer.pack_uint(i % 50);
+    }
+
+    return record;
+}
+
+std::vector<block_codec> available_codecs()
+{
+    std::vector<block_codec> codecs;
+
+    for (block_codec codec : {block_codec::none, block_codec::zstd, block_codec::lz4})
+    {
+        if (codec_available(codec))
+            codecs.push_back(codec);
+    }
+
+    return codecs;
+}
+
+}
+
+TEST(block_file, RoundTrip)
+{
+    ThreadPool pool(3);
+
+    for (block_codec codec : available_codecs())
+    {
+        block_writer_options options;
+        options.codec = codec;
+        options.block_bytes = 4096;
+        std::string path = write_records("msgpacksearch_block_file.msgpack", 5000, options);
+
+        BlockFile file(path);
+        EXPECT_EQ(codec, file.codec());
+        EXPECT_EQ(5000, file.records());
+        EXPECT_GT(file.blocks(), 10u);
+        EXPECT_TRUE(file.indexed_path().empty());
+
+        uint64_t first_record = 0;
+        uint64_t stream_offset = 0;
+        std::vector<size_t> all;
+
+        for (size_t block = 0; block < file.blocks(); block++)
+        {
+            const block_info &info = file.block(block);
+            EXPECT_EQ(first_record, info.first_record);
+            EXPECT_EQ(stream_offset, info.stream_offset);
+            EXPECT_LE(info.size, options.block_bytes);
+            EXPECT_FALSE(info.has_range);
+            EXPECT_EQ(block, file.find_block(info.first_record));
+            EXPECT_EQ(block, file.find_block(info.first_record + info.nmb_records - 1));
+
+            decoded_block decoded = file.read_block(block);
+            EXPECT_EQ(info.size, decoded.size);
+
+            first_record += info.nmb_records;
+            stream_offset += info.size;
+            all.push_back(block);
+        }
+
+        EXPECT_EQ(file.blocks(), file.find_block(5000));
+        EXPECT_THROW(file.read_block(file.blocks()), std::out_of_range);
+
+        // every record in order, on the calling thread and on the pool
+        for (ThreadPool *threads : {static_cast<ThreadPool *>(nullptr), &pool})
+        {
+            uint64_t expected = 0;
+            size_t visited = file.scan(all, [&expected](const Msgpack &record, uint64_t index) {
+                EXPECT_EQ(expected, index);
+                EXPECT_EQ(make_record(index), std::vector<uint8_t>(record.data(), record.data() + record.size()));
+                EXPECT_EQ(index, record.get_u64("id"));
+                expected++;
+                return true;
+            }, threads);
+
+            EXPECT_EQ(5000, visited);
+            EXPECT_EQ(5000, expected);
+
+            // the visitor stops the scan, blocks still decompressing are waited for
+            size_t calls = 0;
+            EXPECT_EQ(10, file.scan(all, [&calls](const Msgpack &, uint64_t) { return ++calls < 10; }, threads));
+        }
+
+        std::remove(path.c_str());
+    }
+}
+
+TEST(block_file, RandomAccess)
+{
+    ThreadPool pool(2);
+    block_writer_options options;
+    options.block_bytes = 1000;
+    options.indexed_path = "price";
+    std::string path = write_records("msgpacksearch_block_file_ranges.msgpack", 3000, options);
+
+    BlockFile file(path);
+    EXPECT_EQ("price", file.indexed_path());
+
+    for (auto [first, count] : std::vector<std::pair<uint64_t, uint64_t>>{{0, 1}, {1234, 100}, {2999, 5}, {0, 3000}, {1500, UINT64_MAX}})
+    {
+        uint64_t expected = first;
+        size_t visited = file.scan_records(first, count, [&expected](const Msgpack &record, uint64_t index) {
+            EXPECT_EQ(expected++, index);
+            EXPECT_EQ(index, record.get_u64("id"));
+            return true;
+        }, &pool);
+
+        EXPECT_EQ(std::min<uint64_t>(count, 3000 - first), visited) << first;
+    }
+
+    EXPECT_EQ(0, file.scan_records(3000, 10, [](const Msgpack &, uint64_t) { return true; }));
+    EXPECT_EQ(0, file.scan_records(10, 0, [](const Msgpack &, uint64_t) { return true; }));
+
+    // min / max skip the strings; a range only selects blocks that may hold matching records
+    std::vector<size_t> selected = file.blocks_in_range(100, 110);
+    EXPECT_FALSE(selected.empty());
+    EXPECT_LT(selected.size(), file.blocks() / 2);
+
+    size_t matches = 0;
+    file.scan(selected, [&matches](const Msgpack &record, uint64_t) {
+        std::optional<double> price = record.try_get_double("price");
+        matches += price && *price >= 100 && *price <= 110;
+        return true;
+    });
+
+    size_t expected_matches = 0;
+    for (uint64_t i = 0; i < 3000; i++)
+        expected_matches += i % 7 != 3 && i % 1000 >= 100 && i % 1000 < 110;
+    EXPECT_EQ(expected_matches, matches);
+
+    for (size_t block = 0; block < file.blocks(); block++)
+    {
+        EXPECT_TRUE(file.block(block).has_range);
+        EXPECT_LE(file.block(block).min, file.block(block).max);
+    }
+
+    EXPECT_TRUE(file.blocks_in_range(2000, 3000).empty());
+    std::remove(path.c_str());
+}
+
+TEST(block_file, ZoneMaps)
+{
+    using op_type = block_predicate::op_type;
+    const uint64_t nmb_records = 10000;
+
+    std::string path = ::testing::TempDir() + "msgpacksearch_block_file_zones.msgpack";
+    block_writer_options options;
+    options.block_bytes = 2000;
+    options.zone_paths = {"region", "latency", "user", "level", "ok"};
+
+    {
+        BlockWriter writer(path, options);
+        for (uint64_t i = 0; i < nmb_records; i++)
+            writer.append(make_event(i));
+        writer.finish();
+    }
+
+    ThreadPool pool(2);
+    BlockFile file(path);
+    ASSERT_EQ(options.zone_paths, file.zone_paths());
+    EXPECT_GT(file.blocks(), 100u);
+
+    uint64_t nulls = 0;
+    uint64_t values = 0;
+    for (size_t block = 0; block < file.blocks(); block++)
+    {
+        nulls += file.zone(block, 2).nulls;
+        values += file.zone(block, 2).values;
+        EXPECT_EQ(0, file.zone(block, 0).values);
+        EXPECT_EQ(file.block(block).nmb_records, file.zone(block, 1).values);
+        EXPECT_NE(nullptr, file.zone(block, 0).bloom);
+    }
+
+    uint64_t expected_nulls = 0;
+    for (uint64_t i = 0; i < nmb_records; i++)
+        expected_nulls += i % 3 == 0 || i % 5 == 0;
+    EXPECT_EQ(expected_nulls, nulls);
+    EXPECT_EQ(nmb_records - expected_nulls, values);
+
+    /// predicates, the expected records, and the most blocks they may read
+    struct query
+    {
+        std::vector<block_predicate> predicates;
+        std::function<bool(uint64_t)> expected;
+        size_t max_blocks;
+    };
+
+    const size_t all = file.blocks();
+    const size_t one_region = all / 10 + 2;
+
+    std::vector<query> queries = {
+        {{{"region", op_type::eq, std::string("r7")}}, [](uint64_t i) { return i / 1000 == 7; }, one_region},
+        {{{"region", op_type::eq, std::string("r77")}}, [](uint64_t) { return false; }, all / 20},
+        {{{"latency", op_type::ge, 850.0}}, [](uint64_t i) { return (i / 1000) * 100 + i % 100 >= 850; }, 2 * one_region},
+        {{{"latency", op_type::lt, 0.0}}, [](uint64_t) { return false; }, 0},
+        {{{"latency", op_type::eq, 342.0}}, [](uint64_t i) { return i / 1000 == 3 && i % 100 == 42; }, one_region},
+        {{{"region", op_type::eq, std::string("r3")}, {"latency", op_type::le, 310.0}},
+            [](uint64_t i) { return i / 1000 == 3 && i % 100 <= 10; }, one_region},
+        {{{"user", op_type::is_null, 0.0}}, [](uint64_t i) { return i % 3 == 0 || i % 5 == 0; }, all},
+        {{{"user", op_type::not_null, 0.0}}, [](uint64_t i) { return i % 3 != 0 && i % 5 != 0; }, all},
+        {{{"user", op_type::eq, 7.0}}, [](uint64_t i) { return i % 3 != 0 && i % 5 != 0 && i % 50 == 7; }, all},
+        {{{"level", op_type::eq, std::string("error")}}, [](uint64_t i) { return i % 500 == 0; }, all},
+        {{{"ok", op_type::eq, true}, {"region", op_type::eq, std::string("r0")}},
+            [](uint64_t i) { return i % 2 == 0 && i < 1000; }, one_region},
+        {{{"id", op_type::eq, 4321.0}}, [](uint64_t i) { return i == 4321; }, all},
+        {{}, [](uint64_t) { return true; }, all},
+    };
+
+    for (size_t q = 0; q < queries.size(); q++)
+    {
+        std::vector<uint64_t> expected;
+        for (uint64_t i = 0; i < nmb_records; i++)
+        {
+            if (queries[q].expected(i))
+                expected.push_back(i);
+        }
+
+        std::vector<uint64_t> found;
+        size_t visited = file.scan_where(queries[q].predicates, [&found](const Msgpack &record, uint64_t index) {
+            EXPECT_EQ(index, record.get_u64("id"));
+            found.push_back(index);
+            return true;
+        }, &pool);
+
+        EXPECT_EQ(expected, found) << q;
+        EXPECT_EQ(found.size(), visited) << q;
+        EXPECT_LE(file.blocks_matching(queries[q].predicates).size(), queries[q].max_blocks) << q;
+
+        // every block holding a match is kept
+        for (uint64_t index : expected)
+            EXPECT_TRUE(file.may_match(file.find_block(index), queries[q].predicates)) << q << " " << index;
+    }
+
+    // the error level is in few blocks, its bloom filter skips most of the others
+    EXPECT_LT(file.blocks_matching({{"level", op_type::eq, std::string("error")}}).size(), all / 2);
+
+    EXPECT_THROW(file.blocks_matching({{"latency", op_type::lt, std::string("x")}}), std::invalid_argument);
+    EXPECT_THROW(file.blocks_matching({{"id", op_type::gt, true}}), std::invalid_argument);
+    EXPECT_THROW(file.scan_where({{"a..b", op_type::is_null, 0.0}}, [](const Msgpack &, uint64_t) { return true; }), parse_error);
+
+    // without bloom filters, only min / max and null counts prune
+    options.bloom_bits_per_value = 0;
+    {
+        BlockWriter writer(path, options);
+        for (uint64_t i = 0; i < nmb_records; i++)
+            writer.append(make_event(i));
+        writer.finish();
+    }
+
+    BlockFile plain(path);
+    EXPECT_EQ(nullptr, plain.zone(0, 0).bloom);
+    EXPECT_EQ(all, plain.blocks_matching({{"region", op_type::eq, std::string("r7")}}).size());
+    EXPECT_LE(plain.blocks_matching({{"latency", op_type::eq, 342.0}}).size(), one_region);
+
+    std::remove(path.c_str());
+}
+
+TEST(block_file, Version1)
+{
+    // written by the first version of BlockWriter on a little endian host: four records {"n": 10 * i,
+    // "s": "even" / "odd"}, a block each, "n" indexed, no zone maps
+    const std::vector<uint8_t> bytes = {
+        0x82, 0xa1, 0x6e, 0x00, 0xa1, 0x73, 0xa4, 0x65, 0x76, 0x65, 0x6e, 0x82, 0xa1, 0x6e, 0x0a, 0xa1,
+        0x73, 0xa3, 0x6f, 0x64, 0x64, 0x82, 0xa1, 0x6e, 0x14, 0xa1, 0x73, 0xa4, 0x65, 0x76, 0x65, 0x6e,
+        0x82, 0xa1, 0x6e, 0x1e, 0xa1, 0x73, 0xa3, 0x6f, 0x64, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x3a, 0x5e, 0x30, 0x0f, 0x6e, 0xe5, 0xc7, 0x43, 0x0b, 0x00, 0x00, 0x00, 0x0b, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x80, 0x80, 0x58, 0x54, 0xc8, 0xcf, 0x07, 0xbe, 0x0a, 0x00, 0x00, 0x00, 0x0a, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x24, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x40, 0x15, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x15, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0xa6, 0x6c, 0x75, 0xe6, 0x50, 0xa1, 0x31, 0x05, 0x0b, 0x00, 0x00, 0x00, 0x0b, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x34, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x40, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0xcb, 0x83, 0xb0, 0x68, 0x6d, 0xd0, 0x1c, 0x9f, 0x0a, 0x00, 0x00, 0x00, 0x0a, 0x00,
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x3e, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x40, 0x6e, 0x04, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2a, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x82, 0x92, 0x3f, 0xbf, 0x17, 0xd7, 0x37, 0x52, 0x01, 0x00, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x04, 0x03, 0x02, 0x01, 0x00, 0x00, 0x00, 0x00, 0x4c, 0x85, 0x39, 0x35, 0x2c,
+        0xe2, 0x7e, 0x50, 0x4d, 0x53, 0x47, 0x50, 0x42, 0x4c, 0x4b, 0x00};
+
+    std::string path = ::testing::TempDir() + "msgpacksearch_block_file_v1.msgpack";
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+
+    BlockFile file(path);
+    EXPECT_EQ(block_codec::none, file.codec());
+    EXPECT_EQ("n", file.indexed_path());
+    EXPECT_TRUE(file.zone_paths().empty());
+    ASSERT_EQ(4, file.blocks());
+    EXPECT_EQ(4, file.records());
+    EXPECT_EQ(2, file.find_block(2));
+    EXPECT_EQ(std::vector<size_t>({1, 2}), file.blocks_in_range(5, 25));
+
+    std::vector<uint64_t> values;
+    EXPECT_EQ(4, file.scan_records(0, 4, [&values](const Msgpack &record, uint64_t index) {
+        EXPECT_EQ(index % 2 ? "odd" : "even", record.get_string_view("s"));
+        values.push_back(record.get_u64("n"));
+        return true;
+    }));
+    EXPECT_EQ(std::vector<uint64_t>({0, 10, 20, 30}), values);
+
+    // without zone maps every block may match, the predicates are evaluated on the records
+    using op_type = block_predicate::op_type;
+    std::vector<block_predicate> predicates = {{"n", op_type::ge, 15.0}, {"s", op_type::eq, std::string("odd")}};
+    EXPECT_EQ(std::vector<size_t>({0, 1, 2, 3}), file.blocks_matching(predicates));
+
+    std::vector<uint64_t> matches;
+    file.scan_where(predicates, [&matches](const Msgpack &, uint64_t index) {
+        matches.push_back(index);
+        return true;
+    });
+    EXPECT_EQ(std::vector<uint64_t>({3}), matches);
+
+    std::remove(path.c_str());
+}
+
+TEST(block_file, Errors)
+{
+    std::string path = ::testing::TempDir() + "msgpacksearch_block_file_errors.msgpack";
+
+    {
+        BlockWriter writer(path);
+        std::vector<uint8_t> two = {0x01, 0x02};
+        std::vector<uint8_t> truncated = {0x92, 0x01};
+        EXPECT_THROW(writer.append(two), parse_error);
+        EXPECT_THROW(writer.append(truncated), parse_error);
+        EXPECT_THROW(writer.append(nullptr, 0), parse_error);
+        EXPECT_EQ(0, writer.records());
+    }
+
+    // an unfinished writer leaves no file
+    EXPECT_THROW(BlockFile file(path), std::system_error);
+
+    for (block_codec codec : {block_codec::zstd, block_codec::lz4})
+    {
+        if (!codec_available(codec))
+        {
+            block_writer_options options;
+            options.codec = codec;
+            EXPECT_THROW(BlockWriter(path, options), std::invalid_argument);
+        }
+    }
+
+    block_writer_options options;
+    options.block_bytes = 100;
+    path = write_records("msgpacksearch_block_file_errors.msgpack", 200, options);
+
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    auto rewrite = [&path](const std::vector<char> &content) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), content.size());
+    };
+
+    // a flipped byte in a block is caught by its checksum when the block is read
+    std::vector<char> corrupted = bytes;
+    corrupted[10] ^= 0x40;
+    rewrite(corrupted);
+    {
+        BlockFile file(path);
+        EXPECT_THROW(file.read_block(0), parse_error);
+        EXPECT_NO_THROW(file.read_block(1));
+        EXPECT_THROW(file.scan({1, 0}, [](const Msgpack &, uint64_t) { return true; }), parse_error);
+
+        // with the pool, the failing block is first in line and the blocks after it are still decompressing
+        ThreadPool pool(2);
+        EXPECT_THROW(file.scan({0, 1, 2, 3}, [](const Msgpack &, uint64_t) { return true; }, &pool), parse_error);
+        EXPECT_THROW(file.scan({1, 0, 2, 3}, [](const Msgpack &, uint64_t) { return true; }, &pool), parse_error);
+    }
+
+    // a flipped byte in the index or the trailer, a truncated file, not a block file
+    for (size_t offset : {bytes.size() - 100, bytes.size() - 20, bytes.size() - 1})
+    {
+        corrupted = bytes;
+        corrupted[offset] ^= 0x01;
+        rewrite(corrupted);
+        EXPECT_THROW(BlockFile file(path), parse_error) << offset;
+    }
+
+    rewrite(std::vector<char>(bytes.begin(), bytes.end() - 1));
+    EXPECT_THROW(BlockFile file(path), parse_error);
+    rewrite(std::vector<char>(bytes.begin() + 1, bytes.end()));
+    EXPECT_THROW(BlockFile file(path), parse_error);
+    rewrite({'a', 'b'});
+    EXPECT_THROW(BlockFile file(path), parse_error);
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,115 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <error.h>
+
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/canonical.h"
+#include "msgpacksearch/json.h"
+
+
+using namespace msgpacksearch;
+
+TEST(canonical, SortsKeysAndShrinksEncodings)
+{
+    // {"b": 1, "a": [uint16 2, int64 3], "c": {"z": 1, "y": 2}}
+    std::vector<uint8_t> data = {0xDF, 0x00, 0x00, 0x00, 0x03,
+                                 0xA1, 'b', 0x01,
+                                 0xA1, 'a', 0xDD, 0x00, 0x00, 0x00, 0x02, 0xCD, 0x00, 0x02, 0xD3, 0, 0, 0, 0, 0, 0, 0, 0x03,
+                                 0xD9, 0x01, 'c', 0x82, 0xA1, 'z', 0x01, 0xA1, 'y', 0x02};
+
+    std::vector<uint8_t> expected = {0x83,
+                                     0xA1, 'a', 0x92, 0x02, 0x03,
+                                     0xA1, 'b', 0x01,
+                                     0xA1, 'c', 0x82, 0xA1, 'y', 0x02, 0xA1, 'z', 0x01};
+
+    EXPECT_EQ(expected, canonicalize(data.data(), data.size()));
+
+    // key order of the input does not matter
+    std::vector<uint8_t> other = json_to_msgpack(R"({"c": {"y": 2, "z": 1}, "b": 1, "a": [2, 3]})");
+    EXPECT_EQ(expected, canonicalize(other.data(), other.size()));
+}
+
+TEST(canonical, BytewiseOrder)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"b": 1, "aa": 2, "a": 3, "B": 4})");
+    std::vector<uint8_t> canonical = canonicalize(data.data(), data.size());
+
+    std::vector<uint8_t> expected = {0x84, 0xA1, 'B', 0x04, 0xA1, 'a', 0x03, 0xA2, 'a', 'a', 0x02, 0xA1, 'b', 0x01};
+    EXPECT_EQ(expected, canonical);
+}
+
+TEST(canonical, InvalidInput)
+{
+    std::vector<uint8_t> data = {0x91, 0xC1};
+    EXPECT_THROW(canonicalize(data.data(), data.size()), msgpacksearch::parse_error);
+}
+
+TEST(canonical, TruncatedInput)
+{
+    // a header announcing more than the input holds is rejected before anything past the input is read
+    std::vector<std::vector<uint8_t>> inputs = {
+        {0xdb, 0x00, 0x00, 0x10, 0x00},       // str 32 of 4096 bytes
+        {0xdb, 0x00},                         // str 32 with a partial length
+        {0xdf, 0xff, 0xff, 0xff, 0xff, 0xa1}, // map 32 of 2^32 - 1 pairs
+        {0x92, 0x01},                         // array with a missing element
+        {0x81, 0xa1, 'a'},                    // map with a missing value
+        {0xc7, 0x08, 0x01, 0x00},             // ext 8 of 8 bytes
+    };
+
+    for (const std::vector<uint8_t> &data : inputs)
+    {
+        // exact size copies, so that a read past the end shows under a sanitizer
+        std::unique_ptr<uint8_t[]> copy(new uint8_t[data.size()]);
+        std::copy(data.begin(), data.end(), copy.get());
+        EXPECT_THROW(canonicalize(copy.get(), data.size()), msgpacksearch::parse_error);
+    }
+
+    // a complete object followed by more bytes reads only the object
+    std::vector<uint8_t> data = {0x92, 0x01, 0x02, 0xc1};
+    std::vector<uint8_t> out;
+    EXPECT_EQ(3, canonicalize(data.data(), data.size(), out));
+    EXPECT_EQ(std::vector<uint8_t>({0x92, 0x01, 0x02}), out);
+}
+
+TEST(find, sorted_keys)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"d": 4, "a": 1, "c": 3, "b": 2})");
+    data = canonicalize(data.data(), data.size());
+
+    Msgpack msgpck(data);
+    msgpck.set_sorted_keys(true);
+
+    EXPECT_EQ(3, msgpck.get_int("c"));
+    EXPECT_EQ(std::monostate(), std::get<std::monostate>(msgpck.get("bb")));
+    EXPECT_EQ(std::monostate(), std::get<std::monostate>(msgpck.get("e")));
+}
+
+TEST(find, map_index)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"a": 1, "b": 2, "c": 3, "d": 4, "e": 5})");
+    Msgpack msgpck(data);
+    msgpack_map map = std::get<msgpack_map>(msgpck.parse_data(data.data()).second);
+
+    map_index index = msgpck.build_map_index(map);
+    EXPECT_TRUE(index.sorted);
+    EXPECT_EQ(5, index.key_offsets.size());
+
+    for (int i = 0; i < 5; i++)
+    {
+        const uint8_t *value = msgpck.find_map_key(index, std::string(1, 'a' + i));
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(*value, i + 1);
+    }
+    EXPECT_EQ(nullptr, msgpck.find_map_key(index, "ab"));
+    EXPECT_EQ(nullptr, msgpck.find_map_key(index, "f"));
+
+    // unsorted maps still work through a linear scan of the index
+    data = json_to_msgpack(R"({"b": 2, "a": 1})");
+    map = std::get<msgpack_map>(msgpck.parse_data(data.data()).second);
+    index = msgpck.build_map_index(map);
+    EXPECT_FALSE(index.sorted);
+    EXPECT_EQ(*msgpck.find_map_key(index, "a"), 1);
+}
@@ -0,0 +1,94 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/columnar.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/json.h"
+
+
+using namespace msgpacksearch;
+
+TEST(columnar, Extract)
+{
+    std::vector<uint8_t> stream;
+    for (const char *record : {R"({"id": 1, "price": 2.5, "ok": true, "name": "a", "tags": ["x", "y"], "meta": {"host": "h1"}})",
+                               R"({"id": 2, "price": 3, "name": 7, "meta": {"host": "h2", "id": 9}})",
+                               R"({"id": 3.5, "ok": false, "tags": ["z"], "id": 4})",
+                               R"([1, 2, 3])"})
+    {
+        std::vector<uint8_t> encoded = json_to_msgpack(record);
+        stream.insert(stream.end(), encoded.begin(), encoded.end());
+    }
+
+    ColumnarExtractor extractor({{"id", column_type::int64},
+                                 {"price", column_type::float64},
+                                 {"ok", column_type::boolean},
+                                 {"name", column_type::string},
+                                 {"tags[1]", column_type::string},
+                                 {"meta.host", column_type::string},
+                                 {"id", column_type::float64}});
+
+    record_batch batch = extractor.make_batch(16);
+    ASSERT_EQ(7, batch.columns.size());
+
+    // two batches: 3 rows then the rest
+    size_t consumed = extractor.extract(stream.data(), stream.size(), batch, 3);
+    EXPECT_EQ(3, batch.rows);
+    EXPECT_EQ(consumed + extractor.extract(stream.data() + consumed, stream.size() - consumed, batch), stream.size());
+    ASSERT_EQ(4, batch.rows);
+
+    const column &id = batch.columns[0];
+    EXPECT_EQ("id", id.path);
+    EXPECT_EQ(std::vector<int64_t>({1, 2, 0, 0}), id.int64_values);
+    EXPECT_FALSE(id.is_null(1));
+    EXPECT_TRUE(id.is_null(2)); // 3.5 is not an int64, the duplicate "id": 4 is ignored
+    EXPECT_EQ(2, id.null_count);
+
+    EXPECT_EQ(std::vector<double>({2.5, 3, 0, 0}), batch.columns[1].float64_values);
+    EXPECT_EQ(std::vector<uint8_t>({1, 0, 0, 0}), batch.columns[2].boolean_values);
+    EXPECT_FALSE(batch.columns[2].is_null(2));
+    EXPECT_EQ(2, batch.columns[2].null_count);
+
+    const column &name = batch.columns[3];
+    EXPECT_EQ("a", name.string_values[0]);
+    EXPECT_TRUE(name.is_null(1));
+
+    EXPECT_EQ("y", batch.columns[4].string_values[0]);
+    EXPECT_TRUE(batch.columns[4].is_null(2));
+    EXPECT_EQ("h2", batch.columns[5].string_values[1]);
+    EXPECT_EQ(3.5, batch.columns[6].float64_values[2]);
+
+    batch.clear();
+    EXPECT_EQ(0, batch.rows);
+    EXPECT_TRUE(batch.columns[0].int64_values.empty());
+
+    // validity words roll over every 64 rows
+    std::vector<uint8_t> single = json_to_msgpack(R"({"id": 5})");
+    for (int row = 0; row < 130; row++)
+        extractor.extract_record(single.data(), batch);
+    EXPECT_EQ(3, batch.columns[0].validity.size());
+    EXPECT_FALSE(batch.columns[0].is_null(129));
+    EXPECT_EQ(0, batch.columns[0].null_count);
+    EXPECT_EQ(130, batch.columns[1].null_count);
+}
+
+TEST(columnar, TruncatedStream)
+{
+    ColumnarExtractor extractor({{"v", column_type::int64}});
+    record_batch batch = extractor.make_batch();
+
+    // {"v": 1} then a map whose second member is missing, and a key running past the end
+    std::vector<uint8_t> stream = {0x81, 0xa1, 'v', 0x01, 0x82, 0xa1, 'v', 0x01};
+    EXPECT_EQ(4, extractor.extract(stream.data(), stream.size(), batch));
+    EXPECT_EQ(1, batch.rows);
+    EXPECT_EQ(0, extractor.extract(stream.data() + 4, stream.size() - 4, batch));
+
+    std::vector<uint8_t> key = {0x81, 0xa5, 'v'};
+    EXPECT_EQ(0, extractor.extract(key.data(), key.size(), batch));
+    EXPECT_EQ(1, batch.rows);
+
+    std::vector<uint8_t> invalid = {0x81, 0xa1, 'v', 0xc1};
+    EXPECT_THROW(extractor.extract(invalid.data(), invalid.size(), batch), parse_error);
+}
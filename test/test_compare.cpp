@@ -0,0 +1,161 @@
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/canonical.h"
+#include "msgpacksearch/compare.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/json.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+std::vector<uint8_t> raw(std::initializer_list<uint8_t> bytes)
+{
+    return std::vector<uint8_t>(bytes);
+}
+
+template <typename Pack>
+std::vector<uint8_t> packed(Pack pack)
+{
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+    pack(packer);
+    return buffer;
+}
+
+/// Objects in ascending order, with other encodings of some of them
+std::vector<std::vector<std::vector<uint8_t>>> ordered_values()
+{
+    return {
+        {raw({0xc0})},
+        {raw({0xc2})},
+        {raw({0xc3})},
+        {raw({0xd3, 0x80, 0, 0, 0, 0, 0, 0, 0})}, // INT64_MIN
+        {raw({0xff}), raw({0xd0, 0xff}), raw({0xd2, 0xff, 0xff, 0xff, 0xff})}, // -1
+        {raw({0x00}), raw({0xd1, 0x00, 0x00})},
+        {raw({0x05}), raw({0xcc, 0x05}), raw({0xcf, 0, 0, 0, 0, 0, 0, 0, 5}), raw({0xd0, 0x05})},
+        {raw({0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff})}, // UINT64_MAX
+        {packed([](Packer &p) { p.pack_double(-0.0); })},
+        {packed([](Packer &p) { p.pack_double(0.0); })},
+        {packed([](Packer &p) { p.pack_float(1.5f); })},
+        {packed([](Packer &p) { p.pack_double(1.5); })},
+        {packed([](Packer &p) { p.pack_double(std::numeric_limits<double>::infinity()); })},
+        {raw({0xa0}), raw({0xd9, 0x00})},
+        {raw({0xa1, 'a'}), raw({0xda, 0x00, 0x01, 'a'})},
+        {raw({0xa2, 'a', 'b'})},
+        {raw({0xa1, 'b'})},
+        {raw({0xc4, 0x01, 'a'}), raw({0xc5, 0x00, 0x01, 'a'})},
+        {raw({0x90}), raw({0xdc, 0x00, 0x00})},
+        {raw({0x91, 0x01}), raw({0xdd, 0, 0, 0, 1, 0xcc, 0x01})},
+        {raw({0x92, 0x01, 0x00})},
+        {raw({0x91, 0x02})},
+        {raw({0x80})},
+        {raw({0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0x02}), raw({0x82, 0xa1, 'b', 0x02, 0xa1, 'a', 0x01}),
+         raw({0xde, 0x00, 0x02, 0xa1, 'b', 0xcc, 0x02, 0xd9, 0x01, 'a', 0x01})},
+        {raw({0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0x03})},
+        {raw({0x81, 0xa1, 'b', 0x00})},
+        {raw({0xd4, 0x01, 0x07}), raw({0xc7, 0x01, 0x01, 0x07})},
+        {raw({0xd4, 0x02, 0x00})},
+    };
+}
+
+}
+
+TEST(compare, Order)
+{
+    auto values = ordered_values();
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        for (size_t j = 0; j < values.size(); j++)
+        {
+            for (const std::vector<uint8_t> &x : values[i])
+            {
+                for (const std::vector<uint8_t> &y : values[j])
+                {
+                    int expected = i < j ? -1 : (i > j ? 1 : 0);
+                    int order = compare(x.data(), y.data());
+
+                    EXPECT_EQ(expected, (order > 0) - (order < 0)) << i << " " << j;
+                    EXPECT_EQ(i == j, equal(x.data(), y.data())) << i << " " << j;
+
+                    // the definition of equal: same canonical bytes
+                    EXPECT_EQ(i == j, canonicalize(x.data(), x.size()) == canonicalize(y.data(), y.size())) << i << " " << j;
+
+                    if (i == j)
+                        EXPECT_EQ(hash(x.data()), hash(y.data())) << i;
+                    else
+                        EXPECT_NE(hash(x.data()), hash(y.data())) << i << " " << j;
+                }
+            }
+        }
+    }
+}
+
+TEST(compare, Documents)
+{
+    std::vector<uint8_t> a = json_to_msgpack(R"({"id": 7, "tags": ["x", "y"], "meta": {"host": "n1", "pid": 12}})");
+    std::vector<uint8_t> b = json_to_msgpack(R"({"meta": {"pid": 12, "host": "n1"}, "id": 7, "tags": ["x", "y"]})");
+    std::vector<uint8_t> c = json_to_msgpack(R"({"meta": {"pid": 12, "host": "n2"}, "id": 7, "tags": ["x", "y"]})");
+    std::vector<uint8_t> d = json_to_msgpack(R"({"meta": {"pid": 12, "host": "n1"}, "id": 7, "tags": ["y", "x"]})");
+
+    EXPECT_TRUE(equal(a.data(), b.data()));
+    EXPECT_EQ(0, compare(a.data(), b.data()));
+    EXPECT_EQ(hash(a.data()), hash(b.data()));
+    EXPECT_NE(hash(a.data()), hash(a.data(), 1));
+
+    EXPECT_FALSE(equal(a.data(), c.data()));
+    EXPECT_LT(compare(a.data(), c.data()), 0);
+    EXPECT_NE(hash(a.data()), hash(c.data()));
+    EXPECT_FALSE(equal(a.data(), d.data()));
+    EXPECT_NE(hash(a.data()), hash(d.data()));
+
+    // canonical inputs are compared with one memcmp
+    std::vector<uint8_t> canonical_a = canonicalize(a.data(), a.size());
+    std::vector<uint8_t> canonical_b = canonicalize(b.data(), b.size());
+    EXPECT_TRUE(equal(canonical_a.data(), canonical_b.data(), true));
+    EXPECT_FALSE(equal(canonical_a.data(), c.data(), true));
+    EXPECT_TRUE(equal(canonical_a.data(), b.data()));
+
+    // subtrees, through cursors and decoded objects
+    Cursor meta_a = Cursor(a.data(), a.size()).child("meta");
+    Cursor meta_c = Cursor(c.data(), c.size()).child("meta");
+    EXPECT_TRUE(equal(meta_a, Cursor(b.data(), b.size()).child("meta")));
+    EXPECT_FALSE(equal(meta_a, meta_c));
+    EXPECT_GT(compare(meta_c, meta_a), 0);
+    EXPECT_EQ(hash(meta_a), hash(Cursor(b.data(), b.size()).child("meta")));
+
+    Msgpack doc_a(a);
+    Msgpack doc_b(b);
+    EXPECT_TRUE(equal(doc_a["meta"], doc_b["meta"]));
+    EXPECT_TRUE(equal(doc_a["id"], msgpack_object(int64_t(7))));
+    EXPECT_EQ(hash(doc_a["tags"]), hash(Cursor(b.data(), b.size()).child("tags")));
+    EXPECT_LT(compare(doc_a["id"], msgpack_object(1.0)), 0);
+}
+
+TEST(compare, Duplicates)
+{
+    // duplicate keys are compared in order of appearance, as canonicalize keeps them
+    std::vector<uint8_t> a = raw({0x82, 0xa1, 'a', 0x01, 0xa1, 'a', 0x02});
+    std::vector<uint8_t> b = raw({0x82, 0xa1, 'a', 0x02, 0xa1, 'a', 0x01});
+    std::vector<uint8_t> c = raw({0x83, 0xa1, 'b', 0x00, 0xa1, 'a', 0x01, 0xa1, 'a', 0x02});
+    std::vector<uint8_t> d = raw({0x83, 0xa1, 'a', 0x01, 0xa1, 'b', 0x00, 0xa1, 'a', 0x02});
+
+    EXPECT_FALSE(equal(a.data(), b.data()));
+    EXPECT_LT(compare(a.data(), b.data()), 0);
+    EXPECT_TRUE(equal(c.data(), d.data()));
+    EXPECT_EQ(0, compare(c.data(), d.data()));
+    EXPECT_EQ(hash(c.data()), hash(d.data()));
+
+    std::vector<uint8_t> invalid = raw({0x91, 0xc1});
+    std::vector<uint8_t> array = raw({0x91, 0x01});
+    EXPECT_THROW(compare(invalid.data(), array.data()), parse_error);
+    EXPECT_THROW(hash(invalid.data()), parse_error);
+}
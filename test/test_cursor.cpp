@@ -0,0 +1,76 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/json.h"
+
+
+using namespace msgpacksearch;
+
+TEST(cursor, Navigation)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"a": {"b": {"c": 7}}, "list": [10, [20, 21], 30], "s": "str"})");
+    Msgpack msgpck(data);
+
+    Cursor root = msgpck.cursor();
+    ASSERT_TRUE(root.valid());
+    EXPECT_TRUE(root.is_map());
+    EXPECT_EQ(3, root.nmb_elements());
+    EXPECT_EQ(data.size(), root.length());
+
+    Cursor c = root.child("a").child("b").child("c");
+    ASSERT_TRUE(c);
+    EXPECT_EQ(7, std::get<uint64_t>(c.value()));
+    EXPECT_EQ("c", c.key());
+
+    EXPECT_FALSE(root.child("missing"));
+    EXPECT_FALSE(root.child("a").child("b").child("c").child("d")); // scalar has no children
+
+    Cursor list = root.child("list");
+    EXPECT_TRUE(list.is_array());
+    EXPECT_EQ(30, std::get<uint64_t>(list.at(2).value()));
+    EXPECT_EQ(21, std::get<uint64_t>(list.at(1).at(1).value()));
+    EXPECT_FALSE(list.at(3));
+
+    auto str = std::get<msgpack_str>(root.child("s").value());
+    EXPECT_EQ("str", std::string(str.data, str.size));
+}
+
+TEST(cursor, Siblings)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"([1, {"x": 1}, [2, 3], "four"])");
+    Msgpack msgpck(data);
+
+    size_t count = 0;
+    for (Cursor element = msgpck.cursor().at(0); element; element = element.next_sibling())
+        count++;
+    EXPECT_EQ(4, count);
+
+    Cursor last = msgpck.cursor().at(1).next_sibling().next_sibling();
+    auto str = std::get<msgpack_str>(last.value());
+    EXPECT_EQ("four", std::string(str.data, str.size));
+    EXPECT_FALSE(last.next_sibling());
+
+    // map members iterate over the values, keeping their keys
+    data = json_to_msgpack(R"({"a": 1, "b": [1, 2], "c": 3})");
+    Msgpack map(data);
+    std::string keys;
+    for (Cursor member = map.cursor().at(0); member; member = member.next_sibling())
+        keys += member.key();
+    EXPECT_EQ("abc", keys);
+    EXPECT_EQ(3, std::get<uint64_t>(map.cursor().at(1).next_sibling().value()));
+}
+
+TEST(cursor, Invalid)
+{
+    Cursor empty;
+    EXPECT_FALSE(empty);
+    EXPECT_FALSE(empty.child("a"));
+    EXPECT_FALSE(empty.next_sibling());
+    EXPECT_EQ(std::monostate(), std::get<std::monostate>(empty.value()));
+
+    std::vector<uint8_t> data;
+    EXPECT_FALSE(Cursor(data.data(), 0));
+}
@@ -0,0 +1,40 @@
+#include <cstdint>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/epoch.h"
+
+
+using namespace msgpacksearch;
+
+TEST(epoch, Guards)
+{
+    uint64_t idle = EpochGuard::advance();
+    EXPECT_TRUE(EpochGuard::quiescent(idle));
+
+    uint64_t replaced;
+    {
+        EpochGuard outer;
+        replaced = EpochGuard::advance();
+        EXPECT_FALSE(EpochGuard::quiescent(replaced));
+
+        // nested guards keep the epoch of the outermost one
+        {
+            EpochGuard inner;
+        }
+        EXPECT_FALSE(EpochGuard::quiescent(replaced));
+
+        // readers announced in later epochs do not hold back an earlier one
+        uint64_t later = EpochGuard::advance();
+        bool quiescent = true;
+        std::thread([&] {
+            EpochGuard guard;
+            quiescent = EpochGuard::quiescent(replaced - 1);
+        }).join();
+        EXPECT_TRUE(quiescent);
+        EXPECT_FALSE(EpochGuard::quiescent(later));
+    }
+
+    EXPECT_TRUE(EpochGuard::quiescent(replaced));
+}
@@ -0,0 +1,206 @@
+#include <array>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/decode.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/ext.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+std::vector<uint8_t> packed_timestamp(const msgpack_timestamp &timestamp)
+{
+    std::vector<uint8_t> buffer;
+    Packer(buffer).pack_timestamp(timestamp);
+    return buffer;
+}
+
+}
+
+TEST(ext, Lengths)
+{
+    // every width, followed by a sentinel that must not be swallowed
+    for (uint32_t size : {1u, 2u, 4u, 8u, 16u, 0u, 3u, 255u, 256u, 65535u, 65536u})
+    {
+        std::vector<uint8_t> payload(size, 0x5a);
+        std::vector<uint8_t> buffer;
+        Packer packer(buffer);
+        packer.pack_ext(7, payload.data(), size);
+        const size_t encoded = buffer.size();
+        packer.pack_uint(1);
+
+        EXPECT_EQ(encoded, Msgpack::skip_object(buffer.data())) << size;
+        EXPECT_EQ(encoded, Msgpack::skip_object_bounded(buffer.data(), buffer.data() + buffer.size())) << size;
+        EXPECT_EQ(0, Msgpack::skip_object_bounded(buffer.data(), buffer.data() + encoded - 1)) << size;
+
+        auto parsed = Msgpack::parse_data(buffer.data());
+        EXPECT_EQ(encoded, parsed.first) << size;
+        msgpack_ext decoded = std::get<msgpack_ext>(parsed.second);
+        EXPECT_EQ(7, decoded.type);
+        EXPECT_EQ(size, decoded.size);
+        EXPECT_EQ(buffer.data() + encoded - size, decoded.data) << size;
+
+        msgpack_ext ext;
+        ASSERT_TRUE(read_ext(buffer.data(), ext));
+        EXPECT_EQ(7, ext.type);
+        EXPECT_EQ(size, ext.size);
+        EXPECT_EQ(decoded.data, ext.data);
+    }
+
+    // the element after a fixext 16 or an ext 32 is found at the right place
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+    std::vector<uint8_t> payload(70000, 1);
+    packer.pack_array(3);
+    packer.pack_ext(1, payload.data(), 16);
+    packer.pack_ext(2, payload.data(), 70000);
+    packer.pack_str("after");
+
+    Msgpack doc(buffer);
+    EXPECT_EQ("after", doc.get_string_view(2));
+    EXPECT_EQ(70000, doc.get_ext(1).size);
+
+    std::vector<uint8_t> other = {0xc4, 0x01, 0x00};
+    msgpack_ext untouched(3, 1, other.data());
+    EXPECT_FALSE(read_ext(other.data(), untouched));
+    EXPECT_EQ(3, untouched.type);
+}
+
+TEST(ext, Timestamps)
+{
+    struct expectation
+    {
+        msgpack_timestamp timestamp;
+        size_t encoded_size;
+    };
+
+    const std::vector<expectation> cases = {
+        {{0, 0}, 6},
+        {{1700000000, 0}, 6},
+        {{4294967295, 0}, 6},
+        {{4294967296, 0}, 10},
+        {{1700000000, 123456789}, 10},
+        {{(int64_t(1) << 34) - 1, 999999999}, 10},
+        {{int64_t(1) << 34, 0}, 15},
+        {{-1, 999999999}, 15},
+        {{std::numeric_limits<int64_t>::min(), 0}, 15},
+    };
+
+    for (const expectation &test : cases)
+    {
+        std::vector<uint8_t> buffer = packed_timestamp(test.timestamp);
+        EXPECT_EQ(test.encoded_size, buffer.size()) << test.timestamp.seconds;
+        EXPECT_EQ(buffer.size(), Msgpack::skip_object(buffer.data()));
+
+        msgpack_timestamp decoded;
+        ASSERT_TRUE(read_timestamp(buffer.data(), decoded)) << test.timestamp.seconds;
+        EXPECT_EQ(test.timestamp, decoded);
+    }
+
+    // the layouts of the specification
+    EXPECT_EQ(std::vector<uint8_t>({0xd6, 0xff, 0x65, 0x53, 0xf1, 0x00}), packed_timestamp({1700000000, 0}));
+    EXPECT_EQ(std::vector<uint8_t>({0xd7, 0xff, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01}),
+              packed_timestamp({1, 1}));
+    EXPECT_EQ(std::vector<uint8_t>({0xc7, 0x0c, 0xff, 0, 0, 0, 5, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe}),
+              packed_timestamp({-2, 5}));
+
+    // nanoseconds out of range, other ext types and widths are not timestamps
+    msgpack_timestamp untouched{42, 0};
+    std::vector<uint8_t> overflow_64 = {0xd7, 0xff, 0xee, 0x6b, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00};
+    std::vector<uint8_t> overflow_96 = {0xc7, 0x0c, 0xff, 0x3b, 0x9a, 0xca, 0x00, 0, 0, 0, 0, 0, 0, 0, 0};
+    std::vector<uint8_t> other_type = {0xd6, 0x01, 0x00, 0x00, 0x00, 0x01};
+    std::vector<uint8_t> other_width = {0xd5, 0xff, 0x00, 0x01};
+    std::vector<uint8_t> not_ext = {0xce, 0x00, 0x00, 0x00, 0x01};
+
+    for (const std::vector<uint8_t> *invalid : {&overflow_64, &overflow_96, &other_type, &other_width, &not_ext})
+        EXPECT_FALSE(read_timestamp(invalid->data(), untouched));
+    EXPECT_EQ(42, untouched.seconds);
+
+    EXPECT_TRUE(msgpack_timestamp({1, 5}) < msgpack_timestamp({2, 0}));
+    EXPECT_TRUE(msgpack_timestamp({-1, 5}) < msgpack_timestamp({-1, 6}));
+}
+
+TEST(ext, Getters)
+{
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+    packer.pack_map(3);
+    packer.pack_str("ts");
+    packer.pack_timestamp({1700000000, 500});
+    packer.pack_str("n");
+    packer.pack_uint(1700000000);
+    packer.pack_str("list");
+    packer.pack_array(1);
+    packer.pack_timestamp({-5, 0});
+
+    Msgpack doc(buffer);
+    EXPECT_EQ(msgpack_timestamp({1700000000, 500}), doc.get_timestamp("ts"));
+    EXPECT_EQ(std::nullopt, doc.try_get_timestamp("n"));
+    EXPECT_EQ(std::nullopt, doc.try_get_timestamp("missing"));
+    EXPECT_THROW(doc.get_timestamp("n"), bad_object_type);
+
+    Msgpack list(doc.get_array("list").start - 1, 16);
+    EXPECT_EQ(msgpack_timestamp({-5, 0}), list.get_timestamp(0));
+    EXPECT_EQ(std::nullopt, list.try_get_timestamp(1));
+}
+
+TEST(ext, Registry)
+{
+    typedef std::array<uint8_t, 16> uuid;
+
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+    uuid id;
+    for (size_t i = 0; i < id.size(); i++)
+        id[i] = static_cast<uint8_t>(i * 17);
+
+    packer.pack_array(4);
+    packer.pack_timestamp({1700000000, 1});
+    packer.pack_ext(5, id.data(), 16);
+    packer.pack_ext(5, id.data(), 4);
+    packer.pack_str("text");
+
+    Msgpack doc(buffer);
+    const uint8_t *timestamp = doc.cursor().at(0).data();
+    const uint8_t *identifier = doc.cursor().at(1).data();
+    const uint8_t *short_identifier = doc.cursor().at(2).data();
+    const uint8_t *text = doc.cursor().at(3).data();
+
+    ExtRegistry registry;
+    EXPECT_TRUE(registry.has_decoder(timestamp_ext_type));
+    EXPECT_EQ(msgpack_timestamp({1700000000, 1}), registry.decode<msgpack_timestamp>(timestamp));
+    EXPECT_EQ(std::nullopt, registry.decode<uuid>(identifier));
+    EXPECT_EQ(std::nullopt, registry.decode<msgpack_timestamp>(text));
+    EXPECT_EQ(std::nullopt, registry.decode<msgpack_timestamp>(static_cast<const uint8_t *>(nullptr)));
+
+    // the decoder gets the payload in place
+    const uint8_t *seen = nullptr;
+    registry.register_decoder<uuid>(5, [&seen](const msgpack_ext &ext, uuid &out) {
+        if (ext.size != out.size())
+            return false;
+        seen = ext.data;
+        std::memcpy(out.data(), ext.data, out.size());
+        return true;
+    });
+
+    EXPECT_TRUE(registry.has_decoder(5));
+    EXPECT_EQ(id, registry.decode<uuid>(identifier));
+    EXPECT_EQ(identifier + 2, seen);
+    EXPECT_EQ(std::nullopt, registry.decode<uuid>(short_identifier));
+    EXPECT_EQ(id, registry.decode<uuid>(doc.get_ext(1)));
+    EXPECT_THROW(registry.decode<msgpack_timestamp>(identifier), std::invalid_argument);
+
+    registry.unregister(timestamp_ext_type);
+    EXPECT_FALSE(registry.has_decoder(timestamp_ext_type));
+    EXPECT_EQ(std::nullopt, registry.decode<msgpack_timestamp>(timestamp));
+}
@@ -0,0 +1,54 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/json.h"
+#include "msgpacksearch/instrumentation.h"
+
+
+using namespace msgpacksearch;
+
+TEST(instrumentation, Counters)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"a": 1, "b": [1, 2, 3], "c": {"d": 4}})");
+    Msgpack msgpck(data);
+
+    reset_thread_lookup_stats();
+    msgpck.get_u64("a");
+    msgpck.at_path("c.d");
+    lookup_stats stats = thread_lookup_stats();
+
+#ifdef MSGPACKSEARCH_INSTRUMENTATION
+    EXPECT_EQ(2, stats.lookups);
+    EXPECT_EQ(2, stats.max_depth);
+    EXPECT_EQ(1 + 3 + 1, stats.keys_compared); // "a", then "a" "b" "c" and "d"
+    EXPECT_EQ(3 + 10, stats.bytes_skipped); // a:1 and b:[1,2,3] (array 32) skipped on the way to "c"
+    EXPECT_EQ(2, stats.objects_decoded); // skipping the array walks it through parse_data, then the scalar at c.d
+    EXPECT_LE(stats.max_lookup_nanoseconds, stats.lookup_nanoseconds);
+
+    std::thread([&] {
+        Msgpack view(data);
+        view.get_u64("a");
+    }).join();
+    EXPECT_GE(global_lookup_stats().lookups, 3);
+#else
+    EXPECT_EQ(0, stats.lookups);
+    EXPECT_EQ(0, stats.keys_compared);
+#endif
+}
+
+TEST(instrumentation, Prometheus)
+{
+    lookup_stats stats;
+    stats.keys_compared = 12;
+    stats.lookup_nanoseconds = 1500000000;
+
+    std::string text = to_prometheus(stats);
+    EXPECT_NE(std::string::npos, text.find("# TYPE msgpacksearch_keys_compared_total counter\n"));
+    EXPECT_NE(std::string::npos, text.find("\nmsgpacksearch_keys_compared_total 12\n"));
+    EXPECT_NE(std::string::npos, text.find("\nmsgpacksearch_lookup_seconds_total 1.500000000\n"));
+    EXPECT_NE(std::string::npos, to_prometheus(stats, "svc").find("\nsvc_lookups_total 0\n"));
+}
@@ -0,0 +1,81 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <error.h>
+
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/json.h"
+
+
+using namespace msgpacksearch;
+
+TEST(json, Scalars)
+{
+    EXPECT_EQ(json_to_msgpack("null"), std::vector<uint8_t>({0xc0}));
+    EXPECT_EQ(json_to_msgpack(" true "), std::vector<uint8_t>({0xc3}));
+    EXPECT_EQ(json_to_msgpack("false"), std::vector<uint8_t>({0xc2}));
+    EXPECT_EQ(json_to_msgpack("127"), std::vector<uint8_t>({0x7f}));
+    EXPECT_EQ(json_to_msgpack("4660"), std::vector<uint8_t>({0xcd, 0x12, 0x34}));
+    EXPECT_EQ(json_to_msgpack("-1"), std::vector<uint8_t>({0xff}));
+    EXPECT_EQ(json_to_msgpack("-33"), std::vector<uint8_t>({0xd0, 0xdf}));
+    EXPECT_EQ(json_to_msgpack("\"hello\""), std::vector<uint8_t>({0xa5, 'h', 'e', 'l', 'l', 'o'}));
+    EXPECT_EQ(json_to_msgpack("1.5"), std::vector<uint8_t>({0xcb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(json_to_msgpack("18446744073709551616")[0], 0xcb); // exceeds uint64_t
+}
+
+TEST(json, Escapes)
+{
+    EXPECT_EQ(json_to_msgpack(R"("a\"b\n")"), std::vector<uint8_t>({0xa4, 'a', '"', 'b', '\n'}));
+    EXPECT_EQ(json_to_msgpack(R"("é")"), std::vector<uint8_t>({0xa2, 0xc3, 0xa9}));
+    EXPECT_EQ(json_to_msgpack(R"("😀")"), std::vector<uint8_t>({0xa4, 0xf0, 0x9f, 0x98, 0x80}));
+
+    // unicode escapes, a surrogate pair decodes to one 4 byte code point
+    EXPECT_EQ(json_to_msgpack(R"("\u0041\u00e9\u20AC")"), std::vector<uint8_t>({0xa6, 'A', 0xc3, 0xa9, 0xe2, 0x82, 0xac}));
+    EXPECT_EQ(json_to_msgpack(R"("\ud83d\ude00")"), std::vector<uint8_t>({0xa4, 0xf0, 0x9f, 0x98, 0x80}));
+    EXPECT_THROW(json_to_msgpack(R"("\ud83d")"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack(R"("\ud83dx")"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack(R"("\ud83d\u0041")"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack(R"("\ude00")"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack(R"("\u00g1")"), msgpacksearch::parse_error);
+}
+
+TEST(json, Containers)
+{
+    // same document as the README example
+    std::string json = R"({"A": "hello", "B": 0, "C": [1, 2, 3], "D": {"NESTED": 4}})";
+    std::vector<uint8_t> expected = {0xDF, 0x00, 0x00, 0x00, 0x04, 0xA1, 0x41, 0xA5, 0x68, 0x65, 0x6C, 0x6C, 0x6F, 0xA1,
+                                     0x42, 0x00, 0xA1, 0x43, 0xDD, 0x00, 0x00, 0x00, 0x03, 0x01, 0x02, 0x03, 0xA1, 0x44,
+                                     0xDF, 0x00, 0x00, 0x00, 0x01, 0xA6, 0x4E, 0x45, 0x53, 0x54, 0x45, 0x44, 0x04};
+
+    std::vector<uint8_t> data = json_to_msgpack(json);
+    EXPECT_EQ(expected, data);
+
+    Msgpack msgpck(data);
+    EXPECT_EQ("hello", msgpck.get_sv("A"));
+    EXPECT_EQ(3, msgpck.get_array("C").nmb_elements);
+
+    EXPECT_EQ(json_to_msgpack("[]"), std::vector<uint8_t>({0xDD, 0, 0, 0, 0}));
+    EXPECT_EQ(json_to_msgpack("{ }"), std::vector<uint8_t>({0xDF, 0, 0, 0, 0}));
+    EXPECT_EQ(json_to_msgpack("[[],[1]]"), std::vector<uint8_t>({0xDD, 0, 0, 0, 2, 0xDD, 0, 0, 0, 0, 0xDD, 0, 0, 0, 1, 0x01}));
+}
+
+TEST(json, Errors)
+{
+    EXPECT_THROW(json_to_msgpack(""), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack("[1, 2"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack("{\"a\" 1}"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack("[1,]"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack("01"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack("\"abc"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack("tru"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack("{} {}"), msgpacksearch::parse_error);
+    EXPECT_THROW(json_to_msgpack(R"("\ud83d")"), msgpacksearch::parse_error);
+
+    try {
+        json_to_msgpack("[1, x]");
+        FAIL();
+    } catch (const parse_error &e) {
+        EXPECT_EQ(4, e.offset());
+    }
+}
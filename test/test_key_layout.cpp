@@ -0,0 +1,186 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/cursor.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/key_layout.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
+#include "test_records.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// {"id": id, "level": <level>, "tags": [...], "ok": bool, "meta": {"host": ..., "pid": ...}, "msg": ...}
+void pack_log(Packer &packer, uint64_t id, const std::string &level, size_t nmb_tags, const std::string &msg)
+{
+    pack_record(packer, {{"id", json_value(std::to_string(id))},
+                         {"level", [&](Packer &p) { p.pack_str(level); }},
+                         {"tags", [&](Packer &p) {
+                              p.pack_array(nmb_tags);
+                              for (size_t i = 0; i < nmb_tags; i++)
+                                  p.pack_str("tag-" + std::to_string(id + i));
+                          }},
+                         {"ok", json_value(id % 2 ? "true" : "false")},
+                         {"meta", map_value({{"host", [&](Packer &p) { p.pack_str("node-" + std::to_string(id % 10)); }},
+                                             {"pid", json_value(std::to_string(1000 + id))}})},
+                         {"msg", [&](Packer &p) { p.pack_str(msg); }}});
+}
+
+std::vector<const uint8_t *> split(const std::vector<uint8_t> &stream)
+{
+    std::vector<const uint8_t *> records;
+
+    for (size_t offset = 0; offset < stream.size(); offset += Msgpack::skip_object(stream.data() + offset))
+        records.push_back(stream.data() + offset);
+
+    return records;
+}
+
+}
+
+TEST(key_layout, Dictionary)
+{
+    KeyDictionary dictionary;
+
+    EXPECT_EQ(0, dictionary.intern("id"));
+    EXPECT_EQ(1, dictionary.intern("level"));
+    EXPECT_EQ(0, dictionary.intern("id"));
+    EXPECT_EQ(2, dictionary.intern(std::string("a\0b", 3)));
+    EXPECT_EQ(3, dictionary.size());
+
+    EXPECT_EQ(1, dictionary.find("level"));
+    EXPECT_EQ(KeyDictionary::npos, dictionary.find("a"));
+    EXPECT_EQ("level", dictionary.key(1));
+    EXPECT_EQ(std::string("a\0b", 3), dictionary.key(2));
+    EXPECT_THROW(dictionary.key(3), std::out_of_range);
+}
+
+TEST(key_layout, Stream)
+{
+    std::vector<uint8_t> stream;
+    Packer packer(stream);
+
+    // same layout with other container sizes, then a longer level and message, a wider id and a missing key
+    for (uint64_t id = 0; id < 20; id++)
+        pack_log(packer, id, "info", id % 4, "served");
+    pack_log(packer, 20, "warning", 1, "served");
+    pack_log(packer, 21, "warning", 2, "served later");
+    pack_log(packer, 300, "warning", 2, "served");
+    packer.pack_map(1);
+    packer.pack_str("id");
+    packer.pack_uint(22);
+
+    std::vector<const uint8_t *> records = split(stream);
+    ASSERT_EQ(24, records.size());
+
+    auto dictionary = std::make_shared<KeyDictionary>();
+    LayoutPredictor root(dictionary);
+    LayoutPredictor meta(dictionary);
+    const std::vector<std::string> keys = {"id", "level", "tags", "ok", "meta", "msg", "other"};
+    const uint8_t *end = stream.data() + stream.size();
+
+    for (const uint8_t *record : records)
+    {
+        Cursor cursor(record, end - record);
+        root.bind(record, end - record);
+        EXPECT_EQ(cursor.length(), root.size());
+
+        for (const std::string &key : keys)
+        {
+            Cursor expected = cursor.child(key);
+            EXPECT_EQ(expected ? expected.data() : nullptr, root.find(key)) << key << " " << record - stream.data();
+        }
+
+        const uint8_t *nested = root.find(dictionary->find("meta"));
+        if (!nested)
+            continue;
+
+        meta.bind(nested, end - nested);
+        Cursor expected = cursor.child("meta").child("host");
+        EXPECT_EQ(expected.data(), meta.find("host"));
+        EXPECT_EQ(cursor.child("meta").child("pid").data(), meta.find("pid"));
+        EXPECT_EQ(nullptr, meta.find("id"));
+    }
+
+    // learned on the first record, the id width and the last record changed it; a longer level or message
+    // only shifts the members after it
+    EXPECT_EQ(3, root.statistics().misses);
+    EXPECT_EQ(21, root.statistics().hits);
+    EXPECT_EQ(1, meta.statistics().misses);
+    EXPECT_EQ(22, meta.statistics().hits);
+}
+
+TEST(key_layout, Verification)
+{
+    std::vector<uint8_t> learned = {0x82, 0xa1, 'a', 0xa2, 'x', 'x', 0xa1, 'b', 0x01};
+
+    // "b" of the learned layout is at offset 6: here those bytes are inside the longer value of "a", whose
+    // header is followed to the real "b"
+    std::vector<uint8_t> inside = {0x82, 0xa1, 'a', 0xa5, 'x', 'x', 0xa1, 'b', 0x02, 0xa1, 'b', 0x03};
+    // same sizes, other value types: a positive fixint is not a bool
+    std::vector<uint8_t> retyped = {0x82, 0xa1, 'a', 0xa2, 'y', 'y', 0xa1, 'b', 0xc3};
+    // same layout, other values
+    std::vector<uint8_t> same = {0x82, 0xa1, 'a', 0xa2, 'y', 'z', 0xa1, 'b', 0x7f};
+
+    LayoutPredictor predictor;
+    EXPECT_FALSE(predictor.bind(learned.data(), learned.size()));
+    EXPECT_EQ(learned.data() + 8, predictor.find("b"));
+
+    EXPECT_TRUE(predictor.bind(inside.data(), inside.size()));
+    EXPECT_EQ(inside.data() + 11, predictor.find("b"));
+
+    // the value of "a" is compared when it has a fixed size: here the bytes of "b" are inside a string
+    std::vector<uint8_t> fixed = {0x82, 0xa1, 'a', 0xca, 0, 0, 0, 0, 0xa1, 'b', 0x01};
+    std::vector<uint8_t> hidden = {0x82, 0xa1, 'a', 0xa6, 0, 0, 0, 0, 0xa1, 'b', 0xa1, 'b', 0x02};
+    LayoutPredictor floats;
+    EXPECT_FALSE(floats.bind(fixed.data(), fixed.size()));
+    EXPECT_EQ(fixed.data() + 10, floats.find("b"));
+    EXPECT_FALSE(floats.bind(hidden.data(), hidden.size()));
+    EXPECT_EQ(hidden.data() + 12, floats.find("b"));
+
+    EXPECT_TRUE(predictor.bind(learned.data(), learned.size()));
+    EXPECT_FALSE(predictor.bind(retyped.data(), retyped.size()));
+    EXPECT_TRUE(predictor.bind(retyped.data(), retyped.size()));
+    EXPECT_FALSE(predictor.bind(learned.data(), learned.size()));
+    EXPECT_TRUE(predictor.bind(same.data(), same.size()));
+    EXPECT_EQ(same.data() + 8, predictor.find("b"));
+    EXPECT_EQ(same.data() + 3, predictor.find("a"));
+
+    // the first of duplicate keys wins
+    std::vector<uint8_t> duplicates = {0x82, 0xa1, 'a', 0x01, 0xa1, 'a', 0x02};
+    predictor.bind(duplicates.data(), duplicates.size());
+    EXPECT_EQ(duplicates.data() + 3, predictor.find("a"));
+    EXPECT_EQ(nullptr, predictor.find("b"));
+
+    // not a map: nothing is found
+    std::vector<uint8_t> array = {0x91, 0x01};
+    EXPECT_FALSE(predictor.bind(array.data(), array.size()));
+    EXPECT_EQ(nullptr, predictor.find("a"));
+    EXPECT_EQ(0, predictor.size());
+
+    std::vector<uint8_t> truncated = {0x82, 0xa1, 'a', 0xa2, 'x'};
+    std::vector<uint8_t> invalid = {0x81, 0xa1, 'a', 0xc1};
+    EXPECT_THROW(predictor.bind(truncated.data(), truncated.size()), parse_error);
+    EXPECT_EQ(nullptr, predictor.find("a"));
+    EXPECT_THROW(predictor.bind(invalid.data(), invalid.size()), parse_error);
+    EXPECT_FALSE(predictor.bind(same.data(), same.size()));
+    EXPECT_EQ(same.data() + 8, predictor.find("b"));
+
+    // an invalid value skipped while verifying leaves nothing bound
+    std::vector<uint8_t> invalid_value = {0x82, 0xa1, 'a', 0xc1, 0xa1, 'b', 0x01};
+    EXPECT_THROW(predictor.bind(invalid_value.data(), invalid_value.size()), parse_error);
+    EXPECT_EQ(nullptr, predictor.find("b"));
+    EXPECT_EQ(0, predictor.size());
+    EXPECT_FALSE(predictor.bind(same.data(), same.size()));
+
+    // a truncated record matching the layout is walked, not read past its end
+    EXPECT_THROW(predictor.bind(same.data(), same.size() - 1), parse_error);
+
+    EXPECT_THROW(LayoutPredictor(nullptr), std::invalid_argument);
+}
@@ -0,0 +1,194 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/json.h"
+#include "msgpacksearch/key_search.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// Recursive search through Cursor, the reference for documents with string keys only
+void reference_search(const Cursor &value, const std::vector<std::string> &keys, std::vector<const uint8_t *> &out)
+{
+    for (uint32_t i = 0; i < value.nmb_elements(); i++)
+    {
+        Cursor element = value.at(i);
+
+        if (value.is_map())
+        {
+            for (const std::string &key : keys)
+            {
+                if (element.key() == key)
+                {
+                    out.push_back(element.data());
+                    break;
+                }
+            }
+        }
+
+        reference_search(element, keys, out);
+    }
+}
+
+/// Nested maps and arrays, depth levels deep, with "id" and "name" members at several levels
+std::string deep_document(int depth)
+{
+    std::string json;
+
+    for (int level = 0; level < depth; level++)
+    {
+        json += R"({"id": )" + std::to_string(level) + R"(, "tags": ["a", {"name": "n)" + std::to_string(level) + R"("}], )";
+        json += level % 3 ? R"("child": )" : R"("list": [1, {"ids": 2}, )";
+    }
+
+    json += R"({"id": "leaf"})";
+
+    for (int level = depth - 1; level >= 0; level--)
+        json += level % 3 ? "}" : "]}";
+
+    return json;
+}
+
+}
+
+TEST(key_search, Matches)
+{
+    std::vector<uint8_t> data = json_to_msgpack(
+        R"({"id": 1, "a": {"id": {"id": 2}}, "list": [{"id": 3}, {"x": {"id": 4}}], "ids": [1], "name": "id", "": 5})");
+
+    KeySearch search("id");
+    std::vector<key_match> matches = search.find_all(data.data(), data.size());
+
+    ASSERT_EQ(5, matches.size());
+    for (const key_match &match : matches)
+    {
+        EXPECT_EQ(0, match.key);
+        EXPECT_EQ("id", match.value.key());
+    }
+
+    EXPECT_EQ(1, std::get<uint64_t>(matches[0].value.value()));
+    EXPECT_TRUE(matches[1].value.is_map());
+    EXPECT_EQ(2, std::get<uint64_t>(matches[2].value.value()));
+    EXPECT_EQ(3, std::get<uint64_t>(matches[3].value.value()));
+    EXPECT_EQ(4, std::get<uint64_t>(matches[4].value.value()));
+
+    // the cursors navigate like the ones of Cursor::child
+    EXPECT_EQ("a", matches[0].value.next_sibling().key());
+    EXPECT_EQ(matches[2].value.data(), matches[1].value.child("id").data());
+    EXPECT_FALSE(matches[4].value.next_sibling());
+    EXPECT_EQ(Msgpack::skip_object(matches[1].value.data()), matches[1].value.length());
+
+    // a set of keys, the empty key, duplicates
+    KeySearch several(std::vector<std::string>{"name", "", "x", "missing", "name"});
+    std::vector<key_match> found = several.find_all(data.data(), data.size());
+    ASSERT_EQ(3, found.size());
+    EXPECT_EQ(2, found[0].key);
+    EXPECT_EQ(0, found[1].key);
+    EXPECT_EQ(1, found[2].key);
+    EXPECT_EQ(5, std::get<uint64_t>(found[2].value.value()));
+    EXPECT_EQ(0, several.match("name"));
+    EXPECT_EQ(1, several.match(""));
+    EXPECT_EQ(UINT32_MAX, several.match("nam"));
+    EXPECT_EQ(UINT32_MAX, several.match("a much longer key than any"));
+
+    // the visitor stops the search
+    size_t calls = 0;
+    EXPECT_EQ(2, search.find_all(data.data(), data.size(), [&calls](uint32_t, const Cursor &) { return ++calls < 2; }));
+    EXPECT_EQ(2, calls);
+
+    // no matches in scalars, empty containers or documents without the key
+    for (const char *json : {"1", R"("id")", "{}", "[]", R"([[], {}, {"x": []}])"})
+    {
+        std::vector<uint8_t> other = json_to_msgpack(json);
+        EXPECT_TRUE(search.find_all(other.data(), other.size()).empty()) << json;
+    }
+}
+
+TEST(key_search, KeyTypes)
+{
+    std::vector<uint8_t> data;
+    Packer packer(data);
+
+    // {1: {"id": 1}, ["id"]: 2, {"id": 3}: 4, "id": 5, str8 "id": 6}, keys are not searched
+    packer.pack_map(5);
+    packer.pack_uint(1);
+    packer.pack_map(1);
+    packer.pack_str("id");
+    packer.pack_uint(1);
+    packer.pack_array(1);
+    packer.pack_str("id");
+    packer.pack_uint(2);
+    packer.pack_map(1);
+    packer.pack_str("id");
+    packer.pack_uint(3);
+    packer.pack_uint(4);
+    packer.pack_str("id");
+    packer.pack_uint(5);
+    data.insert(data.end(), {0xd9, 0x02, 'i', 'd', 0x06});
+
+    KeySearch search("id");
+    std::vector<key_match> matches = search.find_all(data.data(), data.size());
+
+    ASSERT_EQ(3, matches.size());
+    EXPECT_EQ(1, std::get<uint64_t>(matches[0].value.value()));
+    EXPECT_EQ(5, std::get<uint64_t>(matches[1].value.value()));
+    EXPECT_EQ(6, std::get<uint64_t>(matches[2].value.value()));
+}
+
+TEST(key_search, Deep)
+{
+    for (int depth : {1, 2, 10, 200})
+    {
+        std::vector<uint8_t> data = json_to_msgpack(deep_document(depth));
+
+        for (const std::vector<std::string> &keys : std::vector<std::vector<std::string>>{{"id"}, {"name", "ids"}, {"child", "list", "id"}})
+        {
+            std::vector<const uint8_t *> expected;
+            reference_search(Cursor(data.data(), data.size()), keys, expected);
+
+            std::vector<const uint8_t *> found;
+            for (const key_match &match : KeySearch(keys).find_all(data.data(), data.size()))
+                found.push_back(match.value.data());
+
+            EXPECT_EQ(expected, found) << depth << " " << keys.size();
+            EXPECT_FALSE(found.empty());
+        }
+    }
+}
+
+TEST(key_search, Errors)
+{
+    KeySearch search("id");
+
+    std::vector<uint8_t> truncated = {0x82, 0xa2, 'i', 'd', 0x01, 0xa1};
+    std::vector<uint8_t> truncated_value = {0x81, 0xa2, 'i', 'd', 0xcd, 0x01};
+    std::vector<uint8_t> huge = {0x81, 0xa2, 'i', 'd', 0xdd, 0xff, 0xff, 0xff, 0xff, 0x01};
+    std::vector<uint8_t> invalid = {0x92, 0x01, 0xc1};
+
+    EXPECT_THROW(search.find_all(truncated.data(), truncated.size()), parse_error);
+    EXPECT_THROW(search.find_all(truncated_value.data(), truncated_value.size()), parse_error);
+    EXPECT_THROW(search.find_all(huge.data(), huge.size()), parse_error);
+    EXPECT_THROW(search.find_all(truncated.data(), 0), parse_error);
+
+    // matches before the error are visited
+    size_t visited = 0;
+    EXPECT_THROW(search.find_all(truncated.data(), truncated.size(), [&visited](uint32_t, const Cursor &) { return ++visited; }), parse_error);
+    EXPECT_EQ(1, visited);
+
+    try
+    {
+        search.find_all(invalid.data(), invalid.size());
+        FAIL();
+    }
+    catch (const parse_error &e)
+    {
+        EXPECT_EQ(2, e.offset());
+    }
+}
@@ -1,11 +1,17 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
 #include <utility>
 #include <variant>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <error.h>
 
 #include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
 
 
 using namespace msgpacksearch;
@@ -270,4 +276,228 @@ TEST(get, Arrays)
         EXPECT_THROW(msgpck.get_sv(2), msgpacksearch::bad_object_type);
     }
 
-}
\ No newline at end of file
+}
+
+TEST(parse, Numbers)
+{
+    std::vector<uint8_t> data;
+
+    data = {0xff}; // negative fixnum -> -1
+    auto [read, obj] = Msgpack::parse_data(data.data());
+    EXPECT_EQ(1, read);
+    EXPECT_EQ(-1, std::get<int64_t>(obj));
+
+    data = {0xd0, 0x80}; // int8 -> -128
+    std::tie(read, obj) = Msgpack::parse_data(data.data());
+    EXPECT_EQ(-128, std::get<int64_t>(obj));
+
+    data = {0xca, 0x3f, 0xc0, 0x00, 0x00}; // float -> 1.5
+    std::tie(read, obj) = Msgpack::parse_data(data.data());
+    EXPECT_EQ(5, read);
+    EXPECT_EQ(1.5, std::get<double>(obj));
+
+    data = {0xcb, 0x40, 0x09, 0x21, 0xfb, 0x54, 0x44, 0x2d, 0x18}; // double -> pi
+    std::tie(read, obj) = Msgpack::parse_data(data.data());
+    EXPECT_EQ(9, read);
+    EXPECT_DOUBLE_EQ(3.141592653589793, std::get<double>(obj));
+}
+
+TEST(get, Typed)
+{
+    /*
+    {
+        "u" : uint64 0xffffffffffffffff,
+        "n" : -5,
+        "f" : 2.0 (float),
+        "h" : 2.5 (double),
+        "s" : "str",
+        "b" : true
+    }
+    */
+    std::vector<uint8_t> data = {0x86,
+                                 0xA1, 'u', 0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                 0xA1, 'n', 0xfb,
+                                 0xA1, 'f', 0xca, 0x40, 0x00, 0x00, 0x00,
+                                 0xA1, 'h', 0xcb, 0x40, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                 0xA1, 's', 0xA3, 's', 't', 'r',
+                                 0xA1, 'b', 0xc3};
+    Msgpack msgpck(data.data(), data.size());
+
+    EXPECT_EQ(UINT64_MAX, msgpck.get_u64("u"));
+    EXPECT_FALSE(msgpck.try_get_i64("u")); // does not fit
+    EXPECT_FALSE(msgpck.try_get_double("u")); // not exactly representable
+
+    EXPECT_EQ(-5, msgpck.get_i64("n"));
+    EXPECT_EQ(-5.0, msgpck.get_double("n"));
+    EXPECT_THROW(msgpck.get_u64("n"), msgpacksearch::bad_object_type);
+
+    EXPECT_EQ(2, msgpck.get_u64("f")); // integral float
+    EXPECT_EQ(2, msgpck.get_i64("f"));
+    EXPECT_EQ(2.5, msgpck.get_double("h"));
+    EXPECT_FALSE(msgpck.try_get_i64("h"));
+
+    EXPECT_EQ("str", msgpck.get_string_view("s"));
+    EXPECT_EQ(true, *msgpck.try_get_bool("b"));
+    EXPECT_FALSE(msgpck.try_get_string_view("b"));
+
+    EXPECT_FALSE(msgpck.try_get_u64("missing"));
+    EXPECT_THROW(msgpck.get_double("missing"), msgpacksearch::bad_object_type);
+
+    // root is not an array
+    EXPECT_FALSE(msgpck.try_get_u64(0));
+
+    std::vector<uint8_t> array = {0x93, 0x01, 0xd0, 0x80, 0xa1, 'x'}; // [1, -128, "x"]
+    Msgpack msgpck_array(array.data(), array.size());
+    EXPECT_EQ(1, msgpck_array.get_u64(0));
+    EXPECT_EQ(-128, msgpck_array.get_i64(1));
+    EXPECT_EQ("x", msgpck_array.get_string_view(2));
+    EXPECT_FALSE(msgpck_array.try_get_u64(3));
+    EXPECT_FALSE(msgpck_array.try_get_u64(-1));
+}
+
+TEST(view, ConcurrentReaders)
+{
+    std::vector<uint8_t> data;
+    Packer packer(data);
+    packer.pack_map(64);
+    for (uint32_t i = 0; i < 64; i++)
+    {
+        packer.pack_str("k" + std::to_string(i));
+        packer.pack_array(2);
+        packer.pack_uint(i);
+        packer.pack_str("v" + std::to_string(i));
+    }
+
+    // readers only get a const view, the setters swap what is attached to it meanwhile
+    Msgpack view(data);
+    const Msgpack &shared = view;
+    auto tape = std::make_shared<const Tape>(data.data(), data.size());
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> failures{0};
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++)
+    {
+        readers.emplace_back([&shared, &stop, &failures, t] {
+            for (uint32_t i = 0; !stop || i < 2000; i++)
+            {
+                uint32_t key = (i + t) % 64;
+                const std::string name = "k" + std::to_string(key);
+                bool ok = shared.get_array(name).nmb_elements == 2 &&
+                          shared.find_path(name + "[0]") && *shared.find_path(name + "[0]") == key &&
+                          shared.try_get_u64("missing") == std::nullopt &&
+                          std::get<msgpack_array>(shared[name]).nmb_elements == 2;
+                failures += !ok;
+            }
+        });
+    }
+
+    for (int round = 0; round < 200; round++)
+    {
+        // a new tape every other round, the replaced ones are freed while readers run
+        view.set_tape(round % 2 ? std::make_shared<const Tape>(data.data(), data.size()) : nullptr);
+        view.set_cache(round % 3 ? std::make_shared<LookupCache>() : nullptr, 1);
+        view.set_sorted_keys(false);
+    }
+    stop = true;
+
+    for (std::thread &reader : readers)
+        reader.join();
+
+    EXPECT_EQ(0, failures);
+
+    // a copy takes what is attached at the time of the copy
+    view.set_tape(tape);
+    Msgpack copy(shared);
+    view.set_tape(nullptr);
+    EXPECT_EQ(tape, copy.tape());
+    EXPECT_EQ(nullptr, view.tape());
+    EXPECT_EQ(nullptr, Msgpack(Msgpack(data)).tape());
+}
+
+TEST(view, ReleasesReplacedStates)
+{
+    std::vector<uint8_t> data = {0x81, 0xa1, 'a', 0x01};
+    Msgpack view(data);
+
+    // no lookup is running, so a replaced tape or cache is freed when it is replaced
+    auto tape = std::make_shared<const Tape>(data.data(), data.size());
+    std::weak_ptr<const Tape> weak_tape = tape;
+    view.set_tape(std::move(tape));
+    EXPECT_EQ(1, view.get_u64("a"));
+    view.set_tape(nullptr);
+    EXPECT_TRUE(weak_tape.expired());
+
+    auto cache = std::make_shared<LookupCache>();
+    std::weak_ptr<LookupCache> weak_cache = cache;
+    view.set_cache(std::move(cache), 1);
+    EXPECT_NE(nullptr, view.find_path("a"));
+
+    for (int round = 0; round < 100; round++)
+        view.set_sorted_keys(round % 2);
+
+    EXPECT_FALSE(weak_cache.expired());
+    view.set_cache(nullptr);
+    EXPECT_TRUE(weak_cache.expired());
+
+    // a copy shares the current state, which outlives the view it was copied from
+    tape = std::make_shared<const Tape>(data.data(), data.size());
+    weak_tape = tape;
+    view.set_tape(std::move(tape));
+    auto copy = std::make_unique<Msgpack>(view);
+    view.set_tape(nullptr);
+    EXPECT_FALSE(weak_tape.expired());
+    EXPECT_EQ(1, copy->get_u64("a"));
+    copy.reset();
+    EXPECT_TRUE(weak_tape.expired());
+}
+
+TEST(view, ReleasesStatesUnderOverlappingReaders)
+{
+    std::vector<uint8_t> data = {0x81, 0xa1, 'a', 0x01};
+    Msgpack view(data);
+    const Msgpack &shared = view;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> failures{0};
+
+    // readers run lookups back to back, so some lookup is running across every set_tape below
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++)
+    {
+        readers.emplace_back([&shared, &stop, &failures] {
+            while (!stop)
+                failures += shared.get_u64("a") != 1;
+        });
+    }
+
+    std::vector<std::weak_ptr<const Tape>> replaced;
+    for (int round = 0; round < 20; round++)
+    {
+        auto tape = std::make_shared<const Tape>(data.data(), data.size());
+        replaced.push_back(tape);
+        view.set_tape(std::move(tape));
+    }
+    view.set_tape(nullptr);
+
+    // each replaced tape is freed once the lookups that may have seen it are done, while others still run
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    auto all_expired = [&replaced] {
+        for (const std::weak_ptr<const Tape> &tape : replaced)
+        {
+            if (!tape.expired())
+                return false;
+        }
+        return true;
+    };
+
+    while (!all_expired() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+
+    EXPECT_TRUE(all_expired());
+    stop = true;
+
+    for (std::thread &reader : readers)
+        reader.join();
+
+    EXPECT_EQ(0, failures);
+}
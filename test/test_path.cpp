@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <error.h>
+
+#include "msgpacksearch/compare.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/json.h"
+#include "msgpacksearch/packer.h"
+#include "msgpacksearch/path.h"
+
+
+using namespace msgpacksearch;
+
+TEST(path, Parse)
+{
+    msgpack_path path = parse_path("a.b[2].c");
+    ASSERT_EQ(4, path.size());
+    EXPECT_EQ("a", path[0].key);
+    EXPECT_EQ("b", path[1].key);
+    EXPECT_EQ(path_element::kind::index, path[2].type);
+    EXPECT_EQ(2, path[2].index);
+    EXPECT_EQ("c", path[3].key);
+
+    path = parse_path(R"(["a.b"][0]["x\"y"])");
+    ASSERT_EQ(3, path.size());
+    EXPECT_EQ("a.b", path[0].key);
+    EXPECT_EQ(0, path[1].index);
+    EXPECT_EQ("x\"y", path[2].key);
+
+    EXPECT_TRUE(parse_path("").empty());
+
+    EXPECT_THROW(parse_path("a..b"), msgpacksearch::parse_error);
+    EXPECT_THROW(parse_path(".a"), msgpacksearch::parse_error);
+    EXPECT_THROW(parse_path("a."), msgpacksearch::parse_error);
+    EXPECT_THROW(parse_path("a[x]"), msgpacksearch::parse_error);
+    EXPECT_THROW(parse_path("a[1"), msgpacksearch::parse_error);
+    EXPECT_THROW(parse_path("a]"), msgpacksearch::parse_error);
+    EXPECT_THROW(parse_path("a[0]b"), msgpacksearch::parse_error);
+}
+
+TEST(path, Evaluate)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"a": {"b": [1, 2, {"c": "deep"}]}, "x.y": 5})");
+    Msgpack msgpck(data);
+
+    auto str = std::get<msgpack_str>(msgpck.at_path("a.b[2].c"));
+    EXPECT_EQ("deep", std::string(str.data, str.size));
+    EXPECT_EQ(2, std::get<uint64_t>(msgpck.at_path("a.b[1]")));
+    EXPECT_EQ(5, std::get<uint64_t>(msgpck.at_path(R"(["x.y"])")));
+    EXPECT_EQ(std::monostate(), std::get<std::monostate>(msgpck.at_path("a.b[3]")));
+    EXPECT_EQ(std::monostate(), std::get<std::monostate>(msgpck.at_path("a[0]")));
+    EXPECT_EQ(data.data(), msgpck.find_path(""));
+}
+
+TEST(path, Cache)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"a": {"b": 1}, "c": 2})");
+    auto cache = std::make_shared<LookupCache>();
+
+    Msgpack msgpck(data);
+    msgpck.set_cache(cache, 42);
+
+    EXPECT_EQ(1, std::get<uint64_t>(msgpck.at_path("a.b")));
+    EXPECT_EQ(1, std::get<uint64_t>(msgpck.at_path("a.b")));
+    EXPECT_EQ(nullptr, msgpck.find_path("missing"));
+    EXPECT_EQ(nullptr, msgpck.find_path("missing"));
+
+    // a second view of the same buffer shares the entries
+    Msgpack other(data);
+    other.set_cache(cache, 42);
+    EXPECT_EQ(2, std::get<uint64_t>(other.at_path("c")));
+    EXPECT_EQ(1, std::get<uint64_t>(other.at_path("a.b")));
+
+    LookupCache::stats stats = cache->statistics();
+    EXPECT_EQ(3, stats.hits);
+    EXPECT_EQ(3, stats.misses);
+    EXPECT_EQ(3, stats.entries);
+    EXPECT_EQ(0, stats.evictions);
+
+    // the cached offset is used as is
+    EXPECT_EQ(cache->find(42, "a.b"), msgpck.find_path("a.b") - data.data());
+
+    // a cache needs the identity of the buffer, the address of the data is not one
+    EXPECT_THROW(msgpck.set_cache(cache), std::invalid_argument);
+    EXPECT_NO_THROW(msgpck.set_cache(nullptr));
+    EXPECT_EQ(nullptr, msgpck.cache());
+
+    // an offset past the end of a smaller buffer under a reused id is not trusted
+    std::vector<uint8_t> small = json_to_msgpack(R"({"c": 3})");
+    cache->insert(42, "c", data.size() - 1);
+    Msgpack reused(small);
+    reused.set_cache(cache, 42);
+    EXPECT_EQ(3, std::get<uint64_t>(reused.at_path("c")));
+    EXPECT_EQ(cache->find(42, "c"), reused.find_path("c") - small.data());
+}
+
+TEST(path, CacheEviction)
+{
+    LookupCache probe;
+    probe.insert(1, "p", 0);
+    const size_t entry_memory = probe.statistics().memory;
+
+    LookupCache cache(entry_memory * 4);
+
+    for (size_t i = 0; i < 10; i++)
+        cache.insert(1, "p" + std::to_string(i), i);
+
+    LookupCache::stats stats = cache.statistics();
+    EXPECT_EQ(4, stats.entries);
+    EXPECT_EQ(6, stats.evictions);
+    EXPECT_LE(stats.memory, cache.memory_cap());
+
+    EXPECT_FALSE(cache.find(1, "p0")); // least recently used went first
+    EXPECT_EQ(9, *cache.find(1, "p9"));
+    EXPECT_FALSE(cache.find(2, "p9")); // other buffer
+
+    cache.clear();
+    EXPECT_EQ(0, cache.statistics().entries);
+}
+
+TEST(path, CacheConcurrentReaders)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({"a": [10, 20, 30, 40]})");
+    auto cache = std::make_shared<LookupCache>();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&] {
+            Msgpack view(data);
+            view.set_cache(cache, 7);
+            for (int i = 0; i < 1000; i++)
+                EXPECT_EQ(10 * (i % 4 + 1), std::get<uint64_t>(view.at_path("a[" + std::to_string(i % 4) + "]")));
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    LookupCache::stats stats = cache->statistics();
+    EXPECT_EQ(4000, stats.hits + stats.misses);
+    EXPECT_EQ(4, stats.entries);
+}
+
+TEST(path, Bounded)
+{
+    // {"type": "order", "route": {"svc": "billing", "shard": [3, 4]}, "body": <1000 chars>, "tail": 1}
+    // type: 1..12, route: 12..40, body: 40..1048, tail: 1048..1054
+    std::vector<uint8_t> data;
+    Packer packer(data);
+    packer.pack_map(4);
+    packer.pack_str("type");
+    packer.pack_str("order");
+    packer.pack_str("route");
+    packer.pack_map(2);
+    packer.pack_str("svc");
+    packer.pack_str("billing");
+    packer.pack_str("shard");
+    packer.pack_array(2);
+    packer.pack_uint(3);
+    packer.pack_uint(4);
+    packer.pack_str("body");
+    packer.pack_str(std::string(1000, 'x'));
+    packer.pack_str("tail");
+    packer.pack_uint(1);
+    ASSERT_EQ(1054, data.size());
+
+    lookup_result result = find_key_bounded(data.data(), data.size(), "type");
+    ASSERT_EQ(lookup_status::found, result.status);
+    EXPECT_EQ(data.data() + 6, result.value);
+    EXPECT_EQ(6, result.size);
+    EXPECT_EQ(6, result.bytes_scanned);
+    EXPECT_EQ(1, result.elements_scanned);
+
+    result = find_path_bounded(data.data(), data.size(), parse_path("route.shard[1]"));
+    ASSERT_EQ(lookup_status::found, result.status);
+    EXPECT_EQ(4, *result.value);
+    EXPECT_EQ(39, result.bytes_scanned);
+    EXPECT_EQ(6, result.elements_scanned);
+
+    EXPECT_EQ(lookup_status::found, find_key_bounded(data.data(), data.size(), "tail").status);
+    EXPECT_EQ(lookup_status::missing, find_path_bounded(data.data(), data.size(), parse_path("route.shard[2]")).status);
+    EXPECT_EQ(lookup_status::missing, find_path_bounded(data.data(), data.size(), parse_path("type.x")).status);
+
+    result = find_key_bounded(data.data(), data.size(), "missing");
+    EXPECT_EQ(lookup_status::missing, result.status);
+    EXPECT_EQ(data.size(), result.bytes_scanned);
+    EXPECT_EQ(4, result.elements_scanned);
+
+    // the body does not fit in the byte budget, the scan stops before it
+    lookup_budget budget;
+    budget.max_bytes = 100;
+    result = find_key_bounded(data.data(), data.size(), "tail", budget);
+    EXPECT_EQ(lookup_status::over_budget, result.status);
+    EXPECT_EQ(nullptr, result.value);
+    EXPECT_EQ(45, result.bytes_scanned);
+    EXPECT_EQ(lookup_status::found, find_path_bounded(data.data(), data.size(), parse_path("route.svc"), budget).status);
+
+    budget = lookup_budget();
+    budget.max_elements = 3;
+    result = find_key_bounded(data.data(), data.size(), "tail", budget);
+    EXPECT_EQ(lookup_status::over_budget, result.status);
+    EXPECT_EQ(3, result.elements_scanned);
+
+    // truncated messages
+    EXPECT_EQ(lookup_status::found, find_path_bounded(data.data(), 40, parse_path("route.svc")).status);
+    EXPECT_EQ(lookup_status::truncated, find_key_bounded(data.data(), 500, "tail").status);
+    budget = lookup_budget();
+    budget.max_bytes = 2000;
+    EXPECT_EQ(lookup_status::truncated, find_key_bounded(data.data(), 500, "tail", budget).status);
+    EXPECT_EQ(lookup_status::truncated, find_key_bounded(data.data(), 0, "type").status);
+
+    result = find_key_bounded(data.data(), 10, "type");
+    EXPECT_EQ(lookup_status::truncated, result.status);
+    EXPECT_EQ(data.data() + 6, result.value);
+    EXPECT_EQ(0, result.size);
+}
+
+TEST(path, ParsePattern)
+{
+    msgpack_pattern pattern = parse_pattern(R"(items[*].price.*["*"][-2][1:5][::3][-3:][:-1])");
+    ASSERT_EQ(10, pattern.size());
+    EXPECT_EQ(pattern_element::kind::key, pattern[0].type);
+    EXPECT_EQ(pattern_element::kind::wildcard, pattern[1].type);
+    EXPECT_EQ("price", pattern[2].key);
+    EXPECT_EQ(pattern_element::kind::wildcard, pattern[3].type);
+    EXPECT_EQ(pattern_element::kind::key, pattern[4].type);
+    EXPECT_EQ("*", pattern[4].key);
+    EXPECT_EQ(pattern_element::kind::index, pattern[5].type);
+    EXPECT_EQ(-2, pattern[5].index);
+
+    EXPECT_EQ(pattern_element::kind::slice, pattern[6].type);
+    EXPECT_EQ(1, pattern[6].start);
+    EXPECT_EQ(5, pattern[6].stop);
+    EXPECT_EQ(1, pattern[6].step);
+    EXPECT_EQ(0, pattern[7].start);
+    EXPECT_EQ(INT64_MAX, pattern[7].stop);
+    EXPECT_EQ(3, pattern[7].step);
+    EXPECT_EQ(-3, pattern[8].start);
+    EXPECT_EQ(INT64_MAX, pattern[8].stop);
+    EXPECT_EQ(-1, pattern[9].stop);
+
+    EXPECT_TRUE(parse_pattern("").empty());
+    EXPECT_EQ(pattern_element::kind::wildcard, parse_pattern("*")[0].type);
+
+    for (const char *invalid : {"a[::0]", "a[1:2:-1]", "a[x:]", "a[1:2:3:4]", "a[**]", "a[", "a..*", "[*]x"})
+        EXPECT_THROW(parse_pattern(invalid), parse_error) << invalid;
+
+    // exact paths keep their grammar: * is a key, fan-out selectors are not indexes
+    EXPECT_EQ("*", parse_path("a.*")[1].key);
+    for (const char *invalid : {"a[*]", "a[-1]", "a[1:2]"})
+        EXPECT_THROW(parse_path(invalid), parse_error) << invalid;
+}
+
+TEST(path, Patterns)
+{
+    std::vector<uint8_t> data = json_to_msgpack(R"({
+        "items": [{"sku": "a", "price": 1}, {"sku": "b"}, {"sku": "c", "price": 3}, 4, {"sku": "e", "price": 5}],
+        "metrics": {"cpu": 0.5, "mem": 0.25, "disk": {"used": 7}},
+        "*": "star"
+    })");
+    Msgpack msgpck(data);
+
+    // the values selected by a pattern, compared with a JSON array of the expected values
+    auto selects = [&msgpck](const std::string &pattern, const char *expected) {
+        std::vector<uint8_t> list = json_to_msgpack(expected);
+        Cursor element = Cursor(list.data(), list.size()).at(0);
+        bool same = true;
+
+        size_t visited = msgpck.for_each_match(pattern, [&](const Cursor &value) {
+            same = same && element && equal(value, element);
+            element = element.next_sibling();
+            return true;
+        });
+
+        return same && !element && visited == Cursor(list.data(), list.size()).nmb_elements();
+    };
+
+    EXPECT_TRUE(selects("items[*].price", "[1, 3, 5]"));
+    EXPECT_TRUE(selects("metrics.*", R"([0.5, 0.25, {"used": 7}])"));
+    EXPECT_TRUE(selects("metrics.*.used", "[7]"));
+    EXPECT_TRUE(selects(R"(["*"])", R"(["star"])"));
+    EXPECT_TRUE(selects("items[1:3].sku", R"(["b", "c"])"));
+    EXPECT_TRUE(selects("items[-1].price", "[5]"));
+    EXPECT_TRUE(selects("items[-2]", "[4]"));
+    EXPECT_TRUE(selects("items[-6]", "[]"));
+    EXPECT_TRUE(selects("items[5]", "[]"));
+    EXPECT_TRUE(selects("items[::2].sku", R"(["a", "c", "e"])"));
+    EXPECT_TRUE(selects("items[-2:][*]", R"(["e", 5])"));
+    EXPECT_TRUE(selects("items[3:1]", "[]"));
+    EXPECT_TRUE(selects("metrics[0:2]", "[]"));
+    EXPECT_TRUE(selects("items.*.missing", "[]"));
+    EXPECT_TRUE(selects("*.cpu", "[0.5]"));
+    EXPECT_FALSE(selects("items[*].price", "[1, 3]"));
+
+    // slices against python semantics on an array of 10 elements
+    std::vector<uint8_t> numbers = json_to_msgpack("[0, 1, 2, 3, 4, 5, 6, 7, 8, 9]");
+    Cursor root(numbers.data(), numbers.size());
+
+    for (int64_t start : {-12, -10, -3, -1, 0, 2, 9, 10, 12})
+    {
+        for (int64_t stop : {-12, -4, -1, 0, 3, 10, 15})
+        {
+            for (uint32_t step : {1u, 2u, 4u})
+            {
+                std::vector<uint64_t> expected;
+                int64_t from = start < 0 ? std::max<int64_t>(start + 10, 0) : std::min<int64_t>(start, 10);
+                int64_t to = stop < 0 ? std::max<int64_t>(stop + 10, 0) : std::min<int64_t>(stop, 10);
+                for (int64_t i = from; i < to; i += step)
+                    expected.push_back(i);
+
+                std::string pattern = "[" + std::to_string(start) + ":" + std::to_string(stop) + ":" + std::to_string(step) + "]";
+                std::vector<Cursor> cursors;
+                copy_matches(root, parse_pattern(pattern), std::back_inserter(cursors));
+
+                std::vector<uint64_t> found;
+                for (const Cursor &cursor : cursors)
+                    found.push_back(std::get<uint64_t>(cursor.value()));
+
+                EXPECT_EQ(expected, found) << pattern;
+            }
+        }
+    }
+
+    // the visitor stops the evaluation
+    size_t calls = 0;
+    EXPECT_EQ(2, for_each_match(root, parse_pattern("[*]"), [&calls](const Cursor &) { return ++calls < 2; }));
+    EXPECT_EQ(0, for_each_match(Cursor(), parse_pattern("[*]"), [](const Cursor &) { return true; }));
+    EXPECT_THROW(msgpck.for_each_match("items[", [](const Cursor &) { return true; }), parse_error);
+}
@@ -0,0 +1,90 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <error.h>
+
+#include "msgpacksearch/json.h"
+#include "msgpacksearch/profiler.h"
+
+
+using namespace msgpacksearch;
+
+TEST(profiler, Paths)
+{
+    std::vector<uint8_t> stream = json_to_msgpack(R"({"id": 1, "items": [{"price": 2}, {"price": 2.5}], "a.b": "x"})");
+    std::vector<uint8_t> second = json_to_msgpack(R"({"items": [], "id": -1})");
+    stream.insert(stream.end(), second.begin(), second.end());
+
+    Profiler profiler;
+    EXPECT_EQ(2, profiler.profile_stream(stream.data(), stream.size()));
+    EXPECT_EQ(2, profiler.documents());
+    EXPECT_EQ(3, profiler.max_depth());
+
+    auto paths = profiler.paths();
+    ASSERT_EQ(6, paths.size()); // root, id, items, items[*], items[*].price, ["a.b"]
+
+    const path_profile &root = paths.at("");
+    EXPECT_EQ(2, root.count);
+    EXPECT_EQ(2, root.containers);
+    EXPECT_EQ(3, root.max_width);
+    EXPECT_EQ(2, root.min_width);
+    EXPECT_EQ(stream.size(), root.total_bytes);
+
+    const path_profile &id = paths.at("id");
+    EXPECT_EQ(1, id.types[static_cast<size_t>(msgpack_type::uint)]);
+    EXPECT_EQ(1, id.types[static_cast<size_t>(msgpack_type::int_)]);
+    EXPECT_EQ(1, id.key_positions.at(0));
+    EXPECT_EQ(1, id.key_positions.at(1));
+    EXPECT_EQ(1, id.depth);
+
+    const path_profile &items = paths.at("items");
+    EXPECT_EQ(2, items.types[static_cast<size_t>(msgpack_type::array)]);
+    EXPECT_EQ(0, items.min_width);
+    EXPECT_EQ(2, items.max_width);
+
+    const path_profile &price = paths.at("items[*].price");
+    EXPECT_EQ(2, price.count);
+    EXPECT_EQ(3, price.depth);
+    EXPECT_EQ(1, price.types[static_cast<size_t>(msgpack_type::float_)]);
+    EXPECT_EQ(1, price.min_bytes);
+    EXPECT_EQ(9, price.max_bytes);
+
+    EXPECT_EQ(1, paths.count(R"(["a.b"])"));
+
+    std::string json = profiler.report_json();
+    EXPECT_NE(std::string::npos, json.find(R"({"path":"items[*].price","count":2,"depth":3)"));
+    EXPECT_NE(std::string::npos, profiler.report().find("items[*].price  count=2"));
+}
+
+TEST(profiler, Errors)
+{
+    Profiler profiler;
+    std::vector<uint8_t> truncated = {0x92, 0x01};
+    EXPECT_THROW(profiler.profile(truncated.data(), truncated.size()), msgpacksearch::parse_error);
+
+    std::vector<uint8_t> invalid = {0x91, 0xc1};
+    EXPECT_THROW(profiler.profile(invalid.data(), invalid.size()), msgpacksearch::parse_error);
+
+    std::vector<uint8_t> map_header = {0xde};
+    EXPECT_THROW(profiler.profile(map_header.data(), map_header.size()), msgpacksearch::parse_error);
+
+    std::vector<uint8_t> key = {0x81, 0xa5, 'p', 'r'};
+    EXPECT_THROW(profiler.profile(key.data(), key.size()), msgpacksearch::parse_error);
+
+    std::vector<uint8_t> value = {0x81, 0xa1, 'p', 0xcb, 0x00};
+    EXPECT_THROW(profiler.profile(value.data(), value.size()), msgpacksearch::parse_error);
+
+    EXPECT_THROW(profiler.profile(map_header.data(), 0), msgpacksearch::parse_error);
+    EXPECT_EQ(0, profiler.documents());
+}
+
+TEST(profiler, DeepNesting)
+{
+    std::vector<uint8_t> deep(100000, 0x91);
+    deep.push_back(0x01);
+
+    Profiler profiler;
+    EXPECT_EQ(deep.size(), profiler.profile(deep.data(), deep.size()));
+    EXPECT_EQ(deep.size() - 1, profiler.max_depth());
+}
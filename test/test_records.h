@@ -0,0 +1,61 @@
+#ifndef MSGPACKSEARCH_TEST_RECORDS_H
+#define MSGPACKSEARCH_TEST_RECORDS_H
+
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "msgpacksearch/json.h"
+#include "msgpacksearch/packer.h"
+
+// Builders of the record streams the tests index, aggregate and scan
+
+namespace msgpacksearch {
+
+/// Packs one value of a record
+using pack_value = std::function<void(Packer &)>;
+
+/// key -> value member of a record
+using record_member = std::pair<std::string, pack_value>;
+
+/// Packs a record as a map of its members, in order
+inline void pack_record(Packer &packer, const std::vector<record_member> &members)
+{
+    packer.pack_map(members.size());
+
+    for (const auto &[key, value] : members)
+    {
+        packer.pack_str(key);
+        value(packer);
+    }
+}
+
+/// A map value, packed as pack_record does
+inline pack_value map_value(std::vector<record_member> members)
+{
+    return [members = std::move(members)](Packer &packer) { pack_record(packer, members); };
+}
+
+/// A scalar given as JSON, in its smallest encoding
+inline pack_value json_value(std::string_view json)
+{
+    return [encoded = json_to_msgpack(json)](Packer &packer) { packer.pack_raw(encoded.data(), encoded.size()); };
+}
+
+/// Concatenated json_to_msgpack encodings, for streams whose encodings do not matter
+inline std::vector<uint8_t> json_records(std::initializer_list<std::string_view> documents)
+{
+    std::vector<uint8_t> stream;
+
+    for (std::string_view document : documents)
+        json_to_msgpack(document, stream);
+
+    return stream;
+}
+
+}
+
+#endif //MSGPACKSEARCH_TEST_RECORDS_H
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "msgpacksearch/decode.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/hash.h"
+#include "msgpacksearch/packer.h"
+#include "msgpacksearch/side_index.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// Documents with one large map (indexed), one large array (checkpointed) and a small nested map
+std::vector<uint8_t> make_documents(size_t nmb_documents)
+{
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+
+    for (size_t document = 0; document < nmb_documents; document++)
+    {
+        packer.pack_map(12);
+        for (uint32_t key = 0; key < 10; key++)
+        {
+            packer.pack_str("k" + std::to_string(key));
+            packer.pack_uint(document * 100 + key);
+        }
+        packer.pack_str("list");
+        packer.pack_array(100);
+        for (uint32_t element = 0; element < 100; element++)
+            packer.pack_str("e" + std::to_string(element));
+        packer.pack_str("nested");
+        packer.pack_map(1);
+        packer.pack_str("x");
+        packer.pack_int(-static_cast<int64_t>(document));
+    }
+
+    return buffer;
+}
+
+void write_bytes(const std::string &path, const std::vector<uint8_t> &bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+struct side_index_files
+{
+    std::string data = ::testing::TempDir() + "msgpacksearch_side_index.msgpack";
+    std::string index = SideIndex::default_path(data);
+
+    ~side_index_files()
+    {
+        std::remove(data.c_str());
+        std::remove(index.c_str());
+    }
+};
+
+}
+
+TEST(hash, Xxhash64)
+{
+    // reference values of XXH64
+    const std::string long_input = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    EXPECT_EQ(0xef46db3751d8e999ULL, xxhash64("", 0));
+    EXPECT_EQ(0x44bc2cf5ad770999ULL, xxhash64("abc", 3));
+    EXPECT_EQ(0x7639d419de614eedULL, xxhash64(long_input.data(), long_input.size()));
+    EXPECT_EQ(0xe023c8f961330a31ULL, xxhash64(long_input.data(), long_input.size(), 42));
+}
+
+TEST(side_index, Lookups)
+{
+    side_index_files files;
+    write_bytes(files.data, make_documents(5));
+
+    EXPECT_EQ(side_index_status::missing, SideIndex::check(files.data, files.index));
+    side_index_options options;
+    options.min_map_keys = 8;
+    EXPECT_EQ(5, SideIndex::build(files.data, files.index, options));
+    EXPECT_EQ(side_index_status::ok, SideIndex::check(files.data, files.index));
+
+    std::unique_ptr<SideIndex> index = SideIndex::open(files.data, files.index);
+    ASSERT_NE(nullptr, index);
+    EXPECT_EQ(5, index->documents());
+    EXPECT_EQ(5, index->indexed_maps());
+    EXPECT_EQ(5, index->indexed_arrays());
+    EXPECT_EQ(index->data_file().size(), index->document_offset(4) + index->document_size(4));
+
+    for (size_t document = 0; document < index->documents(); document++)
+    {
+        Msgpack view = index->document(document);
+        EXPECT_EQ(document * 100 + 7, view.get_u64("k7"));
+
+        const uint8_t *value = index->find_path(document, "k9");
+        ASSERT_NE(nullptr, value);
+        EXPECT_EQ(document * 100 + 9, std::get<uint64_t>(Msgpack::parse_data(value).second));
+
+        for (uint32_t element : {0u, 31u, 32u, 33u, 99u})
+        {
+            const uint8_t *found = index->find_path(document, "list[" + std::to_string(element) + "]");
+            ASSERT_NE(nullptr, found);
+            EXPECT_EQ(view.cursor().child("list").at(element).data(), found);
+        }
+
+        // the nested map is below min_map_keys and goes through the linear fallback
+        const uint8_t *x = index->find_path(document, "nested.x");
+        ASSERT_NE(nullptr, x);
+        int64_t nested;
+        ASSERT_TRUE(read_i64(x, nested));
+        EXPECT_EQ(-static_cast<int64_t>(document), nested);
+
+        EXPECT_EQ(nullptr, index->find_path(document, "missing"));
+        EXPECT_EQ(nullptr, index->find_path(document, "list[100]"));
+        EXPECT_EQ(nullptr, index->find_path(document, "k1.deeper"));
+    }
+}
+
+TEST(side_index, Validation)
+{
+    side_index_files files;
+    std::vector<uint8_t> data = make_documents(3);
+    write_bytes(files.data, data);
+
+    std::unique_ptr<SideIndex> index = SideIndex::open_or_build(files.data, files.index);
+    ASSERT_NE(nullptr, index);
+    index.reset();
+
+    // same size, same modification time, different content: caught by the sampled hash
+    struct stat before;
+    ASSERT_EQ(0, stat(files.data.c_str(), &before));
+    data[data.size() - 1] ^= 1;
+    write_bytes(files.data, data);
+    struct timespec times[2] = {before.st_atim, before.st_mtim};
+    ASSERT_EQ(0, utimensat(AT_FDCWD, files.data.c_str(), times, 0));
+    EXPECT_EQ(side_index_status::stale, SideIndex::check(files.data, files.index));
+
+    // open_or_build rebuilds it
+    ASSERT_NE(nullptr, SideIndex::open_or_build(files.data, files.index));
+    EXPECT_EQ(side_index_status::ok, SideIndex::check(files.data, files.index));
+
+    // a flipped byte in the payload
+    std::ifstream in(files.index, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    bytes[bytes.size() - 3] ^= 0x10;
+    write_bytes(files.index, bytes);
+    side_index_status status;
+    EXPECT_EQ(nullptr, SideIndex::open(files.data, files.index, &status));
+    EXPECT_EQ(side_index_status::corrupt, status);
+
+    write_bytes(files.index, std::vector<uint8_t>{'n', 'o', 'p', 'e'});
+    EXPECT_EQ(side_index_status::bad_format, SideIndex::check(files.data, files.index));
+
+    // invalid data
+    write_bytes(files.data, std::vector<uint8_t>{0x92, 0x01});
+    EXPECT_THROW(SideIndex::build(files.data, files.index), parse_error);
+    EXPECT_THROW(SideIndex::open(files.data + ".absent", files.index), std::system_error);
+}
+
+TEST(side_index, MemoryBudget)
+{
+    side_index_files files;
+    write_bytes(files.data, make_documents(2000));
+
+    side_index_options options;
+    options.min_map_keys = 8;
+    std::unique_ptr<SideIndex> index = SideIndex::open_or_build(files.data, files.index, options);
+    const MappedFile &data = index->data_file();
+    const size_t page = MappedFile::page_size();
+
+    PageTracker pages(data, 16 * page);
+    size_t max_pages = 0;
+
+    for (size_t i = 0; i < 500; i++)
+    {
+        size_t document = i * 7919 % index->documents();
+
+        for (const char *path : {"k3", "list[45]", "nested.x", "missing"})
+        {
+            const uint8_t *found = index->find_path(document, path, pages);
+            EXPECT_EQ(index->find_path(document, path), found) << path;
+            // the key table answers a missing key without reading the data
+            EXPECT_EQ(found ? 1u : 0u, std::min<size_t>(pages.pages_touched(), 1)) << path;
+            max_pages = std::max(max_pages, pages.pages_touched());
+        }
+
+        // the tracked set exceeds the budget by at most the pages of one query
+        EXPECT_LE(pages.tracked_bytes(), (16 + max_pages) * page);
+    }
+
+    // a lookup reads a few pages around the value, not the document stream
+    EXPECT_LE(max_pages, 3u);
+    EXPECT_EQ(2000, pages.queries());
+    EXPECT_GT(pages.releases(), 0u);
+
+    // the empty path reads nothing
+    EXPECT_EQ(data.data() + index->document_offset(3), index->find_path(3, "", pages));
+    EXPECT_EQ(0, pages.pages_touched());
+}
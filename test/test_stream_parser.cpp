@@ -0,0 +1,247 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/decode.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
+#include "msgpacksearch/stream_parser.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// {"id": id, "route": {"svc": <svc>, "shard": [id, id + 1]}, "body": <large bin>}
+void pack_message(Packer &packer, uint64_t id, const std::string &svc)
+{
+    std::vector<uint8_t> body(3000, static_cast<uint8_t>(id));
+
+    packer.pack_map(3);
+    packer.pack_str("id");
+    packer.pack_uint(id);
+    packer.pack_str("route");
+    packer.pack_map(2);
+    packer.pack_str("svc");
+    packer.pack_str(svc);
+    packer.pack_str("shard");
+    packer.pack_array(2);
+    packer.pack_uint(id);
+    packer.pack_uint(id + 1);
+    packer.pack_str("body");
+    packer.pack_bin(body.data(), body.size());
+}
+
+std::vector<uint8_t> make_stream()
+{
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+
+    pack_message(packer, 1, "billing");
+    pack_message(packer, 2, std::string(300, 's')); // str 16 spanning chunks
+    packer.pack_map(1); // no route
+    packer.pack_str("id");
+    packer.pack_uint(3);
+    pack_message(packer, 70000, "search"); // uint 32 id
+
+    return buffer;
+}
+
+struct received
+{
+    size_t size;
+    std::vector<uint8_t> value; // empty without a match
+    size_t matched_at; // object bytes fed when the match was reported
+};
+
+/// Feeds the stream in chunks of chunk_size bytes
+std::vector<received> parse_chunks(const std::vector<uint8_t> &stream, const std::string &path, size_t chunk_size)
+{
+    StreamParser parser(path);
+    std::vector<received> objects;
+    received current{0, {}, 0};
+
+    parser.on_match([&](const uint8_t *value, size_t size) {
+        current.value.assign(value, value + size);
+        current.matched_at = parser.object_size();
+    });
+    parser.on_object([&](size_t size) {
+        current.size = size;
+        objects.push_back(current);
+        current = received{0, {}, 0};
+    });
+
+    for (size_t offset = 0; offset < stream.size();)
+    {
+        size_t chunk = std::min(chunk_size, stream.size() - offset);
+        size_t consumed = 0;
+
+        while (consumed < chunk)
+            consumed += parser.feed(stream.data() + offset + consumed, chunk - consumed);
+
+        offset += chunk;
+    }
+
+    EXPECT_FALSE(parser.depth());
+    return objects;
+}
+
+}
+
+TEST(stream_parser, Chunks)
+{
+    std::vector<uint8_t> stream = make_stream();
+
+    for (const std::string path : {"route.svc", "route.shard[1]", "route", "id"})
+    {
+        msgpack_path steps = parse_path(path);
+
+        for (size_t chunk_size : {1, 2, 3, 7, 64, 100000})
+        {
+            std::vector<received> objects = parse_chunks(stream, path, chunk_size);
+            ASSERT_EQ(4, objects.size());
+
+            size_t offset = 0;
+            for (const received &object : objects)
+            {
+                const uint8_t *record = stream.data() + offset;
+                ASSERT_EQ(Msgpack::skip_object(record), object.size) << path << " " << chunk_size;
+
+                Cursor expected = follow_path(Cursor(record, object.size), steps);
+                if (expected)
+                {
+                    EXPECT_EQ(std::vector<uint8_t>(expected.data(), expected.data() + expected.length()), object.value) << path;
+                    // reported with the value, before the body
+                    EXPECT_EQ(expected.data() + expected.length() - record, object.matched_at) << path;
+                }
+                else
+                    EXPECT_TRUE(object.value.empty()) << path;
+
+                offset += object.size;
+            }
+        }
+    }
+}
+
+TEST(stream_parser, Routing)
+{
+    std::vector<uint8_t> stream = make_stream();
+    StreamParser parser("route.svc");
+
+    // the routing key is known after the first few bytes of a 3k message
+    size_t fed = 0;
+    while (!parser.matched())
+        fed += parser.feed(stream.data() + fed, 1);
+
+    EXPECT_LT(fed, 40);
+    EXPECT_FALSE(parser.complete());
+    EXPECT_EQ(2, parser.depth());
+
+    std::string_view svc;
+    ASSERT_TRUE(read_str(parser.match().data(), svc));
+    EXPECT_EQ("billing", svc);
+
+    // feed stops at the end of the message
+    fed += parser.feed(stream.data() + fed, stream.size() - fed);
+    EXPECT_TRUE(parser.complete());
+    EXPECT_EQ(Msgpack::skip_object(stream.data()), fed);
+    EXPECT_EQ(fed, parser.object_size());
+
+    // and the next one starts on the next feed
+    parser.feed(stream.data() + fed, 1);
+    EXPECT_FALSE(parser.complete());
+    EXPECT_FALSE(parser.matched());
+    EXPECT_EQ(1, parser.object_size());
+}
+
+TEST(stream_parser, Duplicates)
+{
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+
+    // {"a": {"x": 1}, "a": {"b": 2}, "": 3}: the first "a" wins, so "a.b" does not resolve
+    packer.pack_map(3);
+    packer.pack_str("a");
+    packer.pack_map(1);
+    packer.pack_str("x");
+    packer.pack_uint(1);
+    packer.pack_str("a");
+    packer.pack_map(1);
+    packer.pack_str("b");
+    packer.pack_uint(2);
+    packer.pack_str("");
+    packer.pack_uint(3);
+
+    std::vector<received> objects = parse_chunks(buffer, "a.b", 1);
+    ASSERT_EQ(1, objects.size());
+    EXPECT_TRUE(objects[0].value.empty());
+
+    objects = parse_chunks(buffer, "[\"\"]", 1);
+    ASSERT_EQ(1, objects.size());
+    EXPECT_EQ(std::vector<uint8_t>({3}), objects[0].value);
+
+    std::vector<uint8_t> invalid = {0x92, 0x01, 0xc1};
+    StreamParser parser;
+    try
+    {
+        parser.feed(invalid.data(), invalid.size());
+        FAIL();
+    }
+    catch (const parse_error &e)
+    {
+        EXPECT_EQ(2, e.offset());
+    }
+
+    EXPECT_THROW(StreamParser("a["), parse_error);
+}
+
+#ifdef MSGPACKSEARCH_HAS_COROUTINES
+
+namespace {
+
+/// Fire and forget coroutine, runs until its first suspension when called
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+detached route(StreamParser &parser, std::vector<std::string> &routes, std::vector<size_t> &sizes, size_t count)
+{
+    for (size_t message = 0; message < count; message++)
+    {
+        const std::vector<uint8_t> *svc = co_await parser.next_match();
+        std::string_view name;
+        routes.push_back(svc && read_str(svc->data(), name) ? std::string(name) : "none");
+        sizes.push_back(co_await parser.next_object());
+    }
+}
+
+}
+
+TEST(stream_parser, Coroutine)
+{
+    std::vector<uint8_t> stream = make_stream();
+    StreamParser parser("route.svc");
+    std::vector<std::string> routes;
+    std::vector<size_t> sizes;
+
+    route(parser, routes, sizes, 4);
+
+    for (size_t offset = 0; offset < stream.size();)
+        offset += parser.feed(stream.data() + offset, std::min<size_t>(5, stream.size() - offset));
+
+    EXPECT_EQ(std::vector<std::string>({"billing", std::string(300, 's'), "none", "search"}), routes);
+    ASSERT_EQ(4, sizes.size());
+    EXPECT_EQ(Msgpack::skip_object(stream.data()), sizes[0]);
+}
+
+#endif
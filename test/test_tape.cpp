@@ -0,0 +1,326 @@
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/json.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
+#include "msgpacksearch/tape.h"
+#include "msgpacksearch/thread_pool.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+const char *document = R"({
+    "id": 7,
+    "name": "tape",
+    "empty": {},
+    "none": [],
+    "items": [
+        {"sku": "a-1", "qty": 2, "tags": ["x", "y"]},
+        {"sku": "b-2", "qty": 300, "tags": []},
+        {"sku": "c-3", "qty": -4, "dims": {"w": 1.5, "h": 2.5}}
+    ],
+    "meta": {"host": "n1", "pid": 70000, "env": {"region": "eu", "zone": null}},
+    "flag": true
+})";
+
+}
+
+TEST(tape, Entries)
+{
+    std::vector<uint8_t> data = json_to_msgpack(document);
+    Tape tape(data.data(), data.size());
+
+    EXPECT_EQ(data.size(), tape.size());
+    EXPECT_EQ(data.data(), tape.data());
+    EXPECT_EQ(0, tape.entries()[0].offset());
+    EXPECT_EQ(tape.entries().size(), tape.entries()[0].next);
+
+    // every entry covers exactly its object
+    for (uint32_t entry = 0; entry < tape.entries().size(); entry++)
+    {
+        const tape_entry &current = tape.entries()[entry];
+        EXPECT_EQ(data[current.offset()], current.type());
+        EXPECT_EQ(Msgpack::skip_object(tape.object(entry)), tape.object_size(entry)) << entry;
+        EXPECT_GT(current.next, entry);
+
+        if (current.key_size)
+            EXPECT_EQ(current.key_size, Msgpack::skip_object(tape.key(entry))) << entry;
+        else
+            EXPECT_EQ(nullptr, tape.key(entry));
+    }
+
+    // keys have no entries: 1 root, 7 members, 3 items with their members and tags, 3 members of meta, 2 of env
+    EXPECT_EQ(1 + 7 + 3 + (3 + 2) + (3 + 0) + (3 + 2) + 3 + 2, tape.entries().size());
+
+    // a scalar root is a single entry
+    std::vector<uint8_t> scalar = {0xcd, 0x01, 0x00};
+    Tape single(scalar.data(), scalar.size());
+    ASSERT_EQ(1, single.entries().size());
+    EXPECT_EQ(0, single.entries()[0].key_size);
+    EXPECT_EQ(3, single.size());
+    EXPECT_EQ(Tape::npos, single.child(0, "a"));
+    EXPECT_EQ(Tape::npos, single.at(0, 0));
+
+    // trailing bytes after the root object are not part of it
+    scalar.push_back(0x01);
+    EXPECT_EQ(3, Tape(scalar.data(), scalar.size()).size());
+}
+
+TEST(tape, Lookups)
+{
+    std::vector<uint8_t> data = json_to_msgpack(document);
+    auto tape = std::make_shared<const Tape>(data.data(), data.size());
+    Cursor root(data.data(), data.size());
+
+    for (const std::string path : {"", "id", "name", "empty", "empty.a", "none", "none[0]", "items[0].sku",
+                                   "items[1].qty", "items[1].tags", "items[2].dims.h", "items[3]", "items.sku",
+                                   "meta.env.zone", "meta.env.region", "meta.pid", "meta[0]", "flag", "missing",
+                                   "id.x"})
+    {
+        msgpack_path steps = parse_path(path);
+        uint32_t entry = tape->follow(0, steps);
+        Cursor expected = follow_path(root, steps);
+
+        EXPECT_EQ(expected.data(), entry == Tape::npos ? nullptr : tape->object(entry)) << path;
+        if (expected)
+        {
+            EXPECT_EQ(expected.length(), tape->object_size(entry)) << path;
+        }
+    }
+
+    // drop-in lookups of a Msgpack view
+    Msgpack plain(data);
+    Msgpack taped(data);
+    taped.set_tape(tape);
+    EXPECT_EQ(tape, taped.tape());
+
+    EXPECT_EQ(plain.find_path("items[2].dims.w"), taped.find_path("items[2].dims.w"));
+    EXPECT_EQ(nullptr, taped.find_path("items[2].dims.d"));
+    EXPECT_EQ(std::get<msgpack_str>(plain.at_path("meta.host")).data, std::get<msgpack_str>(taped.at_path("meta.host")).data);
+    EXPECT_EQ(7, taped.get_u64("id"));
+    EXPECT_EQ("tape", taped.get_string_view("name"));
+    EXPECT_EQ(std::nullopt, taped.try_get_u64("missing"));
+    EXPECT_TRUE(taped.get_bool("flag"));
+    EXPECT_EQ(3, taped.get_array("items").nmb_elements);
+    EXPECT_EQ(plain.get_map("meta").start, taped.get_map("meta").start);
+    EXPECT_EQ(std::get<msgpack_map>(plain["meta"]).start, std::get<msgpack_map>(taped["meta"]).start);
+    EXPECT_TRUE(std::holds_alternative<std::monostate>(taped["missing"]));
+
+    // a cache in front of the tape memoizes its answers
+    taped.set_cache(std::make_shared<LookupCache>(), 1);
+    EXPECT_EQ(plain.find_path("items[0].tags[1]"), taped.find_path("items[0].tags[1]"));
+    EXPECT_EQ(plain.find_path("items[0].tags[1]"), taped.find_path("items[0].tags[1]"));
+
+    std::vector<uint8_t> array_data = json_to_msgpack(R"([1, [2, 3], {"a": 4}, "five"])");
+    Msgpack array(array_data);
+    array.set_tape(std::make_shared<const Tape>(array_data.data(), array_data.size()));
+    EXPECT_EQ(1, array.get_u64(0));
+    EXPECT_EQ("five", array.get_string_view(3));
+    EXPECT_EQ(std::nullopt, array.try_get_u64(4));
+    EXPECT_EQ(Msgpack(array_data).get_array(1).start, std::get<msgpack_array>(array[1]).start);
+    EXPECT_THROW(array[4], std::out_of_range);
+
+    taped.set_tape(nullptr);
+    EXPECT_EQ(nullptr, taped.tape());
+    EXPECT_THROW(taped.set_tape(std::make_shared<const Tape>(array_data.data(), array_data.size())), std::invalid_argument);
+}
+
+TEST(tape, Keys)
+{
+    std::vector<uint8_t> data;
+    Packer packer(data);
+
+    // {1: "int key", "a": 1, "a": 2, [0]: 3, "long...": 4, "": 5}
+    std::string long_key(40, 'k');
+    packer.pack_map(6);
+    packer.pack_uint(1);
+    packer.pack_str("int key");
+    packer.pack_str("a");
+    packer.pack_uint(1);
+    packer.pack_str("a");
+    packer.pack_uint(2);
+    packer.pack_array(1);
+    packer.pack_uint(0);
+    packer.pack_uint(3);
+    packer.pack_str(long_key);
+    packer.pack_uint(4);
+    packer.pack_str("");
+    packer.pack_uint(5);
+
+    Tape tape(data.data(), data.size());
+    Cursor root(data.data(), data.size());
+
+    for (const std::string &key : std::vector<std::string>{"a", long_key, "", "int key", "b"})
+    {
+        uint32_t entry = tape.child(0, key);
+        Cursor expected = root.child(key);
+        EXPECT_EQ(expected.data(), entry == Tape::npos ? nullptr : tape.object(entry)) << key;
+    }
+
+    EXPECT_EQ(1, *tape.object(tape.child(0, "a")));
+}
+
+TEST(tape, Tables)
+{
+    std::vector<uint8_t> data;
+    Packer packer(data);
+
+    // large arrays nested in large arrays fill their element tables in turns
+    packer.pack_array(40);
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        if (i % 10 == 3)
+        {
+            packer.pack_array(Tape::table_threshold + i);
+            for (uint32_t j = 0; j < Tape::table_threshold + i; j++)
+                packer.pack_uint(j * 1000);
+        }
+        else if (i % 10 == 5)
+        {
+            packer.pack_map(1);
+            packer.pack_str("small");
+            packer.pack_array(2);
+            packer.pack_uint(i);
+            packer.pack_str("x");
+        }
+        else
+        {
+            packer.pack_uint(i);
+        }
+    }
+
+    Tape tape(data.data(), data.size());
+    Cursor root(data.data(), data.size());
+
+    for (uint32_t i = 0; i <= 40; i++)
+    {
+        Cursor expected = root.at(i);
+        uint32_t entry = tape.at(0, i);
+        ASSERT_EQ(expected.data(), entry == Tape::npos ? nullptr : tape.object(entry)) << i;
+
+        for (uint32_t j : {0u, 1u, 31u, 32u, 50u, 80u})
+        {
+            std::string path = "[" + std::to_string(i) + "][" + std::to_string(j) + "]";
+            Cursor nested = follow_path(root, parse_path(path));
+            uint32_t nested_entry = tape.follow(0, parse_path(path));
+            EXPECT_EQ(nested.data(), nested_entry == Tape::npos ? nullptr : tape.object(nested_entry)) << path;
+        }
+    }
+}
+
+TEST(tape, Parallel)
+{
+    ThreadPool pool(4);
+
+    // large root arrays and maps whose members are scalars, small and large nested containers
+    std::string array = "[";
+    std::string map = "{";
+
+    for (int i = 0; i < 300; i++)
+    {
+        std::string element = i % 3 == 0 ? std::to_string(i) : i % 3 == 1 ? R"({"i": )" + std::to_string(i) + R"(, "d": [[1], {"x": null}]})" : "[";
+
+        if (i % 3 == 2)
+        {
+            for (int j = 0; j < i % 50; j++)
+                element += (j ? ", " : "") + std::to_string(j);
+            element += "]";
+        }
+
+        array += (i ? ", " : "") + element;
+        map += (i ? R"(, "k)" : R"("k)") + std::to_string(i) + R"(": )" + element;
+    }
+
+    for (const std::string &json : {array + "]", map + "}"})
+    {
+        std::vector<uint8_t> data = json_to_msgpack(json);
+        Tape expected(data.data(), data.size());
+
+        for (size_t chunk_bytes : {size_t(1), size_t(100), data.size() / 2, data.size()})
+        {
+            Tape tape(data.data(), data.size(), &pool, chunk_bytes);
+
+            ASSERT_EQ(expected.entries().size(), tape.entries().size()) << chunk_bytes;
+            EXPECT_EQ(expected.size(), tape.size());
+
+            for (uint32_t entry = 0; entry < tape.entries().size(); entry++)
+            {
+                EXPECT_EQ(expected.entries()[entry].position, tape.entries()[entry].position) << entry;
+                EXPECT_EQ(expected.entries()[entry].next, tape.entries()[entry].next) << entry;
+                EXPECT_EQ(expected.entries()[entry].key_size, tape.entries()[entry].key_size) << entry;
+
+                for (uint32_t index : {0u, 1u, 31u, 40u, 299u, 300u})
+                    EXPECT_EQ(expected.at(entry, index), tape.at(entry, index)) << entry << " " << index;
+            }
+
+            EXPECT_EQ(expected.follow(0, parse_path("k298[47]")), tape.follow(0, parse_path("k298[47]")));
+            EXPECT_EQ(expected.follow(0, parse_path("[298][47]")), tape.follow(0, parse_path("[298][47]")));
+        }
+    }
+
+    // a pool without workers to spare, scalars and small documents build on the calling thread
+    ThreadPool single(1);
+    std::vector<uint8_t> data = json_to_msgpack(array + "]");
+    EXPECT_EQ(Tape(data.data(), data.size()).entries().size(), Tape(data.data(), data.size(), &single, 1).entries().size());
+    std::vector<uint8_t> scalar = {0xcd, 0x01, 0x00};
+    EXPECT_EQ(1, Tape(scalar.data(), scalar.size(), &pool, 1).entries().size());
+
+    // errors past the first run are found by the skip pass or the tasks
+    std::vector<uint8_t> truncated = data;
+    truncated.pop_back();
+    EXPECT_THROW(Tape(truncated.data(), truncated.size(), &pool, 100), parse_error);
+
+    std::vector<uint8_t> invalid = data;
+    invalid[data.size() - 2] = 0xc1;
+    EXPECT_THROW(Tape(invalid.data(), invalid.size(), &pool, 100), parse_error);
+
+    std::vector<uint8_t> huge = {0xdd, 0xff, 0xff, 0xff, 0xff, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01};
+    EXPECT_THROW(Tape(huge.data(), huge.size(), &pool, 1), parse_error);
+}
+
+TEST(tape, Errors)
+{
+    std::vector<uint8_t> truncated = {0x92, 0x01, 0xa3, 'a', 'b'};
+    std::vector<uint8_t> unfinished = {0x82, 0xa1, 'a', 0x01};
+    std::vector<uint8_t> invalid = {0x91, 0xc1};
+    std::vector<uint8_t> invalid_key = {0x81, 0x91, 0xc1, 0x01};
+    std::vector<uint8_t> huge = {0xdd, 0xff, 0xff, 0xff, 0xff, 0x01};
+
+    EXPECT_THROW(Tape(truncated.data(), truncated.size()), parse_error);
+    EXPECT_THROW(Tape(unfinished.data(), unfinished.size()), parse_error);
+    EXPECT_THROW(Tape(truncated.data(), 0), parse_error);
+    EXPECT_THROW(Tape(huge.data(), huge.size()), parse_error);
+
+    try
+    {
+        Tape(invalid.data(), invalid.size());
+        FAIL();
+    }
+    catch (const parse_error &e)
+    {
+        EXPECT_EQ(1, e.offset());
+    }
+
+    try
+    {
+        Tape(invalid_key.data(), invalid_key.size());
+        FAIL();
+    }
+    catch (const parse_error &e)
+    {
+        EXPECT_EQ(2, e.offset());
+    }
+
+    Tape empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(Tape::npos, empty.child(0, "a"));
+    EXPECT_EQ(Tape::npos, empty.follow(0, parse_path("a")));
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/decode.h"
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/msgpacksearch.h"
+#include "msgpacksearch/packer.h"
+#include "msgpacksearch/time_index.h"
+#include "test_records.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// {"seq": seq, "at": {"ts": time}}, or {"seq": seq} without a timestamp
+void pack_timed(Packer &packer, uint64_t seq, const msgpack_timestamp *time)
+{
+    std::vector<record_member> members = {{"seq", json_value(std::to_string(seq))}};
+
+    if (time)
+        members.emplace_back("at", map_value({{"ts", [time = *time](Packer &p) { p.pack_timestamp(time); }}}));
+
+    pack_record(packer, members);
+}
+
+/// Records with runs of equal timestamps, an untimed prefix and untimed records in between
+std::vector<uint8_t> collection(std::vector<msgpack_timestamp> &times)
+{
+    std::vector<uint8_t> data;
+    Packer packer(data);
+
+    for (uint64_t seq = 0; seq < 3; seq++)
+    {
+        pack_timed(packer, seq, nullptr);
+        times.push_back({-1, 0});
+    }
+
+    for (uint64_t seq = 3; seq < 1000; seq++)
+    {
+        msgpack_timestamp time{static_cast<int64_t>(1700000000 + seq / 7), static_cast<uint32_t>(seq % 7 < 4 ? 0 : 500)};
+
+        if (seq % 13 == 0)
+        {
+            pack_timed(packer, seq, nullptr);
+            times.push_back({-1, 0});
+        }
+        else
+        {
+            pack_timed(packer, seq, &time);
+            times.push_back(time);
+        }
+    }
+
+    return data;
+}
+
+}
+
+TEST(time_index, Ranges)
+{
+    std::vector<msgpack_timestamp> times;
+    std::vector<uint8_t> data = collection(times);
+
+    for (size_t interval : {1, 5, 64, 5000})
+    {
+        TimeIndex index("at.ts", interval);
+        EXPECT_EQ(times.size(), index.append(data));
+        EXPECT_EQ(times.size(), index.records());
+        EXPECT_EQ(data.size(), index.indexed_bytes());
+        EXPECT_EQ(std::count(times.begin(), times.end(), msgpack_timestamp{-1, 0}), index.untimed());
+        EXPECT_GE(index.samples(), 1);
+        EXPECT_LE(index.samples(), times.size() / interval + 1);
+
+        for (int64_t first = 1699999990; first < 1700000160; first += 3)
+        {
+            for (msgpack_timestamp until : {msgpack_timestamp{first, 0}, msgpack_timestamp{first, 500},
+                                            msgpack_timestamp{first + 1, 0}, msgpack_timestamp{first + 20, 1}})
+            {
+                msgpack_timestamp from{first, 0};
+                std::vector<uint64_t> expected;
+
+                for (size_t seq = 0; seq < times.size(); seq++)
+                    if (times[seq].seconds >= 0 && !(times[seq] < from) && times[seq] < until)
+                        expected.push_back(seq);
+
+                std::vector<uint64_t> found;
+                size_t visited = index.scan(from, until, [&found, &times](const uint8_t *record, size_t size, const msgpack_timestamp &time) {
+                    Msgpack view(record, size);
+                    found.push_back(view.get_u64("seq"));
+                    EXPECT_EQ(times[found.back()], time);
+                    return true;
+                });
+
+                ASSERT_EQ(expected, found) << interval << " " << first << " " << until.seconds;
+                EXPECT_EQ(found.size(), visited);
+                EXPECT_EQ(found.size(), index.range(from, until).size());
+            }
+        }
+    }
+}
+
+TEST(time_index, Scan)
+{
+    std::vector<msgpack_timestamp> times;
+    std::vector<uint8_t> data = collection(times);
+    TimeIndex index("at.ts", 16);
+    index.append(data);
+
+    // the visitor gets the record and its decoded timestamp, and stops the scan
+    size_t calls = 0;
+    size_t visited = index.scan({1700000010, 0}, {1700000100, 0}, [&](const uint8_t *record, size_t size, const msgpack_timestamp &time) {
+        Msgpack view(record, size);
+        msgpack_timestamp stored;
+        EXPECT_TRUE(read_timestamp(view.find_path("at.ts"), stored));
+        EXPECT_EQ(time, stored);
+        return ++calls < 5;
+    });
+    EXPECT_EQ(5, calls);
+    EXPECT_EQ(5, visited);
+
+    std::deque<Msgpack> records = index.range({1700000010, 0}, {1700000011, 0});
+    ASSERT_FALSE(records.empty());
+    EXPECT_EQ(70, records.front().get_u64("seq"));
+    EXPECT_EQ(76, records.back().get_u64("seq"));
+
+    // empty and inverted ranges, ranges outside the collection
+    EXPECT_TRUE(index.range({1700000010, 0}, {1700000010, 0}).empty());
+    EXPECT_TRUE(index.range({1700000011, 0}, {1700000010, 0}).empty());
+    EXPECT_TRUE(index.range({0, 0}, {1000, 0}).empty());
+    EXPECT_TRUE(index.range({1800000000, 0}, {1900000000, 0}).empty());
+
+    EXPECT_EQ(index.indexed_bytes(), index.lower_bound({1800000000, 0}));
+    EXPECT_EQ(index.range({0, 0}, {1700000001, 0}).front().data(), data.data() + index.lower_bound({0, 0}));
+
+    // a collection without timestamps at the path
+    TimeIndex other("ts", 16);
+    other.append(data);
+    EXPECT_EQ(times.size(), other.untimed());
+    EXPECT_EQ(0, other.samples());
+    EXPECT_TRUE(other.range({0, 0}, {1900000000, 0}).empty());
+    EXPECT_EQ(data.size(), other.lower_bound({0, 0}));
+}
+
+TEST(time_index, Append)
+{
+    std::vector<msgpack_timestamp> times;
+    std::vector<uint8_t> data = collection(times);
+    std::vector<uint8_t> growing;
+    TimeIndex index("at.ts", 8);
+
+    // the collection grows in chunks that split records
+    size_t added = 0;
+    for (size_t size = 0; size < data.size(); size += 1001)
+    {
+        growing.assign(data.begin(), data.begin() + std::min(data.size(), size + 1001));
+        added += index.append(growing);
+        EXPECT_LE(index.indexed_bytes(), growing.size());
+    }
+
+    EXPECT_EQ(times.size(), added);
+    EXPECT_EQ(data.size(), index.indexed_bytes());
+    EXPECT_EQ(20, index.range({1700000010, 0}, {1700000013, 0}).size());
+
+    EXPECT_THROW(index.append(data.data(), data.size() - 1), std::invalid_argument);
+
+    // an older record stops the append after the records before it
+    Packer packer(data);
+    msgpack_timestamp newer{1800000000, 0};
+    msgpack_timestamp older{1700000000, 0};
+    pack_timed(packer, 2000, &newer);
+    size_t older_offset = data.size();
+    pack_timed(packer, 2001, &older);
+    pack_timed(packer, 2002, &newer);
+
+    EXPECT_THROW(index.append(data), std::invalid_argument);
+    EXPECT_EQ(older_offset, index.indexed_bytes());
+    EXPECT_EQ(times.size() + 1, index.records());
+    EXPECT_EQ(1, index.range(newer, {1900000000, 0}).size());
+
+    EXPECT_THROW(TimeIndex("a[", 8), parse_error);
+    EXPECT_THROW(TimeIndex("a", 0), std::invalid_argument);
+}
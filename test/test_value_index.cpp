@@ -0,0 +1,138 @@
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "msgpacksearch/error.h"
+#include "msgpacksearch/packer.h"
+#include "msgpacksearch/value_index.h"
+#include "test_records.h"
+
+
+using namespace msgpacksearch;
+
+namespace {
+
+/// {"id": id, "user": {"id": <user>}}
+std::vector<record_member> user_record(uint64_t id, pack_value user)
+{
+    return {{"id", json_value(std::to_string(id))}, {"user", map_value({{"id", std::move(user)}})}};
+}
+
+std::vector<uint8_t> make_records()
+{
+    std::vector<uint8_t> buffer;
+    Packer packer(buffer);
+
+    pack_record(packer, user_record(0, json_value("42")));
+    pack_record(packer, user_record(1, json_value(R"("alice")")));
+    pack_record(packer, user_record(2, json_value("42.0")));
+    pack_record(packer, user_record(3, json_value("-7")));
+    pack_record(packer, user_record(4, [](Packer &p) { p.pack_raw((const uint8_t *)"\xd2\x00\x00\x00\x2a", 5); })); // int 32 42
+    pack_record(packer, user_record(5, json_value("1.5")));
+    pack_record(packer, user_record(6, [](Packer &p) { p.pack_array(0); })); // not indexable
+    pack_record(packer, user_record(7, json_value(R"("bob")")));
+
+    packer.pack_map(0); // no user at all
+
+    return buffer;
+}
+
+std::vector<uint64_t> ids(std::deque<Msgpack> &&records)
+{
+    std::vector<uint64_t> out;
+    for (Msgpack &record : records)
+        out.push_back(record.get_u64("id"));
+    return out;
+}
+
+}
+
+TEST(value_index, Sorted)
+{
+    std::vector<uint8_t> records = make_records();
+    ValueIndex index("user.id");
+
+    EXPECT_EQ(9, index.append(records));
+    EXPECT_EQ(9, index.records());
+    EXPECT_EQ(7, index.entries());
+    EXPECT_EQ(records.size(), index.indexed_bytes());
+
+    // one key for every encoding of 42
+    EXPECT_EQ(std::vector<uint64_t>({0, 2, 4}), ids(index.find(uint64_t(42))));
+    EXPECT_EQ(std::vector<uint64_t>({0, 2, 4}), ids(index.find(int64_t(42))));
+    EXPECT_EQ(std::vector<uint64_t>({0, 2, 4}), ids(index.find(42.0)));
+    EXPECT_EQ(std::vector<uint64_t>({3}), ids(index.find(int64_t(-7))));
+    EXPECT_EQ(std::vector<uint64_t>({1}), ids(index.find("alice")));
+    EXPECT_TRUE(index.find(uint64_t(43)).empty());
+    EXPECT_TRUE(index.find("carol").empty());
+
+    // numbers in value order, then strings
+    EXPECT_EQ(std::vector<uint64_t>({3, 5, 0, 2, 4}), ids(index.range(int64_t(-100), uint64_t(100))));
+    EXPECT_EQ(std::vector<uint64_t>({5}), ids(index.range(1.0, 2.0)));
+    EXPECT_EQ(std::vector<uint64_t>({1, 7}), ids(index.range(std::string_view("a"), std::string_view("bob"))));
+
+    std::vector<uint64_t> offsets = index.find_offsets(uint64_t(42));
+    ASSERT_EQ(3, offsets.size());
+    EXPECT_EQ(0, offsets[0]);
+    EXPECT_EQ(2, index.record(offsets[1]).get_u64("id"));
+    EXPECT_EQ(nullptr, index.record(offsets[1] + 1).data());
+}
+
+TEST(value_index, Keys)
+{
+    std::string a;
+    std::string b;
+
+    // large integers keep their exact value next to their nearest double
+    ASSERT_TRUE(ValueIndex::encode_key(uint64_t(9007199254740993ULL), a));
+    ASSERT_TRUE(ValueIndex::encode_key(uint64_t(9007199254740992ULL), b));
+    EXPECT_LT(b, a);
+    ASSERT_TRUE(ValueIndex::encode_key(int64_t(-9007199254740993LL), a));
+    ASSERT_TRUE(ValueIndex::encode_key(int64_t(-9007199254740992LL), b));
+    EXPECT_LT(a, b);
+
+    // integral doubles are keyed as the integer they hold
+    ASSERT_TRUE(ValueIndex::encode_key(9007199254740992.0, a));
+    ASSERT_TRUE(ValueIndex::encode_key(uint64_t(9007199254740992ULL), b));
+    EXPECT_EQ(a, b);
+
+    ASSERT_TRUE(ValueIndex::encode_key(int64_t(-1), a));
+    ASSERT_TRUE(ValueIndex::encode_key(-0.5, b));
+    EXPECT_LT(a, b);
+    ASSERT_TRUE(ValueIndex::encode_key(-0.0, a));
+    ASSERT_TRUE(ValueIndex::encode_key(msgpack_object(uint64_t(0)), b));
+    EXPECT_EQ(a, b);
+
+    EXPECT_FALSE(ValueIndex::encode_key(std::numeric_limits<double>::quiet_NaN(), a));
+    EXPECT_FALSE(ValueIndex::encode_key(msgpack_array(0, 0, nullptr), a));
+}
+
+TEST(value_index, HashedAppend)
+{
+    std::vector<uint8_t> records = make_records();
+    ValueIndex index("user.id", ValueIndex::kind::hashed);
+
+    // the collection grows, "bob" is cut in the middle
+    size_t cut = records.size() - 3;
+    EXPECT_EQ(7, index.append(records.data(), cut));
+    EXPECT_EQ(std::vector<uint64_t>({0, 2, 4}), ids(index.find(uint64_t(42))));
+    EXPECT_TRUE(index.find("bob").empty());
+
+    // the rest arrives, in a buffer that moved
+    std::vector<uint8_t> grown = records;
+    Packer packer(grown);
+    pack_record(packer, user_record(8, json_value("42")));
+
+    EXPECT_EQ(3, index.append(grown));
+    EXPECT_EQ(10, index.records());
+    EXPECT_EQ(std::vector<uint64_t>({7}), ids(index.find("bob")));
+    EXPECT_EQ(std::vector<uint64_t>({0, 2, 4, 8}), ids(index.find(uint64_t(42))));
+    EXPECT_THROW(index.range(uint64_t(0), uint64_t(1)), std::logic_error);
+    EXPECT_THROW(index.append(grown.data(), 3), std::invalid_argument);
+
+    std::vector<uint8_t> invalid = grown;
+    invalid.push_back(0xc1);
+    EXPECT_THROW(index.append(invalid), parse_error);
+}